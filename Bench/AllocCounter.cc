@@ -0,0 +1,67 @@
+// Replaces the global `operator new`/`delete` to count the live heap bytes;
+// kept in its own translation unit so that they are never inlined into callers.
+
+#include "AllocCounter.hh"
+
+#include <stdlib.h>
+#include <cstddef>
+#include <atomic>
+#include <new>
+
+namespace
+{
+
+std::atomic<size_t> gLiveBytes{0};
+
+/// Allocations are prefixed with their size, padded so that the returned
+/// pointer is still aligned for any fundamental type.
+constexpr const size_t ALLOC_HEADER_SIZE = alignof(std::max_align_t);
+
+}
+
+size_t liveHeapBytes()
+{
+    return gLiveBytes.load();
+}
+
+void* operator new(size_t size)
+{
+    void* mem = malloc(size + ALLOC_HEADER_SIZE);
+    if(!mem)
+    {
+        throw std::bad_alloc();
+    }
+    *reinterpret_cast<size_t*>(mem) = size;
+    gLiveBytes += size;
+    return reinterpret_cast<char*>(mem) + ALLOC_HEADER_SIZE;
+}
+
+void operator delete(void* ptr) noexcept
+{
+    if(ptr)
+    {
+        void* mem = reinterpret_cast<char*>(ptr) - ALLOC_HEADER_SIZE;
+        gLiveBytes -= *reinterpret_cast<size_t*>(mem);
+        free(mem);
+    }
+}
+
+void* operator new[](size_t size)
+{
+    return operator new(size);
+}
+
+void operator delete[](void* ptr) noexcept
+{
+    operator delete(ptr);
+}
+
+void operator delete(void* ptr, size_t size) noexcept
+{
+    operator delete(ptr);
+}
+
+void operator delete[](void* ptr, size_t size) noexcept
+{
+    operator delete(ptr);
+}
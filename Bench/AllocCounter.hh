@@ -0,0 +1,9 @@
+#pragma once
+
+#include <stddef.h>
+
+/// Returns the number of bytes currently allocated via `operator new` (in any
+/// of its forms) and not `delete`d yet.
+/// Linking `AllocCounter.cc` replaces the global `operator new`/`delete` to
+/// keep this count.
+size_t liveHeapBytes();
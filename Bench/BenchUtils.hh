@@ -0,0 +1,72 @@
+#pragma once
+
+#include <stdio.h>
+#include <chrono>
+#include <vector>
+#include <string>
+#include <utility>
+
+/// Runs `func()` `nRepeats` times and returns the average time per run, in ms.
+template <typename Func>
+inline double timeMs(unsigned int nRepeats, const Func& func)
+{
+    using Clock = std::chrono::steady_clock;
+
+    auto start = Clock::now();
+    for(unsigned int i = 0; i < nRepeats; i ++)
+    {
+        func();
+    }
+    auto end = Clock::now();
+    return std::chrono::duration<double, std::milli>(end - start).count() / nRepeats;
+}
+
+/// Collects results and prints them as a JSON document.
+class JsonReport
+{
+    using Fields = std::vector<std::pair<std::string, double>>;
+    std::string benchmark_;
+    Fields params_;
+    std::vector<std::pair<std::string, Fields>> results_;
+
+public:
+    /// Initializes a report for the benchmark executable named `benchmark`.
+    JsonReport(const char* benchmark)
+        : benchmark_(benchmark)
+    {
+    }
+
+    /// Adds a top-level parameter the benchmark was run with (`nRepeats`...).
+    void param(const char* name, double value)
+    {
+        params_.emplace_back(name, value);
+    }
+
+    /// Adds a result with the given name and numeric fields.
+    void add(const char* name, Fields fields)
+    {
+        results_.emplace_back(name, std::move(fields));
+    }
+
+    void print() const
+    {
+        printf("{\n");
+        printf("  \"benchmark\": \"%s\",\n", benchmark_.c_str());
+        for(const auto& param : params_)
+        {
+            printf("  \"%s\": %.15g,\n", param.first.c_str(), param.second);
+        }
+        printf("  \"results\": [\n");
+        for(size_t i = 0; i < results_.size(); i ++)
+        {
+            printf("    {\"name\": \"%s\"", results_[i].first.c_str());
+            for(const auto& field : results_[i].second)
+            {
+                printf(", \"%s\": %.6g", field.first.c_str(), field.second);
+            }
+            printf("}%s\n", i + 1 < results_.size() ? "," : "");
+        }
+        printf("  ]\n");
+        printf("}\n");
+    }
+};
@@ -0,0 +1,283 @@
+// Ares.Bench.GfxOrder - Measures the cost of ordering rendering commands and
+// prints the results as JSON:
+//  - sorting `GfxCmdIndex`es with `std::sort()` vs `radixSort()`, serially and
+//    with a varying number of worker threads
+//  - recording commands into `GfxRenderer` from the main thread vs from tasks
+//  - `GfxRenderer::renderFrame()` (key generation + sorting) on a backend that
+//    runs nothing but counts the texture rebinds in the final order
+// Each for 1k, 10k and 100k commands.
+//
+// Usage: Ares.Bench.GfxOrder [nRepeats] > results.json
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <random>
+#include <vector>
+#include <thread>
+#include <algorithm>
+#include <Core/Base/Ref.hh>
+#include <Core/Task/TaskScheduler.hh>
+#include <Core/Task/ParallelFor.hh>
+#include <Core/Task/RadixSort.hh>
+#include <Core/Gfx/GfxCmd.hh>
+#include <Core/Gfx/GfxPipeline.hh>
+#include <Core/Gfx/GfxBackend.hh>
+#include <Core/Gfx/GfxRenderer.hh>
+#include "BenchUtils.hh"
+
+using namespace Ares;
+
+namespace
+{
+
+/// The number of passes in the benchmark's pipeline.
+static constexpr const unsigned int N_PASSES = 3;
+
+/// The number of textures materials pick theirs from.
+static constexpr const unsigned int N_TEXTURES = 64;
+
+/// The number of materials (combinations of textures) commands pick theirs from.
+static constexpr const unsigned int N_MATERIALS = 256;
+
+/// The number of commands recorded by each task when recording in parallel.
+static constexpr const size_t RECORD_CHUNK_SIZE = 1024;
+
+/// A backend that has no resources and runs no commands, only counting how
+/// many times the bound textures would change (so that only the renderer's
+/// own work is measured).
+class OrderBackend : public GfxBackend
+{
+    U32 nextTextureId_ = 1;
+    std::vector<GfxMaterialDesc> materials_; ///< (Indexed by handle - 1)
+
+public:
+    size_t nCmdsRun = 0; ///< For the last `runCmds()`.
+    size_t nTextureBindChanges = 0; ///< For the last `runCmds()`.
+
+    ErrString init(Ref<GfxPipeline> pipeline) override { return {}; }
+
+    Handle<GfxBuffer> genBuffer(const GfxBufferDesc& desc) override { return {}; }
+    void resizeBuffer(Handle<GfxBuffer> buffer, size_t newSize) override {}
+    void editBuffer(Handle<GfxBuffer> buffer, size_t dataOffset, size_t dataSize, const void* data) override {}
+    void delBuffer(Handle<GfxBuffer> buffer) override {}
+
+    Handle<GfxTexture> genTexture(const GfxTextureDesc& desc) override { return Handle<GfxTexture>(nextTextureId_ ++); }
+    void resizeTexture(Handle<GfxTexture> texture, Resolution newResolution, size_t newDepth) override {}
+    void editTexture(Handle<GfxTexture> texture, ViewCube dataCube, const void* data) override {}
+    void delTexture(Handle<GfxTexture> texture) override {}
+
+    Handle<GfxShader> genShader(const GfxShaderDesc& desc, ErrString* err) override { return {}; }
+    void delShader(Handle<GfxShader> shader) override {}
+
+    Handle<GfxMaterial> genMaterial(const GfxMaterialDesc& desc) override
+    {
+        materials_.push_back(desc);
+        return Handle<GfxMaterial>(U32(materials_.size()));
+    }
+    void delMaterial(Handle<GfxMaterial> material) override {}
+
+    void changeResolution(Resolution resolution) override {}
+
+    void runCmds(const GfxCmdIndex* cmdsOrder, size_t n) override
+    {
+        nCmdsRun = n;
+        nTextureBindChanges = 0;
+        Handle<GfxTexture> boundTextures[GfxMaterialDesc::MAX_TEXTURES] = {};
+        for(size_t i = 0; i < n; i ++)
+        {
+            const GfxMaterialDesc& material = materials_[cmdsOrder[i].cmd->material - 1];
+            for(unsigned int j = 0; j < material.nTextures; j ++)
+            {
+                if(material.textures[j] != boundTextures[j])
+                {
+                    nTextureBindChanges ++;
+                    boundTextures[j] = material.textures[j];
+                }
+            }
+        }
+    }
+};
+
+/// Generates `nCmds` commands spread over all passes, each using one of
+/// `N_MATERIALS` materials (generated via `renderer`) of 1 to 3 of the given textures.
+std::vector<GfxCmd> genCmds(size_t nCmds, GfxRenderer& renderer,
+                            const std::vector<Handle<GfxTexture>>& textures)
+{
+    std::mt19937 rng(1234);
+    std::uniform_int_distribution<unsigned int> passDist(0, N_PASSES - 1);
+    std::uniform_int_distribution<unsigned int> nTexturesDist(1, 3);
+    std::uniform_int_distribution<size_t> textureDist(0, textures.size() - 1);
+    std::uniform_int_distribution<size_t> materialDist(0, N_MATERIALS - 1);
+
+    std::vector<Handle<GfxMaterial>> materials(N_MATERIALS);
+    for(Handle<GfxMaterial>& material : materials)
+    {
+        GfxMaterialDesc desc;
+        desc.nTextures = nTexturesDist(rng);
+        for(unsigned int i = 0; i < desc.nTextures; i ++)
+        {
+            desc.textures[i] = textures[textureDist(rng)];
+        }
+        material = renderer.genMaterial(desc);
+    }
+
+    std::vector<GfxCmd> cmds(nCmds);
+    for(GfxCmd& cmd : cmds)
+    {
+        cmd.material = materials[materialDist(rng)];
+        cmd.op = GfxCmd::Draw;
+        cmd.passId = U8(passDist(rng));
+        cmd.n = 3;
+    }
+    return cmds;
+}
+
+/// Sorts `nCmds` random sort keys laid out like `GfxRenderer`'s.
+void benchSort(JsonReport& report, size_t nCmds, unsigned int nRepeats)
+{
+    std::mt19937_64 rng(1234);
+    std::uniform_int_distribution<unsigned int> passDist(0, N_PASSES - 1);
+    std::uniform_int_distribution<U32> matDist(0, N_MATERIALS * 3); // (~ Nodes in the material tree)
+
+    std::vector<GfxCmdIndex> keys(nCmds);
+    for(size_t i = 0; i < nCmds; i ++)
+    {
+        keys[i].cmd = nullptr; // (Only sorted, never run)
+        keys[i].key = U64(passDist(rng)) << 56 | U64(matDist(rng));
+    }
+    std::vector<GfxCmdIndex> sorted(nCmds), temp(nCmds);
+    auto keyFunc = [](const GfxCmdIndex& cmdIndex)
+    {
+        return cmdIndex.key;
+    };
+
+    // (The copy is part of each run, it is equally cheap for all of them)
+    double stdSortMs = timeMs(nRepeats, [&]()
+    {
+        sorted = keys;
+        std::sort(sorted.begin(), sorted.end());
+    });
+    report.add("sort.stdSort", {{"nCmds", double(nCmds)}, {"ms", stdSortMs},
+                                {"nsPerCmd", stdSortMs * 1e6 / nCmds}});
+
+    double radixMs = timeMs(nRepeats, [&]()
+    {
+        sorted = keys;
+        radixSort(sorted.data(), temp.data(), nCmds, keyFunc);
+    });
+    report.add("sort.radixSort", {{"nCmds", double(nCmds)}, {"ms", radixMs},
+                                  {"nsPerCmd", radixMs * 1e6 / nCmds},
+                                  {"speedup", stdSortMs / radixMs}});
+
+    unsigned int maxWorkers = std::max(std::thread::hardware_concurrency(), 1u);
+    for(unsigned int nWorkers = 1; nWorkers <= maxWorkers; nWorkers *= 2)
+    {
+        TaskScheduler scheduler(nWorkers);
+        double ms = timeMs(nRepeats, [&]()
+        {
+            sorted = keys;
+            radixSort(sorted.data(), temp.data(), nCmds, keyFunc,
+                      &scheduler, GfxRenderer::ORDER_CHUNK_SIZE);
+        });
+        report.add("sort.radixSortParallel", {{"nCmds", double(nCmds)}, {"nWorkers", double(nWorkers)},
+                                              {"ms", ms}, {"nsPerCmd", ms * 1e6 / nCmds},
+                                              {"speedup", stdSortMs / ms}});
+    }
+}
+
+/// Runs frames of `nCmds` commands through a `GfxRenderer` on an `OrderBackend`.
+/// Commands are recorded by tasks on `scheduler` if it is not null, or by this
+/// thread otherwise.
+void benchRenderFrame(JsonReport& report, size_t nCmds, unsigned int nRepeats,
+                      const char* name, TaskScheduler* scheduler)
+{
+    OrderBackend* orderBackend = new OrderBackend();
+    Ref<GfxBackend> backend = intoRef<GfxBackend>(orderBackend);
+    GfxRenderer renderer(backend, scheduler);
+
+    Ref<GfxPipeline> pipeline = makeRef<GfxPipeline>();
+    pipeline->passes.resize(N_PASSES);
+    ErrString err = renderer.init(pipeline);
+    if(err)
+    {
+        fprintf(stderr, "Failed to initialize renderer: %s\n", err.str().c_str());
+        return;
+    }
+
+    GfxTextureDesc textureDesc;
+    textureDesc.resolution = {1, 1};
+    textureDesc.format = {ImageFormat::Channel::UN8};
+    std::vector<Handle<GfxTexture>> textures(N_TEXTURES);
+    for(auto& texture : textures)
+    {
+        texture = backend->genTexture(textureDesc);
+    }
+    std::vector<GfxCmd> cmds = genCmds(nCmds, renderer, textures);
+
+    auto recordFunc = [&renderer, &cmds](size_t begin, size_t end)
+    {
+        renderer.enqueueCmds(cmds.begin() + begin, end - begin);
+    };
+    auto record = [&]()
+    {
+        if(scheduler)
+        {
+            parallelFor(*scheduler, nCmds, RECORD_CHUNK_SIZE, recordFunc);
+        }
+        else
+        {
+            for(size_t i = 0; i < nCmds; i += RECORD_CHUNK_SIZE)
+            {
+                recordFunc(i, std::min(i + RECORD_CHUNK_SIZE, nCmds));
+            }
+        }
+    };
+
+    const Resolution resolution{800, 600};
+    record();
+    renderer.renderFrame(resolution); // (Warmup; grows the renderer's buffers)
+
+    double recordMs = 0.0, ms = 0.0;
+    for(unsigned int r = 0; r < nRepeats; r ++)
+    {
+        recordMs += timeMs(1, record);
+        ms += timeMs(1, [&]()
+        {
+            renderer.renderFrame(resolution);
+        });
+    }
+    recordMs /= nRepeats;
+    ms /= nRepeats;
+
+    report.add(name, {{"nCmds", double(nCmds)},
+                      {"nWorkers", scheduler ? double(scheduler->nWorkers()) : 0.0},
+                      {"recordMs", recordMs}, {"ms", ms}, {"nsPerCmd", ms * 1e6 / nCmds},
+                      {"nCmdsRun", double(orderBackend->nCmdsRun)},
+                      {"nTextureBindChanges", double(orderBackend->nTextureBindChanges)}});
+}
+
+}
+
+int main(int argc, char** argv)
+{
+    unsigned int nRepeats = argc > 1 ? unsigned(atoi(argv[1])) : 20;
+    nRepeats = nRepeats > 0 ? nRepeats : 1;
+
+    JsonReport report("Ares.Bench.GfxOrder");
+    report.param("nRepeats", nRepeats);
+    for(size_t nCmds : {size_t(1000), size_t(10000), size_t(100000)})
+    {
+        benchSort(report, nCmds, nRepeats);
+
+        benchRenderFrame(report, nCmds, nRepeats, "renderFrame.serial", nullptr);
+        unsigned int maxWorkers = std::max(std::thread::hardware_concurrency(), 1u);
+        for(unsigned int nWorkers = 1; nWorkers <= maxWorkers; nWorkers *= 2)
+        {
+            TaskScheduler scheduler(nWorkers);
+            benchRenderFrame(report, nCmds, nRepeats, "renderFrame.parallel", &scheduler);
+        }
+    }
+
+    report.print();
+    return 0;
+}
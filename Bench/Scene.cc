@@ -0,0 +1,401 @@
+// Ares.Bench.Scene - Measures the core operations of the ECS (`Scene`,
+// `CompStore`, `EntityRef`, `SceneView`) and prints the results as JSON:
+//  - create/destroy churn
+//  - random access to components via `EntityRef::comp<T>()`/`constComp<T>()`
+//  - single- and multi-component iteration at varying sparsity
+//  - parallel iteration scaling with the number of worker threads
+//  - memory footprint per 10k entities
+//  - recording + flushing deferred edits via `SceneCmdQueue`, and a check that
+//    commands recorded while flushing (by `create()` init functions) are replayed
+//
+// Exits with a nonzero status if the `SceneCmdQueue` check fails.
+//
+// Usage: Ares.Bench.Scene [nEntities] [nRepeats] > results.json
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <random>
+#include <vector>
+#include <thread>
+#include <algorithm>
+#include <Core/Scene/Scene.hh>
+#include <Core/Scene/EntityRef.hh>
+#include <Core/Scene/SceneIterator.hh>
+#include <Core/Scene/SceneView.hh>
+#include <Core/Scene/SceneCmdQueue.hh>
+#include <Core/Task/TaskScheduler.hh>
+#include "AllocCounter.hh"
+#include "BenchUtils.hh"
+
+using namespace Ares;
+
+namespace
+{
+
+struct PosComp
+{
+    float x, y, z;
+};
+
+struct VelComp
+{
+    float x, y, z;
+};
+
+
+/// Creates `nEntities` entities, then repeatedly destroys a random half of
+/// them and creates as many new ones (so that slots get recycled).
+void benchChurn(JsonReport& report, size_t nEntities, unsigned int nRepeats)
+{
+    Scene scene(nEntities);
+    std::vector<EntityId> entities;
+    entities.reserve(nEntities);
+
+    double createMs = timeMs(1, [&]()
+    {
+        for(size_t i = 0; i < nEntities; i ++)
+        {
+            entities.push_back(scene.create().id());
+        }
+    });
+    report.add("churn.createInitial", {{"ms", createMs}, {"nsPerOp", createMs * 1e6 / nEntities}});
+
+    std::mt19937 rng(1234);
+    size_t nChurned = nEntities / 2;
+    double destroyMs = 0.0, recreateMs = 0.0;
+    for(unsigned int r = 0; r < nRepeats; r ++)
+    {
+        std::shuffle(entities.begin(), entities.end(), rng);
+
+        destroyMs += timeMs(1, [&]()
+        {
+            for(size_t i = 0; i < nChurned; i ++)
+            {
+                scene.destroy(entities[i]);
+            }
+        });
+        recreateMs += timeMs(1, [&]()
+        {
+            for(size_t i = 0; i < nChurned; i ++)
+            {
+                entities[i] = scene.create().id();
+            }
+        });
+    }
+    destroyMs /= nRepeats;
+    recreateMs /= nRepeats;
+    report.add("churn.destroy", {{"ms", destroyMs}, {"nsPerOp", destroyMs * 1e6 / nChurned}});
+    report.add("churn.recreate", {{"ms", recreateMs}, {"nsPerOp", recreateMs * 1e6 / nChurned}});
+
+    // Same churn, but with components (destroying has to erase them)
+    for(EntityId entity : entities)
+    {
+        scene.ref(entity).setComp<PosComp>({0.0f, 0.0f, 0.0f});
+        scene.ref(entity).setComp<VelComp>({1.0f, 0.0f, 0.0f});
+    }
+    destroyMs = 0.0;
+    recreateMs = 0.0;
+    for(unsigned int r = 0; r < nRepeats; r ++)
+    {
+        std::shuffle(entities.begin(), entities.end(), rng);
+
+        destroyMs += timeMs(1, [&]()
+        {
+            for(size_t i = 0; i < nChurned; i ++)
+            {
+                scene.destroy(entities[i]);
+            }
+        });
+        recreateMs += timeMs(1, [&]()
+        {
+            for(size_t i = 0; i < nChurned; i ++)
+            {
+                EntityRef entity = scene.create();
+                entity.setComp<PosComp>({0.0f, 0.0f, 0.0f});
+                entity.setComp<VelComp>({1.0f, 0.0f, 0.0f});
+                entities[i] = entity.id();
+            }
+        });
+    }
+    destroyMs /= nRepeats;
+    recreateMs /= nRepeats;
+    report.add("churn.destroyWith2Comps", {{"ms", destroyMs}, {"nsPerOp", destroyMs * 1e6 / nChurned}});
+    report.add("churn.recreateWith2Comps", {{"ms", recreateMs}, {"nsPerOp", recreateMs * 1e6 / nChurned}});
+}
+
+/// Accesses the components of all entities in random order.
+void benchRandomAccess(JsonReport& report, size_t nEntities, unsigned int nRepeats)
+{
+    Scene scene(nEntities);
+    std::vector<EntityId> entities;
+    entities.reserve(nEntities);
+    for(size_t i = 0; i < nEntities; i ++)
+    {
+        EntityRef entity = scene.create();
+        entity.setComp<PosComp>({float(i), 0.0f, 0.0f});
+        entities.push_back(entity.id());
+    }
+
+    std::mt19937 rng(1234);
+    std::shuffle(entities.begin(), entities.end(), rng);
+
+    volatile float sink = 0.0f;
+    double ms = timeMs(nRepeats, [&]()
+    {
+        float sum = 0.0f;
+        for(EntityId entity : entities)
+        {
+            sum += scene.ref(entity).comp<PosComp>()->x;
+        }
+        sink = sum;
+    });
+    report.add("access.comp", {{"ms", ms}, {"nsPerOp", ms * 1e6 / nEntities}});
+
+    ms = timeMs(nRepeats, [&]()
+    {
+        float sum = 0.0f;
+        for(EntityId entity : entities)
+        {
+            sum += scene.ref(entity).constComp<PosComp>()->x;
+        }
+        sink = sum;
+    });
+    report.add("access.constComp", {{"ms", ms}, {"nsPerOp", ms * 1e6 / nEntities}});
+
+    // (Missing components: the entities are accessed but have no `VelComp`)
+    ms = timeMs(nRepeats, [&]()
+    {
+        size_t nFound = 0;
+        for(EntityId entity : entities)
+        {
+            nFound += scene.ref(entity).constComp<VelComp>() != nullptr;
+        }
+        sink = float(nFound);
+    });
+    report.add("access.constCompMissing", {{"ms", ms}, {"nsPerOp", ms * 1e6 / nEntities}});
+
+    (void)sink;
+}
+
+/// Iterates over `view<PosComp>` and `view<PosComp, VelComp>` when only a
+/// `density` fraction of the entities have a `PosComp` (single) and when all
+/// entities have a `PosComp` but only a `density` fraction a `VelComp` (multi).
+void benchIteration(JsonReport& report, size_t nEntities, unsigned int nRepeats, double density)
+{
+    Scene scene(nEntities);
+    std::mt19937 rng(1234);
+    std::uniform_real_distribution<double> dist(0.0, 1.0);
+
+    for(size_t i = 0; i < nEntities; i ++)
+    {
+        EntityRef entity = scene.create();
+        entity.setComp<PosComp>({float(i), 0.0f, 0.0f});
+        if(dist(rng) < density)
+        {
+            entity.setComp<VelComp>({1.0f, 0.0f, 0.0f});
+        }
+    }
+
+    volatile float sink = 0.0f;
+    size_t nVisited = 0;
+
+    // Single component: iterate over the (sparse) `VelComp`s
+    auto singleView = scene.view<VelComp>();
+    double ms = timeMs(nRepeats, [&]()
+    {
+        float sum = 0.0f;
+        nVisited = 0;
+        singleView.each([&](EntityId entity, VelComp& vel)
+        {
+            sum += vel.x;
+            nVisited ++;
+        });
+        sink = sum;
+    });
+    report.add("iterate.single", {{"density", density}, {"ms", ms}, {"nVisited", double(nVisited)},
+                                  {"nsPerVisited", nVisited > 0 ? ms * 1e6 / nVisited : 0.0}});
+
+    // Multiple components: join the dense `PosComp`s with the sparse `VelComp`s
+    auto multiView = scene.view<PosComp, VelComp>();
+    ms = timeMs(nRepeats, [&]()
+    {
+        nVisited = 0;
+        multiView.each([&](EntityId entity, PosComp& pos, VelComp& vel)
+        {
+            pos.x += vel.x;
+            nVisited ++;
+        });
+    });
+    report.add("iterate.multi", {{"density", density}, {"ms", ms}, {"nVisited", double(nVisited)},
+                                 {"nsPerVisited", nVisited > 0 ? ms * 1e6 / nVisited : 0.0}});
+
+    // All entities, via `Scene::iterator`
+    ms = timeMs(nRepeats, [&]()
+    {
+        nVisited = 0;
+        for(auto it = scene.begin(); it != scene.end(); ++ it)
+        {
+            nVisited ++;
+        }
+    });
+    report.add("iterate.entities", {{"density", density}, {"ms", ms},
+                                    {"nsPerVisited", nVisited > 0 ? ms * 1e6 / nVisited : 0.0}});
+
+    (void)sink;
+}
+
+/// Runs `view<PosComp, VelComp>().eachParallel()` with 1, 2, 4... worker threads.
+void benchParallel(JsonReport& report, size_t nEntities, unsigned int nRepeats)
+{
+    Scene scene(nEntities);
+    for(size_t i = 0; i < nEntities; i ++)
+    {
+        EntityRef entity = scene.create();
+        entity.setComp<PosComp>({float(i), 0.0f, 0.0f});
+        entity.setComp<VelComp>({1.0f, 2.0f, 3.0f});
+    }
+    auto view = scene.view<PosComp, VelComp>();
+
+    auto updateFunc = [](EntityId entity, PosComp& pos, VelComp& vel)
+    {
+        // (Some arithmetic, so that this is not entirely memory bound)
+        for(int i = 0; i < 8; i ++)
+        {
+            pos.x += vel.x * 0.01f;
+            pos.y += vel.y * 0.01f;
+            pos.z += vel.z * 0.01f;
+        }
+    };
+
+    double serialMs = timeMs(nRepeats, [&]()
+    {
+        view.each(updateFunc);
+    });
+    report.add("parallel.serial", {{"ms", serialMs}});
+
+    unsigned int maxWorkers = std::max(std::thread::hardware_concurrency(), 1u);
+    for(unsigned int nWorkers = 1; nWorkers <= maxWorkers; nWorkers *= 2)
+    {
+        TaskScheduler scheduler(nWorkers);
+        double ms = timeMs(nRepeats, [&]()
+        {
+            view.eachParallel(scheduler, 16 * 1024, updateFunc);
+        });
+        report.add("parallel.eachParallel", {{"nWorkers", double(nWorkers)}, {"ms", ms},
+                                             {"speedup", serialMs / ms}});
+    }
+}
+
+/// Measures the heap memory used by a scene as entities with components are added.
+void benchMemory(JsonReport& report, size_t nEntities)
+{
+    static constexpr const size_t BATCH_SIZE = 10000;
+
+    // (Only add to the report after measuring; it allocates too)
+    size_t baseBytes = liveHeapBytes();
+    Scene* scene = new Scene(nEntities);
+    size_t emptyBytes = liveHeapBytes() - baseBytes;
+
+    size_t nCreated = 0;
+    for(; nCreated < nEntities; nCreated ++)
+    {
+        EntityRef entity = scene->create();
+        entity.setComp<PosComp>({0.0f, 0.0f, 0.0f});
+        entity.setComp<VelComp>({0.0f, 0.0f, 0.0f});
+    }
+    size_t fullBytes = liveHeapBytes() - baseBytes - emptyBytes;
+
+    delete scene;
+    size_t leakedBytes = liveHeapBytes() - baseBytes;
+
+    double bytesPerEntity = double(fullBytes) / double(nCreated > 0 ? nCreated : 1);
+    report.add("memory.emptyScene", {{"maxEntities", double(nEntities)}, {"bytes", double(emptyBytes)}});
+    report.add("memory.per10kEntitiesWith2Comps",
+               {{"nEntities", double(nCreated)}, {"bytes", bytesPerEntity * BATCH_SIZE},
+                {"bytesPerEntity", bytesPerEntity},
+                {"payloadBytesPerEntity", double(sizeof(PosComp) + sizeof(VelComp))}});
+    report.add("memory.leakedAfterDelete", {{"bytes", double(leakedBytes)}});
+}
+
+/// Records `nEntities` deferred creations whose init functions each set a
+/// component and record another edit (from the flushing thread), then flushes
+/// them. Returns `false` if any of the edits recorded while flushing was lost.
+bool benchCmdQueue(JsonReport& report, size_t nEntities, unsigned int nRepeats)
+{
+    TaskScheduler scheduler(1);
+    SceneCmdQueue cmds(&scheduler);
+
+    double recordMs = 0.0, flushMs = 0.0;
+    bool ok = true;
+    for(unsigned int r = 0; r < nRepeats; r ++)
+    {
+        Scene scene(nEntities);
+        size_t nEntitiesHalf = nEntities / 2;
+        recordMs += timeMs(1, [&]()
+        {
+            for(size_t i = 0; i < nEntitiesHalf; i ++)
+            {
+                cmds.create([&cmds](EntityRef entity)
+                {
+                    entity.setComp<PosComp>({0.0f, 0.0f, 0.0f});
+
+                    // (Appends to the buffer being replayed; replayed in the same flush)
+                    cmds.set<VelComp>(entity.id(), {1.0f, 2.0f, 3.0f});
+                    cmds.create([](EntityRef child)
+                    {
+                        child.setComp<PosComp>({1.0f, 1.0f, 1.0f});
+                    });
+                });
+            }
+        });
+        flushMs += timeMs(1, [&]()
+        {
+            cmds.flush(scene);
+        });
+
+        CompStore<PosComp>* posStore = scene.storeFor<PosComp>();
+        CompStore<VelComp>* velStore = scene.storeFor<VelComp>();
+        ok = ok && cmds.size() == 0 && scene.nEntities() == 2 * nEntitiesHalf
+             && posStore && posStore->size() == 2 * nEntitiesHalf
+             && velStore && velStore->size() == nEntitiesHalf;
+    }
+    recordMs /= nRepeats;
+    flushMs /= nRepeats;
+
+    report.add("cmdQueue.record", {{"nCmds", double(nEntities / 2)}, {"ms", recordMs},
+                                   {"nsPerCmd", recordMs * 1e6 / (nEntities / 2)}});
+    report.add("cmdQueue.flush", {{"nCmds", double(nEntities / 2 * 3)}, {"ms", flushMs},
+                                  {"nsPerCmd", flushMs * 1e6 / (nEntities / 2 * 3)}});
+    report.add("cmdQueue.check", {{"ok", ok ? 1.0 : 0.0}});
+    return ok;
+}
+
+}
+
+int main(int argc, char** argv)
+{
+    size_t nEntities = argc > 1 ? size_t(atol(argv[1])) : 1024 * 1024;
+    unsigned int nRepeats = argc > 2 ? unsigned(atoi(argv[2])) : 10;
+    nRepeats = nRepeats > 0 ? nRepeats : 1;
+
+    JsonReport report("Ares.Bench.Scene");
+    report.param("nEntities", double(nEntities));
+    report.param("nRepeats", nRepeats);
+    benchChurn(report, nEntities, nRepeats);
+    benchRandomAccess(report, nEntities, nRepeats);
+    for(double density : {0.01, 0.1, 0.5, 1.0})
+    {
+        benchIteration(report, nEntities, nRepeats, density);
+    }
+    benchParallel(report, nEntities, nRepeats);
+    benchMemory(report, nEntities);
+    bool cmdQueueOk = benchCmdQueue(report, nEntities, nRepeats);
+
+    report.print();
+    if(!cmdQueueOk)
+    {
+        fprintf(stderr, "SceneCmdQueue lost commands recorded while flushing\n");
+        return 1;
+    }
+    return 0;
+}
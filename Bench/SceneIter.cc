@@ -0,0 +1,114 @@
+// Ares.Bench.SceneIter - Measures the cost of iterating over a scene's entities,
+// over a `CompStore` and over a `SceneView` at 1%, 10% and 90% occupancy.
+//
+// Usage: Ares.Bench.SceneIter [nEntities] [nRepeats]
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <random>
+#include <vector>
+#include <algorithm>
+#include <Core/Scene/Scene.hh>
+#include <Core/Scene/EntityRef.hh>
+#include <Core/Scene/SceneIterator.hh>
+#include <Core/Scene/SceneView.hh>
+#include "BenchUtils.hh"
+
+using namespace Ares;
+
+namespace
+{
+
+struct PosComp
+{
+    float x, y, z;
+};
+
+void report(const char* name, float occupancy, double ms, size_t nVisited)
+{
+    printf("%-16s %5.1f%% %10.3f ms %8.2f ns/visited (%zu visited)\n",
+           name, occupancy * 100.0f, ms, nVisited > 0 ? ms * 1e6 / nVisited : 0.0, nVisited);
+}
+
+/// Fills a scene with `nEntities` entities with a `PosComp` each, then destroys
+/// a random `(1 - occupancy)` fraction of them and benchmarks iterating over the rest.
+void benchOccupancy(size_t nEntities, float occupancy, unsigned int nRepeats)
+{
+    Scene scene(nEntities);
+
+    std::vector<EntityId> entities;
+    entities.reserve(nEntities);
+    for(size_t i = 0; i < nEntities; i ++)
+    {
+        EntityRef entity = scene.create();
+        entity.setComp<PosComp>({float(i), 0.0f, 0.0f});
+        entities.push_back(entity.id());
+    }
+
+    std::mt19937 rng(1234);
+    std::shuffle(entities.begin(), entities.end(), rng);
+    size_t nToDestroy = size_t(double(nEntities) * (1.0 - occupancy));
+    for(size_t i = 0; i < nToDestroy; i ++)
+    {
+        scene.destroy(entities[i]);
+    }
+
+    // (Accumulate something so that the loops are not optimized away)
+    volatile float sink = 0.0f;
+
+    size_t nVisited = 0;
+    double ms = timeMs(nRepeats, [&]()
+    {
+        nVisited = 0;
+        for(auto it = scene.begin(); it != scene.end(); ++ it)
+        {
+            nVisited ++;
+        }
+    });
+    report("Scene::iterator", occupancy, ms, nVisited);
+
+    CompStore<PosComp>* store = scene.storeFor<PosComp>();
+    ms = timeMs(nRepeats, [&]()
+    {
+        nVisited = 0;
+        float sum = 0.0f;
+        for(auto it = store->begin(); it != store->end(); ++ it)
+        {
+            sum += it->component->x;
+            nVisited ++;
+        }
+        sink = sum;
+    });
+    report("CompStore::iter", occupancy, ms, nVisited);
+
+    auto view = scene.view<PosComp>();
+    ms = timeMs(nRepeats, [&]()
+    {
+        nVisited = 0;
+        float sum = 0.0f;
+        view.each([&](EntityId entity, PosComp& pos)
+        {
+            sum += pos.x;
+            nVisited ++;
+        });
+        sink = sum;
+    });
+    report("SceneView::each", occupancy, ms, nVisited);
+
+    (void)sink;
+}
+
+}
+
+int main(int argc, char** argv)
+{
+    size_t nEntities = argc > 1 ? size_t(atol(argv[1])) : 1024 * 1024;
+    unsigned int nRepeats = argc > 2 ? unsigned(atoi(argv[2])) : 20;
+
+    printf("Ares.Bench.SceneIter: %zu entities, %u repeats\n", nEntities, nRepeats);
+    for(float occupancy : {0.01f, 0.10f, 0.90f})
+    {
+        benchOccupancy(nEntities, occupancy, nRepeats);
+    }
+    return 0;
+}
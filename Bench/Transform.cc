@@ -0,0 +1,134 @@
+// Ares.Bench.Transform - Measures computing model matrices with
+// `TransformBatch::computeMatrices()` against calling `TransformComp::matrix()`
+// for each transform, and checks that both give the same matrices; prints the
+// results as JSON:
+//  - per-transform `TransformComp::matrix()`
+//  - `TransformBatch::computeMatrices()` (SoA, SSE when available)
+//  - the largest difference between any two corresponding matrix elements
+// Each for 1k, 10k and 100k transforms.
+//
+// Exits with a nonzero status if any difference is larger than `MAX_ERROR`.
+//
+// Usage: Ares.Bench.Transform [nRepeats] > results.json
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <math.h>
+#include <random>
+#include <vector>
+#include <algorithm>
+#include <glm/mat4x4.hpp>
+#include <Core/Comp/TransformComp.hh>
+#include <Core/Comp/TransformBatch.hh>
+#include "BenchUtils.hh"
+
+using namespace Ares;
+
+namespace
+{
+
+/// The largest acceptable absolute difference between the elements of the
+/// batched and per-transform matrices (positions are in `[-100, 100]`, so
+/// this is relative to float's precision at that magnitude).
+static constexpr const double MAX_ERROR = 1e-4;
+
+/// Generates `n` random transforms (with non-normalized rotations, as
+/// `TransformComp::matrix()` normalizes them).
+std::vector<TransformComp> randomTransforms(size_t n)
+{
+    std::mt19937 rng(1234);
+    std::uniform_real_distribution<float> posDist(-100.0f, 100.0f);
+    std::uniform_real_distribution<float> rotDist(-2.0f, 2.0f);
+    std::uniform_real_distribution<float> scaleDist(0.1f, 10.0f);
+
+    std::vector<TransformComp> transforms(n);
+    for(TransformComp& transform : transforms)
+    {
+        transform.position = {posDist(rng), posDist(rng), posDist(rng)};
+        transform.rotation = glm::quat(rotDist(rng), rotDist(rng), rotDist(rng), rotDist(rng));
+        transform.scale = {scaleDist(rng), scaleDist(rng), scaleDist(rng)};
+    }
+    return transforms;
+}
+
+/// Benchmarks both ways of computing the matrices of `nTransforms` transforms.
+/// Returns the largest difference between them.
+double benchMatrices(JsonReport& report, size_t nTransforms, unsigned int nRepeats)
+{
+    std::vector<TransformComp> transforms = randomTransforms(nTransforms);
+    std::vector<glm::mat4> perTransform(nTransforms), batched(nTransforms);
+
+    double ms = timeMs(nRepeats, [&]()
+    {
+        for(size_t i = 0; i < nTransforms; i ++)
+        {
+            perTransform[i] = transforms[i].matrix();
+        }
+    });
+    report.add("matrix.perTransform", {{"nTransforms", double(nTransforms)}, {"ms", ms},
+                                       {"nsPerTransform", ms * 1e6 / nTransforms}});
+    double perTransformMs = ms;
+
+    TransformBatch batch;
+    batch.reserve(nTransforms);
+    ms = timeMs(nRepeats, [&]()
+    {
+        batch.clear();
+        for(const TransformComp& transform : transforms)
+        {
+            batch.push(transform);
+        }
+    });
+    report.add("matrix.batchFill", {{"nTransforms", double(nTransforms)}, {"ms", ms},
+                                    {"nsPerTransform", ms * 1e6 / nTransforms}});
+
+    ms = timeMs(nRepeats, [&]()
+    {
+        batch.computeMatrices(batched.data());
+    });
+    report.add("matrix.batchCompute", {{"nTransforms", double(nTransforms)}, {"ms", ms},
+                                       {"nsPerTransform", ms * 1e6 / nTransforms},
+                                       {"speedup", ms > 0.0 ? perTransformMs / ms : 0.0}});
+
+    double maxError = 0.0;
+    for(size_t i = 0; i < nTransforms; i ++)
+    {
+        for(int col = 0; col < 4; col ++)
+        {
+            for(int row = 0; row < 4; row ++)
+            {
+                double error = fabs(double(perTransform[i][col][row]) - double(batched[i][col][row]));
+                maxError = std::max(maxError, error);
+            }
+        }
+    }
+    report.add("matrix.check", {{"nTransforms", double(nTransforms)}, {"maxError", maxError},
+                                {"ok", maxError <= MAX_ERROR ? 1.0 : 0.0}});
+    return maxError;
+}
+
+}
+
+int main(int argc, char** argv)
+{
+    unsigned int nRepeats = argc > 1 ? unsigned(atoi(argv[1])) : 20;
+    nRepeats = nRepeats > 0 ? nRepeats : 1;
+
+    JsonReport report("Ares.Bench.Transform");
+    report.param("nRepeats", nRepeats);
+    report.param("maxAllowedError", MAX_ERROR);
+
+    double maxError = 0.0;
+    for(size_t nTransforms : {size_t(1000), size_t(10000), size_t(100000)})
+    {
+        maxError = std::max(maxError, benchMatrices(report, nTransforms, nRepeats));
+    }
+
+    report.print();
+    if(maxError > MAX_ERROR)
+    {
+        fprintf(stderr, "TransformBatch matrices differ from TransformComp::matrix() by %g\n", maxError);
+        return 1;
+    }
+    return 0;
+}
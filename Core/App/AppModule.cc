@@ -8,10 +8,10 @@ namespace Ares
 {
 
 AppModule::AppModule(const Path& dllPath)
-    : dll_(dllPath, true),
+    : dllPath_(dllPath),
       dllModule_(nullptr), dllLoadFunc_(nullptr), dllUnloadFunc_(nullptr)
 {
-    // NOTE IMPORTANT `doNotFree` is set in `Dll`'s constructor. This is because
+    // NOTE IMPORTANT `doNotFree` is set when `dll_` is loaded by `initTask()`. This is because
     //      messages logged into `core.g().log` or any other pointers/refs/data
     //      somewhat shared inbetween the app library and Ares' executable
     //      **WOULD GET CORRUPTED IF ~Dll() WAS CALLED**!!
@@ -25,6 +25,30 @@ AppModule::~AppModule()
 
 #define glog (*core.g().log)
 
+const char* AppModule::name() const
+{
+    return "App";
+}
+
+std::vector<const char*> AppModule::initDeps() const
+{
+    // The app module is initialized after all (attached) engine modules, since
+    // application code is likely to make use of them
+    return {ALL_MODULES};
+}
+
+Task AppModule::initTask(Core& core)
+{
+    static const auto initFunc = [](TaskScheduler* scheduler, void* data)
+    {
+        // Load the library (and run its static initializers) off the main thread
+        auto appMod = reinterpret_cast<AppModule*>(data);
+        appMod->dll_ = Dll(appMod->dllPath_, true);
+    };
+
+    return {initFunc, this};
+}
+
 bool AppModule::init(Core& core)
 {
     if(!dll_)
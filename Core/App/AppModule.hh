@@ -26,7 +26,8 @@ public:
     static constexpr const char* UNLOAD_FUNC_NAME = "ARES_unloadAppModule";
 
 private:
-    Dll dll_;
+    Path dllPath_;
+    Dll dll_; ///< Loaded by `initTask()`.
     LoadFunc dllLoadFunc_;
     UnloadFunc dllUnloadFunc_;
     Module* dllModule_;
@@ -37,6 +38,9 @@ public:
     AppModule(const Path& dllPath);
     ~AppModule() override;
 
+    const char* name() const override;
+    std::vector<const char*> initDeps() const override;
+    Task initTask(Core& core) override;
     bool init(Core& core) override;
     void mainUpdate(Core& core) override;
     Task updateTask(Core& core) override;
@@ -1,5 +1,6 @@
 #pragma once
 
+#include <utility>
 #include <Core/Data/Path.hh>
 
 #include <Core/Base/Platform.h>
@@ -23,10 +24,24 @@ class Dll
     Dll(const Dll& toCopy) = delete;
     Dll& operator=(const Dll& toCopy) = delete;
 
+    /// Unloads any loaded library if `doNotFree` was not set, and resets the handle.
+    void close()
+    {
+        if(handle_ && !doNotFree_)
+        {
+#ifdef ARES_PLATFORM_IS_WINDOWS
+            FreeLibrary((HMODULE)handle_);
+#else
+            dlclose(handle_);
+#endif
+        }
+        handle_ = nullptr;
+    }
+
 public:
     /// Creates a new `Dll` without actually loading any library.
     Dll()
-        : handle_(nullptr), doNotFree_(false)
+        : doNotFree_(false), handle_(nullptr)
     {
     }
 
@@ -37,7 +52,7 @@ public:
     /// `~Dll()` is run! This is useful to keep a library open for the whole lifetime
     /// of a program; the OS will unload them afterwards anyways
     Dll(const Path& path, bool doNotFree=false)
-        : handle_(nullptr), path_(path), doNotFree_(doNotFree)
+        : path_(path), doNotFree_(doNotFree), handle_(nullptr)
     {
         reload();
     }
@@ -46,7 +61,7 @@ public:
     /// at `path()`. Returns `false` on failure (sets `operator bool()` to `false` as well).
     bool reload()
     {
-        (void)this->~Dll();
+        close();
 
 #ifdef ARES_PLATFORM_IS_WINDOWS
         handle_ = (void*)LoadLibrary(path_.str().c_str());
@@ -57,18 +72,19 @@ public:
     }
 
     Dll(Dll&& toMove)
+        : doNotFree_(false), handle_(nullptr)
     {
         (void)operator=(std::move(toMove));
     }
 
     Dll& operator=(Dll&& toMove)
     {
-        // Move data over
-        path_ = std::move(toMove.path_);
-        handle_ = std::move(toMove.handle_);
-
-        // Invalidate the moved instance
-        toMove.handle_ = nullptr;
+        // Unload any library this `Dll` was holding, then swap data with the
+        // moved instance (which is left with no library)
+        close();
+        std::swap(path_, toMove.path_);
+        std::swap(doNotFree_, toMove.doNotFree_);
+        std::swap(handle_, toMove.handle_);
 
         return *this;
     }
@@ -76,15 +92,7 @@ public:
     /// Unloads any loaded library if `doNotFree` was not set.
     ~Dll()
     {
-        if(handle_ && !doNotFree_)
-        {
-#ifdef ARES_PLATFORM_IS_WINDOWS
-            FreeLibrary((HMODULE)handle_);
-#else
-            dlclose(handle_);
-#endif
-            handle_ = nullptr;
-        }
+        close();
     }
 
 
@@ -0,0 +1,97 @@
+#pragma once
+
+#include <math.h>
+#include <glm/vec3.hpp>
+#include <glm/mat4x4.hpp>
+#include <Core/Api.h>
+
+namespace Ares
+{
+
+/// An axis-aligned bounding box.
+struct ARES_API Aabb
+{
+    glm::vec3 min{0.0f, 0.0f, 0.0f}; ///< The minimum corner.
+    glm::vec3 max{0.0f, 0.0f, 0.0f}; ///< The maximum corner.
+
+
+    /// Returns the center of the box.
+    inline glm::vec3 center() const
+    {
+        return (min + max) * 0.5f;
+    }
+
+    /// Returns the half-size of the box along each axis.
+    inline glm::vec3 extents() const
+    {
+        return (max - min) * 0.5f;
+    }
+
+    /// Returns the surface area of the box.
+    inline float area() const
+    {
+        glm::vec3 d = max - min;
+        return 2.0f * (d.x * d.y + d.y * d.z + d.z * d.x);
+    }
+
+    /// Returns `true` if `other` is entirely inside of this box.
+    inline bool contains(const Aabb& other) const
+    {
+        return min.x <= other.min.x && min.y <= other.min.y && min.z <= other.min.z
+               && other.max.x <= max.x && other.max.y <= max.y && other.max.z <= max.z;
+    }
+
+    /// Returns `true` if this box and `other` intersect (or touch).
+    inline bool overlaps(const Aabb& other) const
+    {
+        return min.x <= other.max.x && other.min.x <= max.x
+               && min.y <= other.max.y && other.min.y <= max.y
+               && min.z <= other.max.z && other.min.z <= max.z;
+    }
+
+    /// Returns `true` if the box intersects the sphere at `center` with the given `radius`.
+    inline bool overlapsSphere(const glm::vec3& sphereCenter, float radius) const
+    {
+        float distSq = 0.0f;
+        for(int i = 0; i < 3; i ++)
+        {
+            float d = sphereCenter[i] < min[i] ? min[i] - sphereCenter[i]
+                    : sphereCenter[i] > max[i] ? sphereCenter[i] - max[i]
+                    : 0.0f;
+            distSq += d * d;
+        }
+        return distSq <= radius * radius;
+    }
+
+    /// Returns the box grown by `margin` in all directions.
+    inline Aabb grown(float margin) const
+    {
+        glm::vec3 m{margin, margin, margin};
+        return {min - m, max + m};
+    }
+
+    /// Returns the smallest box containing both `a` and `b`.
+    static inline Aabb merge(const Aabb& a, const Aabb& b)
+    {
+        return {glm::vec3(fminf(a.min.x, b.min.x), fminf(a.min.y, b.min.y), fminf(a.min.z, b.min.z)),
+                glm::vec3(fmaxf(a.max.x, b.max.x), fmaxf(a.max.y, b.max.y), fmaxf(a.max.z, b.max.z))};
+    }
+
+    /// Returns the smallest axis-aligned box containing this box after being
+    /// transformed by the (affine) `matrix`.
+    inline Aabb transformed(const glm::mat4& matrix) const
+    {
+        glm::vec3 c = center(), e = extents();
+        glm::vec3 newCenter, newExtents;
+        for(int i = 0; i < 3; i ++)
+        {
+            newCenter[i] = matrix[3][i]
+                           + matrix[0][i] * c.x + matrix[1][i] * c.y + matrix[2][i] * c.z;
+            newExtents[i] = fabsf(matrix[0][i]) * e.x + fabsf(matrix[1][i]) * e.y
+                            + fabsf(matrix[2][i]) * e.z;
+        }
+        return {newCenter - newExtents, newCenter + newExtents};
+    }
+};
+
+}
@@ -0,0 +1,60 @@
+#pragma once
+
+#include <math.h>
+#include <glm/vec4.hpp>
+#include <glm/mat4x4.hpp>
+#include <Core/Api.h>
+#include <Core/Base/Aabb.hh>
+
+namespace Ares
+{
+
+/// A view frustum, as the 6 planes bounding it.
+struct ARES_API Frustum
+{
+    /// The planes of the frustum (left, right, bottom, top, near, far), as
+    /// `(a, b, c, d)` such that `a*x + b*y + c*z + d >= 0` for points inside.
+    /// Not normalized.
+    glm::vec4 planes[6];
+
+
+    /// Extracts the frustum planes from a view-projection matrix (OpenGL
+    /// conventions: clip space z in `[-w, w]`).
+    static inline Frustum fromMatrix(const glm::mat4& viewProj)
+    {
+        // (Gribb & Hartmann: each plane is row 3 +/- row 0..2 of the matrix)
+        auto row = [&viewProj](int i)
+        {
+            return glm::vec4(viewProj[0][i], viewProj[1][i], viewProj[2][i], viewProj[3][i]);
+        };
+
+        Frustum frustum;
+        frustum.planes[0] = row(3) + row(0);
+        frustum.planes[1] = row(3) - row(0);
+        frustum.planes[2] = row(3) + row(1);
+        frustum.planes[3] = row(3) - row(1);
+        frustum.planes[4] = row(3) + row(2);
+        frustum.planes[5] = row(3) - row(2);
+        return frustum;
+    }
+
+    /// Returns `true` if `box` is (at least partially) inside of the frustum.
+    /// Conservative: boxes near the frustum's corners may be reported as inside.
+    inline bool intersects(const Aabb& box) const
+    {
+        glm::vec3 c = box.center(), e = box.extents();
+        for(const glm::vec4& plane : planes)
+        {
+            // Distance of the center from the plane vs. the box's projected radius
+            float dist = plane.x * c.x + plane.y * c.y + plane.z * c.z + plane.w;
+            float radius = fabsf(plane.x) * e.x + fabsf(plane.y) * e.y + fabsf(plane.z) * e.z;
+            if(dist + radius < 0.0f)
+            {
+                return false;
+            }
+        }
+        return true;
+    }
+};
+
+}
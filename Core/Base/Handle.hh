@@ -1,6 +1,7 @@
 #pragma once
 
 #include <stddef.h>
+#include <functional>
 #include <Core/Api.h>
 #include <Core/Base/NumTypes.hh>
 
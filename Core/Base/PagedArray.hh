@@ -0,0 +1,101 @@
+#pragma once
+
+#include <stddef.h>
+#include <atomic>
+#include <Core/Api.h>
+
+namespace Ares
+{
+
+/// A fixed-capacity array of `T`s, allocated in pages of `PAGE_SIZE` items on
+/// demand (i.e. when any item in the page is first accessed via `operator[]`).
+/// Only the page table is allocated upfront, so memory usage scales with the
+/// range of indices actually in use instead of with the capacity.
+///
+/// Items never move once their page is allocated, so their addresses are stable.
+/// Page allocation is threadsafe and lockless; concurrent access to the items
+/// themselves is up to the user.
+template <typename T, size_t PAGE_SIZE=4096>
+class ARES_API PagedArray
+{
+    size_t capacity_;
+    size_t nPages_;
+    std::atomic<T*>* pages_; ///< Null for pages that were not allocated yet.
+
+    PagedArray(const PagedArray& toCopy) = delete;
+    PagedArray& operator=(const PagedArray& toCopy) = delete;
+
+    PagedArray(PagedArray&& toMove) = delete;
+    PagedArray& operator=(PagedArray&& toMove) = delete;
+
+public:
+    /// Initializes an array that can hold up to `capacity` items, without
+    /// allocating any page.
+    PagedArray(size_t capacity)
+        : capacity_(capacity), nPages_((capacity + PAGE_SIZE - 1) / PAGE_SIZE)
+    {
+        pages_ = new std::atomic<T*>[nPages_];
+        for(size_t i = 0; i < nPages_; i ++)
+        {
+            pages_[i].store(nullptr);
+        }
+    }
+
+    /// Frees all allocated pages.
+    ~PagedArray()
+    {
+        for(size_t i = 0; i < nPages_; i ++)
+        {
+            delete[] pages_[i].load();
+        }
+        delete[] pages_; pages_ = nullptr;
+    }
+
+
+    /// Returns the maximum number of items in the array.
+    inline size_t capacity() const
+    {
+        return capacity_;
+    }
+
+    /// Returns a pointer to the `index`th item, or null if its page was not
+    /// allocated yet (or if `index` is out of bounds).
+    inline T* find(size_t index) const
+    {
+        if(index >= capacity_)
+        {
+            return nullptr;
+        }
+
+        T* page = pages_[index / PAGE_SIZE].load(std::memory_order_acquire);
+        return page ? &page[index % PAGE_SIZE] : nullptr;
+    }
+
+    /// Returns a reference to the `index`th item, allocating its page if needed
+    /// (all items in a new page are value-initialized).
+    /// **WARNING**: `index` must be less than `capacity()`!
+    T& operator[](size_t index)
+    {
+        std::atomic<T*>& pageSlot = pages_[index / PAGE_SIZE];
+
+        T* page = pageSlot.load(std::memory_order_acquire);
+        if(!page)
+        {
+            // Allocate the page, unless another thread does so first
+            T* newPage = new T[PAGE_SIZE]();
+            if(pageSlot.compare_exchange_strong(page, newPage, std::memory_order_acq_rel))
+            {
+                page = newPage;
+            }
+            else
+            {
+                // (`page` was set to the other thread's page)
+                delete[] newPage;
+            }
+        }
+
+        return page[index % PAGE_SIZE];
+    }
+};
+
+}
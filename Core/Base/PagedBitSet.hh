@@ -0,0 +1,157 @@
+#pragma once
+
+#include <stddef.h>
+#include <atomic>
+#include <Core/Api.h>
+#include <Core/Base/NumTypes.hh>
+#include <Core/Base/Utils.hh>
+#include <Core/Base/PagedArray.hh>
+
+namespace Ares
+{
+
+/// A fixed-capacity set of bits stored in 64-bit words, allocated in pages on
+/// demand like a `PagedArray`.
+///
+/// Meant for occupancy masks: iterating over the set bits (`findNext()`,
+/// `forEach()`) is done a word at a time with `ctz64()`, skipping empty words
+/// and unallocated pages in bulk instead of testing each bit.
+///
+/// Setting/clearing bits is atomic, so bits can be read while other threads
+/// set or clear other bits.
+class ARES_API PagedBitSet
+{
+public:
+    /// The number of words in each page.
+    static constexpr const size_t WORDS_PER_PAGE = 64;
+
+    /// The number of bits in each page.
+    static constexpr const size_t BITS_PER_PAGE = WORDS_PER_PAGE * 64;
+
+private:
+    PagedArray<std::atomic<U64>, WORDS_PER_PAGE> words_;
+
+public:
+    /// Initializes a set that can hold `capacity` bits, all clear.
+    PagedBitSet(size_t capacity)
+        : words_((capacity + 63) / 64)
+    {
+    }
+
+    /// Sets the `index`th bit. `index` must be less than the capacity.
+    inline void set(size_t index)
+    {
+        words_[index / 64].fetch_or(U64(1) << (index % 64), std::memory_order_relaxed);
+    }
+
+    /// Clears the `index`th bit. `index` must be less than the capacity.
+    inline void clear(size_t index)
+    {
+        words_[index / 64].fetch_and(~(U64(1) << (index % 64)), std::memory_order_relaxed);
+    }
+
+    /// Returns the value of the `index`th bit.
+    inline bool test(size_t index) const
+    {
+        const std::atomic<U64>* word = words_.find(index / 64);
+        return word && (word->load(std::memory_order_relaxed) & (U64(1) << (index % 64))) != 0;
+    }
+
+    /// Returns the 64-bit word containing the `index`th bit, with all bits before
+    /// it cleared (i.e. bit `i` of the result is bit `index - index % 64 + i` of the set).
+    inline U64 wordFrom(size_t index) const
+    {
+        const std::atomic<U64>* word = words_.find(index / 64);
+        return word ? word->load(std::memory_order_relaxed) & (~U64(0) << (index % 64)) : 0;
+    }
+
+    /// Returns the index of the first set bit in `[begin, end)`, or `end` if there
+    /// is none.
+    inline size_t findNext(size_t begin, size_t end) const
+    {
+        size_t index = begin;
+        while(index < end)
+        {
+            size_t wordIndex = index / 64;
+            const std::atomic<U64>* word = words_.find(wordIndex);
+            if(!word)
+            {
+                // Page not allocated, so all of its bits are clear
+                index = (index / BITS_PER_PAGE + 1) * BITS_PER_PAGE;
+                continue;
+            }
+
+            // (Ignore the bits before `index` in the word)
+            U64 bits = word->load(std::memory_order_relaxed) & (~U64(0) << (index % 64));
+            if(bits != 0)
+            {
+                size_t found = wordIndex * 64 + ctz64(bits);
+                return found < end ? found : end;
+            }
+            index = (wordIndex + 1) * 64;
+        }
+        return end;
+    }
+
+    /// Runs `func(size_t index)` for the index of each set bit in `[begin, end)`,
+    /// in order.
+    template <typename Func>
+    inline void forEach(size_t begin, size_t end, const Func& func) const
+    {
+        size_t index = begin;
+        while(index < end)
+        {
+            size_t wordIndex = index / 64;
+            const std::atomic<U64>* word = words_.find(wordIndex);
+            if(!word)
+            {
+                index = (index / BITS_PER_PAGE + 1) * BITS_PER_PAGE;
+                continue;
+            }
+
+            U64 bits = word->load(std::memory_order_relaxed) & (~U64(0) << (index % 64));
+            size_t wordBase = wordIndex * 64;
+            if(end - wordBase < 64)
+            {
+                // (Ignore the bits after `end` in the last word)
+                bits &= (U64(1) << (end - wordBase)) - 1;
+            }
+
+            while(bits != 0)
+            {
+                func(wordBase + ctz64(bits));
+                bits &= bits - 1; // (Clear the lowest set bit)
+            }
+            index = wordBase + 64;
+        }
+    }
+
+    /// Returns the number of set bits in `[begin, end)`.
+    inline size_t count(size_t begin, size_t end) const
+    {
+        size_t n = 0;
+        size_t index = begin;
+        while(index < end)
+        {
+            size_t wordIndex = index / 64;
+            const std::atomic<U64>* word = words_.find(wordIndex);
+            if(!word)
+            {
+                index = (index / BITS_PER_PAGE + 1) * BITS_PER_PAGE;
+                continue;
+            }
+
+            U64 bits = word->load(std::memory_order_relaxed) & (~U64(0) << (index % 64));
+            size_t wordBase = wordIndex * 64;
+            if(end - wordBase < 64)
+            {
+                bits &= (U64(1) << (end - wordBase)) - 1;
+            }
+            n += popcount64(bits);
+            index = wordBase + 64;
+        }
+        return n;
+    }
+};
+
+}
@@ -319,6 +319,38 @@ inline void swapEndianness<8>(char* output, const char* input)
 }
 
 
+/// Returns the number of trailing zero bits in `value` (i.e. the index of its
+/// lowest set bit). **WARNING**: `value` must not be 0!
+inline unsigned int ctz64(U64 value)
+{
+#if defined(__GNUC__)
+    // GCC-like compiler
+    return unsigned(__builtin_ctzll(value));
+#elif defined(_MSC_VER)
+    // MSVC
+    unsigned long index;
+    _BitScanForward64(&index, value);
+    return unsigned(index);
+#else
+#   error "Unknown compiler!"
+#endif
+}
+
+/// Returns the number of set bits in `value`.
+inline unsigned int popcount64(U64 value)
+{
+#if defined(__GNUC__)
+    // GCC-like compiler
+    return unsigned(__builtin_popcountll(value));
+#elif defined(_MSC_VER)
+    // MSVC
+    return unsigned(__popcnt64(value));
+#else
+#   error "Unknown compiler!"
+#endif
+}
+
+
 }
 
 
@@ -0,0 +1,17 @@
+#pragma once
+
+#include <Core/Api.h>
+#include <Core/Base/Aabb.hh>
+
+namespace Ares
+{
+
+/// The local-space bounds of an entity; entities with both a `BoundsComp` and
+/// a `TransformComp` are tracked by the scene's `SpatialIndex`.
+struct ARES_API BoundsComp
+{
+    /// The bounding box of the entity, before its transform is applied.
+    Aabb box;
+};
+
+}
@@ -0,0 +1,18 @@
+#pragma once
+
+#include <Core/Api.h>
+#include <Core/Scene/EntityId.hh>
+
+namespace Ares
+{
+
+/// Attaches an entity to a parent entity; the entity's `TransformComp` is then
+/// relative to the parent's world transform (see `TransformHierarchy`).
+/// If `parent` is destroyed the entity is treated as a root again.
+struct ARES_API ParentComp
+{
+    /// The parent entity.
+    EntityId parent = INVALID_ENTITY_ID;
+};
+
+}
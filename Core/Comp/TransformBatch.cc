@@ -0,0 +1,126 @@
+#include "TransformBatch.hh"
+
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#   define ARES_TRANSFORMBATCH_SSE 1
+#   include <xmmintrin.h>
+#endif
+
+namespace Ares
+{
+
+void TransformBatch::clear()
+{
+    for(auto* array : {&px_, &py_, &pz_, &qx_, &qy_, &qz_, &qw_, &sx_, &sy_, &sz_})
+    {
+        array->clear();
+    }
+}
+
+void TransformBatch::reserve(size_t capacity)
+{
+    for(auto* array : {&px_, &py_, &pz_, &qx_, &qy_, &qz_, &qw_, &sx_, &sy_, &sz_})
+    {
+        array->reserve(capacity);
+    }
+}
+
+// The model matrix is `T * R * S`, computed directly instead of multiplying three
+// `glm::mat4`s. For a rotation quaternion `q = (x, y, z, w)` and `s = 2 / |q|^2`
+// (so that `q` need not be normalized; `s = 0` for a null `q`, i.e. no rotation)
+// its columns are:
+//   0: (1 - s(yy + zz),     s(xy + wz),     s(xz - wy), 0) * scale.x
+//   1: (    s(xy - wz), 1 - s(xx + zz),     s(yz + wx), 0) * scale.y
+//   2: (    s(xz + wy),     s(yz - wx), 1 - s(xx + yy), 0) * scale.z
+//   3: (position.x, position.y, position.z, 1)
+
+void TransformBatch::computeMatrices(glm::mat4* outMatrices) const
+{
+    const size_t n = size();
+    size_t i = 0;
+
+#ifdef ARES_TRANSFORMBATCH_SSE
+    // Compute 4 matrices at a time: each `__m128` holds the same matrix element
+    // for 4 consecutive transforms; transpose them to store whole columns
+    const __m128 zero = _mm_setzero_ps();
+    const __m128 one = _mm_set1_ps(1.0f);
+    const __m128 two = _mm_set1_ps(2.0f);
+
+    for(; i + 4 <= n; i += 4)
+    {
+        __m128 x = _mm_loadu_ps(&qx_[i]), y = _mm_loadu_ps(&qy_[i]);
+        __m128 z = _mm_loadu_ps(&qz_[i]), w = _mm_loadu_ps(&qw_[i]);
+
+        __m128 lenSq = _mm_add_ps(_mm_add_ps(_mm_mul_ps(x, x), _mm_mul_ps(y, y)),
+                                  _mm_add_ps(_mm_mul_ps(z, z), _mm_mul_ps(w, w)));
+        __m128 s = _mm_and_ps(_mm_div_ps(two, lenSq), _mm_cmpgt_ps(lenSq, zero));
+
+        __m128 xs = _mm_mul_ps(x, s), ys = _mm_mul_ps(y, s), zs = _mm_mul_ps(z, s);
+        __m128 xx = _mm_mul_ps(x, xs), yy = _mm_mul_ps(y, ys), zz = _mm_mul_ps(z, zs);
+        __m128 xy = _mm_mul_ps(x, ys), xz = _mm_mul_ps(x, zs), yz = _mm_mul_ps(y, zs);
+        __m128 wx = _mm_mul_ps(w, xs), wy = _mm_mul_ps(w, ys), wz = _mm_mul_ps(w, zs);
+
+        __m128 sx = _mm_loadu_ps(&sx_[i]), sy = _mm_loadu_ps(&sy_[i]), sz = _mm_loadu_ps(&sz_[i]);
+
+        __m128 c0[4] =
+        {
+            _mm_mul_ps(_mm_sub_ps(one, _mm_add_ps(yy, zz)), sx),
+            _mm_mul_ps(_mm_add_ps(xy, wz), sx),
+            _mm_mul_ps(_mm_sub_ps(xz, wy), sx),
+            zero,
+        };
+        __m128 c1[4] =
+        {
+            _mm_mul_ps(_mm_sub_ps(xy, wz), sy),
+            _mm_mul_ps(_mm_sub_ps(one, _mm_add_ps(xx, zz)), sy),
+            _mm_mul_ps(_mm_add_ps(yz, wx), sy),
+            zero,
+        };
+        __m128 c2[4] =
+        {
+            _mm_mul_ps(_mm_add_ps(xz, wy), sz),
+            _mm_mul_ps(_mm_sub_ps(yz, wx), sz),
+            _mm_mul_ps(_mm_sub_ps(one, _mm_add_ps(xx, yy)), sz),
+            zero,
+        };
+        __m128 c3[4] =
+        {
+            _mm_loadu_ps(&px_[i]),
+            _mm_loadu_ps(&py_[i]),
+            _mm_loadu_ps(&pz_[i]),
+            one,
+        };
+
+        __m128* columns[4] = {c0, c1, c2, c3};
+        for(unsigned int c = 0; c < 4; c ++)
+        {
+            // (After this, `columns[c][j]` is column `c` of the `i + j`th matrix)
+            __m128* col = columns[c];
+            _MM_TRANSPOSE4_PS(col[0], col[1], col[2], col[3]);
+            for(unsigned int j = 0; j < 4; j ++)
+            {
+                _mm_storeu_ps(&outMatrices[i + j][c][0], col[j]);
+            }
+        }
+    }
+#endif
+
+    // Scalar fallback (and the last `n % 4` matrices for SSE)
+    for(; i < n; i ++)
+    {
+        float x = qx_[i], y = qy_[i], z = qz_[i], w = qw_[i];
+        float lenSq = x * x + y * y + z * z + w * w;
+        float s = lenSq > 0.0f ? 2.0f / lenSq : 0.0f;
+
+        float xx = x * x * s, yy = y * y * s, zz = z * z * s;
+        float xy = x * y * s, xz = x * z * s, yz = y * z * s;
+        float wx = w * x * s, wy = w * y * s, wz = w * z * s;
+
+        glm::mat4& m = outMatrices[i];
+        m[0] = glm::vec4(1.0f - (yy + zz), xy + wz, xz - wy, 0.0f) * sx_[i];
+        m[1] = glm::vec4(xy - wz, 1.0f - (xx + zz), yz + wx, 0.0f) * sy_[i];
+        m[2] = glm::vec4(xz + wy, yz - wx, 1.0f - (xx + yy), 0.0f) * sz_[i];
+        m[3] = glm::vec4(px_[i], py_[i], pz_[i], 1.0f);
+    }
+}
+
+}
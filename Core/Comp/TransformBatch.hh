@@ -0,0 +1,59 @@
+#pragma once
+
+#include <stddef.h>
+#include <vector>
+#include <glm/mat4x4.hpp>
+#include <Core/Api.h>
+#include <Core/Comp/TransformComp.hh>
+
+namespace Ares
+{
+
+/// A batch of transforms stored as a structure of arrays (one array per
+/// position/rotation/scale component), so that the model matrices for all of
+/// them can be computed in one go with SIMD instructions (see `computeMatrices()`).
+///
+/// Use this instead of calling `TransformComp::matrix()` for each entity when
+/// a lot of matrices are needed at once (ex. for an instance buffer).
+class ARES_API TransformBatch
+{
+    std::vector<float> px_, py_, pz_; ///< Positions.
+    std::vector<float> qx_, qy_, qz_, qw_; ///< Rotations (not necessarily normalized).
+    std::vector<float> sx_, sy_, sz_; ///< Scales.
+
+public:
+    /// Returns the number of transforms in the batch.
+    inline size_t size() const
+    {
+        return px_.size();
+    }
+
+    /// Removes all transforms from the batch (but keeps the memory allocated).
+    void clear();
+
+    /// Reserves memory for at least `capacity` transforms.
+    void reserve(size_t capacity);
+
+    /// Appends a transform to the batch.
+    inline void push(const TransformComp& transform)
+    {
+        px_.push_back(transform.position.x);
+        py_.push_back(transform.position.y);
+        pz_.push_back(transform.position.z);
+        qx_.push_back(transform.rotation.x);
+        qy_.push_back(transform.rotation.y);
+        qz_.push_back(transform.rotation.z);
+        qw_.push_back(transform.rotation.w);
+        sx_.push_back(transform.scale.x);
+        sy_.push_back(transform.scale.y);
+        sz_.push_back(transform.scale.z);
+    }
+
+    /// Computes the model matrix of each transform in the batch (the same that
+    /// `TransformComp::matrix()` would return) and writes them contiguously to
+    /// `outMatrices`, which must have space for `size()` matrices.
+    /// Uses SSE when available (4 transforms at a time), else plain scalar code.
+    void computeMatrices(glm::mat4* outMatrices) const;
+};
+
+}
@@ -25,6 +25,8 @@ struct ARES_API TransformComp
 
 
     /// Returns a matrix representation of the transform.
+    /// To compute the matrices of many transforms at once, prefer using a
+    /// `TransformBatch` (see "TransformBatch.hh").
     inline glm::mat4 matrix() const
     {
         // NOTE that `rotation` is normalized before converting it to a matrix;
@@ -0,0 +1,267 @@
+#include "TransformHierarchy.hh"
+
+#include <unordered_map>
+#include <Core/Scene/Scene.hh>
+#include <Core/Scene/EntityRef.hh>
+#include <Core/Scene/SceneView.hh>
+#include <Core/Scene/SceneCmdQueue.hh>
+#include <Core/Task/ParallelFor.hh>
+#include <Core/Comp/TransformComp.hh>
+#include <Core/Comp/ParentComp.hh>
+#include <Core/Comp/WorldTransformComp.hh>
+
+namespace Ares
+{
+
+constexpr const U32 TransformHierarchy::MAX_DEPTH;
+constexpr const U32 TransformHierarchy::NO_PARENT;
+
+TransformHierarchy::TransformHierarchy()
+    : lastVersion_(0), valid_(false)
+{
+}
+
+void TransformHierarchy::rebuild(Scene& scene, SceneCmdQueue* cmds)
+{
+    CompStore<ParentComp>* parentStore = scene.storeFor<ParentComp>();
+    CompStore<WorldTransformComp>* worldStore = scene.storeFor<WorldTransformComp>();
+
+    // Returns the parent of `entity`, or `INVALID_ENTITY_ID` if it is a root
+    auto parentOf = [&scene, parentStore](EntityId entity)
+    {
+        const ParentComp* parentComp = parentStore->get(entity);
+        if(!parentComp || parentComp->parent == entity || !scene.alive(parentComp->parent))
+        {
+            return INVALID_ENTITY_ID;
+        }
+        return parentComp->parent;
+    };
+
+    // Find the depth of each entity with a parent and of all of their ancestors
+    static constexpr const U32 VISITING = U32(-1); // (Used to detect cycles)
+    std::unordered_map<EntityId, U32> depths;
+    std::vector<EntityId> chain;
+    U32 maxDepth = 0;
+
+    // Assigns increasing depths (starting at `depth`) to `chain[begin, end)`,
+    // from the last (the topmost ancestor) to the first
+    auto assignDepths = [&](size_t begin, size_t end, U32 depth)
+    {
+        for(size_t i = end; i -- > begin; depth ++)
+        {
+            depths[chain[i]] = depth;
+            maxDepth = depth > maxDepth ? depth : maxDepth;
+        }
+    };
+
+    auto parentFunc = [&](EntityId entity, ParentComp& parentComp)
+    {
+        // Walk up until a root or an entity of known depth is found, then assign
+        // depths back down
+        chain.clear();
+        EntityId cur = entity;
+        while(true)
+        {
+            auto depthIt = depths.find(cur);
+            if(depthIt != depths.end() && depthIt->second != VISITING)
+            {
+                // Reached an entity whose depth is known
+                assignDepths(0, chain.size(), depthIt->second + 1);
+                break;
+            }
+            else if(depthIt != depths.end())
+            {
+                // Reached an entity in `chain` again: the parents form a cycle;
+                // break it by making `cur` a root
+                size_t curPos = 0;
+                while(chain[curPos] != cur)
+                {
+                    curPos ++;
+                }
+                depths[cur] = 0;
+                assignDepths(curPos + 1, chain.size(), 1);
+                assignDepths(0, curPos, 1);
+                break;
+            }
+
+            chain.push_back(cur);
+            depths[cur] = VISITING;
+
+            EntityId parent = parentOf(cur);
+            if(parent == INVALID_ENTITY_ID || chain.size() > MAX_DEPTH)
+            {
+                // Found a root (or the hierarchy is too deep, make `cur` one)
+                assignDepths(0, chain.size(), 0);
+                break;
+            }
+            cur = parent;
+        }
+    };
+    scene.view<ParentComp>().each(parentFunc);
+
+    // Sort all nodes by depth (counting sort)
+    levels_.assign(depths.empty() ? 0 : maxDepth + 2, 0);
+    for(const auto& pair : depths)
+    {
+        levels_[pair.second + 1] ++;
+    }
+    for(size_t d = 1; d < levels_.size(); d ++)
+    {
+        levels_[d] += levels_[d - 1];
+    }
+
+    nodes_.resize(depths.size());
+    added_.clear();
+    std::vector<size_t> nextInLevel(levels_.begin(), levels_.end());
+    std::unordered_map<EntityId, U32> indices;
+    for(const auto& pair : depths)
+    {
+        U32 index = U32(nextInLevel[pair.second] ++);
+        nodes_[index] = {pair.first, NO_PARENT, parentStore->has(pair.first)};
+        indices[pair.first] = index;
+    }
+
+    // Link each node to its parent's (which is always at a lower index); nodes
+    // that were made roots to break a cycle stay unlinked
+    for(Node& node : nodes_)
+    {
+        EntityId parent = parentOf(node.entity);
+        if(parent != INVALID_ENTITY_ID && depths[parent] < depths[node.entity])
+        {
+            node.parent = indices[parent];
+        }
+
+        if(node.attached && !worldStore->has(node.entity))
+        {
+            if(cmds)
+            {
+                // (Set once its world transform is known, see `update()`)
+                added_.push_back(U32(&node - nodes_.data()));
+            }
+            else
+            {
+                worldStore->set(node.entity, {});
+            }
+        }
+    }
+
+    // Erase world transforms of entities that were detached from their parent
+    auto worldFunc = [parentStore, worldStore, cmds](EntityId entity, WorldTransformComp& worldComp)
+    {
+        if(!parentStore->has(entity))
+        {
+            if(cmds)
+            {
+                cmds->erase<WorldTransformComp>(entity);
+            }
+            else
+            {
+                worldStore->erase(entity);
+            }
+        }
+    };
+    scene.view<WorldTransformComp>().each(worldFunc);
+
+    worlds_.resize(nodes_.size());
+    dirty_.resize(nodes_.size());
+    valid_ = true;
+}
+
+bool TransformHierarchy::validate(const Scene& scene) const
+{
+    for(const Node& node : nodes_)
+    {
+        if(!scene.alive(node.entity))
+        {
+            return false;
+        }
+    }
+    return true;
+}
+
+void TransformHierarchy::updateNodes(Scene& scene, size_t begin, size_t end, U64 since, bool all)
+{
+    CompStore<TransformComp>* transformStore = scene.storeFor<TransformComp>();
+    CompStore<WorldTransformComp>* worldStore = scene.storeFor<WorldTransformComp>();
+
+    for(size_t i = begin; i < end; i ++)
+    {
+        const Node& node = nodes_[i];
+
+        // Only recompute if the transform or any ancestor's changed
+        bool dirty = all || transformStore->changedSince(node.entity, since)
+                     || (node.parent != NO_PARENT && dirty_[node.parent]);
+        dirty_[i] = dirty;
+        if(!dirty)
+        {
+            continue;
+        }
+
+        const TransformComp* transform = transformStore->get(node.entity);
+        glm::mat4 local = transform ? transform->matrix() : glm::mat4(1.0f);
+        worlds_[i] = node.parent != NO_PARENT ? worlds_[node.parent] * local : local;
+
+        if(node.attached)
+        {
+            WorldTransformComp* worldComp = worldStore->getMut(node.entity); // (Marks it as changed)
+            if(worldComp)
+            {
+                worldComp->matrix = worlds_[i];
+            }
+        }
+    }
+}
+
+void TransformHierarchy::update(Scene& scene, SceneCmdQueue* cmds, TaskScheduler* scheduler, size_t chunkSize)
+{
+    U64 sinceVersion = lastVersion_;
+    lastVersion_ = scene.advanceVersion();
+
+    if(!scene.storeFor<TransformComp>() || !scene.storeFor<WorldTransformComp>())
+    {
+        // (Too many component types; nothing to update)
+        return;
+    }
+
+    // Parents that were destroyed do not change any `ParentComp`, hence `validate()`
+    CompStore<ParentComp>* parentStore = scene.storeFor<ParentComp>();
+    if(!parentStore)
+    {
+        return;
+    }
+    bool all = false;
+    if(!valid_ || parentStore->lastChangeVersion() > sinceVersion || !validate(scene))
+    {
+        rebuild(scene, cmds);
+        all = true; // (Recompute everything)
+    }
+
+    for(size_t d = 0; d + 1 < levels_.size(); d ++)
+    {
+        size_t begin = levels_[d], end = levels_[d + 1];
+        if(scheduler && end - begin > chunkSize)
+        {
+            // (All parents are in previous levels, already done)
+            auto levelFunc = [this, &scene, begin, sinceVersion, all](size_t chunkBegin, size_t chunkEnd)
+            {
+                updateNodes(scene, begin + chunkBegin, begin + chunkEnd, sinceVersion, all);
+            };
+            parallelFor(*scheduler, end - begin, chunkSize, levelFunc);
+        }
+        else
+        {
+            updateNodes(scene, begin, end, sinceVersion, all);
+        }
+    }
+
+    // Add the world transforms of newly attached entities, already computed
+    for(U32 index : added_)
+    {
+        WorldTransformComp worldComp;
+        worldComp.matrix = worlds_[index];
+        cmds->set(nodes_[index].entity, worldComp);
+    }
+    added_.clear();
+}
+
+}
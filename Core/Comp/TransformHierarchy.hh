@@ -0,0 +1,101 @@
+#pragma once
+
+#include <stddef.h>
+#include <vector>
+#include <glm/mat4x4.hpp>
+#include <Core/Api.h>
+#include <Core/Base/NumTypes.hh>
+#include <Core/Scene/EntityId.hh>
+
+namespace Ares
+{
+
+class Scene; // #include "Scene/Scene.hh"
+class SceneCmdQueue; // #include "Scene/SceneCmdQueue.hh"
+class TaskScheduler; // #include "Task/TaskScheduler.hh"
+
+/// Computes the `WorldTransformComp` of all entities in a scene that have a
+/// `ParentComp`, from their own and their ancestors' `TransformComp`s.
+///
+/// All entities in the hierarchy (the ones with a parent, plus the roots they
+/// descend from) are kept sorted by depth in one contiguous array, so that
+/// parents always precede their children; world transforms are then computed
+/// in a single linear pass over it (or in parallel, one depth level at a time).
+/// The order is only rebuilt when parents change or entities in it die.
+///
+/// Only the subtrees whose `TransformComp`s changed since the last `update()`
+/// (see `Scene::advanceVersion()`) are recomputed.
+class ARES_API TransformHierarchy
+{
+public:
+    /// The maximum depth of the hierarchy. Deeper entities (or ones whose parents
+    /// form a cycle) are treated as roots.
+    static constexpr const U32 MAX_DEPTH = 256;
+
+    /// The `parent` of nodes that are roots.
+    static constexpr const U32 NO_PARENT = U32(-1);
+
+private:
+    /// An entity in the hierarchy.
+    struct Node
+    {
+        EntityId entity;
+        U32 parent; ///< The index of the parent's node, or `NO_PARENT` for roots.
+        bool attached; ///< `true` if the entity has a `ParentComp` (and so a `WorldTransformComp`).
+    };
+
+    std::vector<Node> nodes_; ///< Sorted by depth.
+    std::vector<size_t> levels_; ///< `nodes_[levels_[d], levels_[d + 1])` are at depth `d`.
+    std::vector<glm::mat4> worlds_; ///< The world matrix for each node.
+    std::vector<U8> dirty_; ///< 1 for each node recomputed in the current update.
+    std::vector<U32> added_; ///< Attached nodes whose `WorldTransformComp` is to be set via the `SceneCmdQueue`.
+    U64 lastVersion_; ///< The scene version at the last `update()`.
+    bool valid_; ///< `false` if `nodes_` has to be rebuilt.
+
+    /// Rebuilds `nodes_` and `levels_` from the scene's `ParentComp`s; also
+    /// erases `WorldTransformComp`s of entities that do not have a parent anymore
+    /// and adds them to new ones (directly if `cmds` is null, otherwise by recording
+    /// commands into it; added ones are then recorded by `update()` into `added_`).
+    void rebuild(Scene& scene, SceneCmdQueue* cmds);
+
+    /// Returns `false` if any entity in `nodes_` (or its parent) is not alive anymore.
+    bool validate(const Scene& scene) const;
+
+    /// Recomputes the world transforms of the nodes in `[begin, end)` that are
+    /// dirty (i.e. whose transform or any of whose ancestors' changed after `since`),
+    /// or of all of them if `all` is `true`.
+    /// All parents of the nodes must have already been updated.
+    void updateNodes(Scene& scene, size_t begin, size_t end, U64 since, bool all);
+
+public:
+    TransformHierarchy();
+    ~TransformHierarchy() = default;
+
+    /// Updates the `WorldTransformComp`s of all entities with a `ParentComp` in
+    /// `scene`, adding (or erasing) them if needed.
+    /// If `cmds` is not null, `WorldTransformComp`s are added and erased by recording
+    /// commands into it, so this can run as a task alongside others iterating
+    /// over the scene; new ones (set to their computed world transform) only
+    /// appear once it is flushed. If it is null, they are added and erased directly.
+    /// If `scheduler` is not null, each depth level that has more than `chunkSize`
+    /// nodes is processed in parallel on it.
+    /// **WARNING**: Not threadsafe! No other thread should add/erase `ParentComp`s
+    ///              while this runs, nor touch `WorldTransformComp`s at all if
+    ///              `cmds` is null.
+    void update(Scene& scene, SceneCmdQueue* cmds=nullptr, TaskScheduler* scheduler=nullptr,
+                size_t chunkSize=1024);
+
+    /// Returns the number of entities in the hierarchy (roots included).
+    inline size_t size() const
+    {
+        return nodes_.size();
+    }
+
+    /// Returns the number of depth levels in the hierarchy.
+    inline size_t depth() const
+    {
+        return levels_.empty() ? 0 : levels_.size() - 1;
+    }
+};
+
+}
@@ -0,0 +1,20 @@
+#pragma once
+
+#include <glm/mat4x4.hpp>
+#include <Core/Api.h>
+
+namespace Ares
+{
+
+/// The world-space transform of an entity that has a `ParentComp`, i.e. the
+/// product of all of its ancestors' transforms and its own `TransformComp`.
+/// Computed by `TransformHierarchy`; do not set it by hand.
+/// Entities without a parent do not get one: their `TransformComp::matrix()`
+/// already is their world transform.
+struct ARES_API WorldTransformComp
+{
+    /// The world-space model matrix.
+    glm::mat4 matrix{1.0f};
+};
+
+}
@@ -1,6 +1,8 @@
 #include "Core.hh"
 
+#include <string.h>
 #include <algorithm>
+#include <memory>
 #include <uv.h>
 #include <Ares/BuildConfig.h>
 #include "Mem/MemFuncs.hh"
@@ -8,10 +10,14 @@
 #include "Debug/Log.hh"
 #include "Debug/Profiler.hh"
 #include "Debug/TimeProbe.hh"
+#include "Base/Utils.hh"
 #include "Task/TaskScheduler.hh"
 #include "Scene/Scene.hh"
+#include "Scene/SceneCmdQueue.hh"
+#include "Scene/SpatialIndex.hh"
 #include "Data/FolderFileStore.hh"
 #include "Data/ResourceLoader.hh"
+#include "Resource/Json.hh"
 #include "Mem/MemStats.hh"
 #include "Module/Module.hh"
 
@@ -45,11 +51,21 @@ Core::~Core()
         detachModule(*it);
     }
 
+    if(params_.memLogStats)
+    {
+        const MemStats& stats = memStats();
+        ARES_log(*g().log, Debug,
+                 "Mem: %u allocations, %lu bytes mapped (%lu total mapped, %lu total unmapped)",
+                 stats.nAllocs, stats.mapped, stats.totalMapped, stats.totalUnmapped);
+    }
+
     // Perform one final log flush
     g().log->flush();
 
     // Free GlobalData's resources
     delete g().resLoader;
+    delete g().spatialIndex;
+    delete g().sceneCmds;
     delete g().scene;
     delete g().scheduler;
     delete g().profiler;
@@ -74,7 +90,7 @@ static void stderrLogSink(const LogMessage* message, void* data)
 }
 
 
-bool Core::init()
+bool Core::init(int argc, const char* const* argv)
 {
     if(state_ == Inited)
     {
@@ -82,9 +98,56 @@ bool Core::init()
         return true;
     }
 
+    // Profiler
+    // Created before everything else so that the whole startup can be profiled
+    {
+        g().profiler = new Profiler();
+    }
+
+    // ResourceLoader (and its FileStore)
+    // Created before everything else since the config file is loaded through it
+    FolderFileStore* folderFileStore;
+    {
+        // FIXME Switchable `fileStore` implementation depending on use
+        folderFileStore = new FolderFileStore("Resources");
+        Ref<FileStore> fileStore = intoRef<FileStore>(folderFileStore);
+
+        g().resLoader = new ResourceLoader(std::move(fileStore));
+    }
+
+    // Params: defaults <- config file <- command-line arguments
+    // (errors are only logged after the log is created)
+    ErrString paramsLoadErr, paramsErr, argsErr;
+    Path paramsPath = ARES_CORE_PARAMS_FILE;
+    {
+        TimeProbe timer(*g().profiler, "Core.Init.Params");
+
+        Json argsJson = Json::object();
+        argsErr = CoreParams::parseArgs(argsJson, argc, argv);
+
+        auto configArgIt = argsJson.find("config");
+        if(configArgIt != argsJson.end() && configArgIt->is_string())
+        {
+            paramsPath = configArgIt->get<std::string>();
+        }
+
+        Ref<Json> paramsJson;
+        paramsLoadErr = g().resLoader->load<Json>(paramsJson, paramsPath);
+        if(!paramsLoadErr)
+        {
+            paramsErr = params_.apply(*paramsJson);
+        }
+
+        ErrString argsApplyErr = params_.apply(argsJson);
+        if(argsApplyErr)
+        {
+            argsErr += argsApplyErr;
+        }
+    }
+
     // Log
     {
-        g().log = new Log(ARES_CORE_LOG_MESSAGE_POOL_CAPACITY);
+        g().log = new Log(params_.logMessagePoolCapacity);
 
 #define glog (*g().log)
 
@@ -95,6 +158,28 @@ bool Core::init()
         // FIXME
     }
 
+    // Params (logging only)
+    {
+        if(!paramsLoadErr)
+        {
+            ARES_log(glog, Debug, "Params: Loaded %s", paramsPath);
+        }
+        else
+        {
+            ARES_log(glog, Debug, "Params: Could not load %s (%s), using defaults",
+                     paramsPath, paramsLoadErr);
+        }
+
+        if(paramsErr)
+        {
+            ARES_log(glog, Warning, "Params: Error in %s: %s", paramsPath, paramsErr);
+        }
+        if(argsErr)
+        {
+            ARES_log(glog, Warning, "Params: Error in command-line arguments: %s", argsErr);
+        }
+    }
+
     // libuv
     {
         ARES_log(glog, Trace, "libuv version: %s", uv_version_string());
@@ -102,10 +187,8 @@ bool Core::init()
         uv_replace_allocator(Ares::malloc, Ares::realloc, Ares::calloc, Ares::free);
     }
 
-    // Profiler
+    // Profiler (logging only, it was created before the log)
     {
-        g().profiler = new Profiler();
-
 #ifdef ARES_ENABLE_PROFILER
         ARES_log(glog, Debug, "Profiler enabled");
 #else
@@ -124,13 +207,20 @@ bool Core::init()
 
     // Task scheduler
     {
-        g().scheduler = new TaskScheduler(TaskScheduler::optimalNWorkers(),
-                                          ARES_CORE_SCHEDULER_FIBER_POOL_CAPACITY,
-                                          ARES_CORE_SCHEDULER_FIBER_STACK_SIZE);
+        TimeProbe timer(*g().profiler, "Core.Init.Scheduler");
+
+        unsigned int nWorkers = params_.schedulerNWorkers != 0
+                                ? params_.schedulerNWorkers
+                                : TaskScheduler::optimalNWorkers();
+        g().scheduler = new TaskScheduler(nWorkers,
+                                          params_.schedulerFiberPoolCapacity,
+                                          params_.schedulerFiberStackSize,
+                                          params_.schedulerPinWorkers);
 
         ARES_log(glog, Debug,
-                 "Task scheduler: %u worker threads, %u fibers, %.1f KB fiber stacks",
-                 g().scheduler->nWorkers(), g().scheduler->nFibers(),
+                 "Task scheduler: %u worker threads%s, %u fibers, %.1f KB fiber stacks",
+                 g().scheduler->nWorkers(), params_.schedulerPinWorkers ? " (pinned)" : "",
+                 g().scheduler->nFibers(),
                  float(g().scheduler->fiberStackSize()) / 1024.0f);
 
         // FIXME If a `TaskScheduler` is added as a facility before the core is
@@ -140,41 +230,25 @@ bool Core::init()
 
     // Scene
     {
-        g().scene = new Scene(ARES_CORE_SCENE_ENTITY_CAPACITY);
+        g().scene = new Scene(params_.sceneEntityCapacity);
+        g().sceneCmds = new SceneCmdQueue(g().scheduler);
+        g().spatialIndex = new SpatialIndex();
 
         ARES_log(glog, Debug,
                  "Scene: %lu max entities",
                  g().scene->maxEntities());
     }
 
-    // ResourceLoader (and its FileStore)
+    // ResourceLoader (logging only, it was created before the log)
     {
-        // FIXME Switchable `fileStore` implementation depending on use
-        auto folderFileStore = new FolderFileStore("Resources");
-        Ref<FileStore> fileStore = intoRef<FileStore>(folderFileStore);
-
         ARES_log(glog, Debug,
                  "ResourceLoader: Using FolderFileStore with root %s",
                  folderFileStore->root());
-
-        g().resLoader = new ResourceLoader(std::move(fileStore));
     }
 
     // [Re]initialize all modules that were attached to the core before it was
-    // `init()`ed
-    for(auto it = modules_.begin(); it != modules_.end();)
-    {
-        bool itInited = initModule(it->get());
-        if(itInited)
-        {
-            it ++;
-        }
-        else
-        {
-            // Erase uninited module
-            it = modules_.erase(it);
-        }
-    }
+    // `init()`ed; uninited modules are erased
+    initModules(modules_);
 
     // Register the event alias for `halt()` in the event matrix.
     *g().eventMatrix.get<>("core.halt") += Delegate<void()>::from<Core, &Core::halt>(this);
@@ -192,6 +266,25 @@ bool Core::run()
     }
 
     state_ = Running;
+
+    // Everything that was profiled up to here is the startup timeline (core
+    // init + module init); keep it around separately from per-frame events
+    g().startupProfilerEvents.clear();
+    (void)g().profiler->flush(g().startupProfilerEvents);
+    if(!g().startupProfilerEvents.empty())
+    {
+        U64 startTime = U64(-1), endTime = 0;
+        for(const auto& event : g().startupProfilerEvents)
+        {
+            startTime = min(startTime, event.startTime);
+            endTime = max(endTime, event.endTime);
+        }
+        ARES_log(glog, Debug,
+                 "Startup: %lu profiled events, %.2f ms",
+                 g().startupProfilerEvents.size(),
+                 double((endTime - startTime) * Profiler::Clock::nsPerTick()) / 1e6);
+    }
+
     ARES_log(glog, Info, "Running");
 
     // Main loop
@@ -234,7 +327,7 @@ bool Core::run()
             // This amount of messages to be flushed should be enough to make sure
             // that the message buffer is always empty afterwards (so that we don't
             // run out of log messages in the log's message pool...)
-            glog.flush(ARES_CORE_LOG_MESSAGE_POOL_CAPACITY);
+            glog.flush(params_.logMessagePoolCapacity);
 
             // Wait for all module update tasks to finish...
             {
@@ -247,6 +340,22 @@ bool Core::run()
                 }
             }
 
+            // ...then apply all structural scene edits that they deferred; no task
+            // is iterating over the scene at this point
+            {
+                TimeProbe timer(*g().profiler, "Core.MainLoop.SceneCmds");
+
+                g().sceneCmds->flush(*g().scene);
+            }
+
+            // Update the spatial index to the final state of the scene for this
+            // frame, so that tasks can query it next frame
+            {
+                TimeProbe timer(*g().profiler, "Core.MainLoop.SpatialIndex");
+
+                g().spatialIndex->update(*g().scene);
+            }
+
             // Clear the previous frame's data and swap current and previous frame
             // data. Events/commands that were in `current()` will now be in `past()`
             // for the next frame, ready to be processed; `current()` will be blank,
@@ -258,6 +367,8 @@ bool Core::run()
         // Flush all of the profiler's events. Does nothing `#ifndef ARES_ENABLE_PROFILER`
         g().profilerEvents.clear(); // IMPORTANT Otherwise profiling events would accumulate forever!
         (void)g().profiler->flush(g().profilerEvents);
+        g().profilerCounters.clear();
+        (void)g().profiler->flush(g().profilerCounters);
     }
 
     ARES_log(glog, Info, "Done running");
@@ -298,6 +409,175 @@ bool Core::initModule(Module* module)
     }
 }
 
+void Core::initModules(std::vector<Ref<Module>>& modules)
+{
+    TimeProbe timer(*g().profiler, "Core.Init.Modules");
+
+    enum InitState
+    {
+        Waiting, ///< Waiting for its `initTask()` and/or `initDeps()`.
+        Inited, ///< `init()` succeeded.
+        Failed, ///< `init()` failed, or any of its `initDeps()` did.
+    };
+
+    size_t n = modules.size();
+    std::vector<InitState> states(n, Waiting);
+    std::unique_ptr<TaskVar[]> taskVars(new TaskVar[n]);
+
+    // Schedule all init tasks at once so that they run concurrently
+    for(size_t i = 0; i < n; i ++)
+    {
+        taskVars[i] = 0;
+
+        if(!modules[i])
+        {
+            ARES_log(glog, Error, "Attempting to init a null module");
+            states[i] = Failed;
+            continue;
+        }
+
+        Task initTask = modules[i]->initTask(*this);
+        if(initTask)
+        {
+            g().scheduler->schedule(initTask, &taskVars[i]);
+        }
+    }
+
+    /// Returns `true` if the module depends on all others (see `Module::initDeps()`).
+    auto dependsOnAll = [](const Module& module)
+    {
+        for(const char* dep : module.initDeps())
+        {
+            if(strcmp(dep, Module::ALL_MODULES) == 0)
+            {
+                return true;
+            }
+        }
+        return false;
+    };
+
+    /// Returns the state of the module in `modules` named `name`, or `Inited`
+    /// if there is no such module (i.e. it is not attached or was already inited).
+    /// For `Module::ALL_MODULES`, returns `Failed` if any of the modules that do
+    /// not depend on all others failed, else `Waiting` if any is still waiting.
+    auto depState = [&](const char* name)
+    {
+        bool all = strcmp(name, Module::ALL_MODULES) == 0;
+        InitState allState = Inited;
+        for(size_t j = 0; j < n; j ++)
+        {
+            if(!modules[j])
+            {
+                continue;
+            }
+            if(all && !dependsOnAll(*modules[j]))
+            {
+                if(states[j] == Failed)
+                {
+                    allState = Failed;
+                }
+                else if(states[j] == Waiting && allState != Failed)
+                {
+                    allState = Waiting;
+                }
+            }
+            else if(!all && strcmp(modules[j]->name(), name) == 0)
+            {
+                return states[j];
+            }
+        }
+        return allState;
+    };
+
+    // `init()` each module on the main thread as soon as its init task and its
+    // dependencies are done
+    size_t nWaiting = std::count(states.begin(), states.end(), Waiting);
+    while(nWaiting > 0)
+    {
+        bool progressed = false;
+        TaskVar* pendingVar = nullptr; // (The var of an init task that is still running)
+
+        for(size_t i = 0; i < n; i ++)
+        {
+            if(states[i] != Waiting)
+            {
+                continue;
+            }
+            if(taskVars[i].load() != 0)
+            {
+                // Init task still running
+                pendingVar = &taskVars[i];
+                continue;
+            }
+
+            InitState depsState = Inited;
+            for(const char* dep : modules[i]->initDeps())
+            {
+                InitState state = depState(dep);
+                if(state == Failed)
+                {
+                    ARES_log(glog, Error,
+                             "Module @%p (%s): dependency %s failed to init",
+                             modules[i].get(), modules[i]->name(), dep);
+                    depsState = Failed;
+                    break;
+                }
+                else if(state == Waiting)
+                {
+                    depsState = Waiting;
+                }
+            }
+
+            if(depsState == Waiting)
+            {
+                continue;
+            }
+            else if(depsState == Failed)
+            {
+                states[i] = Failed;
+            }
+            else
+            {
+                states[i] = initModule(modules[i].get()) ? Inited : Failed;
+            }
+
+            nWaiting --;
+            progressed = true;
+        }
+
+        if(!progressed && pendingVar)
+        {
+            // Nothing can be inited until (at least) another init task is done;
+            // wait for one of them instead of spinning through the modules again
+            g().scheduler->waitFor(*pendingVar);
+        }
+        else if(!progressed)
+        {
+            // All remaining modules are waiting on each other
+            for(size_t i = 0; i < n; i ++)
+            {
+                if(states[i] == Waiting)
+                {
+                    ARES_log(glog, Error,
+                             "Module @%p (%s): circular init dependencies",
+                             modules[i].get(), modules[i]->name());
+                    states[i] = Failed;
+                }
+            }
+            nWaiting = 0;
+        }
+    }
+
+    // Erase modules that failed to init
+    size_t i = 0;
+    auto failedFunc = [&](const Ref<Module>&)
+    {
+        return states[i ++] == Failed;
+    };
+    modules.erase(std::remove_if(modules.begin(), modules.end(), failedFunc),
+                  modules.end());
+}
+
 bool Core::attachModule(Ref<Module> module)
 {
     if(!module || std::find(modules_.begin(), modules_.end(), module) != modules_.end())
@@ -305,22 +585,30 @@ bool Core::attachModule(Ref<Module> module)
         return false;
     }
 
-    bool ok = true;
+    return attachModules({module}) == 1;
+}
+
+size_t Core::attachModules(std::vector<Ref<Module>> modules)
+{
+    // Skip null modules and modules that are already attached
+    auto skipFunc = [this](const Ref<Module>& module)
+    {
+        return !module || std::find(modules_.begin(), modules_.end(), module) != modules_.end();
+    };
+    modules.erase(std::remove_if(modules.begin(), modules.end(), skipFunc),
+                  modules.end());
+
     if(state_ != Dead)
     {
-        // Core already inited/running, initialize module here
-        ok = initModule(module.get()); // (may fail, logs errors)
+        // Core already inited/running, initialize modules here
+        initModules(modules); // (may fail, logs errors)
     }
 
-    if(ok)
+    for(auto& module : modules)
     {
         modules_.push_back(module); // (increases refcount)
-        return true;
-    }
-    else
-    {
-        return false;
     }
+    return modules.size();
 }
 
 bool Core::detachModule(Ref<Module> module)
@@ -10,6 +10,7 @@
 #include "Module/Module.hh"
 #include "GlobalData.hh"
 #include "FrameData.hh"
+#include "CoreParams.hh"
 
 namespace Ares
 {
@@ -32,6 +33,8 @@ class ARES_API Core
 private:
     std::atomic<State> state_;
 
+    CoreParams params_;
+
     std::vector<Ref<Module>> modules_;
 
     GlobalData globalData_;
@@ -48,6 +51,13 @@ private:
     /// some information on error.
     bool initModule(Module* module);
 
+    /// Initializes all `modules` for this core, running all of their `initTask()`s
+    /// concurrently on the scheduler and their `init()`s on the main thread as
+    /// soon as the respective `initTask()` and `initDeps()` are done.
+    /// Modules that fail to init are removed from `modules` (some information
+    /// is logged for each of them).
+    void initModules(std::vector<Ref<Module>>& modules);
+
     /// Marks the core as halted, stopping the main loop if it was running.
     /// `state()` will if switch back to `Inited` from `Running`, or stay `Dead`
     /// if the core was `Dead`.
@@ -69,8 +79,10 @@ public:
     /// On success, `state()` will switch to `Inited`.
     /// Does nothing and returns `true` if the core is already initalized.
     ///
-    /// See `CoreConfig.h` for some initialization parameters of inner core structures.
-    bool init();
+    /// The initialization parameters of inner core structures (see `CoreParams`)
+    /// are read from the config file and then overridden by the command-line
+    /// arguments in `argv`, if any.
+    bool init(int argc=0, const char* const* argv=nullptr);
 
     /// Starts running the core's main loop; it will return only after the
     /// "core.halt" event is called by an inner task/interrupt handler/something
@@ -87,6 +99,13 @@ public:
         return state_;
     }
 
+    /// Returns the parameters the core was initialized with.
+    /// Only meaningful after `init()`.
+    inline const CoreParams& params() const
+    {
+        return params_;
+    }
+
 
     /// The core's global data.
     /// This data is always valid for the duration of the core and contains
@@ -120,6 +139,13 @@ public:
     /// `module` is null.
     bool attachModule(Ref<Module> module);
 
+    /// Like `attachModule()`, but for multiple modules at once. If the core is
+    /// already inited, the modules are initialized concurrently (see `Module::initTask()`,
+    /// `Module::initDeps()`); attach all modules with a single call to this
+    /// instead of multiple `attachModule()` calls to minimize startup time.
+    /// Returns the number of modules actually attached.
+    size_t attachModules(std::vector<Ref<Module>> modules);
+
     /// Attempts to `halt()` then detach the given module.
     /// Returns `false` and does nothing on error (no such module attached/module
     /// is null).
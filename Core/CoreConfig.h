@@ -1,5 +1,12 @@
 #pragma once
 
+// NOTE: The capacities below are only the *defaults* for a `Core`; they can be
+//       overridden at runtime, see `CoreParams.hh`.
+
+/// The path of the JSON file containing `CoreParams` overrides, relative to the
+/// resource folder. Can itself be overridden with the `--config=<path>` command-line argument.
+#define ARES_CORE_PARAMS_FILE "Core.json"
+
 /// The capacity of a `Core` `Log`'s message pool.
 #define ARES_CORE_LOG_MESSAGE_POOL_CAPACITY 1024
 
@@ -13,7 +20,8 @@
 #define ARES_CORE_SCHEDULER_FIBER_STACK_SIZE (128 * 1024)
 
 /// The maximum number of entities in a `Core`'s `Scene`.
-#define ARES_CORE_SCENE_ENTITY_CAPACITY 1024
+/// (Memory for entities is allocated in pages as needed, not upfront.)
+#define ARES_CORE_SCENE_ENTITY_CAPACITY (1024 * 1024)
 
 
 /// The name of the application.
@@ -0,0 +1,181 @@
+#include "CoreParams.hh"
+
+#include <string.h>
+#include <limits>
+#include <sstream>
+#include "Base/NumTypes.hh"
+
+namespace Ares
+{
+
+constexpr const size_t CoreParams::MIN_FIBER_STACK_SIZE;
+
+/// Sets `outValue` to the boolean `value`.
+/// Returns an error message if `value` is not a boolean.
+static ErrString parseParamValue(bool& outValue, const Json& value, bool minValue)
+{
+    (void)minValue;
+    if(!value.is_boolean())
+    {
+        return "expected true or false";
+    }
+    outValue = value.get<bool>();
+    return {};
+}
+
+/// Sets `outValue` to the unsigned integer `value`.
+/// Returns an error message if `value` is not an integer in `[minValue, max. value of T]`.
+/// (Checks the JSON type explicitly, as `Json::get<unsigned>()` wraps negative integers)
+template <typename T>
+static ErrString parseParamValue(T& outValue, const Json& value, T minValue)
+{
+    if(!value.is_number_integer())
+    {
+        return "expected an integer";
+    }
+    if(!value.is_number_unsigned() || value.get<U64>() < U64(minValue))
+    {
+        std::ostringstream errMsg;
+        errMsg << "must be at least " << minValue << " (got " << value.dump() << ')';
+        return errMsg.str();
+    }
+    if(value.get<U64>() > U64(std::numeric_limits<T>::max()))
+    {
+        std::ostringstream errMsg;
+        errMsg << "must be at most " << std::numeric_limits<T>::max() << " (got " << value.dump() << ')';
+        return errMsg.str();
+    }
+    outValue = T(value.get<U64>());
+    return {};
+}
+
+/// Sets `outValue` to the value at `json[section][key]`, if present and valid
+/// (see `parseParamValue()`); otherwise leaves it unchanged.
+/// Returns an error message (a line) if the value is present but invalid.
+template <typename T>
+static ErrString getParam(T& outValue, const Json& json,
+                          const char* section, const char* key, T minValue=T())
+{
+    auto sectionIt = json.find(section);
+    if(sectionIt == json.end() || !sectionIt->is_object())
+    {
+        // Section not present, keep default value
+        return {};
+    }
+
+    auto valueIt = sectionIt->find(key);
+    if(valueIt == sectionIt->end())
+    {
+        // Value not present, keep default value
+        return {};
+    }
+
+    ErrString err = parseParamValue(outValue, *valueIt, minValue);
+    if(err)
+    {
+        std::ostringstream errMsg;
+        errMsg << section << '.' << key << ": " << err << '\n';
+        return errMsg.str();
+    }
+    return {};
+}
+
+ErrString CoreParams::apply(const Json& json)
+{
+    if(!json.is_object())
+    {
+        return "Core params are not a JSON object";
+    }
+
+    // (All params are validated even if some are invalid, to report all errors at once)
+    ErrString err;
+#define ARES_applyParam(field, section, key, minValue) \
+    err += getParam(field, json, section, key, decltype(field)(minValue));
+
+    ARES_applyParam(logMessagePoolCapacity, "log", "messagePoolCapacity", 1)
+
+    // ("auto" = 0 internally, see `schedulerNWorkers`)
+    auto schedulerIt = json.find("scheduler");
+    if(schedulerIt != json.end() && schedulerIt->is_object()
+       && schedulerIt->value("nWorkers", Json()) == "auto")
+    {
+        schedulerNWorkers = 0;
+    }
+    else
+    {
+        ARES_applyParam(schedulerNWorkers, "scheduler", "nWorkers", 1)
+    }
+
+    ARES_applyParam(schedulerPinWorkers, "scheduler", "pinWorkers", false)
+    ARES_applyParam(schedulerFiberPoolCapacity, "scheduler", "fiberPoolCapacity", 1)
+    ARES_applyParam(schedulerFiberStackSize, "scheduler", "fiberStackSize", MIN_FIBER_STACK_SIZE)
+    ARES_applyParam(sceneEntityCapacity, "scene", "entityCapacity", 1)
+    ARES_applyParam(memLogStats, "mem", "logStats", false)
+    ARES_applyParam(gfxNullBackend, "gfx", "nullBackend", false)
+    ARES_applyParam(gfxSoftBackend, "gfx", "softBackend", false)
+    ARES_applyParam(gfxNullFrames, "gfx", "nullFrames", 0)
+    ARES_applyParam(gfxNullWidth, "gfx", "nullWidth", 1)
+    ARES_applyParam(gfxNullHeight, "gfx", "nullHeight", 1)
+
+#undef ARES_applyParam
+    return err;
+}
+
+ErrString CoreParams::parseArgs(Json& outJson, int argc, const char* const* argv,
+                                std::vector<std::string>* outRest)
+{
+    ErrString err;
+
+    for(int i = 1; i < argc; i ++) // (skip argv[0], the executable's path)
+    {
+        const char* arg = argv[i];
+        if(strncmp(arg, "--", 2) != 0)
+        {
+            // Not a param override
+            if(outRest)
+            {
+                outRest->emplace_back(arg);
+            }
+            continue;
+        }
+        arg += 2;
+
+        // Split `[section.]key[=value]`
+        const char* equals = strchr(arg, '=');
+        const char* keyEnd = equals ? equals : arg + strlen(arg);
+        const char* dot = static_cast<const char*>(memchr(arg, '.', keyEnd - arg));
+        if(keyEnd == arg || dot == arg || (dot && dot + 1 == keyEnd))
+        {
+            std::ostringstream errMsg;
+            errMsg << "Malformed argument (expected --section.key=value): " << argv[i] << '\n';
+            err += errMsg.str();
+            continue;
+        }
+
+        Json value = true; // (`--section.key` alone is a boolean flag)
+        if(equals)
+        {
+            // Try parsing the value as JSON (numbers, booleans...); if it is not
+            // valid JSON treat it as a plain string
+            value = Json::parse(equals + 1, nullptr, false);
+            if(value.is_discarded())
+            {
+                value = std::string(equals + 1);
+            }
+        }
+
+        if(dot)
+        {
+            outJson[std::string(arg, dot)][std::string(dot + 1, keyEnd)] = std::move(value);
+        }
+        else
+        {
+            // Top-level key (ex. `--config=<path>`)
+            outJson[std::string(arg, keyEnd)] = std::move(value);
+        }
+    }
+
+    return err;
+}
+
+}
@@ -0,0 +1,90 @@
+#pragma once
+
+#include <stddef.h>
+#include <string>
+#include <vector>
+#include "Api.h"
+#include "CoreConfig.h"
+#include "Base/ErrString.hh"
+#include "Resource/Json.hh"
+
+namespace Ares
+{
+
+/// Runtime initialization parameters of a `Core`.
+///
+/// Defaults are taken from the `#define`s in `CoreConfig.h`; `Core::init()`
+/// then overrides them with the values in the `ARES_CORE_PARAMS_FILE` JSON
+/// config file (if any) and with any `--section.key=value` command-line arguments.
+/// See `Resources/Core.json` for the layout of the config file.
+struct ARES_API CoreParams
+{
+    /// The minimum valid `schedulerFiberStackSize`.
+    static constexpr const size_t MIN_FIBER_STACK_SIZE = 16 * 1024;
+
+    /// ["log.messagePoolCapacity"] The capacity of the `Log`'s message pool.
+    size_t logMessagePoolCapacity = ARES_CORE_LOG_MESSAGE_POOL_CAPACITY;
+
+    /// ["scheduler.nWorkers"] The number of worker threads of the `TaskScheduler`
+    /// (at least 1), or "auto" to use `TaskScheduler::optimalNWorkers()`
+    /// (stored as 0 here).
+    unsigned int schedulerNWorkers = 0;
+
+    /// ["scheduler.pinWorkers"] Wether to pin each worker thread to its own
+    /// hardware thread or not.
+    bool schedulerPinWorkers = false;
+
+    /// ["scheduler.fiberPoolCapacity"] The capacity of the `TaskScheduler`'s fiber pool.
+    unsigned int schedulerFiberPoolCapacity = ARES_CORE_SCHEDULER_FIBER_POOL_CAPACITY;
+
+    /// ["scheduler.fiberStackSize"] The stack size in bytes of each fiber in
+    /// the `TaskScheduler`'s fiber pool (at least `MIN_FIBER_STACK_SIZE`).
+    size_t schedulerFiberStackSize = ARES_CORE_SCHEDULER_FIBER_STACK_SIZE;
+
+    /// ["scene.entityCapacity"] The maximum number of entities in the `Scene`.
+    size_t sceneEntityCapacity = ARES_CORE_SCENE_ENTITY_CAPACITY;
+
+    /// ["mem.logStats"] Wether to log memory allocator statistics when the
+    /// core is destroyed or not.
+    /// (The allocator itself is set up before `main()` is entered, so its
+    /// backend can only be chosen at compile time; see `ARES_USE_RPMALLOC`.)
+    bool memLogStats = false;
+
+    /// ["gfx.nullBackend"] Wether to render with the `Null::Backend` instead of
+    /// the OpenGL one; no window or graphics context is created then (for
+    /// headless runs).
+    bool gfxNullBackend = false;
+
+    /// ["gfx.softBackend"] Wether to render on the CPU with the `Soft::Backend`
+    /// instead of the OpenGL one; no window or graphics context is created then
+    /// (for headless runs). Ignored if `gfxNullBackend` is set.
+    bool gfxSoftBackend = false;
+
+    /// ["gfx.nullFrames"] If rendering headless (`gfxNullBackend` or `gfxSoftBackend`)
+    /// and this is not 0, the number of frames to render before halting the core.
+    unsigned int gfxNullFrames = 0;
+
+    /// ["gfx.nullWidth"], ["gfx.nullHeight"] The resolution to render at when
+    /// headless (`gfxNullBackend` or `gfxSoftBackend`), as there is no window
+    /// to take it from.
+    size_t gfxNullWidth = 800, gfxNullHeight = 600;
+
+
+    /// Overrides the parameters that are present in `json` (see `Resources/Core.json`)
+    /// with their values. Parameters missing from it are left unchanged.
+    /// Values of the wrong type or out of range (capacities, sizes and resolutions
+    /// must be > 0) are left unchanged too; returns an error message with a
+    /// line for each of them. All valid values are applied regardless.
+    ErrString apply(const Json& json);
+
+    /// Parses `--section.key=value` command-line arguments into `outJson[section][key]`
+    /// (or `--key=value` ones into `outJson[key]`), where `value` is parsed as
+    /// JSON if possible (`--scheduler.nWorkers=4`) or stored as a string otherwise;
+    /// `--section.key` alone is stored as `true`.
+    /// Arguments not starting with `--` are appended to `outRest`, if it is not null.
+    /// Returns an error message on malformed arguments, skipping them.
+    static ErrString parseArgs(Json& outJson, int argc, const char* const* argv,
+                               std::vector<std::string>* outRest=nullptr);
+};
+
+}
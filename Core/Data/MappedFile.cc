@@ -0,0 +1,237 @@
+#include "MappedFile.hh"
+
+#include <stdlib.h>
+#include <Core/Base/Platform.h>
+
+#if defined(ARES_PLATFORM_IS_POSIX) || defined(ARES_PLATFORM_IS_MAC)
+#   include <fcntl.h>
+#   include <unistd.h>
+#   include <sys/mman.h>
+#   include <sys/stat.h>
+#elif defined(ARES_PLATFORM_IS_WINDOWS)
+#   define WIN32_LEAN_AND_MEAN
+#   include <windows.h>
+#else
+#   include <fstream>
+#endif
+
+namespace Ares
+{
+
+MappedFile::MappedFile()
+    : data_(nullptr), size_(0), mapped_(false), mapping_(nullptr)
+{
+}
+
+MappedFile::~MappedFile()
+{
+    close();
+}
+
+#if defined(ARES_PLATFORM_IS_POSIX) || defined(ARES_PLATFORM_IS_MAC)
+
+ErrString MappedFile::open(const char* path)
+{
+    close();
+
+    int fd = ::open(path, O_RDONLY);
+    if(fd < 0)
+    {
+        return std::string("Could not open file: ") + path;
+    }
+
+    struct stat fileStat;
+    if(fstat(fd, &fileStat) != 0)
+    {
+        ::close(fd);
+        return std::string("Could not stat file: ") + path;
+    }
+
+    size_ = size_t(fileStat.st_size);
+    if(size_ > 0)
+    {
+        void* mem = mmap(nullptr, size_, PROT_READ, MAP_PRIVATE, fd, 0);
+        if(mem != MAP_FAILED)
+        {
+            // (The file is mostly going to be read front to back)
+            (void)madvise(mem, size_, MADV_SEQUENTIAL);
+
+            data_ = reinterpret_cast<const U8*>(mem);
+            mapped_ = true;
+        }
+        else
+        {
+            // Can't map it (ex. the filesystem does not support it), read it
+            // into a heap buffer instead
+            // (`malloc()` is aligned for any fundamental type)
+            U8* buffer = reinterpret_cast<U8*>(malloc(size_));
+            size_t nRead = 0;
+            while(buffer && nRead < size_)
+            {
+                ssize_t n = ::read(fd, buffer + nRead, size_ - nRead);
+                if(n <= 0)
+                {
+                    break;
+                }
+                nRead += size_t(n);
+            }
+            if(nRead < size_)
+            {
+                free(buffer);
+                ::close(fd);
+                size_ = 0;
+                return std::string("Could not map nor read file: ") + path;
+            }
+            data_ = buffer;
+        }
+    }
+
+    // (The mapping stays valid after the descriptor is closed)
+    ::close(fd);
+    return {};
+}
+
+void MappedFile::close()
+{
+    if(mapped_)
+    {
+        munmap(const_cast<U8*>(data_), size_);
+    }
+    else
+    {
+        free(const_cast<U8*>(data_));
+    }
+    data_ = nullptr;
+    size_ = 0;
+    mapped_ = false;
+}
+
+#elif defined(ARES_PLATFORM_IS_WINDOWS)
+
+ErrString MappedFile::open(const char* path)
+{
+    close();
+
+    HANDLE file = CreateFileA(path, GENERIC_READ, FILE_SHARE_READ, nullptr,
+                              OPEN_EXISTING, FILE_FLAG_SEQUENTIAL_SCAN, nullptr);
+    if(file == INVALID_HANDLE_VALUE)
+    {
+        return std::string("Could not open file: ") + path;
+    }
+
+    LARGE_INTEGER fileSize;
+    if(!GetFileSizeEx(file, &fileSize))
+    {
+        CloseHandle(file);
+        return std::string("Could not get the size of file: ") + path;
+    }
+
+    size_ = size_t(fileSize.QuadPart);
+    if(size_ > 0)
+    {
+        HANDLE mapping = CreateFileMappingA(file, nullptr, PAGE_READONLY, 0, 0, nullptr);
+        const void* mem = mapping ? MapViewOfFile(mapping, FILE_MAP_READ, 0, 0, 0) : nullptr;
+        if(mem)
+        {
+            data_ = reinterpret_cast<const U8*>(mem);
+            mapping_ = mapping;
+            mapped_ = true;
+        }
+        else
+        {
+            if(mapping)
+            {
+                CloseHandle(mapping);
+            }
+
+            // Can't map it, read it into a heap buffer instead
+            // (`malloc()` is aligned for any fundamental type)
+            U8* buffer = reinterpret_cast<U8*>(malloc(size_));
+            size_t nRead = 0;
+            while(buffer && nRead < size_)
+            {
+                DWORD toRead = DWORD(size_ - nRead < 0x40000000 ? size_ - nRead : 0x40000000);
+                DWORD n = 0;
+                if(!ReadFile(file, buffer + nRead, toRead, &n, nullptr) || n == 0)
+                {
+                    break;
+                }
+                nRead += n;
+            }
+            if(nRead < size_)
+            {
+                free(buffer);
+                CloseHandle(file);
+                size_ = 0;
+                return std::string("Could not map nor read file: ") + path;
+            }
+            data_ = buffer;
+        }
+    }
+
+    // (The view, if any, keeps the file open)
+    CloseHandle(file);
+    return {};
+}
+
+void MappedFile::close()
+{
+    if(mapped_)
+    {
+        UnmapViewOfFile(data_);
+        CloseHandle(HANDLE(mapping_));
+    }
+    else
+    {
+        free(const_cast<U8*>(data_));
+    }
+    data_ = nullptr;
+    size_ = 0;
+    mapped_ = false;
+    mapping_ = nullptr;
+}
+
+#else
+//  Unknown platform: just read the whole file into memory
+
+ErrString MappedFile::open(const char* path)
+{
+    close();
+
+    std::ifstream stream(path, std::ios::in | std::ios::binary);
+    if(!stream)
+    {
+        return std::string("Could not open file: ") + path;
+    }
+
+    stream.seekg(0, std::ios::end);
+    size_ = size_t(stream.tellg());
+    stream.seekg(0, std::ios::beg);
+
+    if(size_ > 0)
+    {
+        // (`malloc()` is aligned for any fundamental type)
+        U8* mem = reinterpret_cast<U8*>(malloc(size_));
+        stream.read(reinterpret_cast<char*>(mem), size_);
+        if(!stream)
+        {
+            free(mem);
+            size_ = 0;
+            return std::string("Could not read file: ") + path;
+        }
+        data_ = mem;
+    }
+    return {};
+}
+
+void MappedFile::close()
+{
+    free(const_cast<U8*>(data_));
+    data_ = nullptr;
+    size_ = 0;
+    mapped_ = false;
+}
+
+#endif
+
+}
@@ -0,0 +1,55 @@
+#pragma once
+
+#include <stddef.h>
+#include <Core/Api.h>
+#include <Core/Base/NumTypes.hh>
+#include <Core/Base/ErrString.hh>
+
+namespace Ares
+{
+
+/// A read-only view of a file's contents in memory.
+///
+/// The file is memory-mapped where the platform allows it (`mmap()` on POSIX
+/// systems, `MapViewOfFile()` on Windows), so that pages are only read from disk
+/// when first touched; on other platforms, or if mapping it fails, it is read
+/// into a heap buffer instead. Either way `data()` is aligned to at least 16 bytes.
+class ARES_API MappedFile
+{
+    const U8* data_;
+    size_t size_;
+    bool mapped_; ///< `true` if `data_` is mapped, `false` if it was `malloc()`'d.
+    void* mapping_; ///< (Windows only) The handle of the file mapping object.
+
+    MappedFile(const MappedFile& toCopy) = delete;
+    MappedFile& operator=(const MappedFile& toCopy) = delete;
+
+public:
+    /// Creates a new, closed mapped file.
+    MappedFile();
+
+    /// Closes the file if it is open.
+    ~MappedFile();
+
+    /// Maps (or reads) the file at `path` into memory, closing the previously open file
+    /// (if any). Returns an error on failure.
+    ErrString open(const char* path);
+
+    /// Unmaps/frees the file's contents. Does nothing if no file is open.
+    void close();
+
+    /// Returns a pointer to the contents of the file, or null if it is not open
+    /// (or empty).
+    inline const U8* data() const
+    {
+        return data_;
+    }
+
+    /// Returns the size of the file in bytes.
+    inline size_t size() const
+    {
+        return size_;
+    }
+};
+
+}
@@ -16,6 +16,11 @@ DebugModule::~DebugModule()
 
 #define glog (*core.g().log)
 
+const char* DebugModule::name() const
+{
+    return "Debug";
+}
+
 bool DebugModule::init(Core& core)
 {
     ARES_log(glog, Debug, "DebugModule online");
@@ -17,6 +17,7 @@ public:
     DebugModule();
     ~DebugModule() override;
 
+    const char* name() const override;
     bool init(Core& core) override;
     void mainUpdate(Core& core) override;
     Task updateTask(Core& core) override;
@@ -6,7 +6,8 @@ namespace Ares
 {
 
 Profiler::Profiler()
-    : timeEvents_(), timeEventsConsumer_(timeEvents_)
+    : timeEvents_(), timeEventsConsumer_(timeEvents_),
+      counterEvents_(), counterEventsConsumer_(counterEvents_)
 {
 }
 
@@ -30,4 +31,22 @@ size_t Profiler::flush(std::vector<TimeEvent>& events)
 #endif
 }
 
+size_t Profiler::flush(std::vector<CounterEvent>& events)
+{
+#ifdef ARES_ENABLE_PROFILER
+    size_t oldSize = events.size();
+    size_t n = counterEvents_.size_approx();
+
+    events.resize(oldSize + n);
+
+    CounterEvent* it = &events[oldSize]; // The first event to write in `events`
+    size_t nFlushed = counterEvents_.try_dequeue_bulk(counterEventsConsumer_, it, n);
+    events.resize(oldSize + nFlushed);
+    return nFlushed;
+
+#else
+    return 0;
+#endif
+}
+
 }
@@ -67,9 +67,27 @@ public:
         U64 startTime, endTime;
     };
 
+    /// A value of a named counter, as reported via `counter()`.
+    struct ARES_API CounterEvent
+    {
+        /// The name of the counter.
+        const char* name;
+
+        /// The id of the thread from which the value was reported.
+        ThreadId thread;
+
+        /// The time the value was reported at, as reported by `Profiler::Clock::now()`.
+        U64 time;
+
+        /// The value of the counter.
+        I64 value;
+    };
+
 private:
     moodycamel::ConcurrentQueue<TimeEvent> timeEvents_;
     moodycamel::ConsumerToken timeEventsConsumer_; ///< Used by `flush()` only
+    moodycamel::ConcurrentQueue<CounterEvent> counterEvents_;
+    moodycamel::ConsumerToken counterEventsConsumer_; ///< Used by `flush()` only
 
     /// Records the given time event in the events list, waiting for it to be
     /// processed by the next `flush()` call.
@@ -95,11 +113,33 @@ public:
     Profiler& operator=(Profiler&& toMove) = delete;
 
 
+    /// Reports the current value of the counter named `name` (number of draw
+    /// calls, of culled objects, ...).
+    /// **WARNING** `name` should be a pointer to a static string constant;
+    ///             the string is not copied, but merely stored in the event!
+    /// Threadsafe and lockless. Does nothing `#ifndef ARES_ENABLE_PROFILER`.
+    inline void counter(const char* name, I64 value)
+    {
+#ifdef ARES_ENABLE_PROFILER
+        counterEvents_.enqueue(CounterEvent{name, localThreadId(), Clock::now(), value});
+#else
+        (void)name;
+        (void)value;
+#endif
+    }
+
+
     /// Appends all events reported by `TimeProbe`s inbetween the lastest `flush()`
     /// call and this one to `events`. Returns the number of appended events.
     ///
     /// Always returns 0 `#ifndef ARES_ENABLE_PROFILER`.
     size_t flush(std::vector<TimeEvent>& events);
+
+    /// Appends all values reported via `counter()` inbetween the lastest `flush()`
+    /// call and this one to `events`. Returns the number of appended events.
+    ///
+    /// Always returns 0 `#ifndef ARES_ENABLE_PROFILER`.
+    size_t flush(std::vector<CounterEvent>& events);
 };
 
 inline std::ostream& operator<<(std::ostream& stream, const Profiler::TimeEvent& event)
@@ -110,4 +150,12 @@ inline std::ostream& operator<<(std::ostream& stream, const Profiler::TimeEvent&
     return stream;
 }
 
+inline std::ostream& operator<<(std::ostream& stream, const Profiler::CounterEvent& event)
+{
+    stream << event.name << '@' << event.thread << ':'
+           << event.time << '=' << event.value
+           << '\n';
+    return stream;
+}
+
 }
@@ -2,6 +2,7 @@
 
 #include "Api.h"
 #include "Event/EventMatrix.hh"
+#include "Gfx/GfxFrameData.hh"
 
 namespace Ares
 {
@@ -17,10 +18,15 @@ namespace Ares
 /// read/write "current" frame data.
 struct ARES_API FrameData
 {
+    /// The scene data to render, extracted by `GfxModule`.
+    GfxFrameData gfx;
+
+
     /// Clears the frame data. This is done to prepare it for the next update cycle,
     /// when it will be recycled as the new "current" frame data.
     void clear()
     {
+        gfx.clear();
     }
 };
 
@@ -0,0 +1,114 @@
+#include "FrustumCuller.hh"
+
+#include <math.h>
+
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#   define ARES_FRUSTUMCULLER_SSE 1
+#   include <emmintrin.h>
+#endif
+
+namespace Ares
+{
+
+FrustumCuller::FrustumCuller(const Frustum& frustum)
+{
+    for(unsigned int i = 0; i < 8; i ++)
+    {
+        // (Padding planes: `0*x + 0*y + 0*z + 1 >= 0` for any point)
+        glm::vec4 plane = i < 6 ? frustum.planes[i] : glm::vec4(0.0f, 0.0f, 0.0f, 1.0f);
+        planesX_[i] = plane.x;
+        planesY_[i] = plane.y;
+        planesZ_[i] = plane.z;
+        planesW_[i] = plane.w;
+        absPlanesX_[i] = fabsf(plane.x);
+        absPlanesY_[i] = fabsf(plane.y);
+        absPlanesZ_[i] = fabsf(plane.z);
+    }
+}
+
+// A box is outside of the frustum if it is entirely behind any of its planes,
+// i.e. if the distance of its center from the plane is less than minus the
+// box's "radius" projected on the plane's normal:
+//   dot(plane.xyz, center) + plane.w + dot(abs(plane.xyz), extents) < 0
+
+bool FrustumCuller::intersects(const glm::vec3& center, const glm::vec3& extents) const
+{
+#ifdef ARES_FRUSTUMCULLER_SSE
+    const __m128 cx = _mm_set1_ps(center.x), cy = _mm_set1_ps(center.y), cz = _mm_set1_ps(center.z);
+    const __m128 ex = _mm_set1_ps(extents.x), ey = _mm_set1_ps(extents.y), ez = _mm_set1_ps(extents.z);
+    const __m128 zero = _mm_setzero_ps();
+
+    __m128 outside = zero;
+    for(unsigned int i = 0; i < 8; i += 4)
+    {
+        __m128 dist = _mm_add_ps(_mm_add_ps(_mm_mul_ps(_mm_load_ps(&planesX_[i]), cx),
+                                            _mm_mul_ps(_mm_load_ps(&planesY_[i]), cy)),
+                                 _mm_add_ps(_mm_mul_ps(_mm_load_ps(&planesZ_[i]), cz),
+                                            _mm_load_ps(&planesW_[i])));
+        __m128 radius = _mm_add_ps(_mm_add_ps(_mm_mul_ps(_mm_load_ps(&absPlanesX_[i]), ex),
+                                              _mm_mul_ps(_mm_load_ps(&absPlanesY_[i]), ey)),
+                                   _mm_mul_ps(_mm_load_ps(&absPlanesZ_[i]), ez));
+        outside = _mm_or_ps(outside, _mm_cmplt_ps(_mm_add_ps(dist, radius), zero));
+    }
+    return _mm_movemask_ps(outside) == 0;
+
+#else
+    for(unsigned int i = 0; i < 6; i ++)
+    {
+        float dist = planesX_[i] * center.x + planesY_[i] * center.y + planesZ_[i] * center.z
+                     + planesW_[i];
+        float radius = absPlanesX_[i] * extents.x + absPlanesY_[i] * extents.y
+                       + absPlanesZ_[i] * extents.z;
+        if(dist + radius < 0.0f)
+        {
+            return false;
+        }
+    }
+    return true;
+#endif
+}
+
+size_t FrustumCuller::cull(const Aabb& localBounds, const glm::mat4* matrices, size_t n,
+                           U8* outVisible) const
+{
+    const glm::vec3 c = localBounds.center(), e = localBounds.extents();
+
+    size_t nVisible = 0;
+    for(size_t i = 0; i < n; i ++)
+    {
+        // Find the world-space box of the instance (see `Aabb::transformed()`)
+        const glm::mat4& m = matrices[i];
+        glm::vec3 center, extents;
+#ifdef ARES_FRUSTUMCULLER_SSE
+        const __m128 absMask = _mm_castsi128_ps(_mm_set1_epi32(0x7FFFFFFF));
+        __m128 col0 = _mm_loadu_ps(&m[0][0]), col1 = _mm_loadu_ps(&m[1][0]);
+        __m128 col2 = _mm_loadu_ps(&m[2][0]), col3 = _mm_loadu_ps(&m[3][0]);
+
+        __m128 centerV = _mm_add_ps(_mm_add_ps(col3, _mm_mul_ps(col0, _mm_set1_ps(c.x))),
+                                    _mm_add_ps(_mm_mul_ps(col1, _mm_set1_ps(c.y)),
+                                               _mm_mul_ps(col2, _mm_set1_ps(c.z))));
+        __m128 extentsV = _mm_add_ps(_mm_add_ps(_mm_mul_ps(_mm_and_ps(col0, absMask), _mm_set1_ps(e.x)),
+                                                _mm_mul_ps(_mm_and_ps(col1, absMask), _mm_set1_ps(e.y))),
+                                     _mm_mul_ps(_mm_and_ps(col2, absMask), _mm_set1_ps(e.z)));
+
+        alignas(16) float centerF[4], extentsF[4];
+        _mm_store_ps(centerF, centerV);
+        _mm_store_ps(extentsF, extentsV);
+        center = glm::vec3(centerF[0], centerF[1], centerF[2]);
+        extents = glm::vec3(extentsF[0], extentsF[1], extentsF[2]);
+#else
+        for(int j = 0; j < 3; j ++)
+        {
+            center[j] = m[3][j] + m[0][j] * c.x + m[1][j] * c.y + m[2][j] * c.z;
+            extents[j] = fabsf(m[0][j]) * e.x + fabsf(m[1][j]) * e.y + fabsf(m[2][j]) * e.z;
+        }
+#endif
+
+        bool visible = intersects(center, extents);
+        outVisible[i] = U8(visible);
+        nVisible += visible;
+    }
+    return nVisible;
+}
+
+}
@@ -0,0 +1,43 @@
+#pragma once
+
+#include <stddef.h>
+#include <glm/vec3.hpp>
+#include <glm/mat4x4.hpp>
+#include <Core/Api.h>
+#include <Core/Base/NumTypes.hh>
+#include <Core/Base/Aabb.hh>
+#include <Core/Base/Frustum.hh>
+
+namespace Ares
+{
+
+/// Tests lots of bounding boxes against a `Frustum`, checking each box against
+/// 4 of the frustum's planes at a time with SSE when available (else plain
+/// scalar code).
+///
+/// All methods are const, so a culler can be used by any number of tasks
+/// concurrently (ex. with `parallelFor()`).
+class ARES_API FrustumCuller
+{
+    /// The frustum's planes (and their absolute values) as a structure of
+    /// arrays, padded to 8 planes with planes that never cull anything.
+    alignas(16) float planesX_[8], planesY_[8], planesZ_[8], planesW_[8];
+    alignas(16) float absPlanesX_[8], absPlanesY_[8], absPlanesZ_[8];
+
+public:
+    /// Initializes a culler for the given frustum.
+    explicit FrustumCuller(const Frustum& frustum);
+
+    /// Returns `true` if the box centered in `center` with the given half-size
+    /// `extents` is (at least partially) inside of the frustum.
+    /// Conservative like `Frustum::intersects()`.
+    bool intersects(const glm::vec3& center, const glm::vec3& extents) const;
+
+    /// For each of `n` instances of the (local-space) box `localBounds`,
+    /// transformed by the respective (affine) `matrices[i]`, sets `outVisible[i]`
+    /// to 1 if it is inside of the frustum or to 0 otherwise.
+    /// Returns the number of instances inside of the frustum.
+    size_t cull(const Aabb& localBounds, const glm::mat4* matrices, size_t n, U8* outVisible) const;
+};
+
+}
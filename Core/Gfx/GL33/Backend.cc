@@ -1,6 +1,8 @@
 #include "Backend.hh"
 
 #include <sstream>
+#include <iterator>
+#include <algorithm>
 #include <Core/Gfx/GL33/Shader.hh>
 #include <Core/Gfx/GL33/Texture.hh>
 
@@ -73,6 +75,8 @@ Backend::~Backend()
         glDeleteProgram(program);
     }
     shaders_.clear();
+
+    materials_.clear();
 }
 
 
@@ -519,7 +523,7 @@ Handle<GfxShader> Backend::genShader(const GfxShaderDesc& desc, ErrString* err)
     // If GLSL supported `uniform sampler2D u_Texture0 = 1` this would not be required...
     // TODO Find a more elegant way to do texture unit binding!
     std::ostringstream textureUniformName;
-    for(unsigned int i = 0; i < GfxCmd::MAX_TEXTURES; i ++)
+    for(unsigned int i = 0; i < GfxMaterialDesc::MAX_TEXTURES; i ++)
     {
         textureUniformName.str("");
         textureUniformName << "u_Texture" << i;
@@ -548,6 +552,25 @@ void Backend::delShader(Handle<GfxShader> shader)
 }
 
 
+Handle<GfxMaterial> Backend::genMaterial(const GfxMaterialDesc& desc)
+{
+    if(desc.nTextures > GfxMaterialDesc::MAX_TEXTURES)
+    {
+        return {};
+    }
+
+    // (Materials are not OpenGL objects, just the textures to bind)
+    Handle<GfxMaterial> handle(nextMaterialId_ ++);
+    materials_[handle] = desc;
+    return handle;
+}
+
+void Backend::delMaterial(Handle<GfxMaterial> material)
+{
+    materials_.erase(material);
+}
+
+
 void Backend::changeResolution(Resolution resolution)
 {
     glViewport(0, 0, resolution.width, resolution.height);
@@ -698,7 +721,7 @@ static constexpr const size_t GFX_VERTEXATTRIB_TYPE_SIZE[] = // Index by `GfxPip
 };
 
 Backend::Vao::Vao(const GfxPipeline::Pass& pass, VaoKey key)
-    : key(key), vao_(0)
+    : key(key), vao_(0), instanceStride_(0), firstInstance_(0)
 {
     glGenVertexArrays(1, &vao_);
     if(!vao_)
@@ -763,6 +786,7 @@ Backend::Vao::Vao(const GfxPipeline::Pass& pass, VaoKey key)
     }
 
     glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, key.indexBuffer);
+    instanceStride_ = instanceStride;
 }
 
 Backend::Vao::~Vao()
@@ -773,6 +797,35 @@ Backend::Vao::~Vao()
     }
 }
 
+void Backend::Vao::setFirstInstance(const GfxPipeline::Pass& pass, size_t firstInstance)
+{
+    if(firstInstance == firstInstance_ || instanceStride_ == 0)
+    {
+        return;
+    }
+
+    // Same as in the constructor, but offsetting all instance attribs
+    glBindBuffer(GL_ARRAY_BUFFER, key.instanceBuffer);
+    size_t instanceOffset = firstInstance * instanceStride_;
+    for(unsigned int i = 0; i < pass.nAttribs; i ++)
+    {
+        const auto& attrib = pass.attribs[i];
+        if(attrib.instanceDivisor == 0)
+        {
+            continue;
+        }
+
+        glVertexAttribPointer(i,
+                              attrib.n, GFX_VERTEXATTRIB_TYPE_TO_GL[unsigned(attrib.type)],
+                              GL_FALSE,
+                              instanceStride_, (void*)instanceOffset);
+
+        instanceOffset += GFX_VERTEXATTRIB_TYPE_SIZE[unsigned(attrib.type)] * attrib.n;
+    }
+
+    firstInstance_ = firstInstance;
+}
+
 
 // === CmdFuncs assume that some state has been bound for them by `runCmds()` ===
 // - shader program
@@ -819,11 +872,16 @@ static constexpr const CmdFunc GFX_CMD_FUNCS[] = // Indexed by `GfxCmd::Op`
     cmdDrawInstancedIndexed, // 3: DrawInstancedIndexed
 };
 
-void Backend::runCmds(const GfxCmd* cmds, const GfxCmdIndex* cmdsOrder, size_t n)
+void Backend::runCmds(const GfxCmdIndex* cmdsOrder, size_t n)
 {
+    // (Textures could have been rebound by `genTexture()`/`editTexture()` since
+    // the last frame)
+    curBindings_.material = {};
+    std::fill(std::begin(curBindings_.textures), std::end(curBindings_.textures), 0);
+
     for(size_t i = 0; i < n; i ++)
     {
-        const GfxCmd& cmd = cmds[cmdsOrder[i].index];
+        const GfxCmd& cmd = *cmdsOrder[i].cmd;
 
         // Switch to the right pass if needed; rebinds the FBO and shader program
         // The sorting key specifies all cmds for a specific pass to be run in sequence
@@ -833,10 +891,24 @@ void Backend::runCmds(const GfxCmd* cmds, const GfxCmdIndex* cmdsOrder, size_t n
         }
 
         // Bind the right textures if needed
-        for(unsigned int i = 0; i < cmd.nTextures; i ++)
+        // The sorting key has commands with the same (or similar) materials run in sequence
+        if(cmd.material != curBindings_.material)
         {
-            glActiveTexture(GL_TEXTURE0 + i);
-            glBindTexture(GL_TEXTURE_2D, cmd.textures[i]);
+            auto materialIt = materials_.find(cmd.material);
+            if(materialIt != materials_.end())
+            {
+                const GfxMaterialDesc& material = materialIt->second;
+                for(unsigned int i = 0; i < material.nTextures; i ++)
+                {
+                    if(material.textures[i] != curBindings_.textures[i])
+                    {
+                        glActiveTexture(GL_TEXTURE0 + i);
+                        glBindTexture(GL_TEXTURE_2D, material.textures[i]);
+                        curBindings_.textures[i] = material.textures[i];
+                    }
+                }
+            }
+            curBindings_.material = cmd.material;
         }
 
         // Bind the right vertex/instance attribute source buffers (via rebinding a VAO) if needed
@@ -853,6 +925,11 @@ void Backend::runCmds(const GfxCmd* cmds, const GfxCmdIndex* cmdsOrder, size_t n
 
             glBindVertexArray(vaoIt->second);
             curBindings_.vaoKey = cmdVaoKey;
+            curBindings_.vao = &vaoIt->second;
+        }
+        if(cmd.op == GfxCmd::DrawInstanced || cmd.op == GfxCmd::DrawIndexedInstanced)
+        {
+            curBindings_.vao->setFirstInstance(pipeline_->passes[curPassId_], cmd.firstInstance);
         }
 
         // Issue the actual command
@@ -22,6 +22,8 @@ private:
     std::unordered_map<Handle<GfxBuffer>, GfxBufferDesc> buffers_;
     std::unordered_map<Handle<GfxTexture>, TextureDesc> textures_;
     std::unordered_set<Handle<GfxShader>> shaders_;
+    std::unordered_map<Handle<GfxMaterial>, GfxMaterialDesc> materials_;
+    U32 nextMaterialId_ = 1;
 
     Ref<GfxPipeline> pipeline_;
     U8 curPassId_ = 0;
@@ -60,6 +62,8 @@ private:
 
     private:
         GLuint vao_;
+        size_t instanceStride_; ///< The stride of per-instance attribs in `key.instanceBuffer`.
+        size_t firstInstance_; ///< The element of `key.instanceBuffer` instance attribs currently start at.
 
     public:
         Vao(const GfxPipeline::Pass& pass, VaoKey key);
@@ -71,6 +75,8 @@ private:
             // Move data over
             key = toMove.key;
             vao_ = toMove.vao_;
+            instanceStride_ = toMove.instanceStride_;
+            firstInstance_ = toMove.firstInstance_;
 
             // Invalidate the moved instance
             toMove.vao_ = 0;
@@ -80,6 +86,12 @@ private:
         {
             return vao_;
         }
+
+        /// Points the per-instance attribs of `pass` (the one the VAO was created
+        /// for) to start from the element `firstInstance` of the instance buffer,
+        /// if they don't already. The VAO must be bound.
+        /// (GL 3.3 has no base instance for instanced draws)
+        void setFirstInstance(const GfxPipeline::Pass& pass, size_t firstInstance);
     };
     class VaoKeyHasher
     {
@@ -108,7 +120,10 @@ private:
     struct Bindings
     {
         VaoKey vaoKey = {0, U32(-1), U32(-1), U32(-1)}; // Encapsulates vertex + index + instance buffers
+        Vao* vao = nullptr; // The VAO for `vaoKey`
         GLuint ubo = 0;
+        Handle<GfxMaterial> material{0};
+        GLuint textures[GfxMaterialDesc::MAX_TEXTURES] = {}; // (Bound to texture units 0..N)
 
     } curBindings_;
 
@@ -134,8 +149,11 @@ public:
     Handle<GfxShader> genShader(const GfxShaderDesc& desc, ErrString* err) override;
     void delShader(Handle<GfxShader> shader) override;
 
+    Handle<GfxMaterial> genMaterial(const GfxMaterialDesc& desc) override;
+    void delMaterial(Handle<GfxMaterial> material) override;
+
     void changeResolution(Resolution resolution) override;
-    void runCmds(const GfxCmd* cmds, const GfxCmdIndex* cmdsOrder, size_t n) override;
+    void runCmds(const GfxCmdIndex* cmdsOrder, size_t n) override;
 };
 
 }
@@ -99,13 +99,26 @@ public:
     virtual void delShader(Handle<GfxShader> shader) = 0;
 
 
+    /// Attempts to create a material (a set of textures to bind for commands)
+    /// given its description; returns a null handle on error.
+    /// Materials can not be edited; create a new one instead.
+    /// **WARNING**: Use `GfxRenderer::genMaterial()` instead, or commands using
+    ///              the material will not be sorted by it!
+    virtual Handle<GfxMaterial> genMaterial(const GfxMaterialDesc& desc) = 0;
+
+    /// Deletes the given material (but not its textures).
+    /// Does nothing if the given handle is null or invalid.
+    /// **WARNING**: Use `GfxRenderer::delMaterial()` instead!
+    virtual void delMaterial(Handle<GfxMaterial> material) = 0;
+
+
     /// A callback for when the rendering resolution needs to be changed.
     ///
     /// Use this to setup the new viewport, recreate swapchains if needed, etc.
     virtual void changeResolution(Resolution resolution) = 0;
 
-    /// Runs `cmds[cmdsOrder[i].index]` for each `i` in `[0..n)` in sequence.
-    virtual void runCmds(const GfxCmd* cmds, const GfxCmdIndex* cmdsOrder, size_t n) = 0;
+    /// Runs `*cmdsOrder[i].cmd` for each `i` in `[0..n)` in sequence.
+    virtual void runCmds(const GfxCmdIndex* cmdsOrder, size_t n) = 0;
 };
 
 }
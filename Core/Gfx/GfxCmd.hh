@@ -13,10 +13,6 @@ namespace Ares
 /// and `instanceBuffer` is interleaved and not tightly packed; see OpenGL's definitons for this.
 struct GfxCmd
 {
-    /// The maximum number of textures that can be bound at a time for the command.
-    static const unsigned int MAX_TEXTURES = 8;
-
-
     enum Op : U8
     {
         /// Draws `n` vertices (whose `GfxPipeline::Attrib`s are gathered from
@@ -30,11 +26,13 @@ struct GfxCmd
         DrawIndexed = 1,
 
         /// Performs a `Draw` operation `nInstance` times, gathering per-instance
-        /// `GfxPipeline::Attrib` data from `instanceBuffer`.
+        /// `GfxPipeline::Attrib` data from `instanceBuffer` (starting from
+        /// the element `firstInstance`).
         DrawInstanced = 2,
 
         /// Performs a `DrawIndexed` operation `nInstance` times, gathering per-instance
-        /// `GfxPipeline::Attrib` data from `instanceBuffer`.
+        /// `GfxPipeline::Attrib` data from `instanceBuffer` (starting from
+        /// the element `firstInstance`).
         DrawIndexedInstanced = 3,
 
     } op = Draw; ///< The rendering operation to perform for this command.
@@ -70,27 +68,38 @@ struct GfxCmd
     /// The number of instances to draw; see `Op::DrawInstanced`
     size_t nInstances = 0;
 
-    /// The textures to be bound to texture inputs in the `GfxPipeline::Pass`'
-    /// shader for this command.
+    /// The first element of per-instance attribs to read from `instanceBuffer`;
+    /// see `Op::DrawInstanced`. (Like OpenGL's "base instance", this does not
+    /// offset the instance ids seen by shaders)
+    size_t firstInstance = 0;
+
+    /// The material (textures) to use for the command; leave null to bind no textures.
+    /// The material should have been `genMaterial()`d from the `GfxRenderer` in use.
     ///
     /// The renderer will try to minimize the amount of times textures are bound
-    /// by clustering drawcalls that use the same textures togeter.
-    Handle<GfxTexture> textures[MAX_TEXTURES];
-
-    /// The number of textures in `nTextures`. Must be `<= MAX_TEXTURES`.
-    unsigned int nTextures = 0;
+    /// by clustering drawcalls that use the same material (and similar ones) together.
+    Handle<GfxMaterial> material;
+
+    /// The offset in bytes of the per-instance attribute data stored inline for
+    /// the command by `GfxRenderer::enqueueCmd(cmd, instanceData, instanceDataSize)`
+    /// in the renderer's recording bucket, and the size in bytes of the data of
+    /// each instance (size 0 = no inline data).
+    /// Do not set these manually; backends never get commands with inline data.
+    U32 instanceDataOffset = 0, instanceDataSize = 0;
 };
 
 
-/// The index of a `GfxCmd` in a sorted list.
+/// A reference to a `GfxCmd` in a sorted list.
 ///
-/// Commands are sorted by the value of the `key`; for `N` commands in a `cmdList`,
-/// `cmdList[idx0.index]` for the `idx0` with the lowest `key` is run, followed
-/// by `cmdList[idx1.index]` for the second lowest `key` in `idx1`, etc. etc.
+/// Commands are sorted by the value of the `key`; for `N` commands, `*idx0.cmd`
+/// for the `idx0` with the lowest `key` is run, followed by `*idx1.cmd` for the
+/// second lowest `key` in `idx1`, etc. etc.
+/// (The commands are pointed to and not copied, so that they can be sorted
+/// without moving them out of the storage they were recorded into)
 struct GfxCmdIndex
 {
     U64 key; ///< The command's sort key in the list. See `GfxCmdIndex`'s documentation.
-    size_t index; ///< The index of the command in the list. See `GfxCmdIndex`'s documentation.
+    const GfxCmd* cmd; ///< The command. See `GfxCmdIndex`'s documentation.
 
     /// `true` if this' `key` has a lower value than other's.
     inline bool operator<(const GfxCmdIndex& other) const
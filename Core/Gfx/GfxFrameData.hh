@@ -0,0 +1,79 @@
+#pragma once
+
+#include <stddef.h>
+#include <vector>
+#include <glm/mat4x4.hpp>
+#include <Core/Api.h>
+#include <Core/Base/Ref.hh>
+#include <Core/Resource/Mesh.hh>
+#include <Core/Gfx/GfxCmd.hh>
+
+namespace Ares
+{
+
+/// The rendering data extracted from the scene in a frame by `GfxModule`'s
+/// update task, to be uploaded and rendered by `GfxModule::mainUpdate()` in
+/// the next frame. See `FrameData::gfx`.
+struct ARES_API GfxFrameData
+{
+    /// The instances of a mesh to draw.
+    struct Batch
+    {
+        /// The mesh to draw.
+        Ref<Mesh> mesh;
+
+        /// The model matrices of the instances of `mesh` to draw, if they changed
+        /// since the frame before; empty otherwise (the ones the main thread
+        /// uploaded or kept from then are still valid).
+        std::vector<glm::mat4> instanceMatrices;
+
+        /// The command that draws the batch; its `vertexBuffer`, `indexBuffer`
+        /// and `instanceBuffer` are left for the main thread to fill in (batches
+        /// with few instances have their instance data recorded inline instead,
+        /// see `GfxRenderer::enqueueCmd(cmd, instanceData, instanceDataSize)`).
+        GfxCmd cmd;
+    };
+
+    /// `true` if the scene was extracted in this frame data.
+    bool extracted = false;
+
+    /// The view-projection matrix of the active camera.
+    glm::mat4 camViewProj;
+
+    /// The batches to draw (the first `nBatches` in the vector; the others are
+    /// kept around for reuse).
+    std::vector<Batch> batches;
+    size_t nBatches = 0;
+
+    /// The number of mesh instances inside and outside of the camera frustum.
+    size_t nVisibleMeshes = 0, nCulledMeshes = 0;
+
+
+    /// Appends a new batch for `mesh` and returns it.
+    inline Batch& addBatch(const Ref<Mesh>& mesh)
+    {
+        if(nBatches >= batches.size())
+        {
+            batches.emplace_back();
+        }
+        Batch& batch = batches[nBatches ++];
+        batch.mesh = mesh;
+        return batch;
+    }
+
+    /// Clears the frame data, keeping the memory of the batches allocated.
+    void clear()
+    {
+        for(size_t i = 0; i < nBatches; i ++)
+        {
+            batches[i].mesh = {};
+            batches[i].instanceMatrices.clear();
+            batches[i].cmd = GfxCmd();
+        }
+        nBatches = 0;
+        extracted = false;
+        nVisibleMeshes = nCulledMeshes = 0;
+    }
+};
+
+}
@@ -1,6 +1,8 @@
 #include "GfxModule.hh"
 
+#include <atomic>
 #include <utility>
+#include <algorithm>
 #include <unordered_map>
 #include <glm/mat4x4.hpp>
 #include <glm/gtc/matrix_transform.hpp>
@@ -8,32 +10,84 @@
 #include <glm/gtx/quaternion.hpp>
 #include <Core/Core.hh>
 #include <Core/Debug/Log.hh>
+#include <Core/Debug/TimeProbe.hh>
 #include <Core/Data/ResourceLoader.hh>
 #include <Core/Visual/Window.hh>
 #include <Core/Resource/Mesh.hh>
 #include <Core/Scene/Scene.hh>
-#include <Core/Scene/SceneIterator.hh>
+#include <Core/Scene/SceneView.hh>
 #include <Core/Comp/TransformComp.hh>
+#include <Core/Comp/TransformBatch.hh>
+#include <Core/Comp/TransformHierarchy.hh>
+#include <Core/Comp/WorldTransformComp.hh>
 #include <Core/Comp/MeshComp.hh>
 #include <Core/Comp/CameraComp.hh>
+#include <Core/Task/ParallelFor.hh>
 #include <Core/Gfx/GfxRenderer.hh>
 #include <Core/Gfx/GfxBackend.hh>
+#include <Core/Gfx/FrustumCuller.hh>
 
 // OpenGL 3.3 core backend
 #include <flextGL.h>
 #include <Core/Gfx/GL33/Backend.hh>
 
+// Null and software backends (no window/GPU)
+#include <Core/Gfx/Null/Backend.hh>
+#include <Core/Gfx/Soft/Backend.hh>
+#include <Core/Gfx/Soft/Programs.hh>
+
 namespace Ares
 {
 
+/// The paths to the shaders used by the pipeline.
+/// TODO Non-hardcoded shader paths
+static constexpr const char* PBR_SHADER_PATH = "Gfx/PBR.arsh";
+static constexpr const char* PP_SHADER_PATH = "Gfx/Postprocess.arsh";
+
+/// The number of mesh instances culled by each task when frustum culling on
+/// multiple threads; scenes with less instances than this are culled on the
+/// main thread only.
+static constexpr const size_t CULL_CHUNK_SIZE = 4 * 1024;
+
+/// Mesh batches with up to this many visible instances have their instance data
+/// recorded inline, so that the renderer can merge them with other draws of
+/// the same mesh; bigger ones are drawn from their own instance buffer, which
+/// is only uploaded to when their visible instances change.
+static constexpr const size_t INLINE_INSTANCES_MAX = 16;
+
 struct GfxModule::Data
 {
+    Ref<ShaderSrc> pbrShaderSrc, ppShaderSrc; ///< Loaded by `initTask()`.
+    bool shaderSrcsOk = false; ///< Set by `initTask()`.
+
+    // === Main thread only (`mainUpdate()`) ===
+
     struct PbrUniforms
     {
         glm::mat4 camViewProj;
 
     } pbrUniforms;
     Handle<GfxBuffer> pbrUniformsBuffer;
+    Handle<GfxMaterial> ppMaterial; ///< The PBR pass' targets, as inputs for the postprocess pass.
+
+    /// The GPU buffers of a mesh that was drawn.
+    struct MeshBuffers
+    {
+        Handle<GfxBuffer> vertexBuffer = {}, indexBuffer = {}, instanceBuffer = {};
+        size_t vertexBufferSize = 0, indexBufferSize = 0, instanceBufferSize = 0;
+        size_t nInstances = 0; ///< The number of instance matrices in `instanceBuffer`.
+        /// The latest `GfxFrameData::Batch::instanceMatrices` handed over for
+        /// the mesh, if they are few enough to be recorded inline (see
+        /// `INLINE_INSTANCES_MAX`); empty if they are in `instanceBuffer` instead.
+        std::vector<glm::mat4> inlineMatrices;
+    };
+    std::unordered_map<Ref<Mesh>, MeshBuffers> meshBuffers;
+
+    /// The aspect ratio of `resolution_`, for the update task to calculate the
+    /// camera's projection with. (Set by the main thread, read by the update task)
+    std::atomic<float> aspectRatio{1.0f};
+
+    // === Update task only (`updateTask()`) ===
 
     CameraComp camComp; ///< The active camera
     glm::vec3 camPos; ///< The position of the active camera
@@ -42,16 +96,34 @@ struct GfxModule::Data
     struct MeshBatch
     {
         size_t count;
-        std::vector<glm::mat4> modelMatrices;
-        Handle<GfxBuffer> vertexBuffer = {}, indexBuffer = {}, instanceBuffer = {};
-        size_t vertexBufferSize = 0, indexBufferSize = 0, instanceBufferSize = 0;
+        TransformBatch transforms; ///< The transforms of all root instances (SoA).
+        std::vector<glm::mat4> worldMatrices; ///< The `WorldTransformComp`s of all child instances.
+        std::vector<glm::mat4> modelMatrices; ///< `transforms`' matrices, then `worldMatrices`.
+        std::vector<U8> visible; ///< For each of `modelMatrices`, 1 if the instance is inside of the camera frustum.
+        std::vector<glm::mat4> visibleMatrices; ///< The `modelMatrices` of visible instances (handed over to `GfxFrameData`).
+        size_t nVisible = 0; ///< The number of visible instances, as of the latest culling.
     };
     std::unordered_map<Ref<Mesh>, MeshBatch> meshMap;
+    TransformHierarchy hierarchy; ///< Computes `WorldTransformComp`s for entities with a parent.
+    U64 sceneVersion = 0; ///< The scene version when `meshMap` was last rebuilt (see `Scene::advanceVersion()`).
+    bool batchesChanged = true; ///< `true` if `meshMap` was rebuilt this frame.
+
+    /// A batch to cull, and the index of its first instance in the whole scene.
+    struct CullBatch
+    {
+        MeshBatch* batch;
+        const Mesh* mesh;
+        size_t offset;
+    };
+    std::vector<CullBatch> cullBatches; ///< The batches culled this frame.
+    glm::mat4 culledViewProj; ///< The camera view-projection that batches were last culled for.
+    size_t nVisibleMeshes = 0, nCulledMeshes = 0; ///< As of the latest culling.
 };
 
 
 GfxModule::GfxModule()
-    : window_(nullptr), resolution_{0, 0}, renderer_(nullptr), data_(nullptr)
+    : core_(nullptr), window_(nullptr), nullBackend_(nullptr), softBackend_(nullptr), nNullFramesLeft_(0),
+      resolution_{0, 0}, renderer_(nullptr), data_(nullptr), nVisibleMeshes_(0), nCulledMeshes_(0)
 {
 }
 
@@ -93,10 +165,31 @@ bool GfxModule::initGL(Core& core)
 
 bool GfxModule::createRenderer(Core& core)
 {
+    if(core.params().gfxNullBackend)
+    {
+        ARES_log(glog, Trace, "Creating renderer (null)");
+
+        nullBackend_ = new Null::Backend();
+        backend_ = intoRef<GfxBackend>(nullBackend_);
+        renderer_ = new GfxRenderer(backend_, core.g().scheduler);
+
+        return true;
+    }
+    else if(core.params().gfxSoftBackend)
+    {
+        ARES_log(glog, Trace, "Creating renderer (software)");
+
+        softBackend_ = new Soft::Backend(core.g().scheduler);
+        backend_ = intoRef<GfxBackend>(softBackend_);
+        renderer_ = new GfxRenderer(backend_, core.g().scheduler);
+
+        return true;
+    }
+
     ARES_log(glog, Trace, "Creating renderer (OpenGL 3.3 core)");
 
     backend_ = intoRef<GfxBackend>(new GL33::Backend());
-    renderer_ = new GfxRenderer(backend_);
+    renderer_ = new GfxRenderer(backend_, core.g().scheduler);
 
     return true;
 }
@@ -114,22 +207,27 @@ Handle<GfxTexture> GfxModule::createPipelineTarget(Core& core, Resolution resolu
     return renderer_->backend().genTexture(desc); // (Returns a 0 handle on error)
 }
 
-Handle<GfxShader> GfxModule::loadShader(Core& core, const Path& path)
+bool GfxModule::loadShaderSrc(Core& core, Ref<ShaderSrc>& outSrc, const Path& path)
 {
     ARES_log(glog, Trace, "Loading shader: %s", path);
 
-    Ref<ShaderSrc> src;
-    ErrString err = core.g().resLoader->load<ShaderSrc>(src, path);
+    ErrString err = core.g().resLoader->load<ShaderSrc>(outSrc, path);
     if(err)
     {
         ARES_log(glog, Error, "Failed loading shader source at %s: %s",
                  path, err);
-        return Handle<GfxShader>();
+        return false;
     }
+    return true;
+}
 
+Handle<GfxShader> GfxModule::compileShader(Core& core, const Ref<ShaderSrc>& src,
+                                           const Path& path)
+{
     GfxShaderDesc desc;
     desc.src = src;
 
+    ErrString err;
     Handle<GfxShader> handle = renderer_->backend().genShader(desc, &err);
     if(!handle)
     {
@@ -151,15 +249,24 @@ bool GfxModule::createPipeline(Core& core, Resolution resolution)
     using VA = GfxPipeline::Attrib;
     using Ch = ImageFormat::Channel;
 
-    // Load the required shaders for the passes
-    // TODO Non-hardcoded shader paths
-    Handle<GfxShader> pbrShader = loadShader(core, "Gfx/PBR.arsh");
-    Handle<GfxShader> ppShader = loadShader(core, "Gfx/Postprocess.arsh");
+    // Compile the required shaders for the passes (sources loaded by `initTask()`)
+    if(!data_->shaderSrcsOk)
+    {
+        return false;
+    }
+    Handle<GfxShader> pbrShader = compileShader(core, data_->pbrShaderSrc, PBR_SHADER_PATH);
+    Handle<GfxShader> ppShader = compileShader(core, data_->ppShaderSrc, PP_SHADER_PATH);
 
     if(!pbrShader || !ppShader)
     {
         return false;
     }
+    if(softBackend_)
+    {
+        // (GLSL can't run on the CPU, use the ported programs instead)
+        softBackend_->setProgram(pbrShader, Soft::PBR_PROGRAM);
+        softBackend_->setProgram(ppShader, Soft::POSTPROCESS_PROGRAM);
+    }
 
     // #0: PBR pass
     // - Input attribs:
@@ -211,6 +318,14 @@ bool GfxModule::createPipeline(Core& core, Resolution resolution)
         pbrPass.uniformBuffer = data_->pbrUniformsBuffer;
 
         pipeline_->passes.push_back(pbrPass);
+
+        GfxMaterialDesc ppMaterialDesc;
+        for(unsigned int i = 0; i < pbrPass.nTargets; i ++)
+        {
+            ppMaterialDesc.textures[i] = pbrPass.targets[i];
+        }
+        ppMaterialDesc.nTextures = pbrPass.nTargets;
+        data_->ppMaterial = renderer_->genMaterial(ppMaterialDesc);
     }
 
     // #1: Postprocess pass
@@ -257,8 +372,74 @@ bool GfxModule::initPipelineAndRenderer(Core& core)
     }
 }
 
+const char* GfxModule::name() const
+{
+    return "Gfx";
+}
+
+Task GfxModule::initTask(Core& core)
+{
+    if(renderer_)
+    {
+        // Already inited (see `init()`)
+        return {};
+    }
+
+    delete data_; // (Leftover from an `initTask()` whose `init()` was never run)
+    data_ = new Data();
+    core_ = &core;
+
+    static const auto initFunc = [](TaskScheduler* scheduler, void* data)
+    {
+        auto gfxMod = reinterpret_cast<GfxModule*>(data);
+        Core& core = *gfxMod->core_;
+        TimeProbe timer(*core.g().profiler, "GfxModule.InitTask");
+
+        // Load shader sources off the main thread; they are compiled by `init()`
+        // since that requires the graphics context
+        bool pbrOk = gfxMod->loadShaderSrc(core, gfxMod->data_->pbrShaderSrc, PBR_SHADER_PATH);
+        bool ppOk = gfxMod->loadShaderSrc(core, gfxMod->data_->ppShaderSrc, PP_SHADER_PATH);
+        gfxMod->data_->shaderSrcsOk = pbrOk && ppOk;
+    };
+
+    return {initFunc, this};
+}
+
 bool GfxModule::init(Core& core)
 {
+    if(renderer_)
+    {
+        // Already inited
+        return true;
+    }
+
+    if(core.params().gfxNullBackend || core.params().gfxSoftBackend)
+    {
+        // No window or graphics context required
+        ARES_log(glog, Info, "Using the %s rendering backend",
+                 core.params().gfxNullBackend ? "null" : "software");
+
+        Resolution nullResolution{core.params().gfxNullWidth, core.params().gfxNullHeight};
+        if(nullResolution.width == 0 || nullResolution.height == 0)
+        {
+            ARES_log(glog, Error, "Invalid headless resolution: %s", nullResolution);
+            return false;
+        }
+
+        nNullFramesLeft_ = core.params().gfxNullFrames;
+        bool allOk = createRenderer(core)
+                     && createPipeline(core, nullResolution)
+                     && initPipelineAndRenderer(core);
+        if(!allOk)
+        {
+            // (Do not leave a half-inited renderer around, or a retry would see it as inited)
+            destroyRenderer(core);
+            return false;
+        }
+
+        return true;
+    }
+
     window_ = core.g().facilities.get<Window>();
     if(!window_ || !window_->operator bool())
     {
@@ -268,8 +449,6 @@ bool GfxModule::init(Core& core)
         return false;
     }
 
-    data_ = new Data();
-
     Resolution initialResolution = window_->resolution();
 
     bool allOk = initGL(core)
@@ -278,6 +457,8 @@ bool GfxModule::init(Core& core)
                  && initPipelineAndRenderer(core);
     if(!allOk)
     {
+        // (Do not leave a half-inited renderer around, or a retry would see it as inited)
+        destroyRenderer(core);
         return false;
     }
 
@@ -286,20 +467,53 @@ bool GfxModule::init(Core& core)
 
 void GfxModule::halt(Core& core)
 {
+    if(nullBackend_)
+    {
+        const Null::FrameStats& stats = nullBackend_->totalStats();
+        ARES_log(glog, Debug,
+                 "Null backend: %lu frames, %lu draws, %lu instances, %lu pass changes, "
+                 "%lu buffer binds, %lu texture binds, %lu+%lu bytes uploaded, %lu errors",
+                 nullBackend_->nFrames(), stats.nDraws, stats.nInstances, stats.nPassChanges,
+                 stats.nBufferBindChanges, stats.nTextureBindChanges,
+                 stats.nBufferBytesUploaded, stats.nTextureBytesUploaded, stats.nErrors);
+    }
+
     // Destoy data
+    if(data_ && backend_)
+    {
+        for(auto buffersIt = data_->meshBuffers.begin(); buffersIt != data_->meshBuffers.end(); buffersIt ++)
+        {
+            backend_->delBuffer(buffersIt->second.vertexBuffer);
+            backend_->delBuffer(buffersIt->second.indexBuffer);
+            backend_->delBuffer(buffersIt->second.instanceBuffer);
+        }
+    }
     delete data_; data_ = nullptr;
 
-    ARES_log(glog, Trace, "Destroying GfxRenderer");
-    delete renderer_; renderer_ = nullptr;
-
-    ARES_log(glog, Trace, "Destroying GfxBackend");
-    (void)backend_.~Ref(); // (will destroy all OpenGL data)
+    destroyRenderer(core);
 
     window_ = nullptr; // (will be destroyed by `Core`)
 }
 
+void GfxModule::destroyRenderer(Core& core)
+{
+    if(renderer_)
+    {
+        ARES_log(glog, Trace, "Destroying GfxRenderer");
+        renderer_->halt();
+        delete renderer_; renderer_ = nullptr;
+    }
+    pipeline_ = Ref<GfxPipeline>();
+
+    nullBackend_ = nullptr; // (destroyed along with `backend_`)
+    softBackend_ = nullptr; // (destroyed along with `backend_`)
+    ARES_log(glog, Trace, "Destroying GfxBackend");
+    backend_ = Ref<GfxBackend>(); // (will destroy all OpenGL data)
+}
+
 GfxModule::~GfxModule()
 {
+    delete data_; // (in case `init()` was never reached after `initTask()`)
 }
 
 
@@ -321,52 +535,87 @@ void GfxModule::changeResolution(Core& core, Resolution newResolution)
 }
 
 
-void GfxModule::updateSceneData(Core& core)
+void GfxModule::extractSceneData(Core& core, GfxFrameData& frame)
 {
-    for(auto batchIt = data_->meshMap.begin(); batchIt != data_->meshMap.end(); batchIt ++)
-    {
-        batchIt->second.count = 0;
-        batchIt->second.modelMatrices.clear();
-    }
-
     Scene* scene = core.g().scene;
-    for(auto it = scene->begin(); it != scene->end(); it ++)
+
+    // (No transform = can't be a renderable or camera)
+    // TODO Default-init to pos=(0, 0, 0) rot=(0, 0, 0) scale=(1, 1, 1) instead?
+
+    // Propagate transforms to children in the hierarchy
+    // (Runs alongside other tasks, so `WorldTransformComp`s are added and erased
+    // through the scene command queue)
+    data_->hierarchy.update(*scene, core.g().sceneCmds, core.g().scheduler);
+
+    // Only rebuild the batches if any transform/mesh was added, changed or removed
+    // since they were last built; otherwise last frame's are still valid
+    U64 sinceVersion = data_->sceneVersion;
+    data_->sceneVersion = scene->advanceVersion();
+
+    auto meshView = scene->view<TransformComp, MeshComp>();
+    CompStore<WorldTransformComp>* worldStore = scene->storeFor<WorldTransformComp>();
+    data_->batchesChanged = meshView.changedSince(sinceVersion)
+                            || (worldStore && worldStore->lastChangeVersion() > sinceVersion);
+    if(data_->batchesChanged)
     {
-        auto transformComp = it->comp<TransformComp>();
-        if(!transformComp)
+        for(auto batchIt = data_->meshMap.begin(); batchIt != data_->meshMap.end(); batchIt ++)
         {
-            // No transform = can't be a renderable or camera
-            // TODO Default-init to pos=(0, 0, 0) rot=(0, 0, 0) scale=(1, 1, 1) instead?
-            continue;
+            batchIt->second.count = 0;
+            batchIt->second.transforms.clear();
+            batchIt->second.worldMatrices.clear();
         }
 
-        auto meshComp = it->comp<MeshComp>();
-        if(meshComp)
+        auto meshFunc = [this, worldStore](EntityId entity, TransformComp& transformComp, MeshComp& meshComp)
         {
-            // Add this mesh's model matrix to the appropriate drawing batch
-            Data::MeshBatch& meshBatch = data_->meshMap[meshComp->mesh];
+            // Add this mesh's transform to the appropriate drawing batch
+            // (its world transform if it has a parent)
+            Data::MeshBatch& meshBatch = data_->meshMap[meshComp.mesh];
             meshBatch.count ++;
-            meshBatch.modelMatrices.push_back(transformComp->matrix());
+
+            const WorldTransformComp* worldComp = worldStore ? worldStore->get(entity) : nullptr;
+            if(worldComp)
+            {
+                meshBatch.worldMatrices.push_back(worldComp->matrix);
+            }
+            else
+            {
+                meshBatch.transforms.push(transformComp);
+            }
+        };
+        meshView.each(meshFunc);
+
+        // Compute all model matrices for each batch in one go
+        for(auto batchIt = data_->meshMap.begin(); batchIt != data_->meshMap.end(); batchIt ++)
+        {
+            Data::MeshBatch& meshBatch = batchIt->second;
+            size_t nRoots = meshBatch.transforms.size();
+            meshBatch.modelMatrices.resize(nRoots + meshBatch.worldMatrices.size());
+            meshBatch.transforms.computeMatrices(meshBatch.modelMatrices.data());
+            std::copy(meshBatch.worldMatrices.begin(), meshBatch.worldMatrices.end(),
+                      meshBatch.modelMatrices.begin() + nRoots);
         }
+    }
 
-        auto cameraComp = it->comp<CameraComp>();
-        if(cameraComp && data_->camComp.priority >= cameraComp->priority)
+    auto cameraFunc = [this](EntityId entity, TransformComp& transformComp, CameraComp& cameraComp)
+    {
+        if(data_->camComp.priority >= cameraComp.priority)
         {
             // Found a camera with same or higher priority, replace the current one
             // NOTE Comparison is `>=` so that the default, uninitialized
             //      `data_->cameraComp` gets replaced by the first camera that
             //      we find, even if it has default priority.
-            data_->camComp = *cameraComp;
-            data_->camPos = transformComp->position;
-            data_->camRot = transformComp->rotation;
+            data_->camComp = cameraComp;
+            data_->camPos = transformComp.position;
+            data_->camRot = transformComp.rotation;
         }
-    }
-
-    auto& backend = renderer_->backend();
+    };
+    scene->view<TransformComp, CameraComp>().each(cameraFunc);
 
-    // Update uniforms for pass 0 before rendering
+    // Calculate the camera's transforms, for the aspect ratio of the latest
+    // resolution known by the main thread
+    Frustum camFrustum;
     {
-        float aspectRatio = float(resolution_.width) / float(resolution_.height);
+        float aspectRatio = data_->aspectRatio.load();
 
         // NOTE **Camera view transforms are inverted**; if the camera is at X=20,
         //      its transform must translate by X=-20!
@@ -378,50 +627,114 @@ void GfxModule::updateSceneData(Core& core)
         //       use depending on `data_->camera.type`
         auto camProjection = data_->camComp.perspective.projectionMatrix(aspectRatio);
 
-        data_->pbrUniforms.camViewProj = camProjection * camView;
+        frame.camViewProj = camProjection * camView;
+        camFrustum = data_->camComp.perspective.frustum(aspectRatio, camView);
+    }
 
+    // Only draw the instances inside of the camera frustum. Culling is redone
+    // only if the batches or the camera changed since the last time; otherwise
+    // the instance data uploaded (or kept) by the main thread is still valid
+    bool visibleChanged = data_->batchesChanged || data_->culledViewProj != frame.camViewProj;
+    if(visibleChanged)
+    {
+        cullBatches(core, camFrustum);
+        data_->culledViewProj = frame.camViewProj;
 
-        backend.editBuffer(data_->pbrUniformsBuffer,
-                           0, sizeof(data_->pbrUniforms), &data_->pbrUniforms);
+        core.g().profiler->counter("GfxModule.VisibleMeshes", I64(data_->nVisibleMeshes));
+        core.g().profiler->counter("GfxModule.CulledMeshes", I64(data_->nCulledMeshes));
     }
-
+    frame.nVisibleMeshes = data_->nVisibleMeshes;
+    frame.nCulledMeshes = data_->nCulledMeshes;
 
     for(auto batchIt = data_->meshMap.begin(); batchIt != data_->meshMap.end();
         batchIt ++)
     {
-        if(batchIt->second.count == 0)
+        const Mesh& mesh = *batchIt->first;
+        Data::MeshBatch& meshBatch = batchIt->second;
+        if(meshBatch.nVisible == 0)
         {
-            // FIXME IMPORTANT Mark batches whose `count == 0` (i.e. for meshes
-            //       that haven't been drawn even once this frame) for cleanup.
-            //       Do not delete them immediately here; delete them only when
-            //       GPU memory is getting scarce, or after a set number of frames
-            //       in which the mesh hasn't been rendered even once, or after
-            //       some other trigger happens. Deleting them immediately is much
-            //       more likely in resulting in having to reupload them a couple
-            //       of frames down the road because they are needed again!
+            // All instances are outside of the camera frustum (or there are
+            // none), nothing to draw
             continue;
         }
 
+        GfxFrameData::Batch& batch = frame.addBatch(batchIt->first);
+        if(visibleChanged)
+        {
+            // (Hand the matrices over to the frame data, recycling its old storage)
+            std::swap(batch.instanceMatrices, meshBatch.visibleMatrices);
+        }
 
-        const Mesh& mesh = *batchIt->first;
-        Data::MeshBatch& batch = batchIt->second;
+        // Generate the GfxCmd to render the batch; the main thread will fill
+        // in its buffers (and instance data, for batches drawn inline)
+        // FIXME IMPORTANT Bind the correct textures gathered from Material here!
+        GfxCmd& batchRenderCmd = batch.cmd;
+        batchRenderCmd.passId = 0;
+        if(mesh.indices().size() > 0)
+        {
+            batchRenderCmd.op = GfxCmd::DrawIndexedInstanced;
+            batchRenderCmd.n = mesh.indices().size();
+        }
+        else
+        {
+            batchRenderCmd.op = GfxCmd::DrawInstanced;
+            batchRenderCmd.n = mesh.vertices().size();
+        }
+        batchRenderCmd.first = 0;
+        batchRenderCmd.nInstances = meshBatch.nVisible;
+    }
 
-        if(!batch.vertexBuffer)
+    frame.extracted = true;
+}
+
+void GfxModule::submitSceneData(Core& core, const GfxFrameData& frame)
+{
+    nVisibleMeshes_ = frame.nVisibleMeshes;
+    nCulledMeshes_ = frame.nCulledMeshes;
+    if(!frame.extracted)
+    {
+        // (First frame, nothing was extracted yet)
+        return;
+    }
+
+    auto& backend = renderer_->backend();
+
+    // Update uniforms for pass 0 before rendering
+    data_->pbrUniforms.camViewProj = frame.camViewProj;
+    backend.editBuffer(data_->pbrUniformsBuffer,
+                       0, sizeof(data_->pbrUniforms), &data_->pbrUniforms);
+
+    for(size_t i = 0; i < frame.nBatches; i ++)
+    {
+        // FIXME IMPORTANT Mark buffers of meshes that haven't been drawn for a
+        //       while for cleanup. Do not delete them immediately when a mesh
+        //       is not drawn; delete them only when GPU memory is getting scarce,
+        //       or after a set number of frames in which the mesh hasn't been
+        //       rendered even once, or after some other trigger happens. Deleting
+        //       them immediately is much more likely in resulting in having to
+        //       reupload them a couple of frames down the road because they are
+        //       needed again!
+
+        const GfxFrameData::Batch& batch = frame.batches[i];
+        const Mesh& mesh = *batch.mesh;
+        Data::MeshBuffers& buffers = data_->meshBuffers[batch.mesh];
+
+        if(!buffers.vertexBuffer)
         {
             // First time we draw this Mesh, create its vertex buffer
             GfxBufferDesc vertexBufferDesc;
-            batch.vertexBufferSize = vertexBufferDesc.size = mesh.vertexDataSize();
+            buffers.vertexBufferSize = vertexBufferDesc.size = mesh.vertexDataSize();
             vertexBufferDesc.data = mesh.vertexData();
             vertexBufferDesc.usage = GfxUsage::Dynamic; // FIXME: Static for StaticMeshComp, dynamic for DynamicMeshComp
-            batch.vertexBuffer = backend.genBuffer(vertexBufferDesc);
+            buffers.vertexBuffer = backend.genBuffer(vertexBufferDesc);
         }
-        else if(batch.indexBufferSize != mesh.indexDataSize())
+        else if(buffers.indexBufferSize != mesh.indexDataSize())
         {
             // Mesh's vertex data was resized, update its vertex buffer
-            batch.vertexBufferSize = mesh.vertexDataSize();
-            backend.resizeBuffer(batch.vertexBuffer, batch.vertexBufferSize);
-            backend.editBuffer(batch.vertexBuffer,
-                               0, batch.vertexBufferSize,
+            buffers.vertexBufferSize = mesh.vertexDataSize();
+            backend.resizeBuffer(buffers.vertexBuffer, buffers.vertexBufferSize);
+            backend.editBuffer(buffers.vertexBuffer,
+                               0, buffers.vertexBufferSize,
                                mesh.vertexData());
         }
         // FIXME IMPORTANT Also check if **the contents** of the vertex data in the
@@ -431,22 +744,22 @@ void GfxModule::updateSceneData(Core& core)
 
         if(mesh.indexDataSize() > 0)
         {
-            if(!batch.indexBuffer)
+            if(!buffers.indexBuffer)
             {
                 // First time we draw this Mesh, create its index buffer
                 GfxBufferDesc indexBufferDesc;
-                batch.indexBufferSize = indexBufferDesc.size = mesh.indexDataSize();
+                buffers.indexBufferSize = indexBufferDesc.size = mesh.indexDataSize();
                 indexBufferDesc.data = mesh.indexData();
                 indexBufferDesc.usage = GfxUsage::Dynamic; // FIXME: Static for StaticMeshComp, dynamic for DynamicMeshComp
-                batch.indexBuffer = backend.genBuffer(indexBufferDesc);
+                buffers.indexBuffer = backend.genBuffer(indexBufferDesc);
             }
-            else if(batch.indexBufferSize != mesh.indexDataSize())
+            else if(buffers.indexBufferSize != mesh.indexDataSize())
             {
                 // Mesh's index data was resized, update its index buffer
-                batch.indexBufferSize = mesh.indexDataSize();
-                backend.resizeBuffer(batch.indexBuffer, batch.indexBufferSize);
-                backend.editBuffer(batch.indexBuffer,
-                                   0, batch.indexBufferSize,
+                buffers.indexBufferSize = mesh.indexDataSize();
+                backend.resizeBuffer(buffers.indexBuffer, buffers.indexBufferSize);
+                backend.editBuffer(buffers.indexBuffer,
+                                   0, buffers.indexBufferSize,
                                    mesh.indexData());
             }
             // FIXME IMPORTANT Also check if **the contents** of the index data in the
@@ -454,56 +767,152 @@ void GfxModule::updateSceneData(Core& core)
             //       contents accordingly
         }
 
-        if(!batch.instanceBuffer)
-        {
-            // First time we draw this Mesh batch, create its instance buffer
-            GfxBufferDesc instanceBufferDesc;
-            batch.instanceBufferSize = instanceBufferDesc.size
-                                     = batch.modelMatrices.size() * sizeof(glm::mat4);
-            instanceBufferDesc.data = batch.modelMatrices.data();
-            instanceBufferDesc.usage = GfxUsage::Streaming;
-            batch.instanceBuffer = renderer_->backend().genBuffer(instanceBufferDesc);
-        }
-        else
+        if(batch.instanceMatrices.size() > INLINE_INSTANCES_MAX)
         {
-            // Update the instance buffer, growing it if necessary
-            // If the buffer is actually bigger there is no harm (except some more
-            // memory consumption) in leaving it that size and only filling it partially
-            size_t newInstanceBufferSize = batch.modelMatrices.size() * sizeof(glm::mat4);
-            if(newInstanceBufferSize > batch.instanceBufferSize)
+            // The visible instances changed and are many, upload them to the
+            // mesh's instance buffer (where they stay for the frames in which
+            // they don't change)
+            size_t newInstanceBufferSize = batch.instanceMatrices.size() * sizeof(glm::mat4);
+            if(!buffers.instanceBuffer)
             {
-                backend.resizeBuffer(batch.instanceBuffer, newInstanceBufferSize);
-                batch.instanceBufferSize = newInstanceBufferSize;
+                // First time we draw this Mesh batch, create its instance buffer
+                GfxBufferDesc instanceBufferDesc;
+                buffers.instanceBufferSize = instanceBufferDesc.size = newInstanceBufferSize;
+                instanceBufferDesc.data = batch.instanceMatrices.data();
+                instanceBufferDesc.usage = GfxUsage::Streaming;
+                buffers.instanceBuffer = backend.genBuffer(instanceBufferDesc);
             }
-
-            backend.editBuffer(batch.instanceBuffer,
-                               0, newInstanceBufferSize,
-                               batch.modelMatrices.data());
+            else
+            {
+                // Update the instance buffer, growing it if necessary
+                // If the buffer is actually bigger there is no harm (except some more
+                // memory consumption) in leaving it that size and only filling it partially
+                if(newInstanceBufferSize > buffers.instanceBufferSize)
+                {
+                    backend.resizeBuffer(buffers.instanceBuffer, newInstanceBufferSize);
+                    buffers.instanceBufferSize = newInstanceBufferSize;
+                }
+
+                backend.editBuffer(buffers.instanceBuffer,
+                                   0, newInstanceBufferSize,
+                                   batch.instanceMatrices.data());
+            }
+            buffers.nInstances = batch.instanceMatrices.size();
+            buffers.inlineMatrices.clear();
+        }
+        else if(!batch.instanceMatrices.empty())
+        {
+            // The visible instances changed and are few, keep their matrices
+            // around to record them inline (also in the frames in which they don't)
+            buffers.inlineMatrices.assign(batch.instanceMatrices.begin(), batch.instanceMatrices.end());
         }
 
 
-        // Generate the GfxCmd to render the batch
-        // FIXME IMPORTANT Bind the correct textures gathered from Material here!
-        GfxCmd batchRenderCmd;
-        batchRenderCmd.passId = 0;
-        if(mesh.indices().size() > 0)
+        GfxCmd batchRenderCmd = batch.cmd;
+        batchRenderCmd.vertexBuffer = buffers.vertexBuffer;
+        batchRenderCmd.indexBuffer = buffers.indexBuffer;
+        if(!buffers.inlineMatrices.empty())
         {
-            batchRenderCmd.op = GfxCmd::DrawIndexedInstanced;
-            batchRenderCmd.n = mesh.indices().size();
+            // Few instances: recorded inline and uploaded by the renderer to its
+            // own instance buffer, so that they can be merged with other draws
+            batchRenderCmd.nInstances = std::min(batchRenderCmd.nInstances, buffers.inlineMatrices.size());
+            renderer_->enqueueCmd(batchRenderCmd, buffers.inlineMatrices.data(), sizeof(glm::mat4));
         }
         else
         {
-            batchRenderCmd.op = GfxCmd::DrawInstanced;
-            batchRenderCmd.n = mesh.vertices().size();
+            batchRenderCmd.instanceBuffer = buffers.instanceBuffer;
+            batchRenderCmd.firstInstance = 0;
+            batchRenderCmd.nInstances = std::min(batchRenderCmd.nInstances, buffers.nInstances);
+            renderer_->enqueueCmd(batchRenderCmd);
         }
-        batchRenderCmd.first = 0;
-        batchRenderCmd.nInstances = batch.count;
-        batchRenderCmd.vertexBuffer = batch.vertexBuffer;
-        batchRenderCmd.indexBuffer = batch.indexBuffer;
-        batchRenderCmd.instanceBuffer = batch.instanceBuffer;
+    }
+}
+
+void GfxModule::cullBatches(Core& core, const Frustum& frustum)
+{
+    // Lay out all instances of all batches one after the other, so that they
+    // can be culled in evenly-sized chunks regardless of how they are batched
+    std::vector<Data::CullBatch>& cullBatches = data_->cullBatches;
+    cullBatches.clear();
+    size_t nInstances = 0;
+    for(auto batchIt = data_->meshMap.begin(); batchIt != data_->meshMap.end(); batchIt ++)
+    {
+        Data::MeshBatch& batch = batchIt->second;
+        batch.visible.resize(batch.modelMatrices.size());
+        if(batch.count > 0)
+        {
+            cullBatches.push_back({&batch, batchIt->first.get(), nInstances});
+            nInstances += batch.modelMatrices.size();
+        }
+    }
 
-        renderer_->enqueueCmd(batchRenderCmd);
+    if(nInstances == 0 || cullBatches.empty())
+    {
+        // Nothing to cull (nor to look batches up for)
+        for(auto batchIt = data_->meshMap.begin(); batchIt != data_->meshMap.end(); batchIt ++)
+        {
+            batchIt->second.visibleMatrices.clear();
+            batchIt->second.nVisible = 0;
+        }
+        data_->nVisibleMeshes = data_->nCulledMeshes = 0;
+        return;
     }
+
+    FrustumCuller culler(frustum);
+    auto cullFunc = [&cullBatches, &culler](size_t begin, size_t end)
+    {
+        // Find the batch `begin` is in, then cull up to `end` batch by batch
+        auto batchIt = std::upper_bound(cullBatches.begin(), cullBatches.end(), begin,
+                                        [](size_t index, const Data::CullBatch& cullBatch)
+                                        {
+                                            return index < cullBatch.offset;
+                                        }) - 1;
+        for(; begin < end; batchIt ++)
+        {
+            Data::MeshBatch& batch = *batchIt->batch;
+            size_t batchBegin = begin - batchIt->offset;
+            size_t batchEnd = std::min(end - batchIt->offset, batch.modelMatrices.size());
+            if(batchIt->mesh->hasBounds())
+            {
+                (void)culler.cull(batchIt->mesh->bounds(),
+                                  batch.modelMatrices.data() + batchBegin, batchEnd - batchBegin,
+                                  batch.visible.data() + batchBegin);
+            }
+            else
+            {
+                // (No bounds were computed for the mesh, it could be anywhere)
+                std::fill(batch.visible.begin() + batchBegin, batch.visible.begin() + batchEnd, U8(1));
+            }
+            begin += batchEnd - batchBegin;
+        }
+    };
+    TaskScheduler* scheduler = core.g().scheduler;
+    if(scheduler && nInstances > CULL_CHUNK_SIZE)
+    {
+        parallelFor(*scheduler, nInstances, CULL_CHUNK_SIZE, cullFunc);
+    }
+    else
+    {
+        cullFunc(0, nInstances);
+    }
+
+    // Gather the matrices of the visible instances for the instance buffers
+    data_->nVisibleMeshes = 0;
+    for(auto batchIt = data_->meshMap.begin(); batchIt != data_->meshMap.end(); batchIt ++)
+    {
+        Data::MeshBatch& batch = batchIt->second;
+        batch.visibleMatrices.clear();
+        for(size_t i = 0; i < batch.modelMatrices.size(); i ++)
+        {
+            if(batch.visible[i])
+            {
+                batch.visibleMatrices.push_back(batch.modelMatrices[i]);
+            }
+        }
+        batch.nVisible = batch.visibleMatrices.size();
+        data_->nVisibleMeshes += batch.nVisible;
+    }
+    data_->nCulledMeshes = nInstances - data_->nVisibleMeshes;
 }
 
 void GfxModule::mainUpdate(Core& core)
@@ -517,16 +926,24 @@ void GfxModule::mainUpdate(Core& core)
     //       is run before `updateTask()`. This means that the rendering commands
     //       run will always be the ones generated for the previous frame,
     //       introducing a one-frame rendering lag
-    window_->beginFrame();
+    if(window_)
+    {
+        window_->beginFrame();
+    }
 
-    auto curResolution = window_->resolution();
+    auto curResolution = window_ ? window_->resolution() : resolution_;
     if(curResolution != resolution_)
     {
         changeResolution(core, curResolution);
     }
+    if(resolution_.height > 0)
+    {
+        data_->aspectRatio.store(float(resolution_.width) / float(resolution_.height));
+    }
 
-    // Generate commands and uniform data for rendering Scene data in pass 0
-    updateSceneData(core);
+    // Upload the Scene data extracted by the update task last frame and
+    // generate its commands and uniform data for pass 0
+    submitSceneData(core, core.past().gfx);
 
     // Generate the final command for outputting the final image for pass 1
     GfxCmd ppDrawCmd;
@@ -534,21 +951,31 @@ void GfxModule::mainUpdate(Core& core)
     ppDrawCmd.passId = 1;
     ppDrawCmd.n = 3; // One fullscreen triangle
     ppDrawCmd.vertexBuffer = {}; // No vertex buffers, positions generated in vertex shader
-    const auto& pbrPass = pipeline_->passes[0];
-
-    for(unsigned int i = 0; i < pbrPass.nTargets; i ++)
-    {
-        ppDrawCmd.textures[i] = pbrPass.targets[i];
-    }
-    ppDrawCmd.nTextures = pbrPass.nTargets;
+    ppDrawCmd.material = data_->ppMaterial; // (The PBR pass' targets)
     renderer_->enqueueCmd(ppDrawCmd);
 
     // Sort and execute rendering commands and swap buffers
     renderer_->renderFrame(resolution_);
-    window_->endFrame();
+    core.g().profiler->counter("GfxRenderer.DrawsSaved", I64(renderer_->nDrawsSaved()));
+    if(window_)
+    {
+        window_->endFrame();
+    }
+
+    if(nullBackend_)
+    {
+        // Log the errors found by the backend while validating this frame
+        for(const std::string& err : nullBackend_->errors())
+        {
+            ARES_log(glog, Error, "Null backend: %s", err);
+        }
+        nullBackend_->clearErrors();
+    }
 
     // FIXME TEST, USE A REAL EVENT SYSTEM TO TELL THE CORE TO QUIT!
-    if(window_->quitRequested())
+    bool quit = window_ ? window_->quitRequested()
+                        : (nNullFramesLeft_ > 0 && -- nNullFramesLeft_ == 0);
+    if(quit)
     {
         auto quitFunc = *core.g().eventMatrix.get<>("core.halt");
         quitFunc();
@@ -557,9 +984,17 @@ void GfxModule::mainUpdate(Core& core)
 
 Task GfxModule::updateTask(Core& core)
 {
-    auto updateFunc = [](TaskScheduler* scheduler, void* data)
+    core_ = &core;
+
+    static const auto updateFunc = [](TaskScheduler* scheduler, void* data)
     {
-        // FIXME IMPLEMENT: Generate rendering commands for this frame here
+        // Extract the scene data to render into this frame's data; it will be
+        // uploaded and rendered by `mainUpdate()` next frame
+        auto gfxMod = reinterpret_cast<GfxModule*>(data);
+        Core& core = *gfxMod->core_;
+
+        TimeProbe timer(*core.g().profiler, "GfxModule.UpdateTask");
+        gfxMod->extractSceneData(core, core.curr().gfx);
     };
     return {updateFunc, this};
 }
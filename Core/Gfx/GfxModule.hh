@@ -4,6 +4,7 @@
 #include <Core/Base/Ref.hh>
 #include <Core/Module/Module.hh>
 #include <Core/Visual/Resolution.hh>
+#include <Core/Base/Frustum.hh>
 #include <Core/Gfx/GfxBackend.hh>
 #include <Core/Gfx/GfxPipeline.hh>
 
@@ -12,11 +13,18 @@ namespace Ares
 
 class Window; // (#include "../Visual/Window.hh")
 class GfxRenderer; // (#include "Gfx/GfxRenderer.hh")
+struct GfxFrameData; // (#include "Gfx/GfxFrameData.hh")
+namespace Null { class Backend; } // (#include "Gfx/Null/Backend.hh")
+namespace Soft { class Backend; } // (#include "Gfx/Soft/Backend.hh")
 
 /// A graphics + graphical input module.
 class ARES_API GfxModule : public Module
 {
-    Window* window_; // (retrieved from `core.g().facilities` on init)
+    Core* core_; ///< Set by `initTask()`.
+    Window* window_; // (retrieved from `core.g().facilities` on init; null if headless)
+    Null::Backend* nullBackend_; // (== `backend_` if `CoreParams::gfxNullBackend`, null otherwise)
+    Soft::Backend* softBackend_; // (== `backend_` if `CoreParams::gfxSoftBackend`, null otherwise)
+    unsigned int nNullFramesLeft_; ///< See `CoreParams::gfxNullFrames`.
 
     Resolution resolution_;
     Ref<GfxBackend> backend_; // (initialized/destroyed by `GfxModule`)
@@ -26,13 +34,17 @@ class ARES_API GfxModule : public Module
     struct Data;
     Data* data_; // (initialized/destroyed by `GfxModule`)
 
+    size_t nVisibleMeshes_; ///< See `nVisibleMeshes()`.
+    size_t nCulledMeshes_; ///< See `nCulledMeshes()`.
+
     /// Attempts to initialize OpenGL, returns `false` on error.
     /// `window_` should be inited for OpenGL 3.3+.
     bool initGL(Core& core);
 
-    /// Creates `renderer_`.
+    /// Creates `renderer_` (with a `Null::Backend` if `CoreParams::gfxNullBackend`,
+    /// a `Soft::Backend` if `CoreParams::gfxSoftBackend`, an OpenGL 3.3 one otherwise).
     /// Returns `false` on error.
-    /// A graphics context should already be inited.
+    /// A graphics context should already be inited, unless rendering headless.
     bool createRenderer(Core& core);
 
     /// Creates a texture to be used as `pipeline_`'s target with the given
@@ -42,11 +54,16 @@ class ARES_API GfxModule : public Module
     Handle<GfxTexture> createPipelineTarget(Core& core, Resolution resolution,
                                             ImageFormat format);
 
-    /// Attempts to load a `ShaderSrc` resource at `path`, then compile the shader
-    /// and return its handle.
+    /// Attempts to load a `ShaderSrc` resource at `path` into `outSrc`.
+    /// Returns `false` and logs an error on failure.
+    /// Threadsafe; called by `initTask()`.
+    bool loadShaderSrc(Core& core, Ref<ShaderSrc>& outSrc, const Path& path);
+
+    /// Attempts to compile the shader from `src` (loaded from `path`) and return
+    /// its handle.
     /// Returns a null handle and logs an error on failure.
     /// `renderer_` and its backend should already be created.
-    Handle<GfxShader> loadShader(Core& core, const Path& path);
+    Handle<GfxShader> compileShader(Core& core, const Ref<ShaderSrc>& src, const Path& path);
 
     /// Attempts to create `pipeline_`.
     /// Returns `false` on error.
@@ -58,23 +75,55 @@ class ARES_API GfxModule : public Module
     /// `renderer_`, its backend and `pipeline_` should already be created.
     bool initPipelineAndRenderer(Core& core);
 
+    /// Destroys `renderer_`, `pipeline_` and the backend, if created.
+    /// Used by `halt()`, and by `init()` on failure so that it can be retried.
+    void destroyRenderer(Core& core);
+
 
     /// Executed when the resolution of `window_`'s renderable area changes; resizes
     /// all of `pipeline_`'s render targets accordingly
     void changeResolution(Core& core, Resolution newResolution);
 
-    /// Enqueue the `GfxCmd`s required to render Scene data (MeshComps, ...) for
-    /// this frame into the renderer.
-    void updateSceneData(Core& core);
+    /// Walks the Scene (MeshComps, cameras, ...), culls it and generates the
+    /// instance data and `GfxCmd`s to render it into `frame`.
+    /// Run by the update task on a worker thread; does not touch the backend.
+    void extractSceneData(Core& core, GfxFrameData& frame);
+
+    /// Uploads the buffers for the Scene data extracted into `frame` (the
+    /// previous frame's) and enqueues its `GfxCmd`s into the renderer.
+    /// Run by `mainUpdate()` on the main thread.
+    void submitSceneData(Core& core, const GfxFrameData& frame);
+
+    /// Tests all instances of all mesh batches against `frustum` (in parallel
+    /// if there are many) and gathers the model matrices of the visible ones.
+    /// Called by `extractSceneData()` when the batches or the camera changed.
+    void cullBatches(Core& core, const Frustum& frustum);
 
 public:
     GfxModule();
     ~GfxModule() override;
 
+    const char* name() const override;
+    Task initTask(Core& core) override;
     bool init(Core& core) override;
     void mainUpdate(Core& core) override;
     Task updateTask(Core& core) override;
     void halt(Core& core) override;
+
+
+    /// Returns the number of mesh instances that were inside of the camera
+    /// frustum (and thus drawn) as of the latest frame.
+    inline size_t nVisibleMeshes() const
+    {
+        return nVisibleMeshes_;
+    }
+
+    /// Returns the number of mesh instances that were outside of the camera
+    /// frustum (and thus not drawn) as of the latest frame.
+    inline size_t nCulledMeshes() const
+    {
+        return nCulledMeshes_;
+    }
 };
 
 }
@@ -1,18 +1,28 @@
 #include "GfxRenderer.hh"
 
+#include <string.h>
+#include <algorithm>
+#include <functional>
+#include <Core/Task/ParallelFor.hh>
+#include <Core/Task/RadixSort.hh>
+
 namespace Ares
 {
 
-GfxRenderer::GfxRenderer(Ref<GfxBackend> backend)
-    : backend_(backend), cmdQueueTok_(cmdQueue_),
-      frameResolution_{0, 0} // (set to 0x0 to make sure that `changeVideoMode` is run at startup)
+constexpr const size_t GfxRenderer::ORDER_CHUNK_SIZE;
+
+GfxRenderer::GfxRenderer(Ref<GfxBackend> backend, TaskScheduler* scheduler)
+    : backend_(backend), scheduler_(scheduler),
+      cmdBuckets_(scheduler ? scheduler->nWorkers() + 1 : 1),
+      frameResolution_{0, 0}, // (set to 0x0 to make sure that `changeVideoMode` is run at startup)
+      materialsChanged_(false), mergeBufferSize_(0), nDrawsSaved_(0)
 {
 }
 
 GfxRenderer::~GfxRenderer()
 {
     // `~GfxBackend()`, that will be run when the last `Ref<GfxBackend>` to the
-    // backend dies, will Destroy all leftover resources
+    // backend dies, will Destroy all leftover resources (`halt()` not called...)
 }
 
 ErrString GfxRenderer::init(Ref<GfxPipeline> pipeline)
@@ -27,6 +37,76 @@ ErrString GfxRenderer::init(Ref<GfxPipeline> pipeline)
     return err;
 }
 
+void GfxRenderer::halt()
+{
+    if(mergeBuffer_)
+    {
+        backend_->delBuffer(mergeBuffer_);
+        mergeBuffer_ = {};
+        mergeBufferSize_ = 0;
+    }
+}
+
+
+Handle<GfxMaterial> GfxRenderer::genMaterial(const GfxMaterialDesc& desc)
+{
+    Handle<GfxMaterial> material = backend_->genMaterial(desc);
+    if(material)
+    {
+        materials_[material] = {desc, 0};
+        materialsChanged_ = true;
+    }
+    return material;
+}
+
+void GfxRenderer::delMaterial(Handle<GfxMaterial> material)
+{
+    auto it = materials_.find(material);
+    if(!material || it == materials_.end())
+    {
+        return;
+    }
+
+    backend_->delMaterial(material);
+    materials_.erase(it);
+    materialsChanged_ = true;
+}
+
+void GfxRenderer::rebuildMaterialTree()
+{
+    // Draw calls are grouped together by the textures they use.
+    // After the tree is built, iterating into the tree will automatically give
+    // the optimal binding order and, by accessing `iterator.index()`, also a
+    // sorting key to see which commands to run first.
+    // (Inserting moves the nodes around, so indices can only be taken after
+    // all materials are in)
+    materialTree_.clear();
+    for(const auto& materialIt : materials_)
+    {
+        const GfxMaterialDesc& desc = materialIt.second.desc;
+
+        auto it = materialTree_.begin();
+        for(unsigned int i = 0; i < desc.nTextures; i ++)
+        {
+            it = it.at(desc.textures[i]);
+        }
+    }
+
+    for(auto& materialIt : materials_)
+    {
+        const GfxMaterialDesc& desc = materialIt.second.desc;
+
+        auto it = materialTree_.begin();
+        for(unsigned int i = 0; i < desc.nTextures; i ++)
+        {
+            it = it.get(desc.textures[i]);
+        }
+        materialIt.second.sortId = U32(it.index());
+    }
+
+    materialsChanged_ = false;
+}
+
 
 void GfxRenderer::renderFrame(Resolution resolution)
 {
@@ -37,90 +117,284 @@ void GfxRenderer::renderFrame(Resolution resolution)
         frameResolution_ = resolution;
     }
 
-    // Copy all commands that we can find from the global command queue to this
-    // frame's command queue
-    size_t nCmds = cmdQueue_.size_approx();
-    if(nCmds > frameCmds_.size())
+    // Count the commands recorded in all buckets for this frame
+    size_t nCmds = 0;
+    for(const CmdBucket& bucket : cmdBuckets_)
+    {
+        nCmds += bucket.cmds.size();
+    }
+    if(nCmds > frameCmdsOrder_.size())
     {
-        // TODO Grow `frameCmds_`, `frameCmdsOrder_` exponentially every time
-        //      instead of just matching the new number of commands in the queue?
-        frameCmds_.resize(nCmds);
+        // TODO Grow `frameCmdsOrder_` exponentially every time instead of just
+        //      matching the new number of commands?
         frameCmdsOrder_.resize(nCmds);
+        frameCmdsOrderTemp_.resize(nCmds);
     }
-    nCmds = cmdQueue_.try_dequeue_bulk(cmdQueueTok_, &frameCmds_[0], nCmds);
 
-    // Calculate the order the commands will be run in
+    // Calculate the order the commands will be run in, then merge what can be
+    // merged in it
     orderFrameCmds(nCmds);
+    nCmds = mergeFrameDraws(nCmds);
 
     // Run the ordered commands
-    backend_->runCmds(&frameCmds_[0], &frameCmdsOrder_[0], nCmds);
+    backend_->runCmds(frameCmdsOrder_.data(), nCmds);
+
+    // (Keeps the capacity around for the next frame)
+    for(CmdBucket& bucket : cmdBuckets_)
+    {
+        bucket.cmds.clear();
+        bucket.instanceData.clear();
+    }
 }
 
-void GfxRenderer::orderFrameCmds(size_t n)
+void GfxRenderer::enqueueCmd(const GfxCmd& cmd, const void* instanceData, size_t instanceDataSize)
 {
-    // TODO PERFORMANCE IMPORTANT Rebuild the material tree only once per material
-    //      addition/deletion, not for every command for every frame!!
-    //      This could be done by storing a `Handle<GfxMaterial>` instead of
-    //      `textures` in `GfxCmd`
+    bool instanced = cmd.op == GfxCmd::DrawInstanced || cmd.op == GfxCmd::DrawIndexedInstanced;
+    size_t dataSize = (instanced ? cmd.nInstances : 1) * instanceDataSize;
 
-    // TODO PERFORMANCE Multithreaded (Task-based) index generation + sorting?
+    std::unique_lock<std::mutex> lock;
+    CmdBucket& bucket = localBucket(lock);
+    size_t dataOffset = bucket.instanceData.size();
+    bucket.instanceData.resize(dataOffset + dataSize);
+    memcpy(bucket.instanceData.data() + dataOffset, instanceData, dataSize);
 
-    // Rebuild the texture tree for this frame.
-    // Draw calls are grouped together by the textures they use.
-    // After the tree is built, iterating into the tree will automatically give
-    // the optimal binding order and, by accessing `iterator.index()`, also a
-    // sorting key to see which commands to run first.
-    frameTextures_.clear();
-    for(size_t i = 0; i < n; i ++)
+    bucket.cmds.push_back(cmd);
+    GfxCmd& bucketCmd = bucket.cmds.back();
+    bucketCmd.instanceBuffer = {};
+    bucketCmd.firstInstance = 0;
+    bucketCmd.instanceDataOffset = U32(dataOffset);
+    bucketCmd.instanceDataSize = U32(instanceDataSize);
+}
+
+GfxRenderer::CmdBucket& GfxRenderer::localBucket(std::unique_lock<std::mutex>& lock)
+{
+    size_t workerIndex = scheduler_ ? scheduler_->localWorkerIndex() : TaskScheduler::INVALID_INDEX;
+    if(workerIndex != TaskScheduler::INVALID_INDEX)
+    {
+        // Only this worker ever records into its bucket, no need to lock
+        return cmdBuckets_[workerIndex];
+    }
+    else
     {
-        const GfxCmd& cmd = frameCmds_[i];
+        lock = std::unique_lock<std::mutex>(sharedBucketLock_);
+        return cmdBuckets_.back();
+    }
+}
 
-        // TODO Extract this to its own function (see below)
-        auto it = frameTextures_.begin();
-        for(unsigned int i = 0;
-            i < GfxCmd::MAX_TEXTURES && cmd.textures[i] != 0;
-            i ++)
+const U8* GfxRenderer::inlineInstanceData(const GfxCmd& cmd) const
+{
+    // (There is one bucket per worker; just check which one's storage `cmd` is in)
+    std::less_equal<const GfxCmd*> lessEqual;
+    std::less<const GfxCmd*> less;
+    for(const CmdBucket& bucket : cmdBuckets_)
+    {
+        const GfxCmd* cmds = bucket.cmds.data();
+        if(lessEqual(cmds, &cmd) && less(&cmd, cmds + bucket.cmds.size()))
         {
-            it = it.at(cmd.textures[i]);
+            return bucket.instanceData.data() + cmd.instanceDataOffset;
         }
     }
+    return nullptr;
+}
+
+void GfxRenderer::orderFrameCmds(size_t n)
+{
+    if(materialsChanged_)
+    {
+        rebuildMaterialTree();
+    }
 
-    // There are **no** attempts to minimize vertex/index buffer rebinds!! This
-    // is because if the vertex/index buffers are the same you should not use 2+
-    // different `Draw[Indexed]` calls, but a single `Draw[Indexed]Instanced` call
-    // instead!
-    // TODO Could try to merge ("batch") `Draw[Indexed]` commands with the same
-    //      buffers to `Draw[Indexed]Instanced` calls here!
+    // There are **no** attempts to minimize vertex/index buffer rebinds for
+    // commands in general!! This is because if the vertex/index buffers are the
+    // same you should not use 2+ different `Draw[Indexed]` calls, but a single
+    // `Draw[Indexed]Instanced` call instead!
+    // The exception are commands with inline instance data, that are grouped by
+    // the draw they perform so that `mergeFrameDraws()` can turn them into
+    // `Draw[Indexed]Instanced` calls.
 
     // Build the final 64-bit command sorting keys
     // Priority used for sorting:
-    // - Rendering pass (lo to hi)
-    // - Textures used (minimize rebinds)
+    // - Rendering pass (lo to hi) [bits 56..63]
+    // - Material used (minimize texture rebinds) [bits 32..55]
+    // - Draw performed, for commands with inline instance data (group them for
+    //   merging; 0 for all other commands) [bits 0..31]
     static_assert(sizeof(GfxCmd::passId) == 1,
                   "Sort key generation code expects GfxCmd::pass to be an U8");
 
-    for(size_t i = 0; i < n; i ++)
+    // (Each bucket's references go in `frameCmdsOrder_` after the previous buckets')
+    size_t bucketOffset = 0;
+    for(const CmdBucket& bucket : cmdBuckets_)
     {
-        const GfxCmd& cmd = frameCmds_[i];
-        GfxCmdIndex& cmdIndex = frameCmdsOrder_[i];
+        const GfxCmd* cmds = bucket.cmds.data();
+        GfxCmdIndex* cmdIndices = frameCmdsOrder_.data() + bucketOffset;
+
+        auto keysFunc = [this, cmds, cmdIndices](size_t begin, size_t end)
+        {
+            for(size_t i = begin; i < end; i ++)
+            {
+                const GfxCmd& cmd = cmds[i];
+
+                auto materialIt = materials_.find(cmd.material);
+                U32 matIndex = materialIt != materials_.end() ? materialIt->second.sortId : 0;
+
+                U32 drawHash = 0;
+                if(cmd.instanceDataSize > 0)
+                {
+                    // (Only equal hashes matter for merging, collisions just
+                    // interleave different draws - that are then not merged)
+                    U64 hash = U64(cmd.op | GfxCmd::DrawInstanced); // (Instanced or not)
+                    for(U64 value : {U64(cmd.vertexBuffer), U64(cmd.indexBuffer), U64(cmd.first),
+                                     U64(cmd.n), U64(cmd.instanceDataSize)})
+                    {
+                        hash = (hash ^ value) * 0x100000001B3ULL; // (FNV-1a-like mixing)
+                    }
+                    drawHash = U32(hash ^ (hash >> 32));
+                }
 
-        // TODO Extract this to its own function (see above)
-        auto matIt = frameTextures_.begin();
-        for(unsigned int i = 0;
-            i < GfxCmd::MAX_TEXTURES && cmd.textures[i] != 0;
-            i ++)
+                // Key layout: see above
+                cmdIndices[i].cmd = &cmd;
+                cmdIndices[i].key = U64(cmd.passId) << 56
+                                  | U64(matIndex & 0xFFFFFF) << 32
+                                  | U64(drawHash);
+            }
+        };
+        size_t bucketSize = bucket.cmds.size();
+        if(scheduler_ && bucketSize > ORDER_CHUNK_SIZE)
         {
-            matIt = matIt.at(cmd.textures[i]);
+            parallelFor(*scheduler_, bucketSize, ORDER_CHUNK_SIZE, keysFunc);
         }
-        U32 matIndex = U32(matIt.index());
+        else
+        {
+            keysFunc(0, bucketSize);
+        }
+        bucketOffset += bucketSize;
+    }
+
+    // Order the command references by key.
+    // (Radix sort is stable, so commands with the same key are run in the order
+    // they were recorded in, bucket by bucket)
+    auto keyFunc = [](const GfxCmdIndex& cmdIndex)
+    {
+        return cmdIndex.key;
+    };
+    radixSort(frameCmdsOrder_.data(), frameCmdsOrderTemp_.data(), n, keyFunc,
+              scheduler_, ORDER_CHUNK_SIZE);
+}
+
 
-        // Key layout: see docs
-        cmdIndex.index = i;
-        cmdIndex.key = U64(cmd.passId) << 56 | U64(matIndex);
+size_t GfxRenderer::mergeFrameDraws(size_t n)
+{
+    nDrawsSaved_ = 0;
+    mergedCmds_.clear();
+    mergedCmdsSlots_.clear();
+    mergeData_.clear();
+
+    bool anyInstanceData = false;
+    for(const CmdBucket& bucket : cmdBuckets_)
+    {
+        anyInstanceData |= !bucket.instanceData.empty();
+    }
+    if(!anyInstanceData)
+    {
+        // Nothing to merge (or to upload instance data for)
+        return n;
+    }
+
+    // (`Draw | DrawInstanced` = `DrawInstanced`, ditto for indexed draws)
+    auto canMerge = [](const GfxCmd& cmd, const GfxCmd& other)
+    {
+        return other.instanceDataSize == cmd.instanceDataSize
+               && (other.op | GfxCmd::DrawInstanced) == (cmd.op | GfxCmd::DrawInstanced)
+               && other.passId == cmd.passId
+               && other.vertexBuffer == cmd.vertexBuffer && other.indexBuffer == cmd.indexBuffer
+               && other.first == cmd.first && other.n == cmd.n
+               && other.material == cmd.material;
+    };
+
+    // Compact `frameCmdsOrder_` in place, replacing each run of mergeable
+    // commands with a (placeholder) reference to the command they merge into,
+    // and gather the instance data of each run (in order) into `mergeData_`.
+    // NOTE: Every command with inline instance data becomes an instanced draw
+    //       that reads from `mergeBuffer_`, even if it can't be merged with
+    //       any other (a run of 1); the data has to come from some buffer!
+    GfxCmdIndex* order = frameCmdsOrder_.data();
+    size_t nOut = 0;
+    for(size_t i = 0; i < n;)
+    {
+        const GfxCmd& cmd = *order[i].cmd;
+        if(cmd.instanceDataSize == 0)
+        {
+            order[nOut ++] = order[i ++];
+            continue;
+        }
+
+        size_t runEnd = i + 1;
+        while(runEnd < n && canMerge(cmd, *order[runEnd].cmd))
+        {
+            runEnd ++;
+        }
+
+        // Each run's data starts at a multiple of its stride, so that it can be
+        // addressed by `firstInstance`
+        size_t stride = cmd.instanceDataSize;
+        size_t firstInstance = (mergeData_.size() + stride - 1) / stride;
+        size_t nInstances = 0;
+        mergeData_.resize(firstInstance * stride);
+        for(size_t j = i; j < runEnd; j ++)
+        {
+            const GfxCmd& runCmd = *order[j].cmd;
+            bool instanced = runCmd.op == GfxCmd::DrawInstanced || runCmd.op == GfxCmd::DrawIndexedInstanced;
+            size_t runCmdInstances = instanced ? runCmd.nInstances : 1;
+
+            size_t dataOffset = mergeData_.size();
+            mergeData_.resize(dataOffset + runCmdInstances * stride);
+            memcpy(mergeData_.data() + dataOffset, inlineInstanceData(runCmd), runCmdInstances * stride);
+            nInstances += runCmdInstances;
+        }
+
+        GfxCmd mergedCmd = cmd;
+        mergedCmd.op = GfxCmd::Op(cmd.op | GfxCmd::DrawInstanced);
+        mergedCmd.nInstances = nInstances;
+        mergedCmd.firstInstance = firstInstance;
+        mergedCmd.instanceDataOffset = mergedCmd.instanceDataSize = 0;
+        mergedCmds_.push_back(mergedCmd);
+
+        mergedCmdsSlots_.push_back(nOut);
+        order[nOut ++].key = order[i].key;
+
+        nDrawsSaved_ += runEnd - i - 1;
+        i = runEnd;
+    }
+
+    // Upload the data of all runs at once, growing the buffer as needed
+    // (if it is actually bigger there is no harm in only filling it partially)
+    size_t dataSize = mergeData_.size();
+    if(dataSize > mergeBufferSize_)
+    {
+        size_t newSize = std::max(dataSize, mergeBufferSize_ * 2);
+        if(!mergeBuffer_)
+        {
+            GfxBufferDesc bufferDesc;
+            bufferDesc.size = newSize;
+            bufferDesc.usage = GfxUsage::Streaming;
+            mergeBuffer_ = backend_->genBuffer(bufferDesc);
+        }
+        else
+        {
+            backend_->resizeBuffer(mergeBuffer_, newSize);
+        }
+        mergeBufferSize_ = mergeBuffer_ ? newSize : 0;
+    }
+    backend_->editBuffer(mergeBuffer_, 0, dataSize, mergeData_.data());
+
+    // (`mergedCmds_` is done growing, pointers to its commands are now stable)
+    for(size_t mergedI = 0; mergedI < mergedCmds_.size(); mergedI ++)
+    {
+        mergedCmds_[mergedI].instanceBuffer = mergeBuffer_;
+        order[mergedCmdsSlots_[mergedI]].cmd = &mergedCmds_[mergedI];
     }
 
-    // Order the command indices by key
-    std::sort(frameCmdsOrder_.begin(), frameCmdsOrder_.begin() + n);
+    return nOut;
 }
 
 }
@@ -1,13 +1,14 @@
 #pragma once
 
 #include <stddef.h>
+#include <mutex>
 #include <unordered_map>
 #include <vector>
-#include <concurrentqueue.h>
 #include <Core/Base/MapTree.hh>
 #include <Core/Base/Handle.hh>
 #include <Core/Base/Ref.hh>
 #include <Core/Visual/Resolution.hh>
+#include <Core/Task/TaskScheduler.hh>
 #include <Core/Gfx/GfxResources.hh>
 #include <Core/Gfx/GfxCmd.hh>
 #include <Core/Gfx/GfxPipeline.hh>
@@ -18,36 +19,90 @@ namespace Ares
 
 class GfxRenderer
 {
+public:
+    /// The number of commands that are processed by each task when ordering
+    /// commands on multiple threads; frames with less commands than this are
+    /// ordered on the calling thread only.
+    static constexpr const size_t ORDER_CHUNK_SIZE = 8 * 1024;
+
 private:
     Ref<GfxBackend> backend_;
     Ref<GfxPipeline> pipeline_;
+    TaskScheduler* scheduler_; ///< The scheduler to order commands on (can be null).
 
-    moodycamel::ConcurrentQueue<GfxCmd> cmdQueue_; ///< The global command queue.
-    moodycamel::ConsumerToken cmdQueueTok_; ///< A queue consumer token to be
-                                            ///< used by `renderFrame()` only
+    /// The commands recorded by one thread for the next frame.
+    /// (Padded so that the vectors of adjacent buckets are always more than a
+    /// cache line apart, and workers recording concurrently don't false-share;
+    /// `alignas(64)` would not do, as C++14's `std::allocator` ignores over-alignment)
+    struct CmdBucket
+    {
+        std::vector<GfxCmd> cmds;
+        std::vector<U8> instanceData; ///< Inline per-instance data of `cmds` (see `GfxCmd::instanceDataOffset`).
+        char pad[64];
+    };
+    std::vector<CmdBucket> cmdBuckets_; ///< One per worker of `scheduler_`, plus one for non-worker threads (the last).
+    std::mutex sharedBucketLock_; ///< Locked when recording into the non-worker threads' bucket.
 
     Resolution frameResolution_; ///< This frame's rendering resolution.
-    std::vector<GfxCmd> frameCmds_; ///< All of this frame's rendering commands, unsorted.
-    std::vector<GfxCmdIndex> frameCmdsOrder_; ///< The sorted indices to `frameCmds_`.
-
-    /// A tree of all the combinations of textures (from `textures[0]` to possibly
-    /// `textures[MAX_TEXTURES]`) used in all of this frame commands'. Each
-    /// combination of textures in each command is put in as a key in the tree
-    /// before the commands themselves are run; when iterating it afterwards the
-    /// index of the iterator can be used as part of the sort key for commands to
-    /// minimize the amount of times the textures have to be rebound (see how
-    /// `MapTree` stores nodes internally to understand!).
-    MapTree<U32, size_t> frameTextures_;
+    std::vector<GfxCmdIndex> frameCmdsOrder_; ///< This frame's commands (in all buckets), sorted.
+    std::vector<GfxCmdIndex> frameCmdsOrderTemp_; ///< Scratch space for sorting `frameCmdsOrder_`.
 
-
-    /// Generates sorted indices into `frameCmdsOrder_` for the first `n` commands
-    /// currently in `frameCmds_`.
+    /// A material created via `genMaterial()`.
+    struct MaterialData
+    {
+        GfxMaterialDesc desc;
+        U32 sortId; ///< The index of the material's node in `materialTree_`.
+    };
+    std::unordered_map<Handle<GfxMaterial>, MaterialData> materials_;
+
+    /// A tree of the combinations of textures (from `textures[0]` to
+    /// `textures[nTextures - 1]`) of all materials. Each combination of textures
+    /// is put in as a key in the tree; when iterating it afterwards the index of
+    /// the iterator can be used as part of the sort key for commands to minimize
+    /// the amount of times the textures have to be rebound (see how `MapTree`
+    /// stores nodes internally to understand!).
+    MapTree<U32, size_t> materialTree_;
+    bool materialsChanged_; ///< If `true`, `materialTree_` is rebuilt before ordering commands.
+
+    /// The renderer-owned instance buffer that the inline instance data of all
+    /// commands of a frame is uploaded to by `mergeFrameDraws()` (null until needed).
+    Handle<GfxBuffer> mergeBuffer_;
+    size_t mergeBufferSize_; ///< The current size of `mergeBuffer_` in bytes.
+
+    std::vector<GfxCmd> mergedCmds_; ///< The commands generated by `mergeFrameDraws()` for this frame.
+    std::vector<size_t> mergedCmdsSlots_; ///< Where each of `mergedCmds_` is in `frameCmdsOrder_`.
+    std::vector<U8> mergeData_; ///< Where the instance data of a frame is gathered before uploading it.
+    size_t nDrawsSaved_; ///< See `nDrawsSaved()`.
+
+
+    /// Rebuilds `materialTree_` and updates the `sortId` of all materials.
+    void rebuildMaterialTree();
+
+    /// Returns the bucket the local thread records commands into. If it is the
+    /// one shared by non-worker threads, locks `sharedBucketLock_` into `lock`.
+    CmdBucket& localBucket(std::unique_lock<std::mutex>& lock);
+
+    /// Returns a pointer to the inline instance data of `cmd`, that must be in
+    /// one of the buckets.
+    const U8* inlineInstanceData(const GfxCmd& cmd) const;
+
+    /// Generates the sorted `frameCmdsOrder_` for the `n` commands currently
+    /// in all buckets.
     void orderFrameCmds(size_t n);
 
+    /// Merges each run of adjacent commands in the sorted `frameCmdsOrder_`
+    /// that have inline instance data and otherwise identical draws into a
+    /// single instanced command (in `mergedCmds_`), uploading the data of all
+    /// runs to consecutive ranges of `mergeBuffer_`. Returns the number of
+    /// commands left in the order.
+    size_t mergeFrameDraws(size_t n);
+
 public:
     /// Initializes a new renderer given a handle to the backend it will use.
+    /// If `scheduler` is not null, the commands of large frames are ordered by
+    /// multiple tasks on it (see `ORDER_CHUNK_SIZE`).
     /// Call `init()` to actually be able to start executing rendering commands!
-    GfxRenderer(Ref<GfxBackend> backend);
+    GfxRenderer(Ref<GfxBackend> backend, TaskScheduler* scheduler=nullptr);
 
     /// Destroys the renderer.
     ~GfxRenderer();
@@ -57,6 +112,11 @@ public:
     /// pipeline for the commands it will run. Returns an error message on error.
     ErrString init(Ref<GfxPipeline> pipeline);
 
+    /// Deletes the backend resources owned by the renderer (see
+    /// `enqueueCmd(cmd, instanceData, instanceDataSize)`); call before shutting
+    /// down the backend. They are regenerated if the renderer is used again.
+    void halt();
+
 
     /// Returns a reference to the pipeline currently used by the renderer.
     inline Ref<GfxPipeline> pipeline() const
@@ -78,26 +138,71 @@ public:
     }
 
 
-    /// Pushes `n` `GfxCmd`s into the rendering command queue, to be executed
-    /// later by `renderFrame()`.
-    /// Threadsafe and lockless.
+    /// Creates a material on the backend (see `GfxBackend::genMaterial()`) and
+    /// registers it for sorting commands by it; returns a null handle on error.
+    /// Not threadsafe: call from the thread that runs `renderFrame()` only.
+    Handle<GfxMaterial> genMaterial(const GfxMaterialDesc& desc);
+
+    /// Deletes a material created via `genMaterial()`.
+    /// Does nothing if the given handle is null or invalid.
+    /// Not threadsafe: call from the thread that runs `renderFrame()` only.
+    void delMaterial(Handle<GfxMaterial> material);
+
+
+    /// Records `n` `GfxCmd`s, to be executed by the next `renderFrame()`.
+    /// Each worker thread of the scheduler records into its own bucket, so this
+    /// is lockless (and atomic-free) from tasks; other threads share a single
+    /// bucket guarded by a mutex.
+    /// **WARNING**: Threadsafe, but not to be called while `renderFrame()` runs!
     template <typename CmdIterator>
     inline void enqueueCmds(CmdIterator begin, size_t n)
     {
-        cmdQueue_.enqueue_bulk(begin, n);
+        std::unique_lock<std::mutex> lock;
+        std::vector<GfxCmd>& bucket = localBucket(lock).cmds;
+        bucket.reserve(bucket.size() + n);
+        for(size_t i = 0; i < n; i ++, ++ begin)
+        {
+            bucket.push_back(*begin);
+        }
     }
 
-    /// Pushes `n` `GfxCmd`s into the rendering command queue, to be executed
-    /// later by `renderFrame()`.
-    /// Threadsafe and lockless.
+    /// Records a `GfxCmd`, to be executed by the next `renderFrame()`.
+    /// See `enqueueCmds()`.
     inline void enqueueCmd(const GfxCmd& cmd)
     {
-        cmdQueue_.enqueue(cmd);
+        std::unique_lock<std::mutex> lock;
+        localBucket(lock).cmds.push_back(cmd);
+    }
+
+    /// Records a command whose per-instance attribute data is copied from
+    /// `instanceData` instead of being read from an instance buffer:
+    /// `instanceDataSize` is the size in bytes of one element of what would be
+    /// in an instance buffer for the command's pass, and `instanceData` holds
+    /// one such element for `Draw`/`DrawIndexed` commands or `cmd.nInstances`
+    /// of them for `Draw[Indexed]Instanced` ones. `cmd.instanceBuffer` and
+    /// `cmd.firstInstance` are ignored; the renderer uploads the data of all
+    /// such commands in a frame to a single instance buffer it owns.
+    ///
+    /// Commands recorded like this that end up adjacent after sorting and have
+    /// the same op (instanced or not), pass, buffers, material, `first`, `n` and
+    /// `instanceDataSize` are merged into a single `Draw[Indexed]Instanced`
+    /// command. This is the way to submit per-object draws and still get them
+    /// batched; see `nDrawsSaved()`.
+    /// (Commands recorded via `enqueueCmd(cmd)` are never merged)
+    /// **WARNING**: Threadsafe, but not to be called while `renderFrame()` runs!
+    void enqueueCmd(const GfxCmd& cmd, const void* instanceData, size_t instanceDataSize);
+
+    /// Returns the number of draw calls that were saved by merging commands in
+    /// the latest `renderFrame()` (see `enqueueCmd(cmd, instanceData, instanceDataSize)`).
+    inline size_t nDrawsSaved() const
+    {
+        return nDrawsSaved_;
     }
 
-    /// Copies all commands currently in the rendering command queue to an internal
-    /// buffer, sorts them by pass and to minimize resource (textures, buffers, ...)
-    /// rebinds as much as possible, then has the backend execute them.
+    /// Sorts all commands recorded since the last call (without moving them out
+    /// of their buckets) by pass and to minimize resource (textures, buffers, ...)
+    /// rebinds as much as possible, merges the draws that can be merged, has the
+    /// backend execute them, then clears the buckets.
     /// If resolution changed from the latest `renderFrame()` call also invokes
     /// `backend().changeResolution()` before running the commands.
     void renderFrame(Resolution resolution);
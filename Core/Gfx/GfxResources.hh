@@ -77,4 +77,19 @@ struct GfxShaderDesc
     Ref<ShaderSrc> src;
 };
 
+struct GfxMaterial;
+struct GfxMaterialDesc
+{
+    /// The maximum number of textures in a material.
+    static constexpr const unsigned int MAX_TEXTURES = 8;
+
+    /// The textures to be bound to texture inputs in the `GfxPipeline::Pass`'
+    /// shader for commands using the material.
+    /// The textures should have been `genTexture()`d from the `GfxBackend` in use.
+    Handle<GfxTexture> textures[MAX_TEXTURES];
+
+    /// The number of textures in `textures`. Must be `<= MAX_TEXTURES`.
+    unsigned int nTextures = 0;
+};
+
 }
@@ -0,0 +1,543 @@
+#include "Backend.hh"
+
+#include <sstream>
+
+namespace Ares
+{
+namespace Null
+{
+
+constexpr const size_t Backend::MAX_ERROR_MESSAGES;
+
+FrameStats& FrameStats::operator+=(const FrameStats& other)
+{
+    nDraws += other.nDraws;
+    nInstances += other.nInstances;
+    nPassChanges += other.nPassChanges;
+    nBufferBindChanges += other.nBufferBindChanges;
+    nTextureBindChanges += other.nTextureBindChanges;
+    nBufferBytesUploaded += other.nBufferBytesUploaded;
+    nTextureBytesUploaded += other.nTextureBytesUploaded;
+    nErrors += other.nErrors;
+    return *this;
+}
+
+
+Backend::Backend(bool recording)
+    : nextBufferId_(1), nextTextureId_(1), nextShaderId_(1), nextMaterialId_(1),
+      resolution_{0, 0},
+      recording_(recording), nFrames_(0)
+{
+}
+
+void Backend::error(const std::string& message)
+{
+    if(errors_.size() < MAX_ERROR_MESSAGES)
+    {
+        errors_.push_back(message);
+    }
+    curStats_.nErrors ++;
+}
+
+static constexpr const size_t GFX_VERTEXATTRIB_TYPE_SIZE[] = // Index by `GfxPipeline::VertexAttrib::Type`
+{
+    sizeof(F32), // 0: F32
+    sizeof(I32), // 1: I32
+    sizeof(U32), // 2: U32
+};
+
+ErrString Backend::init(Ref<GfxPipeline> pipeline)
+{
+    // (Like for GL33, resources are *not* destroyed here)
+    pipeline_ = pipeline;
+    curBindings_ = Bindings();
+
+    size_t nPasses = pipeline->passes.size();
+    vertexStrides_.assign(nPasses, 0);
+    instanceStrides_.assign(nPasses, 0);
+
+    for(size_t i = 0; i < nPasses; i ++)
+    {
+        const GfxPipeline::Pass& pass = pipeline->passes[i];
+
+        std::ostringstream err;
+        err << "Pass " << i << ": ";
+
+        if(pass.nAttribs > GfxPipeline::Pass::MAX_ATTRIBS)
+        {
+            err << "Too many attribs (" << pass.nAttribs << ")";
+            return err.str();
+        }
+        for(unsigned int j = 0; j < pass.nAttribs; j ++)
+        {
+            const auto& attrib = pass.attribs[j];
+            size_t& stride = attrib.instanceDivisor == 0 ? vertexStrides_[i] : instanceStrides_[i];
+            stride += GFX_VERTEXATTRIB_TYPE_SIZE[unsigned(attrib.type)] * attrib.n;
+        }
+
+        if(pass.nTargets == 0 || pass.nTargets > GfxPipeline::Pass::MAX_TARGETS)
+        {
+            err << "Invalid number of targets (" << pass.nTargets << ")";
+            return err.str();
+        }
+        if(pass.targets[0] != GfxPipeline::Pass::SCREEN_TARGET)
+        {
+            bool hasDepthTarget = false;
+            for(unsigned int j = 0; j < pass.nTargets; j ++)
+            {
+                auto texIt = textures_.find(pass.targets[j]);
+                if(texIt == textures_.end())
+                {
+                    err << "Nonexisting target texture " << pass.targets[j];
+                    return err.str();
+                }
+                if(texIt->second.format.isDepth())
+                {
+                    if(hasDepthTarget)
+                    {
+                        err << "More than one depth target";
+                        return err.str();
+                    }
+                    hasDepthTarget = true;
+                }
+            }
+        }
+
+        if(shaders_.find(pass.shader) == shaders_.end())
+        {
+            err << "Nonexisting shader " << pass.shader;
+            return err.str();
+        }
+        if(pass.uniformBuffer && buffers_.find(pass.uniformBuffer) == buffers_.end())
+        {
+            err << "Nonexisting uniform buffer " << pass.uniformBuffer;
+            return err.str();
+        }
+    }
+
+    return {};
+}
+
+
+Handle<GfxBuffer> Backend::genBuffer(const GfxBufferDesc& desc)
+{
+    Handle<GfxBuffer> handle(nextBufferId_ ++);
+    buffers_[handle] = desc;
+    buffers_[handle].data = nullptr; // (Not owned, do not keep it around)
+
+    if(desc.data)
+    {
+        curStats_.nBufferBytesUploaded += desc.size;
+    }
+    return handle;
+}
+
+void Backend::resizeBuffer(Handle<GfxBuffer> buffer, size_t newSize)
+{
+    auto descIt = buffers_.find(buffer);
+    if(!buffer || descIt == buffers_.end())
+    {
+        error("resizeBuffer(): Nonexisting buffer " + std::to_string(buffer));
+        return;
+    }
+    descIt->second.size = newSize;
+}
+
+void Backend::editBuffer(Handle<GfxBuffer> buffer, size_t dataOffset, size_t dataSize, const void* data)
+{
+    auto descIt = buffers_.find(buffer);
+    if(!buffer || descIt == buffers_.end())
+    {
+        error("editBuffer(): Nonexisting buffer " + std::to_string(buffer));
+        return;
+    }
+    if(descIt->second.size < (dataOffset + dataSize))
+    {
+        std::ostringstream err;
+        err << "editBuffer(): Edit of " << dataSize << " bytes at offset " << dataOffset
+            << " out of bounds of buffer " << buffer << " (" << descIt->second.size << " bytes)";
+        error(err.str());
+        return;
+    }
+    if(!data && dataSize > 0)
+    {
+        error("editBuffer(): Null data for buffer " + std::to_string(buffer));
+        return;
+    }
+
+    curStats_.nBufferBytesUploaded += dataSize;
+}
+
+void Backend::delBuffer(Handle<GfxBuffer> buffer)
+{
+    auto descIt = buffers_.find(buffer);
+    if(!buffer || descIt == buffers_.end())
+    {
+        error("delBuffer(): Nonexisting buffer " + std::to_string(buffer));
+        return;
+    }
+    buffers_.erase(descIt);
+}
+
+
+static constexpr const size_t GFX_TEXTURE_DATATYPE_SIZE[] = // (index by `GfxTextureDesc::DataType`)
+{
+    sizeof(U8), // U8
+    sizeof(U16), // U16
+    sizeof(F32), // F32
+};
+
+/// Returns the size in bytes of the data for a `width * height * depth` area of
+/// a texture described by `desc`.
+static size_t textureDataSize(const GfxTextureDesc& desc, size_t width, size_t height, size_t depth)
+{
+    return GFX_TEXTURE_DATATYPE_SIZE[unsigned(desc.dataType)] * desc.format.nChannelsSet()
+           * width * height * depth;
+}
+
+/// Returns the number of layers of a texture described by `desc`.
+static size_t textureDepth(const GfxTextureDesc& desc)
+{
+    switch(desc.type)
+    {
+    case GfxTextureDesc::_2D:
+        return 1;
+    case GfxTextureDesc::Cubemap:
+        return 6;
+    default: // _2DArray, _3D
+        return desc.depth;
+    }
+}
+
+Handle<GfxTexture> Backend::genTexture(const GfxTextureDesc& desc)
+{
+    if(desc.format.nChannelsSet() == 0)
+    {
+        // (GL33 would find no suitable texture format either)
+        error("genTexture(): Texture format has no channels");
+        return {};
+    }
+
+    Handle<GfxTexture> handle(nextTextureId_ ++);
+    textures_[handle] = desc;
+    textures_[handle].data = nullptr; // (Not owned, do not keep it around)
+
+    if(desc.data)
+    {
+        curStats_.nTextureBytesUploaded += textureDataSize(desc, desc.resolution.width, desc.resolution.height,
+                                                           textureDepth(desc));
+    }
+    return handle;
+}
+
+void Backend::resizeTexture(Handle<GfxTexture> texture, Resolution newResolution, size_t newDepth)
+{
+    auto descIt = textures_.find(texture);
+    if(!texture || descIt == textures_.end())
+    {
+        error("resizeTexture(): Nonexisting texture " + std::to_string(texture));
+        return;
+    }
+
+    GfxTextureDesc& desc = descIt->second;
+    desc.resolution = newResolution;
+    if(desc.type == GfxTextureDesc::_2DArray || desc.type == GfxTextureDesc::_3D)
+    {
+        desc.depth = newDepth;
+    }
+}
+
+void Backend::editTexture(Handle<GfxTexture> texture, ViewCube dataCube, const void* data)
+{
+    auto descIt = textures_.find(texture);
+    if(!texture || descIt == textures_.end())
+    {
+        error("editTexture(): Nonexisting texture " + std::to_string(texture));
+        return;
+    }
+    const GfxTextureDesc& desc = descIt->second;
+
+    if(dataCube.topFrontLeft.x > dataCube.bottomBackRight.x
+       || dataCube.topFrontLeft.y > dataCube.bottomBackRight.y
+       || dataCube.topFrontLeft.z > dataCube.bottomBackRight.z
+       || dataCube.bottomBackRight.x > desc.resolution.width
+       || dataCube.bottomBackRight.y > desc.resolution.height
+       || dataCube.bottomBackRight.z > textureDepth(desc))
+    {
+        std::ostringstream err;
+        err << "editTexture(): Edit of " << dataCube << " out of bounds of texture " << texture;
+        error(err.str());
+        return;
+    }
+    if(!data)
+    {
+        error("editTexture(): Null data for texture " + std::to_string(texture));
+        return;
+    }
+
+    Resolution xyResolution = dataCube.xyResolution();
+    curStats_.nTextureBytesUploaded += textureDataSize(desc, xyResolution.width, xyResolution.height,
+                                                       dataCube.zDepth());
+}
+
+void Backend::delTexture(Handle<GfxTexture> texture)
+{
+    auto descIt = textures_.find(texture);
+    if(!texture || descIt == textures_.end())
+    {
+        error("delTexture(): Nonexisting texture " + std::to_string(texture));
+        return;
+    }
+    textures_.erase(descIt);
+}
+
+
+Handle<GfxShader> Backend::genShader(const GfxShaderDesc& desc, ErrString* err)
+{
+    if(!desc.src || desc.src->vert.empty() || desc.src->frag.empty())
+    {
+        // (Both are required to link a program in GL33)
+        if(err)
+        {
+            *err = "Shader source missing or without vertex/fragment stage";
+        }
+        return {};
+    }
+
+    Handle<GfxShader> handle(nextShaderId_ ++);
+    shaders_.insert(handle);
+    return handle;
+}
+
+void Backend::delShader(Handle<GfxShader> shader)
+{
+    auto it = shaders_.find(shader);
+    if(shader == 0 || it == shaders_.end())
+    {
+        error("delShader(): Nonexisting shader " + std::to_string(shader));
+        return;
+    }
+    shaders_.erase(it);
+}
+
+
+Handle<GfxMaterial> Backend::genMaterial(const GfxMaterialDesc& desc)
+{
+    if(desc.nTextures > GfxMaterialDesc::MAX_TEXTURES)
+    {
+        error("genMaterial(): Too many textures (" + std::to_string(desc.nTextures) + ")");
+        return {};
+    }
+    for(unsigned int i = 0; i < desc.nTextures; i ++)
+    {
+        if(desc.textures[i] && textures_.find(desc.textures[i]) == textures_.end())
+        {
+            error("genMaterial(): Nonexisting texture " + std::to_string(desc.textures[i])
+                  + " in slot " + std::to_string(i));
+            return {};
+        }
+    }
+
+    Handle<GfxMaterial> handle(nextMaterialId_ ++);
+    materials_[handle] = desc;
+    return handle;
+}
+
+void Backend::delMaterial(Handle<GfxMaterial> material)
+{
+    auto it = materials_.find(material);
+    if(!material || it == materials_.end())
+    {
+        error("delMaterial(): Nonexisting material " + std::to_string(material));
+        return;
+    }
+    materials_.erase(it);
+}
+
+
+void Backend::changeResolution(Resolution resolution)
+{
+    resolution_ = resolution;
+}
+
+bool Backend::validateCmd(const GfxCmd& cmd, U8 prevPassId)
+{
+    std::ostringstream err;
+    err << "runCmds(): Command (op " << unsigned(cmd.op) << ", pass " << unsigned(cmd.passId) << "): ";
+
+    if(unsigned(cmd.op) > unsigned(GfxCmd::DrawIndexedInstanced))
+    {
+        err << "Invalid op";
+        error(err.str());
+        return false;
+    }
+    if(cmd.passId >= pipeline_->passes.size())
+    {
+        err << "Nonexisting pass";
+        error(err.str());
+        return false;
+    }
+    if(cmd.passId < prevPassId)
+    {
+        err << "Run after a command of pass " << unsigned(prevPassId) << " (commands not sorted by pass)";
+        error(err.str());
+        return false;
+    }
+
+    if(cmd.material)
+    {
+        auto materialIt = materials_.find(cmd.material);
+        if(materialIt == materials_.end())
+        {
+            err << "Nonexisting material " << cmd.material;
+            error(err.str());
+            return false;
+        }
+
+        // (The textures could have been deleted after the material was created)
+        const GfxMaterialDesc& material = materialIt->second;
+        for(unsigned int i = 0; i < material.nTextures; i ++)
+        {
+            if(material.textures[i] && textures_.find(material.textures[i]) == textures_.end())
+            {
+                err << "Nonexisting texture " << material.textures[i] << " in slot " << i
+                    << " of material " << cmd.material;
+                error(err.str());
+                return false;
+            }
+        }
+    }
+
+    // Check that all buffers exist and that the vertices/indices/instances drawn
+    // are inside of them
+    auto checkBuffer = [this, &err](Handle<GfxBuffer> buffer, const char* what,
+                                    size_t stride, size_t first, size_t n)
+    {
+        if(stride == 0)
+        {
+            // (Nothing read from the buffer)
+            return true;
+        }
+        if(!buffer)
+        {
+            err << "Missing " << what << " buffer";
+            error(err.str());
+            return false;
+        }
+        auto descIt = buffers_.find(buffer);
+        if(descIt == buffers_.end())
+        {
+            err << "Nonexisting " << what << " buffer " << buffer;
+            error(err.str());
+            return false;
+        }
+        if((first + n) * stride > descIt->second.size)
+        {
+            err << "Reads " << what << "s [" << first << ", " << first + n << ") out of bounds of buffer "
+                << buffer << " (" << descIt->second.size << " bytes)";
+            error(err.str());
+            return false;
+        }
+        return true;
+    };
+
+    bool indexed = cmd.op == GfxCmd::DrawIndexed || cmd.op == GfxCmd::DrawIndexedInstanced;
+    bool instanced = cmd.op == GfxCmd::DrawInstanced || cmd.op == GfxCmd::DrawIndexedInstanced;
+    if(indexed)
+    {
+        // (Indices could point anywhere in the vertex buffer, only check that it exists)
+        if(!checkBuffer(cmd.indexBuffer, "index", sizeof(U32), cmd.first, cmd.n)
+           || !checkBuffer(cmd.vertexBuffer, "vertex", vertexStrides_[cmd.passId], 0, 0))
+        {
+            return false;
+        }
+    }
+    else if(!checkBuffer(cmd.vertexBuffer, "vertex", vertexStrides_[cmd.passId], cmd.first, cmd.n))
+    {
+        return false;
+    }
+    if(instanced && !checkBuffer(cmd.instanceBuffer, "instance", instanceStrides_[cmd.passId],
+                                 cmd.firstInstance, cmd.nInstances))
+    {
+        return false;
+    }
+
+    return true;
+}
+
+void Backend::runCmds(const GfxCmdIndex* cmdsOrder, size_t n)
+{
+    if(recording_)
+    {
+        lastFrameCmds_.resize(n);
+    }
+    else
+    {
+        lastFrameCmds_.clear();
+    }
+
+    if(!pipeline_ && n > 0)
+    {
+        error("runCmds(): Backend not initialized");
+        n = 0;
+    }
+
+    U8 prevPassId = 0;
+    for(size_t i = 0; i < n; i ++)
+    {
+        const GfxCmd& cmd = *cmdsOrder[i].cmd;
+        if(recording_)
+        {
+            lastFrameCmds_[i] = cmd;
+        }
+
+        if(!validateCmd(cmd, prevPassId))
+        {
+            continue;
+        }
+        prevPassId = cmd.passId;
+
+        // Count the state changes a real backend would have to do
+        if(cmd.passId != curBindings_.passId)
+        {
+            curStats_.nPassChanges ++;
+            curBindings_.passId = cmd.passId;
+        }
+
+        if(cmd.vertexBuffer != curBindings_.vertexBuffer
+           || cmd.indexBuffer != curBindings_.indexBuffer
+           || cmd.instanceBuffer != curBindings_.instanceBuffer)
+        {
+            curStats_.nBufferBindChanges ++;
+            curBindings_.vertexBuffer = cmd.vertexBuffer;
+            curBindings_.indexBuffer = cmd.indexBuffer;
+            curBindings_.instanceBuffer = cmd.instanceBuffer;
+        }
+
+        if(cmd.material)
+        {
+            const GfxMaterialDesc& material = materials_[cmd.material]; // (Validated above)
+            for(unsigned int j = 0; j < material.nTextures; j ++)
+            {
+                if(material.textures[j] != curBindings_.textures[j])
+                {
+                    curStats_.nTextureBindChanges ++;
+                    curBindings_.textures[j] = material.textures[j];
+                }
+            }
+        }
+
+        curStats_.nDraws ++;
+        bool instanced = cmd.op == GfxCmd::DrawInstanced || cmd.op == GfxCmd::DrawIndexedInstanced;
+        curStats_.nInstances += instanced ? cmd.nInstances : 1;
+    }
+
+    // End the frame
+    lastStats_ = curStats_;
+    totalStats_ += curStats_;
+    curStats_ = FrameStats();
+    nFrames_ ++;
+}
+
+}
+}
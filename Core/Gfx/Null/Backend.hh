@@ -0,0 +1,170 @@
+#pragma once
+
+#include <stddef.h>
+#include <string>
+#include <vector>
+#include <unordered_map>
+#include <unordered_set>
+#include <Core/Gfx/GfxBackend.hh>
+
+namespace Ares
+{
+namespace Null
+{
+
+/// Statistics on the work a `Null::Backend` was asked to do.
+struct FrameStats
+{
+    size_t nDraws = 0; ///< The number of commands run (all ops are draws).
+    size_t nInstances = 0; ///< The number of instances drawn (1 per non-instanced draw).
+    size_t nPassChanges = 0; ///< The number of times the current pass changed.
+    size_t nBufferBindChanges = 0; ///< Vertex/index/instance buffer set changes (VAO switches in GL33).
+    size_t nTextureBindChanges = 0; ///< Texture units whose bound texture changed.
+    size_t nBufferBytesUploaded = 0; ///< Via `genBuffer()` and `editBuffer()`.
+    size_t nTextureBytesUploaded = 0; ///< Via `genTexture()` and `editTexture()`.
+    size_t nErrors = 0; ///< Invalid resource operations or commands (see `Backend::errors()`).
+
+    FrameStats& operator+=(const FrameStats& other);
+};
+
+/// A rendering backend that renders nothing, for running the renderer without
+/// a GPU or graphics context (headless runs, CI, benchmarks).
+///
+/// Resources are tracked like a real backend would, and every operation and
+/// command is validated against them (nonexisting handles, out of bounds
+/// edits/draws, passes out of order...); failures are counted and logged in
+/// `errors()` instead of being silently ignored.
+///
+/// Each call to `runCmds()` ends a frame: its statistics (including the uploads
+/// done since the previous frame) are then available via `lastFrameStats()`,
+/// and, if recording is enabled, the commands run in `lastFrameCmds()`.
+class Backend : public Ares::GfxBackend
+{
+public:
+    /// The maximum number of messages kept in `errors()`; further errors are
+    /// only counted.
+    static constexpr const size_t MAX_ERROR_MESSAGES = 256;
+
+private:
+    std::unordered_map<Handle<GfxBuffer>, GfxBufferDesc> buffers_;
+    std::unordered_map<Handle<GfxTexture>, GfxTextureDesc> textures_;
+    std::unordered_set<Handle<GfxShader>> shaders_;
+    std::unordered_map<Handle<GfxMaterial>, GfxMaterialDesc> materials_;
+    U32 nextBufferId_, nextTextureId_, nextShaderId_, nextMaterialId_;
+
+    Ref<GfxPipeline> pipeline_;
+    Resolution resolution_;
+    std::vector<size_t> vertexStrides_, instanceStrides_; ///< Per pass, from its `attribs`.
+
+    /// The state that would be bound on a real backend.
+    struct Bindings
+    {
+        U8 passId = 0;
+        Handle<GfxBuffer> vertexBuffer{U32(-1)}, indexBuffer{U32(-1)}, instanceBuffer{U32(-1)};
+        Handle<GfxTexture> textures[GfxMaterialDesc::MAX_TEXTURES] = {};
+    } curBindings_;
+
+    bool recording_;
+    std::vector<GfxCmd> lastFrameCmds_;
+    FrameStats curStats_, lastStats_, totalStats_;
+    size_t nFrames_;
+    std::vector<std::string> errors_;
+
+    /// Records an error message (if there is room for it) and counts it.
+    void error(const std::string& message);
+
+    /// Returns `true` if `cmd` is valid for the current pipeline and resources;
+    /// records errors for it otherwise.
+    bool validateCmd(const GfxCmd& cmd, U8 prevPassId);
+
+public:
+    /// Creates a new null backend; if `recording` is `true`, the commands run in
+    /// each frame are kept (see `lastFrameCmds()`).
+    Backend(bool recording=false);
+    ErrString init(Ref<GfxPipeline> pipeline) override;
+    ~Backend() override = default;
+
+    Handle<GfxBuffer> genBuffer(const GfxBufferDesc& desc) override;
+    void resizeBuffer(Handle<GfxBuffer> buffer, size_t newSize) override;
+    void editBuffer(Handle<GfxBuffer> buffer, size_t dataOffset, size_t dataSize, const void* data) override;
+    void delBuffer(Handle<GfxBuffer> buffer) override;
+
+    Handle<GfxTexture> genTexture(const GfxTextureDesc& desc) override;
+    void resizeTexture(Handle<GfxTexture> texture, Resolution newResolution, size_t newDepth) override;
+    void editTexture(Handle<GfxTexture> texture, ViewCube dataCube, const void* data) override;
+    void delTexture(Handle<GfxTexture> texture) override;
+
+    Handle<GfxShader> genShader(const GfxShaderDesc& desc, ErrString* err) override;
+    void delShader(Handle<GfxShader> shader) override;
+
+    Handle<GfxMaterial> genMaterial(const GfxMaterialDesc& desc) override;
+    void delMaterial(Handle<GfxMaterial> material) override;
+
+    void changeResolution(Resolution resolution) override;
+    void runCmds(const GfxCmdIndex* cmdsOrder, size_t n) override;
+
+
+    /// Enables or disables recording of the commands run in each frame.
+    inline void setRecording(bool recording)
+    {
+        recording_ = recording;
+    }
+
+    /// Returns the commands run in the last frame, in order (empty if not recording).
+    inline const std::vector<GfxCmd>& lastFrameCmds() const
+    {
+        return lastFrameCmds_;
+    }
+
+    /// Returns the statistics of the last frame.
+    inline const FrameStats& lastFrameStats() const
+    {
+        return lastStats_;
+    }
+
+    /// Returns the statistics summed over all frames so far.
+    inline const FrameStats& totalStats() const
+    {
+        return totalStats_;
+    }
+
+    /// Returns the number of frames (`runCmds()` calls) so far.
+    inline size_t nFrames() const
+    {
+        return nFrames_;
+    }
+
+    /// Returns the messages of the errors that happened so far (at most
+    /// `MAX_ERROR_MESSAGES`; see `FrameStats::nErrors` for the total count).
+    inline const std::vector<std::string>& errors() const
+    {
+        return errors_;
+    }
+
+    /// Clears `errors()`.
+    inline void clearErrors()
+    {
+        errors_.clear();
+    }
+
+    /// Returns the number of buffers, textures, shaders and materials currently alive.
+    inline size_t nBuffers() const
+    {
+        return buffers_.size();
+    }
+    inline size_t nTextures() const
+    {
+        return textures_.size();
+    }
+    inline size_t nShaders() const
+    {
+        return shaders_.size();
+    }
+    inline size_t nMaterials() const
+    {
+        return materials_.size();
+    }
+};
+
+}
+}
@@ -3,6 +3,7 @@
 #include <Core/Api.h>
 #include <glm/mat4x4.hpp>
 #include <glm/gtc/matrix_transform.hpp>
+#include <Core/Base/Frustum.hh>
 
 namespace Ares
 {
@@ -27,6 +28,13 @@ struct ARES_API PerspectiveCamera
     {
         return glm::perspectiveFov(fov, aspectRatio, 1.0f, zNear, zFar);
     }
+
+    /// Calculates the (world-space) view frustum of the camera given its
+    /// viewport's aspect ratio and its view matrix (the inverse of its transform).
+    inline Frustum frustum(float aspectRatio, const glm::mat4& view) const
+    {
+        return Frustum::fromMatrix(projectionMatrix(aspectRatio) * view);
+    }
 };
 
 }
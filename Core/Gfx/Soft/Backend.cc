@@ -0,0 +1,518 @@
+#include "Backend.hh"
+
+#include <string.h>
+#include <math.h>
+#include <algorithm>
+#include <sstream>
+#include <Core/Task/ParallelFor.hh>
+
+namespace Ares
+{
+namespace Soft
+{
+
+/// The number of vertices shaded per task by `runCmd()`.
+static constexpr const size_t VERTEX_CHUNK_SIZE = 4096;
+
+/// Returns the description of the screen color/depth texture.
+static GfxTextureDesc screenDesc(bool depth)
+{
+    using Ch = ImageFormat::Channel;
+
+    GfxTextureDesc desc;
+    desc.format = depth ? ImageFormat{Ch::F32Depth} : ImageFormat{Ch::UN8, Ch::UN8, Ch::UN8, Ch::UN8};
+    desc.usage = GfxUsage::Streaming;
+    return desc;
+}
+
+Backend::Backend(TaskScheduler* scheduler)
+    : scheduler_(scheduler),
+      nextBufferId_(1), nextTextureId_(1), nextShaderId_(1), nextMaterialId_(1),
+      resolution_{0, 0}, screen_(screenDesc(false)), screenDepth_(screenDesc(true)),
+      curPassId_(-1), rasterizer_(scheduler)
+{
+}
+
+static constexpr const size_t GFX_VERTEXATTRIB_TYPE_SIZE[] = // Index by `GfxPipeline::VertexAttrib::Type`
+{
+    sizeof(F32), // 0: F32
+    sizeof(I32), // 1: I32
+    sizeof(U32), // 2: U32
+};
+
+ErrString Backend::init(Ref<GfxPipeline> pipeline)
+{
+    // (Like for GL33, resources are *not* destroyed here)
+    size_t nPasses = pipeline->passes.size();
+    std::vector<PassData> passData(nPasses);
+
+    for(size_t i = 0; i < nPasses; i ++)
+    {
+        const GfxPipeline::Pass& pass = pipeline->passes[i];
+
+        std::ostringstream err;
+        err << "Pass " << i << ": ";
+
+        if(pass.nAttribs > GfxPipeline::Pass::MAX_ATTRIBS)
+        {
+            err << "Too many attribs (" << pass.nAttribs << ")";
+            return err.str();
+        }
+        // (Attributes are interleaved, with separate strides for the vertex
+        // and instance buffer - see `GL33::Backend::Vao`)
+        for(unsigned int j = 0; j < pass.nAttribs; j ++)
+        {
+            const auto& attrib = pass.attribs[j];
+            size_t& stride = attrib.instanceDivisor == 0 ? passData[i].vertexStride : passData[i].instanceStride;
+            passData[i].attribOffsets[j] = stride;
+            stride += GFX_VERTEXATTRIB_TYPE_SIZE[unsigned(attrib.type)] * attrib.n;
+        }
+
+        if(pass.nTargets == 0 || pass.nTargets > GfxPipeline::Pass::MAX_TARGETS)
+        {
+            err << "Invalid number of targets (" << pass.nTargets << ")";
+            return err.str();
+        }
+        if(pass.targets[0] != GfxPipeline::Pass::SCREEN_TARGET)
+        {
+            bool hasDepthTarget = false;
+            for(unsigned int j = 0; j < pass.nTargets; j ++)
+            {
+                Texture* target = findTexture(pass.targets[j]);
+                if(!target)
+                {
+                    err << "Nonexisting target texture " << pass.targets[j];
+                    return err.str();
+                }
+                if(target->desc().format.isDepth())
+                {
+                    if(hasDepthTarget)
+                    {
+                        err << "More than one depth target";
+                        return err.str();
+                    }
+                    hasDepthTarget = true;
+                }
+            }
+        }
+
+        if(shaders_.find(pass.shader) == shaders_.end())
+        {
+            err << "Nonexisting shader " << pass.shader;
+            return err.str();
+        }
+        if(pass.uniformBuffer && buffers_.find(pass.uniformBuffer) == buffers_.end())
+        {
+            err << "Nonexisting uniform buffer " << pass.uniformBuffer;
+            return err.str();
+        }
+    }
+
+    pipeline_ = pipeline;
+    passData_ = std::move(passData);
+    return {};
+}
+
+
+Handle<GfxBuffer> Backend::genBuffer(const GfxBufferDesc& desc)
+{
+    Handle<GfxBuffer> handle(nextBufferId_ ++);
+    std::vector<U8>& data = buffers_[handle];
+    data.resize(desc.size, 0);
+    if(desc.data)
+    {
+        memcpy(data.data(), desc.data, desc.size);
+    }
+    return handle;
+}
+
+void Backend::resizeBuffer(Handle<GfxBuffer> buffer, size_t newSize)
+{
+    auto it = buffers_.find(buffer);
+    if(it != buffers_.end())
+    {
+        it->second.resize(newSize, 0);
+    }
+}
+
+void Backend::editBuffer(Handle<GfxBuffer> buffer, size_t dataOffset, size_t dataSize, const void* data)
+{
+    auto it = buffers_.find(buffer);
+    if(it == buffers_.end() || !data || it->second.size() < dataOffset + dataSize)
+    {
+        return;
+    }
+    memcpy(it->second.data() + dataOffset, data, dataSize);
+}
+
+void Backend::delBuffer(Handle<GfxBuffer> buffer)
+{
+    buffers_.erase(buffer);
+}
+
+
+Texture* Backend::findTexture(Handle<GfxTexture> handle) const
+{
+    auto it = textures_.find(handle);
+    return it != textures_.end() ? it->second.get() : nullptr;
+}
+
+Handle<GfxTexture> Backend::genTexture(const GfxTextureDesc& desc)
+{
+    if(desc.format.nChannelsSet() == 0)
+    {
+        return {};
+    }
+
+    Handle<GfxTexture> handle(nextTextureId_ ++);
+    textures_[handle].reset(new Texture(desc));
+    return handle;
+}
+
+void Backend::resizeTexture(Handle<GfxTexture> texture, Resolution newResolution, size_t newDepth)
+{
+    Texture* tex = findTexture(texture);
+    if(tex)
+    {
+        tex->resize(newResolution, newDepth);
+    }
+}
+
+void Backend::editTexture(Handle<GfxTexture> texture, ViewCube dataCube, const void* data)
+{
+    Texture* tex = findTexture(texture);
+    if(tex && data)
+    {
+        (void)tex->edit(dataCube, data);
+    }
+}
+
+void Backend::delTexture(Handle<GfxTexture> texture)
+{
+    textures_.erase(texture);
+}
+
+
+Handle<GfxShader> Backend::genShader(const GfxShaderDesc& desc, ErrString* err)
+{
+    if(!desc.src)
+    {
+        if(err)
+        {
+            *err = "Shader source missing";
+        }
+        return {};
+    }
+
+    Handle<GfxShader> handle(nextShaderId_ ++);
+    shaders_[handle] = Program();
+    return handle;
+}
+
+void Backend::delShader(Handle<GfxShader> shader)
+{
+    shaders_.erase(shader);
+}
+
+Handle<GfxMaterial> Backend::genMaterial(const GfxMaterialDesc& desc)
+{
+    if(desc.nTextures > GfxMaterialDesc::MAX_TEXTURES)
+    {
+        return {};
+    }
+
+    Handle<GfxMaterial> handle(nextMaterialId_ ++);
+    materials_[handle] = desc;
+    return handle;
+}
+
+void Backend::delMaterial(Handle<GfxMaterial> material)
+{
+    materials_.erase(material);
+}
+
+bool Backend::setProgram(Handle<GfxShader> shader, const Program& program)
+{
+    auto it = shaders_.find(shader);
+    if(it == shaders_.end() || !program)
+    {
+        return false;
+    }
+    it->second = program;
+    return true;
+}
+
+
+void Backend::changeResolution(Resolution resolution)
+{
+    resolution_ = resolution;
+    screen_.resize(resolution, 1);
+    screenDepth_.resize(resolution, 1);
+}
+
+void Backend::beginPass(U8 passId)
+{
+    const GfxPipeline::Pass& pass = pipeline_->passes[passId];
+
+    Texture* colorTargets[GfxPipeline::Pass::MAX_TARGETS] = {};
+    unsigned int nColorTargets = 0;
+    Texture* depthTarget = nullptr;
+    if(pass.targets[0] == GfxPipeline::Pass::SCREEN_TARGET)
+    {
+        colorTargets[nColorTargets ++] = &screen_;
+        depthTarget = &screenDepth_;
+    }
+    else
+    {
+        for(unsigned int i = 0; i < pass.nTargets; i ++)
+        {
+            Texture* target = findTexture(pass.targets[i]);
+            if(!target)
+            {
+                // (Deleted after `init()`)
+                continue;
+            }
+
+            if(target->desc().format.isDepth())
+            {
+                depthTarget = target;
+            }
+            else
+            {
+                colorTargets[nColorTargets ++] = target;
+            }
+        }
+    }
+
+    // Render at the current resolution, but never out of any target
+    Resolution viewport = resolution_;
+    for(unsigned int i = 0; i < nColorTargets; i ++)
+    {
+        viewport.width = std::min(viewport.width, colorTargets[i]->resolution().width);
+        viewport.height = std::min(viewport.height, colorTargets[i]->resolution().height);
+    }
+    if(depthTarget)
+    {
+        viewport.width = std::min(viewport.width, depthTarget->resolution().width);
+        viewport.height = std::min(viewport.height, depthTarget->resolution().height);
+    }
+
+    // (Flushes the previous pass' triangles before its targets are cleared)
+    rasterizer_.setTargets(viewport, colorTargets, nColorTargets, depthTarget, pass.depthTestEnabled);
+
+    if(pass.clearTargets)
+    {
+        // Like `glClear()` with OpenGL's default clear values
+        for(unsigned int i = 0; i < nColorTargets; i ++)
+        {
+            colorTargets[i]->clear(glm::vec4(0.0f, 0.0f, 0.0f, 0.0f));
+        }
+        if(depthTarget)
+        {
+            depthTarget->clear(glm::vec4(1.0f, 1.0f, 1.0f, 1.0f));
+        }
+    }
+
+    curPassId_ = passId;
+}
+
+void Backend::runCmd(const GfxCmd& cmd)
+{
+    const GfxPipeline::Pass& pass = pipeline_->passes[cmd.passId];
+    const PassData& passData = passData_[cmd.passId];
+
+    auto shaderIt = shaders_.find(pass.shader);
+    if(shaderIt == shaders_.end() || !shaderIt->second || cmd.n < 3)
+    {
+        return;
+    }
+    const Program& program = shaderIt->second;
+
+    bool indexed = cmd.op == GfxCmd::DrawIndexed || cmd.op == GfxCmd::DrawIndexedInstanced;
+    bool instanced = cmd.op == GfxCmd::DrawInstanced || cmd.op == GfxCmd::DrawIndexedInstanced;
+    size_t nInstances = instanced ? cmd.nInstances : 1;
+    if(nInstances == 0)
+    {
+        return;
+    }
+
+    auto findBuffer = [this](Handle<GfxBuffer> handle) -> const std::vector<U8>*
+    {
+        auto it = buffers_.find(handle);
+        return it != buffers_.end() ? &it->second : nullptr;
+    };
+
+    // Find the range of vertices used by the command
+    const U32* indices = nullptr;
+    size_t minVertex, maxVertex;
+    if(indexed)
+    {
+        const std::vector<U8>* indexBuffer = findBuffer(cmd.indexBuffer);
+        if(!indexBuffer || (cmd.first + cmd.n) * sizeof(U32) > indexBuffer->size())
+        {
+            return;
+        }
+        indices = reinterpret_cast<const U32*>(indexBuffer->data()) + cmd.first;
+
+        auto minMax = std::minmax_element(indices, indices + cmd.n);
+        minVertex = *minMax.first;
+        maxVertex = *minMax.second;
+    }
+    else
+    {
+        minVertex = cmd.first;
+        maxVertex = cmd.first + cmd.n - 1;
+    }
+
+    // Check that the vertex and instance data is all there
+    const U8* vertexData = nullptr;
+    if(passData.vertexStride > 0)
+    {
+        const std::vector<U8>* vertexBuffer = findBuffer(cmd.vertexBuffer);
+        if(!vertexBuffer || (maxVertex + 1) * passData.vertexStride > vertexBuffer->size())
+        {
+            return;
+        }
+        vertexData = vertexBuffer->data();
+    }
+
+    const U8* instanceData = nullptr;
+    if(passData.instanceStride > 0)
+    {
+        unsigned int minDivisor = ~0U;
+        for(unsigned int i = 0; i < pass.nAttribs; i ++)
+        {
+            if(pass.attribs[i].instanceDivisor > 0)
+            {
+                minDivisor = std::min(minDivisor, pass.attribs[i].instanceDivisor);
+            }
+        }
+        size_t nInstanceRows = (nInstances - 1) / minDivisor + 1;
+        size_t firstInstance = instanced ? cmd.firstInstance : 0;
+
+        const std::vector<U8>* instanceBuffer = findBuffer(cmd.instanceBuffer);
+        if(!instanceBuffer
+           || (firstInstance + nInstanceRows) * passData.instanceStride > instanceBuffer->size())
+        {
+            return;
+        }
+        instanceData = instanceBuffer->data() + firstInstance * passData.instanceStride;
+    }
+
+    DrawState draw;
+    draw.program = &program;
+    auto materialIt = materials_.find(cmd.material);
+    if(materialIt != materials_.end())
+    {
+        const GfxMaterialDesc& material = materialIt->second;
+        draw.nTextures = material.nTextures;
+        for(unsigned int i = 0; i < draw.nTextures; i ++)
+        {
+            draw.textures[i] = findTexture(material.textures[i]);
+        }
+    }
+    const std::vector<U8>* uniformBuffer = pass.uniformBuffer ? findBuffer(pass.uniformBuffer) : nullptr;
+    draw.uniforms = uniformBuffer ? uniformBuffer->data() : nullptr;
+    U32 drawIndex = rasterizer_.addDraw(draw);
+
+    // Run the vertex stage for each vertex of each instance, in parallel
+    const size_t nVertices = maxVertex - minVertex + 1;
+    const size_t nTotalVertices = nVertices * nInstances;
+    vertexOutputs_.resize(nTotalVertices);
+
+    auto vertexFunc = [&](size_t begin, size_t end)
+    {
+        VertexInput in;
+        in.uniforms = draw.uniforms;
+        for(size_t i = begin; i < end; i ++)
+        {
+            size_t instance = i / nVertices, vertex = minVertex + i % nVertices;
+            in.vertexId = U32(vertex);
+            in.instanceId = U32(instance);
+            for(unsigned int j = 0; j < pass.nAttribs; j ++)
+            {
+                unsigned int divisor = pass.attribs[j].instanceDivisor;
+                in.attribs[j] = divisor == 0
+                                ? vertexData + vertex * passData.vertexStride + passData.attribOffsets[j]
+                                : instanceData + (instance / divisor) * passData.instanceStride
+                                  + passData.attribOffsets[j];
+            }
+            program.vertex(in, vertexOutputs_[i]);
+        }
+    };
+    if(scheduler_ && nTotalVertices > VERTEX_CHUNK_SIZE)
+    {
+        parallelFor(*scheduler_, nTotalVertices, VERTEX_CHUNK_SIZE, vertexFunc);
+    }
+    else
+    {
+        vertexFunc(0, nTotalVertices);
+    }
+
+    // Assemble triangles (like `GL_TRIANGLES`) and draw them
+    for(size_t instance = 0; instance < nInstances; instance ++)
+    {
+        const VertexOutput* outputs = &vertexOutputs_[instance * nVertices]; // (`outputs[0]` is `minVertex`)
+        for(size_t i = 0; i + 3 <= cmd.n; i += 3)
+        {
+            if(indexed)
+            {
+                rasterizer_.drawTriangle(outputs[indices[i] - minVertex],
+                                         outputs[indices[i + 1] - minVertex],
+                                         outputs[indices[i + 2] - minVertex],
+                                         drawIndex);
+            }
+            else
+            {
+                rasterizer_.drawTriangle(outputs[i], outputs[i + 1], outputs[i + 2], drawIndex);
+            }
+        }
+    }
+}
+
+void Backend::runCmds(const GfxCmdIndex* cmdsOrder, size_t n)
+{
+    rasterizer_.resetStats();
+    if(!pipeline_)
+    {
+        return;
+    }
+
+    curPassId_ = -1;
+    for(size_t i = 0; i < n; i ++)
+    {
+        const GfxCmd& cmd = *cmdsOrder[i].cmd;
+        if(cmd.passId >= pipeline_->passes.size())
+        {
+            continue;
+        }
+
+        // The sorting key specifies all cmds for a specific pass to be run in sequence
+        if(int(cmd.passId) != curPassId_)
+        {
+            beginPass(cmd.passId);
+        }
+        runCmd(cmd);
+    }
+
+    rasterizer_.finish();
+}
+
+void Backend::readScreen(std::vector<U8>& outPixels) const
+{
+    const size_t width = resolution_.width, height = resolution_.height;
+    outPixels.resize(width * height * 4);
+
+    U8* dest = outPixels.data();
+    for(size_t y = height; y > 0; y --) // (Bottom row is row 0)
+    {
+        const float* src = screen_.texel(0, y - 1);
+        for(size_t i = 0; i < width * 4; i ++)
+        {
+            *(dest ++) = U8(std::min(std::max(src[i], 0.0f), 1.0f) * 255.0f + 0.5f);
+        }
+    }
+}
+
+}
+}
@@ -0,0 +1,124 @@
+#pragma once
+
+#include <stddef.h>
+#include <memory>
+#include <vector>
+#include <unordered_map>
+#include <Core/Task/TaskScheduler.hh>
+#include <Core/Gfx/GfxBackend.hh>
+#include <Core/Gfx/Soft/Program.hh>
+#include <Core/Gfx/Soft/Texture.hh>
+#include <Core/Gfx/Soft/Rasterizer.hh>
+
+namespace Ares
+{
+namespace Soft
+{
+
+/// A rendering backend that renders on the CPU, into textures in memory; for
+/// rendering without a GPU (thumbnailing, visual regression tests) and as a
+/// reference to check the output of the other backends against.
+///
+/// Draws are run by a `Rasterizer`, with tiles rasterized in parallel on the
+/// `TaskScheduler` given on construction. Passes, targets, depth testing,
+/// vertex/instance attributes and all `GfxCmd::Op`s work like in `GL33::Backend`;
+/// the screen target is a RGBA texture of the current resolution (see `screen()`).
+///
+/// GLSL shaders can not be run on the CPU: each `GfxShader` must be given the
+/// equivalent `Program` via `setProgram()` (see `Programs.hh` for the ones of
+/// the engine's shaders). Commands of passes whose shader has none are skipped.
+class Backend : public Ares::GfxBackend
+{
+    TaskScheduler* scheduler_;
+
+    std::unordered_map<Handle<GfxBuffer>, std::vector<U8>> buffers_;
+    std::unordered_map<Handle<GfxTexture>, std::unique_ptr<Texture>> textures_;
+    std::unordered_map<Handle<GfxShader>, Program> shaders_; ///< (With a null `Program` until `setProgram()`)
+    std::unordered_map<Handle<GfxMaterial>, GfxMaterialDesc> materials_;
+    U32 nextBufferId_, nextTextureId_, nextShaderId_, nextMaterialId_;
+
+    Ref<GfxPipeline> pipeline_;
+    Resolution resolution_;
+    Texture screen_, screenDepth_; ///< The screen target and its depth buffer.
+
+    /// Per-pass data computed on `init()`.
+    struct PassData
+    {
+        size_t vertexStride = 0, instanceStride = 0;
+        size_t attribOffsets[GfxPipeline::Pass::MAX_ATTRIBS] = {};
+    };
+    std::vector<PassData> passData_;
+    int curPassId_; ///< -1 before the first pass of a frame is begun.
+
+    Rasterizer rasterizer_;
+    std::vector<VertexOutput> vertexOutputs_; ///< (Reused by `runCmd()`)
+
+    /// Returns the texture for `handle`, or null if there is none.
+    Texture* findTexture(Handle<GfxTexture> handle) const;
+
+    /// Sets up the rasterizer to draw to the targets of the given pass, clearing
+    /// them first if the pass requires it.
+    void beginPass(U8 passId);
+
+    /// Shades the vertices of `cmd` and draws its triangles; skips the command
+    /// if any of the data it requires is missing or out of bounds.
+    void runCmd(const GfxCmd& cmd);
+
+public:
+    /// Creates a new software backend that will run tasks on `scheduler`, or
+    /// render on the calling thread only if it is null.
+    Backend(TaskScheduler* scheduler=nullptr);
+    ErrString init(Ref<GfxPipeline> pipeline) override;
+    ~Backend() override = default;
+
+    Handle<GfxBuffer> genBuffer(const GfxBufferDesc& desc) override;
+    void resizeBuffer(Handle<GfxBuffer> buffer, size_t newSize) override;
+    void editBuffer(Handle<GfxBuffer> buffer, size_t dataOffset, size_t dataSize, const void* data) override;
+    void delBuffer(Handle<GfxBuffer> buffer) override;
+
+    Handle<GfxTexture> genTexture(const GfxTextureDesc& desc) override;
+    void resizeTexture(Handle<GfxTexture> texture, Resolution newResolution, size_t newDepth) override;
+    void editTexture(Handle<GfxTexture> texture, ViewCube dataCube, const void* data) override;
+    void delTexture(Handle<GfxTexture> texture) override;
+
+    /// Accepts any shader with a source (which is not compiled); see `setProgram()`.
+    Handle<GfxShader> genShader(const GfxShaderDesc& desc, ErrString* err) override;
+    void delShader(Handle<GfxShader> shader) override;
+
+    Handle<GfxMaterial> genMaterial(const GfxMaterialDesc& desc) override;
+    void delMaterial(Handle<GfxMaterial> material) override;
+
+    void changeResolution(Resolution resolution) override;
+    void runCmds(const GfxCmdIndex* cmdsOrder, size_t n) override;
+
+
+    /// Sets the program run on the CPU in place of `shader`.
+    /// Returns `false` if `shader` does not exist or `program` is invalid.
+    bool setProgram(Handle<GfxShader> shader, const Program& program);
+
+    /// Returns the contents of a texture, or null if it does not exist.
+    inline const Texture* texture(Handle<GfxTexture> handle) const
+    {
+        return findTexture(handle);
+    }
+
+    /// Returns the screen target (RGBA, normalized) as rendered by the last
+    /// `runCmds()`. Its size is the last resolution set via `changeResolution()`.
+    inline const Texture& screen() const
+    {
+        return screen_;
+    }
+
+    /// Converts the screen to 8 bits per channel RGBA pixels in `outPixels`,
+    /// top row first (i.e. flipped vertically, as for image files).
+    void readScreen(std::vector<U8>& outPixels) const;
+
+    /// Returns the rasterizer's statistics for the last `runCmds()`.
+    inline const Rasterizer::Stats& lastFrameStats() const
+    {
+        return rasterizer_.stats();
+    }
+};
+
+}
+}
@@ -0,0 +1,111 @@
+#pragma once
+
+#include <stddef.h>
+#include <string.h>
+#include <glm/vec2.hpp>
+#include <glm/vec3.hpp>
+#include <glm/vec4.hpp>
+#include <Core/Base/NumTypes.hh>
+#include <Core/Gfx/GfxCmd.hh>
+#include <Core/Gfx/GfxPipeline.hh>
+
+namespace Ares
+{
+namespace Soft
+{
+
+class Texture; // (#include <Core/Gfx/Soft/Texture.hh>)
+
+/// The maximum number of floats a `Program`'s vertex stage can pass to its
+/// fragment stage.
+static constexpr const unsigned int MAX_VARYINGS = 16;
+
+
+/// The inputs of a `Program`'s vertex stage, for a single vertex.
+struct VertexInput
+{
+    /// Points to the data of each of the pass' `GfxPipeline::Attrib`s for this
+    /// vertex (or its instance, for per-instance attributes), as stored in the
+    /// vertex/instance buffer - see `attrib()`.
+    const U8* attribs[GfxPipeline::Pass::MAX_ATTRIBS];
+
+    U32 vertexId; ///< The index of the vertex (like `gl_VertexID`).
+    U32 instanceId; ///< The index of the instance (like `gl_InstanceID`).
+
+    /// The data of the pass' uniform buffer (or null if it has none).
+    const U8* uniforms;
+
+    /// Returns the value of the `i`th attribute, reading it as a `T`.
+    /// **WARNING**: `T` must match the attribute's type and size!
+    template <typename T>
+    inline T attrib(unsigned int i) const
+    {
+        T value;
+        memcpy(&value, attribs[i], sizeof(T));
+        return value;
+    }
+};
+
+/// The outputs of a `Program`'s vertex stage, for a single vertex.
+struct VertexOutput
+{
+    glm::vec4 position; ///< In clip space (like `gl_Position`).
+    float varyings[MAX_VARYINGS]; ///< Interpolated over triangles for the fragment stage.
+};
+
+/// The inputs of a `Program`'s fragment stage, for a single pixel.
+struct FragmentInput
+{
+    /// The window coordinates (pixel center) and depth of the fragment, and
+    /// `1 / w` (like `gl_FragCoord`).
+    glm::vec4 fragCoord;
+
+    /// The `VertexOutput::varyings`, perspective-correctly interpolated.
+    const float* varyings;
+
+    /// The textures bound for the command being drawn (see `GfxCmd::textures`);
+    /// null for null handles.
+    const Texture* const* textures;
+    unsigned int nTextures;
+
+    /// The data of the pass' uniform buffer (or null if it has none).
+    const U8* uniforms;
+};
+
+/// The outputs of a `Program`'s fragment stage, for a single pixel.
+struct FragmentOutput
+{
+    /// The values to write to each of the pass' targets.
+    glm::vec4 colors[GfxPipeline::Pass::MAX_TARGETS];
+};
+
+
+/// A shader program for the software rasterizer, i.e. the equivalent of a
+/// `GfxShader`'s GLSL code for `Soft::Backend`.
+///
+/// Both stages are run concurrently from multiple threads, so they must be
+/// threadsafe (ideally, pure functions of their inputs).
+struct Program
+{
+    /// The number of `VertexOutput::varyings` actually written by `vertex`.
+    unsigned int nVaryings = 0;
+
+    /// The number of `FragmentOutput::colors` actually written by `fragment`;
+    /// targets after these are left untouched.
+    unsigned int nOutputs = 1;
+
+    /// The vertex stage; must be set.
+    void (*vertex)(const VertexInput& in, VertexOutput& out) = nullptr;
+
+    /// The fragment stage; must be set.
+    void (*fragment)(const FragmentInput& in, FragmentOutput& out) = nullptr;
+
+    /// Returns `true` if both stages are set.
+    inline operator bool() const
+    {
+        return vertex && fragment && nVaryings <= MAX_VARYINGS;
+    }
+};
+
+}
+}
@@ -0,0 +1,80 @@
+#include "Programs.hh"
+
+#include <string.h>
+#include <algorithm>
+#include <glm/mat4x4.hpp>
+#include <glm/geometric.hpp>
+#include <Core/Gfx/Soft/Texture.hh>
+
+namespace Ares
+{
+namespace Soft
+{
+
+// === PBR.arsh ===
+
+static void pbrVertex(const VertexInput& in, VertexOutput& out)
+{
+    glm::mat4 viewProjection;
+    memcpy(&viewProjection, in.uniforms, sizeof(viewProjection)); // (`u_ViewProjection`)
+
+    // (`vi_i_Model` is uploaded as 4 per-instance vec4s, i.e. its columns)
+    glm::mat4 model(in.attrib<glm::vec4>(6), in.attrib<glm::vec4>(7),
+                    in.attrib<glm::vec4>(8), in.attrib<glm::vec4>(9));
+
+    glm::vec3 position = in.attrib<glm::vec3>(0);
+    out.position = viewProjection * model * glm::vec4(position, 1.0f);
+
+    // vo_Normal = [0..2], vo_Color0 = [3..6]
+    glm::vec3 normal = in.attrib<glm::vec3>(1);
+    glm::vec4 color0 = in.attrib<glm::vec4>(5);
+    memcpy(&out.varyings[0], &normal, sizeof(normal));
+    memcpy(&out.varyings[3], &color0, sizeof(color0));
+}
+
+static void pbrFragment(const FragmentInput& in, FragmentOutput& out)
+{
+    glm::vec3 normal(in.varyings[0], in.varyings[1], in.varyings[2]);
+    glm::vec4 color0(in.varyings[3], in.varyings[4], in.varyings[5], in.varyings[6]);
+
+    // Test directional light
+    const glm::vec3 sunDir = glm::normalize(glm::vec3(1.0f, 1.0f, 1.0f));
+    float sunFac = std::min(std::max(glm::dot(normal, sunDir), 0.1f), 1.0f);
+
+    out.colors[0] = glm::vec4(color0.x * sunFac, color0.y * sunFac, color0.z * sunFac, color0.w);
+}
+
+const Program PBR_PROGRAM = {7, 1, pbrVertex, pbrFragment};
+
+
+// === Postprocess.arsh ===
+
+static void postprocessVertex(const VertexInput& in, VertexOutput& out)
+{
+    // vo_UV = [0..1]
+    float u = float((in.vertexId & 1) << 2) * 0.5f;
+    float v = float((in.vertexId & 2) << 1) * 0.5f;
+    out.position = glm::vec4(u * 2.0f - 1.0f, v * 2.0f - 1.0f, 0.0f, 1.0f);
+    out.varyings[0] = u;
+    out.varyings[1] = v;
+}
+
+static void postprocessFragment(const FragmentInput& in, FragmentOutput& out)
+{
+    // Simplified Reinhard tonemapping (without taking luminance into account)
+    glm::vec4 hdrColor(0.0f, 0.0f, 0.0f, 1.0f);
+    if(in.nTextures > 0 && in.textures[0])
+    {
+        hdrColor = in.textures[0]->sample(glm::vec2(in.varyings[0], in.varyings[1]));
+    }
+
+    out.colors[0] = glm::vec4(hdrColor.x / (hdrColor.x + 1.0f),
+                              hdrColor.y / (hdrColor.y + 1.0f),
+                              hdrColor.z / (hdrColor.z + 1.0f),
+                              hdrColor.w);
+}
+
+const Program POSTPROCESS_PROGRAM = {2, 1, postprocessVertex, postprocessFragment};
+
+}
+}
@@ -0,0 +1,23 @@
+#pragma once
+
+#include <Core/Gfx/Soft/Program.hh>
+
+namespace Ares
+{
+namespace Soft
+{
+
+// CPU ports of the engine's shaders in `Resources/Gfx/`, for `Soft::Backend::setProgram()`.
+// **WARNING**: Keep these in sync with the GLSL code!
+
+/// Port of `Gfx/PBR.arsh`.
+/// Inputs match `GfxModule`'s PBR pass attributes (`Mesh::Vertex`'s + a per-instance
+/// model matrix); the uniforms are a single view-projection `glm::mat4`.
+extern const Program PBR_PROGRAM;
+
+/// Port of `Gfx/Postprocess.arsh`.
+/// Draws a fullscreen triangle (3 vertices, no attributes) tonemapping `textures[0]`.
+extern const Program POSTPROCESS_PROGRAM;
+
+}
+}
@@ -0,0 +1,515 @@
+#include "Rasterizer.hh"
+
+#include <math.h>
+#include <algorithm>
+#include <Core/Task/ParallelFor.hh>
+
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#   define ARES_SOFT_RASTERIZER_SSE 1
+#   include <emmintrin.h>
+#endif
+
+namespace Ares
+{
+namespace Soft
+{
+
+constexpr const int Rasterizer::TILE_SIZE;
+constexpr const size_t Rasterizer::MAX_BATCH_TRIANGLES;
+
+/// Vertex positions are snapped to 1/`SUBPIXEL_STEPS` of a pixel in window
+/// coordinates and edge functions are evaluated exactly in 64-bit fixed point
+/// (see `Triangle`), so that the edges shared by adjacent triangles match exactly.
+static constexpr const I64 SUBPIXEL_STEPS = 256;
+
+/// Triangles are clipped so that their window coordinates stay within
+/// `[-GUARD_BAND, GUARD_BAND]` pixels; this bounds the fixed point edge
+/// functions well within 64 bits (`|E| < 6 * (2 * GUARD_BAND * SUBPIXEL_STEPS)^2 < 2^63`).
+static constexpr const double GUARD_BAND = double(1 << 20);
+
+Rasterizer::Rasterizer(TaskScheduler* scheduler)
+    : scheduler_(scheduler), viewport_{0, 0}, colorTargets_{}, nColorTargets_(0),
+      depthTarget_(nullptr), depthTest_(false), nTilesX_(0), nTilesY_(0)
+{
+}
+
+void Rasterizer::setTargets(Resolution viewport,
+                            Texture* const* colorTargets, unsigned int nColorTargets,
+                            Texture* depthTarget, bool depthTest)
+{
+    flush();
+
+    viewport_ = viewport;
+    nColorTargets_ = std::min(nColorTargets, GfxPipeline::Pass::MAX_TARGETS);
+    std::copy(colorTargets, colorTargets + nColorTargets_, colorTargets_);
+    depthTarget_ = depthTarget;
+    depthTest_ = depthTest && depthTarget;
+
+    nTilesX_ = int((viewport.width + TILE_SIZE - 1) / TILE_SIZE);
+    nTilesY_ = int((viewport.height + TILE_SIZE - 1) / TILE_SIZE);
+    bins_.resize(size_t(nTilesX_) * size_t(nTilesY_));
+}
+
+U32 Rasterizer::addDraw(const DrawState& draw)
+{
+    draws_.push_back(draw);
+    return U32(draws_.size() - 1);
+}
+
+
+// Outcodes for `clipTriangle()`'s trivial rejection, one bit per clip plane
+static constexpr const unsigned int CLIP_LEFT = 1 << 0, CLIP_RIGHT = 1 << 1;
+static constexpr const unsigned int CLIP_BOTTOM = 1 << 2, CLIP_TOP = 1 << 3;
+static constexpr const unsigned int CLIP_NEAR = 1 << 4, CLIP_FAR = 1 << 5;
+
+static inline unsigned int clipCode(const glm::vec4& p)
+{
+    return (p.x < -p.w ? CLIP_LEFT : 0) | (p.x > p.w ? CLIP_RIGHT : 0)
+           | (p.y < -p.w ? CLIP_BOTTOM : 0) | (p.y > p.w ? CLIP_TOP : 0)
+           | (p.z < -p.w ? CLIP_NEAR : 0) | (p.z > p.w ? CLIP_FAR : 0);
+}
+
+void Rasterizer::drawTriangle(const VertexOutput& v0, const VertexOutput& v1, const VertexOutput& v2, U32 draw)
+{
+    stats_.nTriangles ++;
+    clipTriangle(v0, v1, v2, draw);
+}
+
+void Rasterizer::clipTriangle(const VertexOutput& v0, const VertexOutput& v1, const VertexOutput& v2, U32 draw)
+{
+    unsigned int c0 = clipCode(v0.position), c1 = clipCode(v1.position), c2 = clipCode(v2.position);
+    if(c0 & c1 & c2)
+    {
+        // All vertices outside of the same clip plane
+        return;
+    }
+
+    // Only the near plane and the guard band (`|x|, |y| <= guard * w`, far
+    // outside of the viewport) are clipped against; triangles going out of the
+    // other planes are clamped to the viewport when set up (and fragments
+    // past the far plane are discarded when rasterizing)
+    const float guardX = float(GUARD_BAND / double(std::max(viewport_.width, size_t(1))));
+    const float guardY = float(GUARD_BAND / double(std::max(viewport_.height, size_t(1))));
+    auto planeDist = [guardX, guardY](const glm::vec4& p, unsigned int plane)
+    {
+        switch(plane)
+        {
+        case 0: return p.z + p.w; // (Near)
+        case 1: return p.x + guardX * p.w; // (Left guard band)
+        case 2: return guardX * p.w - p.x; // (Right guard band)
+        case 3: return p.y + guardY * p.w; // (Bottom guard band)
+        default: return guardY * p.w - p.y; // (Top guard band)
+        }
+    };
+    static constexpr const unsigned int N_CLIP_PLANES = 5;
+
+    const VertexOutput* in[3] = {&v0, &v1, &v2};
+    unsigned int clipPlanes = 0; // (Bit `i` set if plane `i` needs to be clipped against)
+    for(unsigned int plane = 0; plane < N_CLIP_PLANES; plane ++)
+    {
+        for(unsigned int i = 0; i < 3; i ++)
+        {
+            if(planeDist(in[i]->position, plane) < 0.0f)
+            {
+                clipPlanes |= 1U << plane;
+            }
+        }
+    }
+    if(!clipPlanes)
+    {
+        setupTriangle(in, draw);
+        return;
+    }
+
+    // Clip the triangle against each plane in turn (Sutherland-Hodgman), getting
+    // a convex polygon of up to 3 + `N_CLIP_PLANES` vertices to triangulate as a fan
+    const unsigned int nVaryings = draws_[draw].program->nVaryings;
+    VertexOutput polygons[2][3 + N_CLIP_PLANES];
+    VertexOutput* polygon = polygons[0];
+    unsigned int nPolygon = 3;
+    for(unsigned int i = 0; i < 3; i ++)
+    {
+        polygon[i] = *in[i];
+    }
+
+    for(unsigned int plane = 0; plane < N_CLIP_PLANES && nPolygon >= 3; plane ++)
+    {
+        if(!(clipPlanes & (1U << plane)))
+        {
+            continue;
+        }
+
+        VertexOutput* clippedPolygon = (polygon == polygons[0]) ? polygons[1] : polygons[0];
+        unsigned int nClipped = 0;
+        for(unsigned int i = 0; i < nPolygon; i ++)
+        {
+            const VertexOutput& cur = polygon[i];
+            const VertexOutput& next = polygon[(i + 1) % nPolygon];
+            float curDist = planeDist(cur.position, plane), nextDist = planeDist(next.position, plane);
+
+            if(curDist >= 0.0f)
+            {
+                clippedPolygon[nClipped ++] = cur;
+            }
+            if((curDist >= 0.0f) != (nextDist >= 0.0f))
+            {
+                float t = curDist / (curDist - nextDist);
+                VertexOutput& clipped = clippedPolygon[nClipped ++];
+                for(unsigned int j = 0; j < 4; j ++)
+                {
+                    clipped.position[j] = cur.position[j] + (next.position[j] - cur.position[j]) * t;
+                }
+                for(unsigned int j = 0; j < nVaryings; j ++)
+                {
+                    clipped.varyings[j] = cur.varyings[j] + (next.varyings[j] - cur.varyings[j]) * t;
+                }
+            }
+        }
+        polygon = clippedPolygon;
+        nPolygon = nClipped;
+    }
+
+    for(unsigned int i = 1; i + 1 < nPolygon; i ++)
+    {
+        const VertexOutput* fan[3] = {&polygon[0], &polygon[i], &polygon[i + 1]};
+        setupTriangle(fan, draw);
+    }
+}
+
+void Rasterizer::setupTriangle(const VertexOutput* vertices[3], U32 draw)
+{
+    Triangle tri;
+    double x[3], y[3];
+    I64 fx[3], fy[3]; // (`x`, `y` in fixed point)
+    for(unsigned int i = 0; i < 3; i ++)
+    {
+        const glm::vec4& pos = vertices[i]->position;
+        if(pos.w <= 0.0f)
+        {
+            // (Only possible with odd projections after near clipping)
+            return;
+        }
+
+        // Perspective divide and viewport transform; like OpenGL, window Y points up
+        // and pixel centers are at `(i + 0.5, j + 0.5)`
+        float invW = 1.0f / pos.w;
+        double ndcX = double(pos.x * invW), ndcY = double(pos.y * invW);
+        x[i] = (ndcX * 0.5 + 0.5) * double(viewport_.width);
+        y[i] = (ndcY * 0.5 + 0.5) * double(viewport_.height);
+        if(!(fabs(x[i]) <= 2.0 * GUARD_BAND && fabs(y[i]) <= 2.0 * GUARD_BAND))
+        {
+            // (Only possible with float error in guard band clipping, or NaNs)
+            return;
+        }
+        fx[i] = I64(floor(x[i] * double(SUBPIXEL_STEPS) + 0.5));
+        fy[i] = I64(floor(y[i] * double(SUBPIXEL_STEPS) + 0.5));
+        x[i] = double(fx[i]) / double(SUBPIXEL_STEPS);
+        y[i] = double(fy[i]) / double(SUBPIXEL_STEPS);
+
+        tri.z[i] = pos.z * invW * 0.5f + 0.5f;
+        tri.invW[i] = invW;
+    }
+
+    // Make the triangle counter-clockwise (there is no face culling, like
+    // OpenGL's default), remembering where each vertex went for the varyings
+    unsigned int order[3] = {0, 1, 2};
+    I64 area2 = (fx[1] - fx[0]) * (fy[2] - fy[0]) - (fy[1] - fy[0]) * (fx[2] - fx[0]);
+    if(area2 == 0)
+    {
+        // Degenerate
+        return;
+    }
+    if(area2 < 0)
+    {
+        std::swap(x[1], x[2]);
+        std::swap(y[1], y[2]);
+        std::swap(fx[1], fx[2]);
+        std::swap(fy[1], fy[2]);
+        std::swap(tri.z[1], tri.z[2]);
+        std::swap(tri.invW[1], tri.invW[2]);
+        std::swap(order[1], order[2]);
+        area2 = -area2;
+    }
+    tri.invArea2 = float(1.0 / double(area2));
+
+    // Edge `i` goes from vertex `i + 1` to vertex `i + 2`: `E[i](p)` is the
+    // doubled area of `(v[i + 1], v[i + 2], p)`, i.e. `E[i](v[i]) == area2`
+    for(unsigned int i = 0; i < 3; i ++)
+    {
+        unsigned int from = (i + 1) % 3, to = (i + 2) % 3;
+        I64 dx = fx[to] - fx[from], dy = fy[to] - fy[from];
+        tri.a[i] = -dy;
+        tri.b[i] = dx;
+        tri.c[i] = fx[from] * fy[to] - fy[from] * fx[to];
+
+        // For a counter-clockwise triangle with Y up the inside is on the left
+        // of each edge: left edges go down, top edges go left. Pixel centers
+        // exactly on other edges are outside: bias their `E` by -1 so that
+        // `E >= 0` is the whole test
+        bool isTopLeft = dy < 0 || (dy == 0 && dx < 0);
+        if(!isTopLeft)
+        {
+            tri.c[i] -= 1;
+        }
+    }
+
+    // The pixels whose center is in the bounding box, clamped to the viewport
+    double minX = std::min({x[0], x[1], x[2]}), maxX = std::max({x[0], x[1], x[2]});
+    double minY = std::min({y[0], y[1], y[2]}), maxY = std::max({y[0], y[1], y[2]});
+    tri.minX = int(std::max(ceil(minX - 0.5), 0.0));
+    tri.minY = int(std::max(ceil(minY - 0.5), 0.0));
+    tri.maxX = int(std::min(floor(maxX - 0.5), double(viewport_.width) - 1.0));
+    tri.maxY = int(std::min(floor(maxY - 0.5), double(viewport_.height) - 1.0));
+    if(tri.minX > tri.maxX || tri.minY > tri.maxY)
+    {
+        return;
+    }
+
+    tri.draw = draw;
+    tri.varyings = varyings_.size();
+    const unsigned int nVaryings = draws_[draw].program->nVaryings;
+    for(unsigned int i = 0; i < 3; i ++)
+    {
+        const float* vertexVaryings = vertices[order[i]]->varyings;
+        varyings_.insert(varyings_.end(), vertexVaryings, vertexVaryings + nVaryings);
+    }
+
+    triangles_.push_back(tri);
+    if(triangles_.size() >= MAX_BATCH_TRIANGLES)
+    {
+        flush();
+    }
+}
+
+
+void Rasterizer::flush()
+{
+    if(triangles_.empty())
+    {
+        return;
+    }
+
+    // Bin triangles to the tiles their bounding box overlaps (in order)
+    binnedTiles_.clear();
+    for(U32 i = 0; i < U32(triangles_.size()); i ++)
+    {
+        const Triangle& tri = triangles_[i];
+        for(int ty = tri.minY / TILE_SIZE; ty <= tri.maxY / TILE_SIZE; ty ++)
+        {
+            for(int tx = tri.minX / TILE_SIZE; tx <= tri.maxX / TILE_SIZE; tx ++)
+            {
+                U32 tile = U32(ty * nTilesX_ + tx);
+                if(bins_[tile].empty())
+                {
+                    binnedTiles_.push_back(tile);
+                }
+                bins_[tile].push_back(i);
+            }
+        }
+    }
+
+    // Rasterize each tile as a separate task
+    std::vector<size_t> tileFragments(binnedTiles_.size(), 0);
+    auto rasterFunc = [this, &tileFragments](size_t begin, size_t end)
+    {
+        for(size_t i = begin; i < end; i ++)
+        {
+            tileFragments[i] = rasterTile(binnedTiles_[i]);
+        }
+    };
+    if(scheduler_ && binnedTiles_.size() > 1)
+    {
+        parallelFor(*scheduler_, binnedTiles_.size(), 1, rasterFunc);
+    }
+    else
+    {
+        rasterFunc(0, binnedTiles_.size());
+    }
+
+    stats_.nTrianglesBinned += triangles_.size();
+    for(size_t nFragments : tileFragments)
+    {
+        stats_.nFragments += nFragments;
+    }
+
+    for(U32 tile : binnedTiles_)
+    {
+        bins_[tile].clear(); // (Keeping their capacity for the next flush)
+    }
+    triangles_.clear();
+    varyings_.clear();
+}
+
+void Rasterizer::finish()
+{
+    flush();
+    draws_.clear();
+}
+
+size_t Rasterizer::rasterTile(U32 tile)
+{
+    int tileX0 = int(tile % U32(nTilesX_)) * TILE_SIZE, tileY0 = int(tile / U32(nTilesX_)) * TILE_SIZE;
+    int tileX1 = std::min(tileX0 + TILE_SIZE, int(viewport_.width)) - 1;
+    int tileY1 = std::min(tileY0 + TILE_SIZE, int(viewport_.height)) - 1;
+
+    size_t nFragments = 0;
+    for(U32 triIndex : bins_[tile])
+    {
+        const Triangle& tri = triangles_[triIndex];
+        nFragments += rasterTriangle(tri,
+                                     std::max(tri.minX, tileX0), std::max(tri.minY, tileY0),
+                                     std::min(tri.maxX, tileX1), std::min(tri.maxY, tileY1));
+    }
+    return nFragments;
+}
+
+size_t Rasterizer::rasterTriangle(const Triangle& tri, int x0, int y0, int x1, int y1)
+{
+    const DrawState& draw = draws_[tri.draw];
+    const Program& program = *draw.program;
+    const unsigned int nVaryings = program.nVaryings;
+    const unsigned int nOutputs = std::min(program.nOutputs, nColorTargets_);
+    const float* triVaryings[3] =
+    {
+        &varyings_[tri.varyings],
+        &varyings_[tri.varyings + nVaryings],
+        &varyings_[tri.varyings + 2 * nVaryings],
+    };
+
+    float varyings[MAX_VARYINGS];
+    FragmentInput fragIn;
+    fragIn.varyings = varyings;
+    fragIn.textures = draw.textures;
+    fragIn.nTextures = draw.nTextures;
+    fragIn.uniforms = draw.uniforms;
+    FragmentOutput fragOut;
+
+    // (Edge function steps per pixel and per 4-pixel block, in fixed point)
+    I64 stepX[3], blockStepX[3];
+    for(unsigned int i = 0; i < 3; i ++)
+    {
+        stepX[i] = tri.a[i] * SUBPIXEL_STEPS;
+        blockStepX[i] = stepX[i] * 4;
+    }
+
+#ifdef ARES_SOFT_RASTERIZER_SSE
+    // Two 64-bit lanes per register: pixels `[x, x + 2)` and `[x + 2, x + 4)`
+    __m128i laneSteps01[3], laneSteps23[3], blockSteps[3];
+    for(unsigned int i = 0; i < 3; i ++)
+    {
+        laneSteps01[i] = _mm_set_epi64x(stepX[i], 0);
+        laneSteps23[i] = _mm_set_epi64x(stepX[i] * 3, stepX[i] * 2);
+        blockSteps[i] = _mm_set1_epi64x(blockStepX[i]);
+    }
+#endif
+
+    size_t nFragments = 0;
+    for(int y = y0; y <= y1; y ++)
+    {
+        // Evaluate the edge functions exactly at the first pixel center of the
+        // row, then step them 4 pixels at a time (also exactly)
+        I64 py = I64(y) * SUBPIXEL_STEPS + SUBPIXEL_STEPS / 2;
+        I64 px = I64(x0) * SUBPIXEL_STEPS + SUBPIXEL_STEPS / 2;
+        I64 rowE[3];
+        for(unsigned int i = 0; i < 3; i ++)
+        {
+            rowE[i] = tri.a[i] * px + tri.b[i] * py + tri.c[i];
+        }
+#ifdef ARES_SOFT_RASTERIZER_SSE
+        __m128i e01[3], e23[3];
+        for(unsigned int i = 0; i < 3; i ++)
+        {
+            __m128i rowEi = _mm_set1_epi64x(rowE[i]);
+            e01[i] = _mm_add_epi64(rowEi, laneSteps01[i]);
+            e23[i] = _mm_add_epi64(rowEi, laneSteps23[i]);
+        }
+#endif
+
+        for(int x = x0; x <= x1; x += 4)
+        {
+            // Compute coverage for pixels `[x, x + 4)`, masking out the ones past `x1`
+            // (a pixel is covered if all of its `E`s are >= 0, see `Triangle`)
+            alignas(16) I64 e[3][4];
+            unsigned int coverage;
+#ifdef ARES_SOFT_RASTERIZER_SSE
+            // (No 64-bit compares in SSE2, but `movemask_pd` gathers the sign bits)
+            unsigned int outside = 0;
+            for(unsigned int i = 0; i < 3; i ++)
+            {
+                _mm_store_si128(reinterpret_cast<__m128i*>(&e[i][0]), e01[i]);
+                _mm_store_si128(reinterpret_cast<__m128i*>(&e[i][2]), e23[i]);
+                outside |= unsigned(_mm_movemask_pd(_mm_castsi128_pd(e01[i])))
+                           | (unsigned(_mm_movemask_pd(_mm_castsi128_pd(e23[i]))) << 2);
+                e01[i] = _mm_add_epi64(e01[i], blockSteps[i]);
+                e23[i] = _mm_add_epi64(e23[i], blockSteps[i]);
+            }
+            coverage = ~outside & 0xF;
+#else
+            coverage = 0xF;
+            for(unsigned int i = 0; i < 3; i ++)
+            {
+                for(unsigned int lane = 0; lane < 4; lane ++)
+                {
+                    e[i][lane] = rowE[i] + stepX[i] * I64(lane);
+                    coverage &= e[i][lane] >= 0 ? 0xF : ~(1U << lane);
+                }
+                rowE[i] += blockStepX[i];
+            }
+#endif
+            int nLanes = std::min(4, x1 - x + 1);
+            coverage &= (1U << nLanes) - 1;
+
+            for(; coverage; coverage &= coverage - 1)
+            {
+                unsigned int lane = 0;
+                for(; !(coverage & (1U << lane)); lane ++);
+                int pixelX = x + int(lane);
+
+                // Barycentrics, depth test
+                float l0 = float(e[0][lane]) * tri.invArea2, l1 = float(e[1][lane]) * tri.invArea2;
+                float l2 = 1.0f - l0 - l1;
+                float z = l0 * tri.z[0] + l1 * tri.z[1] + l2 * tri.z[2];
+                if(z < 0.0f || z > 1.0f)
+                {
+                    continue;
+                }
+
+                float* depth = nullptr;
+                if(depthTest_)
+                {
+                    depth = depthTarget_->texel(size_t(pixelX), size_t(y));
+                    if(!(z < *depth))
+                    {
+                        continue;
+                    }
+                }
+
+                // Perspective-correct varyings
+                float invW = l0 * tri.invW[0] + l1 * tri.invW[1] + l2 * tri.invW[2];
+                float w = 1.0f / invW;
+                float p0 = l0 * tri.invW[0] * w, p1 = l1 * tri.invW[1] * w, p2 = l2 * tri.invW[2] * w;
+                for(unsigned int i = 0; i < nVaryings; i ++)
+                {
+                    varyings[i] = p0 * triVaryings[0][i] + p1 * triVaryings[1][i] + p2 * triVaryings[2][i];
+                }
+
+                fragIn.fragCoord = glm::vec4(float(pixelX) + 0.5f, float(y) + 0.5f, z, invW);
+                program.fragment(fragIn, fragOut);
+
+                if(depth)
+                {
+                    *depth = z;
+                }
+                for(unsigned int i = 0; i < nOutputs; i ++)
+                {
+                    colorTargets_[i]->store(size_t(pixelX), size_t(y), fragOut.colors[i]);
+                }
+                nFragments ++;
+            }
+        }
+    }
+    return nFragments;
+}
+
+}
+}
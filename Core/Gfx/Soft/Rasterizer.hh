@@ -0,0 +1,152 @@
+#pragma once
+
+#include <stddef.h>
+#include <vector>
+#include <Core/Base/NumTypes.hh>
+#include <Core/Visual/Resolution.hh>
+#include <Core/Task/TaskScheduler.hh>
+#include <Core/Gfx/GfxCmd.hh>
+#include <Core/Gfx/GfxPipeline.hh>
+#include <Core/Gfx/Soft/Program.hh>
+#include <Core/Gfx/Soft/Texture.hh>
+
+namespace Ares
+{
+namespace Soft
+{
+
+/// The state triangles are drawn with; one per `GfxCmd`.
+struct DrawState
+{
+    const Program* program = nullptr;
+    const Texture* textures[GfxMaterialDesc::MAX_TEXTURES] = {};
+    unsigned int nTextures = 0;
+    const U8* uniforms = nullptr;
+};
+
+/// A binned, tile-parallel triangle rasterizer.
+///
+/// Triangles drawn are clipped, set up and queued in submission order; on
+/// `flush()` they are binned to the `TILE_SIZE`x`TILE_SIZE` screen tiles they
+/// overlap, then each tile is rasterized (coverage, depth test, fragment
+/// stage, output) as a separate task. Tiles own disjoint pixels and process
+/// their triangles in order, so the output is the same as drawing sequentially.
+///
+/// Coverage is computed with fixed point edge functions, 4 pixels at a time
+/// (with SSE2 if available) and a top-left fill rule; depth is tested `LESS` like OpenGL's
+/// default, and only written if depth testing is enabled.
+class Rasterizer
+{
+public:
+    /// The width and height in pixels of a tile.
+    static constexpr const int TILE_SIZE = 64;
+
+    /// The number of triangles queued after which the rasterizer `flush()`es
+    /// by itself, to bound memory usage.
+    static constexpr const size_t MAX_BATCH_TRIANGLES = 64 * 1024;
+
+    /// Statistics on the work done since the last `resetStats()`.
+    struct Stats
+    {
+        size_t nTriangles = 0; ///< Triangles drawn.
+        size_t nTrianglesBinned = 0; ///< Triangles left after clipping/culling (clipped ones may be split).
+        size_t nFragments = 0; ///< Fragments shaded (i.e. covered and passing the depth test).
+    };
+
+private:
+    /// A set up triangle, in window coordinates.
+    struct Triangle
+    {
+        /// The coefficients of the edge functions `E[i](x, y) = a[i] * x + b[i] * y + c[i]`
+        /// for the edge opposite of vertex `i`, with `x, y` in fixed point
+        /// (1/`SUBPIXEL_STEPS` of a pixel); `E[i]` is positive inside the triangle.
+        /// `c[i]` includes the top-left fill rule's bias, so that a pixel center
+        /// is covered iff `E[i] >= 0` for all edges.
+        /// Integers, so that they are exact (and edges shared by adjacent
+        /// triangles agree on every pixel) however they are stepped.
+        I64 a[3], b[3], c[3];
+        float z[3]; ///< The window depth ([0..1]) of each vertex.
+        float invW[3]; ///< `1 / w` of each vertex.
+        float invArea2; ///< `1 / (2 * area)`, to turn edge functions into barycentrics.
+        int minX, minY, maxX, maxY; ///< The pixels covered by the triangle's bounding box (inclusive).
+        U32 draw; ///< The index of its `DrawState` in `draws_`.
+        size_t varyings; ///< The index of its vertices' varyings in `varyings_` (`3 * nVaryings` floats).
+    };
+
+    TaskScheduler* scheduler_;
+
+    Resolution viewport_;
+    Texture* colorTargets_[GfxPipeline::Pass::MAX_TARGETS];
+    unsigned int nColorTargets_;
+    Texture* depthTarget_;
+    bool depthTest_;
+
+    int nTilesX_, nTilesY_;
+
+    std::vector<DrawState> draws_;
+    std::vector<Triangle> triangles_;
+    std::vector<float> varyings_;
+    std::vector<std::vector<U32>> bins_; ///< The indices of the triangles overlapping each tile.
+    std::vector<U32> binnedTiles_; ///< The tiles with a non-empty bin in `bins_`.
+
+    Stats stats_;
+
+    /// Clips the triangle against the near plane and queues the resulting
+    /// triangle(s) via `setupTriangle()`.
+    void clipTriangle(const VertexOutput& v0, const VertexOutput& v1, const VertexOutput& v2, U32 draw);
+
+    /// Sets up the (clipped) triangle and queues it, unless it is degenerate or
+    /// covers no pixel.
+    void setupTriangle(const VertexOutput* vertices[3], U32 draw);
+
+    /// Rasterizes all triangles in the bin of the given tile; returns the
+    /// number of fragments shaded.
+    size_t rasterTile(U32 tile);
+
+    /// Rasterizes the part of `tri` in the given pixel rectangle (inclusive);
+    /// returns the number of fragments shaded.
+    size_t rasterTriangle(const Triangle& tri, int x0, int y0, int x1, int y1);
+
+public:
+    /// Creates a rasterizer that will run its tasks on `scheduler`, or that will
+    /// rasterize on the calling thread if `scheduler` is null.
+    Rasterizer(TaskScheduler* scheduler=nullptr);
+
+    /// `flush()`es, then sets the targets for the triangles drawn next.
+    /// All targets must be at least as big as `viewport`; `depthTarget` can be
+    /// null (no depth testing then).
+    void setTargets(Resolution viewport,
+                    Texture* const* colorTargets, unsigned int nColorTargets,
+                    Texture* depthTarget, bool depthTest);
+
+    /// Adds a draw state for `drawTriangle()`s and returns its index.
+    /// The draw state (and what it points to) must be kept alive until the
+    /// next `setTargets()` or `finish()`.
+    U32 addDraw(const DrawState& draw);
+
+    /// Queues a triangle whose vertices were output by the vertex stage of
+    /// `draw`'s program; may `flush()`.
+    void drawTriangle(const VertexOutput& v0, const VertexOutput& v1, const VertexOutput& v2, U32 draw);
+
+    /// Rasterizes all triangles queued so far.
+    void flush();
+
+    /// `flush()`es and forgets all draw states.
+    void finish();
+
+
+    /// Returns the statistics since the last `resetStats()`.
+    inline const Stats& stats() const
+    {
+        return stats_;
+    }
+
+    /// Resets `stats()` to zero.
+    inline void resetStats()
+    {
+        stats_ = Stats();
+    }
+};
+
+}
+}
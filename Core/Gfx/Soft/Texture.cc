@@ -0,0 +1,205 @@
+#include "Texture.hh"
+
+#include <math.h>
+#include <algorithm>
+
+namespace Ares
+{
+namespace Soft
+{
+
+/// Returns the number of layers of a texture described by `desc`.
+static size_t descNLayers(const GfxTextureDesc& desc)
+{
+    switch(desc.type)
+    {
+    case GfxTextureDesc::_2D:
+        return 1;
+    case GfxTextureDesc::Cubemap:
+        return 6;
+    default: // _2DArray, _3D
+        return desc.depth;
+    }
+}
+
+Texture::Texture(const GfxTextureDesc& desc)
+    : desc_(desc), nChannels_(desc.format.nChannelsSet()),
+      normalizedMask_(0), integerMask_(0), nLayers_(descNLayers(desc))
+{
+    using Ch = ImageFormat::Channel;
+
+    desc_.data = nullptr; // (Not owned, do not keep it around)
+    for(unsigned int i = 0; i < nChannels_; i ++)
+    {
+        Ch channel = desc.format.channels[i];
+        if(channel >= Ch::UN2 && channel <= Ch::UN16)
+        {
+            normalizedMask_ |= 1U << i;
+        }
+        else if(channel >= Ch::I8 && channel <= Ch::U32)
+        {
+            integerMask_ |= 1U << i;
+        }
+    }
+
+    texels_.assign(desc_.resolution.width * desc_.resolution.height * nLayers_ * nChannels_, 0.0f);
+
+    if(desc.data)
+    {
+        ViewCube wholeCube;
+        wholeCube.topFrontLeft = {0, 0, 0};
+        wholeCube.bottomBackRight = {desc_.resolution.width, desc_.resolution.height, nLayers_};
+        (void)edit(wholeCube, desc.data);
+    }
+}
+
+void Texture::resize(Resolution newResolution, size_t newDepth)
+{
+    desc_.resolution = newResolution;
+    if(desc_.type == GfxTextureDesc::_2DArray || desc_.type == GfxTextureDesc::_3D)
+    {
+        desc_.depth = newDepth;
+    }
+    nLayers_ = descNLayers(desc_);
+
+    texels_.assign(desc_.resolution.width * desc_.resolution.height * nLayers_ * nChannels_, 0.0f);
+}
+
+bool Texture::edit(ViewCube dataCube, const void* data)
+{
+    const auto& tfl = dataCube.topFrontLeft;
+    const auto& bbr = dataCube.bottomBackRight;
+    if(tfl.x > bbr.x || tfl.y > bbr.y || tfl.z > bbr.z
+       || bbr.x > desc_.resolution.width || bbr.y > desc_.resolution.height || bbr.z > nLayers_)
+    {
+        return false;
+    }
+
+    // Unsigned data is normalized to [0..1] for normalized and float channels
+    // (like OpenGL does), and copied as-is for integer ones
+    float dataScale;
+    switch(desc_.dataType)
+    {
+    case GfxTextureDesc::DataType::U8:
+        dataScale = 1.0f / 255.0f;
+        break;
+    case GfxTextureDesc::DataType::U16:
+        dataScale = 1.0f / 65535.0f;
+        break;
+    default: // F32
+        dataScale = 1.0f;
+        break;
+    }
+    float channelScales[4];
+    for(unsigned int i = 0; i < nChannels_; i ++)
+    {
+        channelScales[i] = (integerMask_ & (1U << i)) ? 1.0f : dataScale;
+    }
+
+    size_t i = 0;
+    for(size_t layer = tfl.z; layer < bbr.z; layer ++)
+    {
+        for(size_t y = tfl.y; y < bbr.y; y ++)
+        {
+            float* dest = texel(tfl.x, y, layer);
+            size_t nValues = (bbr.x - tfl.x) * nChannels_;
+            for(size_t j = 0; j < nValues; j ++, i ++)
+            {
+                float value;
+                switch(desc_.dataType)
+                {
+                case GfxTextureDesc::DataType::U8:
+                    value = float(reinterpret_cast<const U8*>(data)[i]);
+                    break;
+                case GfxTextureDesc::DataType::U16:
+                    value = float(reinterpret_cast<const U16*>(data)[i]);
+                    break;
+                default: // F32
+                    value = reinterpret_cast<const F32*>(data)[i];
+                    break;
+                }
+                dest[j] = value * channelScales[j % nChannels_];
+            }
+        }
+    }
+    return true;
+}
+
+void Texture::clear(const glm::vec4& value)
+{
+    size_t nTexels = texels_.size() / nChannels_;
+    for(size_t i = 0; i < nTexels; i ++)
+    {
+        for(unsigned int j = 0; j < nChannels_; j ++)
+        {
+            texels_[i * nChannels_ + j] = value[j];
+        }
+    }
+}
+
+
+glm::vec4 Texture::fetch(size_t x, size_t y, size_t layer) const
+{
+    glm::vec4 value(0.0f, 0.0f, 0.0f, 1.0f);
+    const float* src = texel(x, y, layer);
+    for(unsigned int i = 0; i < nChannels_; i ++)
+    {
+        value[i] = src[i];
+    }
+    return value;
+}
+
+void Texture::store(size_t x, size_t y, const glm::vec4& value)
+{
+    float* dest = texel(x, y);
+    for(unsigned int i = 0; i < nChannels_; i ++)
+    {
+        dest[i] = (normalizedMask_ & (1U << i)) ? std::min(std::max(value[i], 0.0f), 1.0f) : value[i];
+    }
+}
+
+glm::vec4 Texture::sample(glm::vec2 uv, size_t layer) const
+{
+    const size_t width = desc_.resolution.width, height = desc_.resolution.height;
+    if(width == 0 || height == 0 || layer >= nLayers_)
+    {
+        return glm::vec4(0.0f, 0.0f, 0.0f, 1.0f);
+    }
+
+    // Repeat wrapping, texel centers at (i + 0.5) / size
+    float u = uv.x - floorf(uv.x), v = uv.y - floorf(uv.y);
+    float fx = u * float(width), fy = v * float(height);
+
+    auto wrap = [](long coord, size_t size)
+    {
+        long sizeL = long(size);
+        coord %= sizeL;
+        return size_t(coord < 0 ? coord + sizeL : coord);
+    };
+
+    if(desc_.magFilter == GfxTextureDesc::Nearest)
+    {
+        return fetch(wrap(long(fx), width), wrap(long(fy), height), layer);
+    }
+
+    // Bilinear (there are no mipmaps, so trilinear and anisotropic are bilinear too)
+    fx -= 0.5f; fy -= 0.5f;
+    float x0f = floorf(fx), y0f = floorf(fy);
+    float tx = fx - x0f, ty = fy - y0f;
+    size_t x0 = wrap(long(x0f), width), x1 = wrap(long(x0f) + 1, width);
+    size_t y0 = wrap(long(y0f), height), y1 = wrap(long(y0f) + 1, height);
+
+    glm::vec4 c00 = fetch(x0, y0, layer), c10 = fetch(x1, y0, layer);
+    glm::vec4 c01 = fetch(x0, y1, layer), c11 = fetch(x1, y1, layer);
+    glm::vec4 value;
+    for(unsigned int i = 0; i < 4; i ++)
+    {
+        float top = c00[i] + (c10[i] - c00[i]) * tx;
+        float bottom = c01[i] + (c11[i] - c01[i]) * tx;
+        value[i] = top + (bottom - top) * ty;
+    }
+    return value;
+}
+
+}
+}
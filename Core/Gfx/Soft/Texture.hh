@@ -0,0 +1,109 @@
+#pragma once
+
+#include <stddef.h>
+#include <vector>
+#include <glm/vec2.hpp>
+#include <glm/vec4.hpp>
+#include <Core/Visual/Resolution.hh>
+#include <Core/Visual/ViewCube.hh>
+#include <Core/Gfx/GfxResources.hh>
+
+namespace Ares
+{
+namespace Soft
+{
+
+/// A texture of a `Soft::Backend`, stored in memory.
+///
+/// Whatever its `ImageFormat`, each texel is stored as `nChannels()` floats.
+/// When edited with U8/U16 data, normalized and floating-point channels get it
+/// normalized to [0..1] while integer channels keep it as-is (like OpenGL does
+/// for `glTexSubImage*()`).
+/// Like in OpenGL, row 0 is the first row of the data and is sampled at V=0,
+/// and is also the bottom row of the window when rendering to the texture.
+class Texture
+{
+    GfxTextureDesc desc_; ///< (`desc_.data` is always null)
+    unsigned int nChannels_;
+    unsigned int normalizedMask_; ///< Bit `i` set if channel `i` is normalized (UN*).
+    unsigned int integerMask_; ///< Bit `i` set if channel `i` is an integer one (I*, U*).
+    size_t nLayers_;
+    std::vector<float> texels_;
+
+    /// Returns the index in `texels_` of the first channel of a texel.
+    inline size_t texelIndex(size_t x, size_t y, size_t layer) const
+    {
+        return ((layer * desc_.resolution.height + y) * desc_.resolution.width + x) * nChannels_;
+    }
+
+public:
+    /// Creates a texture from its description, uploading `desc.data` if not null.
+    Texture(const GfxTextureDesc& desc);
+
+    /// Returns the texture's description. Its `data` is always null.
+    inline const GfxTextureDesc& desc() const
+    {
+        return desc_;
+    }
+
+    /// Returns the resolution of each layer of the texture.
+    inline Resolution resolution() const
+    {
+        return desc_.resolution;
+    }
+
+    /// Returns the number of layers in the texture (1 for 2D textures, 6 for
+    /// cubemaps, `desc().depth` for arrays and 3D textures).
+    inline size_t nLayers() const
+    {
+        return nLayers_;
+    }
+
+    /// Returns the number of floats stored per texel.
+    inline unsigned int nChannels() const
+    {
+        return nChannels_;
+    }
+
+
+    /// Resizes the texture, clearing its contents to zero.
+    /// `newDepth` is ignored unless it is an array or 3D texture.
+    void resize(Resolution newResolution, size_t newDepth);
+
+    /// Uploads `data` (of the texture's `GfxTextureDesc::dataType`) to the
+    /// area of the texture in `dataCube`. Returns `false` if the area is out of
+    /// bounds.
+    bool edit(ViewCube dataCube, const void* data);
+
+    /// Sets all texels to `value` (only the first `nChannels()` components are used).
+    void clear(const glm::vec4& value);
+
+
+    /// Returns a pointer to the first channel of the texel at `(x, y)` in `layer`.
+    /// **WARNING**: Not bounds-checked!
+    inline float* texel(size_t x, size_t y, size_t layer=0)
+    {
+        return &texels_[texelIndex(x, y, layer)];
+    }
+    inline const float* texel(size_t x, size_t y, size_t layer=0) const
+    {
+        return &texels_[texelIndex(x, y, layer)];
+    }
+
+    /// Returns the value of the texel at `(x, y)` in `layer`; channels not in
+    /// the texture are 0, except for alpha which is 1.
+    /// **WARNING**: Not bounds-checked!
+    glm::vec4 fetch(size_t x, size_t y, size_t layer=0) const;
+
+    /// Writes `value` to the texel at `(x, y)`, clamping normalized channels
+    /// to [0..1].
+    /// **WARNING**: Not bounds-checked!
+    void store(size_t x, size_t y, const glm::vec4& value);
+
+    /// Samples the texture at `uv` in `layer` with its `magFilter` (nearest or
+    /// bilinear; there are no mipmaps) and repeat wrapping, like OpenGL's default.
+    glm::vec4 sample(glm::vec2 uv, size_t layer=0) const;
+};
+
+}
+}
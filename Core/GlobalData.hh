@@ -14,6 +14,8 @@ class Log; // (#include "Debug/Log.hh")
 class Profiler; // (#include "Debug/Profiler.hh")
 class TaskScheduler; // (#include "Task/TaskScheduler.hh")
 class Scene; // (#include "Scene/Scene.hh")
+class SceneCmdQueue; // (#include "Scene/SceneCmdQueue.hh")
+class SpatialIndex; // (#include "Scene/SpatialIndex.hh")
 class ResourceLoader; // (#include "Data/ResourceLoader.hh")
 
 /// Engine data stored globally, independent of which frame it is accessed by.
@@ -29,12 +31,28 @@ struct ARES_API GlobalData
     /// The profiling events that happened last frame.
     std::vector<Profiler::TimeEvent> profilerEvents;
 
+    /// The profiling counter values that were reported last frame.
+    std::vector<Profiler::CounterEvent> profilerCounters;
+
+    /// The profiling events that happened before the first frame (core and
+    /// module initialization); the startup timeline.
+    std::vector<Profiler::TimeEvent> startupProfilerEvents;
+
     /// The task scheduler for the engine.
     TaskScheduler* scheduler;
 
     /// The scene where the action is taking place.
     Scene* scene;
 
+    /// Deferred structural edits to `scene` recorded by tasks during the frame;
+    /// flushed by the core once all update tasks are done.
+    SceneCmdQueue* sceneCmds;
+
+    /// A spatial index of all entities in `scene` with bounds; updated by the
+    /// core once per frame, after `sceneCmds` are flushed. Can be queried by
+    /// any number of tasks concurrently.
+    SpatialIndex* spatialIndex;
+
     /// The main resource loader.
     ResourceLoader* resLoader;
 
@@ -20,6 +20,11 @@ InputModule::~InputModule()
 
 #define glog (*core.g().log)
 
+const char* InputModule::name() const
+{
+    return "Input";
+}
+
 bool InputModule::init(Core& core)
 {
     window_ = core.g().facilities.get<Window>();
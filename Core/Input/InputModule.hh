@@ -19,6 +19,7 @@ public:
     InputModule();
     ~InputModule() override;
 
+    const char* name() const override;
     bool init(Core& core) override;
     void mainUpdate(Core& core) override;
     Task updateTask(Core& core) override;
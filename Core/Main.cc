@@ -27,55 +27,66 @@ static bool addCoreModulesAndFacilities()
     unsigned int nModulesAttachedHere = 0;
 
 
-    // Window facility
-    // TODO: Load videomode and title (app name) from config file
-    VideoMode targetVideoMode;
-    targetVideoMode.fullscreenMode = VideoMode::Windowed;
-    targetVideoMode.resolution = {800, 600};
-    targetVideoMode.refreshRate = 0; // (don't care)
-
-    ARES_log(glog, Trace, "Creating window");
-    core.g().facilities.add<Window>(Window::GL33, targetVideoMode, "Ares");
-    if(!core.g().facilities.get<Window>()->operator bool())
+    // (No window when rendering with the null or software backend, see `CoreParams`)
+    bool headless = core.params().gfxNullBackend || core.params().gfxSoftBackend;
+
+    if(!headless)
     {
-        ARES_log(glog, Fatal, "Failed to create window");
-        return false;
+        // Window facility
+        // TODO: Load videomode and title (app name) from config file
+        VideoMode targetVideoMode;
+        targetVideoMode.fullscreenMode = VideoMode::Windowed;
+        targetVideoMode.resolution = {800, 600};
+        targetVideoMode.refreshRate = 0; // (don't care)
+
+        ARES_log(glog, Trace, "Creating window");
+        core.g().facilities.add<Window>(Window::GL33, targetVideoMode, "Ares");
+        if(!core.g().facilities.get<Window>()->operator bool())
+        {
+            ARES_log(glog, Fatal, "Failed to create window");
+            return false;
+        }
     }
 
-    // GfxModule [requires Window facility]
-    ARES_log(glog, Trace, "Attaching GfxModule");
-    core.attachModule(intoRef<Module>(new GfxModule()));
-    nModulesAttachedHere ++;
+    // Modules; attached (and initialized) all at once so that their `initTask()`s
+    // run concurrently, see `Core::attachModules()`
+    std::vector<Ref<Module>> modules;
+
+    // GfxModule [requires Window facility, unless headless]
+    modules.push_back(intoRef<Module>(new GfxModule()));
 
     // InputModule [requires Window facility]
-    core.attachModule(intoRef<Module>(new InputModule()));
-    nModulesAttachedHere ++;
+    if(!headless)
+    {
+        modules.push_back(intoRef<Module>(new InputModule()));
+    }
 
     // PhysModule
-    core.attachModule(intoRef<Module>(new PhysModule()));
-    nModulesAttachedHere ++;
+    modules.push_back(intoRef<Module>(new PhysModule()));
 
 #ifndef NDEBUG
     ARES_log(glog, Warning, "!! DEBUG BUILD !!");
 
     // DebugModule
     {
-        core.attachModule(intoRef<Module>(new DebugModule()));
-        nModulesAttachedHere ++;
+        modules.push_back(intoRef<Module>(new DebugModule()));
     }
 #else
     ARES_log(glog, Trace, "Release/RelWithDebInfo build");
 #endif
 
-    // AppModule
+    // AppModule [initialized after all other modules, see `AppModule::initDeps()`]
     static constexpr const char* appModuleDll =
 #ifdef ARES_PLATFORM_IS_WINDOWS
         ARES_CORE_APP_DLL ".dll";
 #else
         ARES_CORE_APP_DLL ".so";
 #endif
-    core.attachModule(intoRef<Module>(new AppModule(appModuleDll)));
-    nModulesAttachedHere ++;
+    modules.push_back(intoRef<Module>(new AppModule(appModuleDll)));
+
+    ARES_log(glog, Trace, "Attaching %lu modules", modules.size());
+    nModulesAttachedHere = modules.size();
+    core.attachModules(std::move(modules));
 
     if(core.nAttachedModules() == nModulesAttachedHere)
     {
@@ -92,7 +103,7 @@ static bool addCoreModulesAndFacilities()
 
 int main(int argc, char** argv)
 {
-    if(!core.init())
+    if(!core.init(argc, argv))
     {
         // Core initialization error
         // TODO Show a message box to inform the user of this
@@ -1,5 +1,6 @@
 #pragma once
 
+#include <vector>
 #include <Core/Api.h>
 #include <Core/Task/Task.hh>
 
@@ -14,9 +15,43 @@ class ARES_API Module
 public:
     virtual ~Module() = default;
 
+    /// Returns an unique, human-readable name for the module (ex. "Gfx"), that
+    /// other modules can refer to in `initDeps()`.
+    /// **WARNING**: Should point to a static string constant!
+    virtual const char* name() const
+    {
+        return "";
+    }
+
+    /// A name for `initDeps()` that stands for all modules being initialized
+    /// along with this one (except for the ones that also depend on all modules).
+    static constexpr const char* ALL_MODULES = "*";
+
+    /// Returns the `name()`s of the modules whose `init()` has to be run before
+    /// this module's `init()` (or `ALL_MODULES`). Names of modules that are not
+    /// attached to the core are ignored; if any of the dependencies fails to
+    /// init, this module will also fail to init.
+    virtual std::vector<const char*> initDeps() const
+    {
+        return {};
+    }
+
+    /// Returns a task that, when **scheduled to run on a nonspecified worker
+    /// thread**, will do any initialization work for the module that does not
+    /// have to be done on the main thread (loading files, creating data structures...).
+    /// It should not access other modules.
+    /// The tasks of all modules being initialized are scheduled at once, so they
+    /// run concurrently; `init()` is run only after this task has completed.
+    /// Return a null task if there is nothing to do.
+    virtual Task initTask(Core& core)
+    {
+        return {};
+    }
+
     /// Attempts to initialize the module instance; returns `false` on error.
     /// Does nothing and returns `true` if the module is already inited.
-    /// **This function will be run on the main thread.**
+    /// **This function will be run on the main thread**, after `initTask()`
+    /// has completed and after all `initDeps()` have been `init()`ed.
     virtual bool init(Core& core) = 0;
 
     /// Does anything that has to be done for the module for this frame **on the
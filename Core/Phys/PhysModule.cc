@@ -3,8 +3,10 @@
 #include <glm/geometric.hpp>
 #include <Core/Core.hh>
 #include <Core/Debug/Log.hh>
+#include <Core/Debug/TimeProbe.hh>
 #include <Core/Scene/Scene.hh>
-#include <Core/Scene/SceneIterator.hh>
+#include <Core/Scene/SceneView.hh>
+#include <Core/Scene/SceneCmdQueue.hh>
 
 namespace Ares
 {
@@ -17,7 +19,7 @@ constexpr const PhysModule::Seconds PhysModule::MAX_PERUPDATE_TIME;
 PhysModule::PhysModule()
     : broadphase_(nullptr), collisionConfig_(nullptr), collisionDispatcher_(nullptr),
       constraintSolver_(nullptr), dynamicsWorld_(nullptr),
-      dt_(1.0f / 60.0f)
+      dt_(1.0f / 60.0f), lastSceneVersion_(0)
 {
 }
 
@@ -27,23 +29,55 @@ PhysModule::~PhysModule()
 
 #define glog (*core.g().log)
 
-bool PhysModule::init(Core& core)
+const char* PhysModule::name() const
 {
-    ARES_log(glog, Trace, "Starting up Bullet Physics (version %d)", btGetVersion());
+    return "Phys";
+}
+
+Task PhysModule::initTask(Core& core)
+{
+    core_ = &core;
+    if(dynamicsWorld_)
+    {
+        // Already inited, don't create (and leak) another dynamics world
+        return {};
+    }
 
-    broadphase_ = new btDbvtBroadphase();
+    static const auto initFunc = [](TaskScheduler* scheduler, void* data)
+    {
+        auto physMod = reinterpret_cast<PhysModule*>(data);
+        TimeProbe timer(*physMod->core_->g().profiler, "PhysModule.InitTask");
 
-    collisionConfig_ = new btDefaultCollisionConfiguration();
-    collisionDispatcher_ = new btCollisionDispatcher(collisionConfig_);
+        // Create the dynamics world off the main thread
+        physMod->broadphase_ = new btDbvtBroadphase();
 
-    constraintSolver_ = new btSequentialImpulseConstraintSolver();
+        physMod->collisionConfig_ = new btDefaultCollisionConfiguration();
+        physMod->collisionDispatcher_ = new btCollisionDispatcher(physMod->collisionConfig_);
 
-    dynamicsWorld_ = new btDiscreteDynamicsWorld(collisionDispatcher_, broadphase_,
-                                                 constraintSolver_, collisionConfig_);
-    dynamicsWorld_->setGravity(DEFAULT_GRAVITY);
+        physMod->constraintSolver_ = new btSequentialImpulseConstraintSolver();
+
+        physMod->dynamicsWorld_ = new btDiscreteDynamicsWorld(physMod->collisionDispatcher_,
+                                                              physMod->broadphase_,
+                                                              physMod->constraintSolver_,
+                                                              physMod->collisionConfig_);
+        physMod->dynamicsWorld_->setGravity(DEFAULT_GRAVITY);
+    };
+
+    return {initFunc, this};
+}
+
+bool PhysModule::init(Core& core)
+{
+    // (Dynamics world created by `initTask()`)
+    ARES_log(glog, Trace, "Started up Bullet Physics (version %d)", btGetVersion());
 
     // Allocate a `CompStore` for the internal `PhysDataComp`s.
-    (void)core.g().scene->storeFor<PhysDataComp>();
+    ErrString err;
+    if(!core.g().scene->storeFor<PhysDataComp>(&err))
+    {
+        ARES_log(glog, Error, "Could not allocate PhysDataComp store: %s", err);
+        return false;
+    }
 
     ARES_log(glog, Debug, "PhysModule online");
     return true;
@@ -165,15 +199,15 @@ btCollisionShape* PhysModule::createBulletCollisionShape(const CollisionShape& c
     }
 }
 
-PhysModule::PhysDataComp* PhysModule::addPhysDataComp(EntityRef entity)
+bool PhysModule::initPhysDataComp(EntityRef entity, PhysDataComp& physDataComp)
 {
-    auto transform = entity.comp<TransformComp>();
-    auto rigidBody = entity.comp<RigidBodyComp>();
+    auto transform = entity.constComp<TransformComp>();
+    auto rigidBody = entity.constComp<RigidBodyComp>();
 
     if(!transform || !rigidBody)
     {
-        // Error: this entity does not have a transform or rigid body!
-        return nullptr;
+        // Error: this entity does not have a transform or rigid body (anymore?)!
+        return false;
     }
 
     // Get a reference or instantiate the Bullet collision shape corresponding to the Ares one
@@ -195,23 +229,20 @@ PhysModule::PhysDataComp* PhysModule::addPhysDataComp(EntityRef entity)
     btVector3 bulletLocalInertia;
     bulletCollisionShape->calculateLocalInertia(bulletMass, bulletLocalInertia);
 
-    // Add the new `PhysDataComp`
-    PhysDataComp* physDataComp = entity.setComp<PhysDataComp>({});
-
-    physDataComp->bulletCollisionShape = bulletCollisionShape; // (increases refcount)
+    physDataComp.bulletCollisionShape = bulletCollisionShape; // (increases refcount)
 
     // Setup the motion state that will sync `TransformComp`s <=> Bullet's transforms
     // for active Bullet rigid bodies
-    physDataComp->bulletMotionState = PhysMotionState(entity);
+    physDataComp.bulletMotionState = PhysMotionState(entity);
 
     btRigidBody::btRigidBodyConstructionInfo bulletRigidBodyInfo(
                 bulletMass,
-                &physDataComp->bulletMotionState,
-                physDataComp->bulletCollisionShape.get(),
+                &physDataComp.bulletMotionState,
+                physDataComp.bulletCollisionShape.get(),
                 bulletLocalInertia);
-    // NOTE: `&physDataComp->bulletMotionState` works because an entity's `PhysDataComp`
-    //       is heap-allocated and its address will not change throughout the program;
-    //       hence, its `bulletMotionState` field's address will not change, too
+    // NOTE: `&physDataComp.bulletMotionState` works because components are never
+    //       moved inside of their `CompStore`; hence, its address will not change
+    //       until the `PhysDataComp` is erased
 
     bulletRigidBodyInfo.m_friction = rigidBody->props.friction;
     bulletRigidBodyInfo.m_rollingFriction = rigidBody->props.rollingFriction;
@@ -219,25 +250,31 @@ PhysModule::PhysDataComp* PhysModule::addPhysDataComp(EntityRef entity)
     bulletRigidBodyInfo.m_linearDamping = rigidBody->props.angularDamping;
     bulletRigidBodyInfo.m_angularDamping = rigidBody->props.angularDamping;
 
-    physDataComp->bulletRigidBody = new btRigidBody(bulletRigidBodyInfo);
+    physDataComp.bulletRigidBody = new btRigidBody(bulletRigidBodyInfo);
     if(rigidBody->type == RigidBodyComp::Kinematic)
     {
-       int bulletCollisionFlags = physDataComp->bulletRigidBody->getCollisionFlags();
+       int bulletCollisionFlags = physDataComp.bulletRigidBody->getCollisionFlags();
        bulletCollisionFlags |= btRigidBody::CF_KINEMATIC_OBJECT;
-       physDataComp->bulletRigidBody->setCollisionFlags(bulletCollisionFlags);
+       physDataComp.bulletRigidBody->setCollisionFlags(bulletCollisionFlags);
     }
 
     // Mark the Bullet data as synced to the current `rigidBody`'s values
-    physDataComp->cachedRigidBody = *rigidBody;
+    physDataComp.cachedRigidBody = *rigidBody;
+
+    // Add the rigid body to the dynamics world so that Bullet will start
+    // simulating the entity next frame
+    dynamicsWorld_->addRigidBody(physDataComp.bulletRigidBody);
 
-    return physDataComp;
+    return true;
 }
 
 void PhysModule::updatePhysDataComp(EntityRef entity)
 {
+    SceneCmdQueue* sceneCmds = core_->g().sceneCmds;
+
     bool massPropsChanged = false; // `true` if mass and/or inertia of the object changed
 
-    auto rigidBodyComp = entity.comp<RigidBodyComp>();
+    auto rigidBodyComp = entity.constComp<RigidBodyComp>(); // (do not mark it as changed)
     auto physDataComp = entity.comp<PhysDataComp>();
 
     if(rigidBodyComp)
@@ -303,12 +340,23 @@ void PhysModule::updatePhysDataComp(EntityRef entity)
         {
             // The entity has had a rigid body added to it but no Bullet data yet.
 
-            // Create the Bullet data
-            physDataComp = addPhysDataComp(entity);
-
-            // Add the rigid body to the dynamics world so that Bullet will start
-            // simulating the entity next frame
-            dynamicsWorld_->addRigidBody(physDataComp->bulletRigidBody);
+            // Add and initialize the Bullet data at the end of the frame, when
+            // no other task is iterating over the scene anymore
+            auto initFunc = [this](EntityRef newEntity, PhysDataComp& newPhysDataComp)
+            {
+                if(!initPhysDataComp(newEntity, newPhysDataComp))
+                {
+                    // The rigid body or transform were erased in the meantime, or
+                    // the transform was not set yet; in the latter case retry
+                    // in the next update, as the rigid body won't change again
+                    if(newEntity.constComp<RigidBodyComp>())
+                    {
+                        pendingInits_.push_back(newEntity.id());
+                    }
+                    newEntity.erase<PhysDataComp>();
+                }
+            };
+            sceneCmds->set<PhysDataComp>(entity.id(), {}, initFunc);
         }
     }
     else
@@ -322,7 +370,7 @@ void PhysModule::updatePhysDataComp(EntityRef entity)
             dynamicsWorld_->removeRigidBody(physDataComp->bulletRigidBody);
 
             delete physDataComp->bulletRigidBody; physDataComp->bulletRigidBody = nullptr;
-            entity.erase<PhysDataComp>();
+            sceneCmds->erase<PhysDataComp>(entity.id());
         }
     }
 }
@@ -368,12 +416,45 @@ Task PhysModule::updateTask(Core& core)
         //       and past state, then apply transforms and velocities to entities
         //       with physics components that are simulated in the dynamics world
 
+        // Check if Bullet data has to be created/deleted/synced with Ares', only
+        // for rigid bodies that were added/changed/removed since the last update
         Scene* scene = physMod->core_->g().scene;
-        for(auto it = scene->begin(); it != scene->end(); it ++)
+        U64 sinceVersion = physMod->lastSceneVersion_;
+        physMod->lastSceneVersion_ = scene->advanceVersion();
+
+        CompStore<RigidBodyComp>* rigidBodyStore = scene->storeFor<RigidBodyComp>();
+        for(EntityId entity : physMod->pendingInits_)
         {
-            // Check if Bullet data has to be created/deleted/synced with Ares'
-            physMod->updatePhysDataComp(*it);
+            // (Skip the ones whose rigid body changed, they are updated below anyway)
+            if(rigidBodyStore && rigidBodyStore->has(entity)
+               && !rigidBodyStore->changedSince(entity, sinceVersion))
+            {
+                physMod->updatePhysDataComp(scene->ref(entity));
+            }
         }
+        physMod->pendingInits_.clear();
+
+        auto rigidBodyFunc = [physMod, scene](EntityId entity, RigidBodyComp& rigidBodyComp)
+        {
+            // (Creates or syncs Bullet data)
+            physMod->updatePhysDataComp(scene->ref(entity));
+        };
+        scene->view<RigidBodyComp>().eachChangedSince(sinceVersion, rigidBodyFunc);
+
+        if(!rigidBodyStore || rigidBodyStore->lastChangeVersion() <= sinceVersion)
+        {
+            // No rigid body was erased
+            return;
+        }
+        auto physDataFunc = [physMod, scene, rigidBodyStore](EntityId entity, PhysDataComp& physDataComp)
+        {
+            if(!rigidBodyStore->has(entity))
+            {
+                // (Deletes Bullet data for entities whose rigid body was removed)
+                physMod->updatePhysDataComp(scene->ref(entity));
+            }
+        };
+        scene->view<PhysDataComp>().each(physDataFunc);
     };
 
     // Bullet's 3D transforms will automatically be applied to Ares' `TransformComp`s
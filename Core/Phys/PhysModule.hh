@@ -50,13 +50,12 @@ private:
     /// An internal `Comp` to store Bullet data associated to an Ares entity.
     struct PhysDataComp
     {
-        // NOTE `PhysDataComp` resides on the heap; no need to `new`
-        //      `PhysMotionState` one!
         RigidBodyComp cachedRigidBody; ///< The `RigidBodyComp` as it was the last time
                                        ///  `updatePhysDataComp()` was called on this.
 
         Ref<btCollisionShape> bulletCollisionShape; // (from `collisionShapeMap_`)
-        PhysMotionState bulletMotionState;
+        PhysMotionState bulletMotionState; // (Bullet keeps a pointer to this; fine
+                                           //  since components never move in their `CompStore`)
         btRigidBody* bulletRigidBody = nullptr; // If null this entity does not
                                                 // have an active rigid body and
                                                 // its `PhysDataComp` can be disposed of.
@@ -66,18 +65,29 @@ private:
                  ///  advance the physics simulation each update cycle.
     Clock::time_point tLastUpdate_; ///< The time When the last simulation step was started.
     Seconds updateTimeAccumulator_; ///< (See `updateTask()` impl)
+    U64 lastSceneVersion_; ///< The scene version at the last update (see `Scene::advanceVersion()`).
+
+    /// Entities with a `RigidBodyComp` whose Bullet data could not be inited
+    /// because they had no `TransformComp` (yet); retried by every update.
+    /// (Appended to when the `SceneCmdQueue` is flushed, consumed by `updateTask()`)
+    std::vector<EntityId> pendingInits_;
 
 
     /// Attempts to create a Bullet collision shape from an Ares one. Returns null on error.
     static btCollisionShape* createBulletCollisionShape(const CollisionShape& collisionShape);
 
-    /// Attachs an appropriate `PhysDataComp` to the given entity, which must
-    /// already have a `TransformComp` and `RigidBodyComp`. Returns a pointer to
-    /// the newly-added `PhysDataComp`.
-    PhysDataComp* addPhysDataComp(EntityRef entity);
+    /// Initializes the Bullet data in the given entity's (newly-added) `PhysDataComp`
+    /// and adds its rigid body to the dynamics world. The entity must have a
+    /// `TransformComp` and `RigidBodyComp`; returns `false` if it does not.
+    /// Called when the `SceneCmdQueue` is flushed (see `updatePhysDataComp()`).
+    bool initPhysDataComp(EntityRef entity, PhysDataComp& physDataComp);
 
     /// Updates the `PhysDataComp` for an entity so that it will match what the
-    /// `RigidBodyComp` expects from it.
+    /// `RigidBodyComp` expects from it. `PhysDataComp`s are added/erased via the
+    /// core's `SceneCmdQueue`, so this is safe to call while iterating over the scene.
+    /// Only called for entities whose `RigidBodyComp` changed since the last update
+    /// (or that have a `PhysDataComp` but their `RigidBodyComp` was removed, or
+    /// that are in `pendingInits_`).
     void updatePhysDataComp(EntityRef entity);
 
     /// Steps `dynamicsWorld_`'s simulation as many times as necessary to make
@@ -90,6 +100,8 @@ public:
     PhysModule();
     ~PhysModule() override;
 
+    const char* name() const override;
+    Task initTask(Core& core) override;
     bool init(Core& core) override;
     void mainUpdate(Core& core) override;
     Task updateTask(Core& core) override;
@@ -35,7 +35,7 @@ public:
             return;
         }
 
-        TransformComp* transform = entity_.comp<TransformComp>();
+        const TransformComp* transform = entity_.constComp<TransformComp>();
         if(!transform)
         {
             // Can't query the transform of an entity without a transform comp!
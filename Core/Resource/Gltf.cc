@@ -376,6 +376,7 @@ Ref<Mesh> Gltf::extractMesh(unsigned int index) const
         }
     }
 
+    outMesh->updateBounds();
     return outMesh;
 }
 
@@ -5,6 +5,7 @@
 #include <glm/vec3.hpp>
 #include <glm/vec4.hpp>
 #include <Core/Api.h>
+#include <Core/Base/Aabb.hh>
 
 namespace Ares
 {
@@ -30,6 +31,8 @@ public:
 private:
     std::vector<Vertex> vertices_;
     std::vector<Index> indices_;
+    Aabb bounds_;
+    bool hasBounds_ = false;
 
 public:
     /// Gets/modifies the vertices currently in the mesh.
@@ -53,6 +56,46 @@ public:
     }
 
 
+    /// Returns the (local-space) bounding box of the vertices in the mesh, as
+    /// of the latest `updateBounds()` call.
+    inline const Aabb& bounds() const
+    {
+        return bounds_;
+    }
+
+    /// Returns `true` if `bounds()` were computed by `updateBounds()` for a
+    /// mesh with vertices; meshes built in code have none until then (and are
+    /// never frustum culled, as their extent is unknown).
+    inline bool hasBounds() const
+    {
+        return hasBounds_;
+    }
+
+    /// Recomputes `bounds()` from the positions of the vertices currently in the
+    /// mesh. Call this after modifying `vertices()`! (Meshes are loaded with
+    /// their bounds already computed)
+    inline void updateBounds()
+    {
+        if(vertices_.empty())
+        {
+            bounds_ = Aabb();
+            hasBounds_ = false;
+            return;
+        }
+
+        bounds_ = {vertices_[0].position, vertices_[0].position};
+        hasBounds_ = true;
+        for(const Vertex& vertex : vertices_)
+        {
+            for(int i = 0; i < 3; i ++)
+            {
+                bounds_.min[i] = fminf(bounds_.min[i], vertex.position[i]);
+                bounds_.max[i] = fmaxf(bounds_.max[i], vertex.position[i]);
+            }
+        }
+    }
+
+
     /// Returns the number of triangles in the mesh, i.e. the number of
     /// indices in it / 3.
     inline size_t nTriangles() const
@@ -1,19 +1,204 @@
 #pragma once
 
 #include <stddef.h>
+#include <string.h>
+#include <new>
 #include <vector>
 #include <utility>
 #include <iterator>
+#include <atomic>
+#include <type_traits>
 #include <Core/Api.h>
+#include <Core/Base/NumTypes.hh>
 #include <Core/Base/Utils.hh>
+#include <Core/Base/PagedArray.hh>
+#include <Core/Base/PagedBitSet.hh>
 #include <Core/Scene/EntityId.hh>
+#include <Core/Scene/CompTypeId.hh>
 
 namespace Ares
 {
 
-/// The interface containing common functionality of all `CompStore<T>`s.
-class CompStoreBase
+/// The common functionality of all `CompStore<T>`s: the mapping of entities to
+/// the slots their components are stored in.
+///
+/// Each component occupies a slot; slots of erased components are reused by
+/// new ones, so slots in `[0, nSlots())` are mostly (but not necessarily all)
+/// in use. Both the entity -> slot and the slot -> entity mappings are `PagedArray`s,
+/// so memory usage scales with the number of entities/components actually in use.
+/// Used slots are also tracked in a bitset, so that iteration (`forEachSlot()`)
+/// skips runs of unused slots a 64-bit word at a time.
+///
+/// Each slot also records the scene version (see `Scene::version()`) at which
+/// its component was last changed, for systems to only process what changed since
+/// they last ran (see `changedSince()`).
+class ARES_API CompStoreBase
 {
+    friend class SceneSnapshot;
+
+public:
+    /// The number of items in each page of the entity -> slot and slot -> entity arrays.
+    static constexpr const size_t INDEX_PAGE_SIZE = 4096;
+
+    /// The entity indices/per-entity signatures array of the parent scene.
+    using Signatures = PagedArray<std::atomic<CompMask>>;
+
+protected:
+    /// The slot returned for entities without a component.
+    static constexpr const U32 INVALID_SLOT = U32(-1);
+
+    size_t maxEntities_;
+    CompMask typeMask_; ///< The `CompMask` of the stored components.
+    Signatures* signatures_; ///< To keep up to date on `set()`/`erase()` (or null).
+    const std::atomic<U64>* version_; ///< The parent scene's version (or null).
+    std::atomic<U64> lastChange_; ///< The version of the latest set/erase/change.
+
+    PagedArray<U32, INDEX_PAGE_SIZE> entitySlots_; ///< Entity index -> (slot + 1), 0 if none.
+    PagedArray<EntityId, INDEX_PAGE_SIZE> slotEntities_; ///< Slot -> entity, `INVALID_ENTITY_ID` if unused.
+    PagedArray<U64, INDEX_PAGE_SIZE> slotVersions_; ///< Slot -> version of the last change.
+    PagedBitSet slotBits_; ///< A bit set for each used slot.
+    std::vector<U32> freeSlots_; ///< Slots < `nSlots_` that are unused.
+    U32 nSlots_; ///< All slots >= this were never used.
+    size_t size_; ///< The number of used slots.
+    bool recordErased_; ///< If `true`, `freeSlot()` appends to `erased_`.
+    std::vector<EntityId> erased_; ///< Entities whose component was erased since the last `takeErased()`.
+
+    CompStoreBase(const CompStoreBase& toCopy) = delete;
+    CompStoreBase& operator=(const CompStoreBase& toCopy) = delete;
+
+    CompStoreBase(size_t maxEntities, CompMask typeMask, Signatures* signatures,
+                  const std::atomic<U64>* version)
+        : maxEntities_(maxEntities),
+          typeMask_(typeMask), signatures_(signatures),
+          version_(version), lastChange_(0),
+          entitySlots_(maxEntities), slotEntities_(maxEntities), slotVersions_(maxEntities),
+          slotBits_(maxEntities),
+          nSlots_(0), size_(0), recordErased_(false)
+    {
+    }
+
+    /// Returns the version to mark changes with.
+    inline U64 curVersion() const
+    {
+        return version_ ? version_->load(std::memory_order_relaxed) : 1;
+    }
+
+    /// Marks the store as changed at the current version.
+    inline void touch()
+    {
+        // (CAS loop so that a racing `touch()` with an older version can not
+        // overwrite a newer one; `lastChange_` only ever increases)
+        U64 version = curVersion();
+        U64 lastChange = lastChange_.load(std::memory_order_relaxed);
+        while(lastChange < version
+              && !lastChange_.compare_exchange_weak(lastChange, version, std::memory_order_relaxed));
+    }
+
+    /// Marks the component in `slot` as changed at the current version.
+    inline void touchSlot(U32 slot)
+    {
+        slotVersions_[slot] = curVersion();
+        touch();
+    }
+
+    /// Returns the slot for the entity at `entityIndex` (of any generation), or
+    /// `INVALID_SLOT` if there is none.
+    inline U32 slotAt(U32 entityIndex) const
+    {
+        const U32* slotPlusOne = entitySlots_.find(entityIndex);
+        return (slotPlusOne && *slotPlusOne != 0) ? *slotPlusOne - 1 : INVALID_SLOT;
+    }
+
+    /// Returns the slot of the component for `entity`, or `INVALID_SLOT` if there
+    /// is none (or if the component belongs to a different generation of the
+    /// entity's slot).
+    inline U32 slotOf(EntityId entity) const
+    {
+        U32 slot = slotAt(entity.index);
+        if(slot == INVALID_SLOT || entityAt(slot) != entity)
+        {
+            return INVALID_SLOT;
+        }
+        return slot;
+    }
+
+    /// Takes a free slot (or a new one) for `entity`, which must be in bounds and
+    /// not have a slot already. Returns the slot.
+    U32 allocSlot(EntityId entity)
+    {
+        U32 slot;
+        if(!freeSlots_.empty())
+        {
+            slot = freeSlots_.back();
+            freeSlots_.pop_back();
+        }
+        else
+        {
+            slot = nSlots_ ++;
+        }
+
+        slotEntities_[slot] = entity;
+        entitySlots_[entity.index] = slot + 1;
+        slotBits_.set(slot);
+        size_ ++;
+        touchSlot(slot);
+
+        if(signatures_)
+        {
+            (*signatures_)[entity.index].fetch_or(typeMask_);
+        }
+        return slot;
+    }
+
+    /// Takes slots `[0, n)` of an empty store for `entities[0..n)`, in order.
+    /// Returns `false` (leaving the store empty) if any entity is out of bounds
+    /// or appears more than once. (Used by `SceneSnapshot`)
+    bool restoreSlots(const EntityId* entities, size_t n)
+    {
+        if(nSlots_ != 0 || n > maxEntities_)
+        {
+            return false;
+        }
+
+        for(size_t i = 0; i < n; i ++)
+        {
+            if(entities[i].index >= maxEntities_ || slotAt(entities[i].index) != INVALID_SLOT)
+            {
+                // Roll back what was taken so far
+                for(size_t j = 0; j < i; j ++)
+                {
+                    freeSlot(entities[j], U32(j));
+                }
+                freeSlots_.clear();
+                nSlots_ = 0;
+                return false;
+            }
+            (void)allocSlot(entities[i]);
+        }
+        return true;
+    }
+
+    /// Releases the `slot` used by `entity`.
+    void freeSlot(EntityId entity, U32 slot)
+    {
+        slotEntities_[slot] = INVALID_ENTITY_ID;
+        entitySlots_[entity.index] = 0;
+        slotBits_.clear(slot);
+        freeSlots_.push_back(slot);
+        size_ --;
+        touch();
+
+        if(recordErased_)
+        {
+            erased_.push_back(entity);
+        }
+
+        if(signatures_)
+        {
+            (*signatures_)[entity.index].fetch_and(~typeMask_);
+        }
+    }
+
 public:
     virtual ~CompStoreBase() = default;
 
@@ -23,63 +208,192 @@ public:
 
     /// Returns `true` if a component is currently associated to `entity` in the
     /// store.
-    virtual bool has(EntityId entity) = 0;
+    /// **WARNING**: Not reliable in multithreaded environments; see `CompStore::get()`,
+    ///              `CompStore::set()`'s warnings!
+    inline bool has(EntityId entity) const
+    {
+        return slotOf(entity) != INVALID_SLOT;
+    }
+
+    /// Returns the number of components currently in the store.
+    inline size_t size() const
+    {
+        return size_;
+    }
+
+    /// Marks the component for `entity` as changed at the current scene version,
+    /// if there is one.
+    inline void markChanged(EntityId entity)
+    {
+        U32 slot = slotOf(entity);
+        if(slot != INVALID_SLOT)
+        {
+            touchSlot(slot);
+        }
+    }
+
+    /// Returns `true` if the component for `entity` was set or marked as changed
+    /// after `version`. Returns `false` if there is no such component.
+    inline bool changedSince(EntityId entity, U64 version) const
+    {
+        U32 slot = slotOf(entity);
+        return slot != INVALID_SLOT && *slotVersions_.find(slot) > version;
+    }
+
+    /// Returns the version at which any component in the store was last set,
+    /// erased or marked as changed.
+    /// If this is not greater than a version, nothing in the store changed since.
+    inline U64 lastChangeVersion() const
+    {
+        return lastChange_.load(std::memory_order_relaxed);
+    }
+
+    /// Starts (or stops) recording the entities whose component gets erased
+    /// (including by them being destroyed), for `takeErased()`.
+    /// Lets a system find out what was removed from the store without scanning
+    /// everything it tracks.
+    inline void recordErased(bool record)
+    {
+        recordErased_ = record;
+        if(!record)
+        {
+            erased_.clear();
+        }
+    }
+
+    /// Appends to `out` the entities whose component was erased since the last
+    /// call (and since recording started, see `recordErased()`), and forgets them.
+    /// An entity may appear more than once, or have a component again by now.
+    /// **WARNING**: There is a single record per store, so only one system can
+    ///              consume it!
+    inline void takeErased(std::vector<EntityId>& out)
+    {
+        out.insert(out.end(), erased_.begin(), erased_.end());
+        erased_.clear();
+    }
+
+    /// Returns the number of slots to iterate over to visit all components in
+    /// the store (some of them may be unused, see `entityAt()`).
+    inline size_t nSlots() const
+    {
+        return nSlots_;
+    }
+
+    /// Returns the entity whose component is in `slot`, or `INVALID_ENTITY_ID`
+    /// if the slot is unused. `slot` must be less than `nSlots()`.
+    inline EntityId entityAt(U32 slot) const
+    {
+        return *slotEntities_.find(slot);
+    }
+
+    /// Returns the first used slot in `[begin, nSlots())`, or `nSlots()` if there
+    /// is none.
+    inline U32 nextSlot(U32 begin) const
+    {
+        return U32(slotBits_.findNext(begin, nSlots_));
+    }
+
+    /// Runs `func(U32 slot)` for each used slot in `[begin, end)` (clamped to
+    /// `nSlots()`), in order; unused slots are skipped 64 at a time.
+    template <typename Func>
+    inline void forEachSlot(size_t begin, size_t end, const Func& func) const
+    {
+        slotBits_.forEach(begin, end < nSlots_ ? end : nSlots_, func);
+    }
 };
 
 /// A sparse collection of `T` components indexed by `Entity`.
-/// Supports iteration.
+/// Components are stored in pages of `COMP_PAGE_SIZE` that are allocated on demand,
+/// and **never move** once set; `T*`s stay valid until the component is erased.
+/// Supports iteration, in O(`nSlots()`) - which is close to the number of components.
 template <typename T>
 class ARES_API CompStore : public CompStoreBase
 {
-    size_t maxEntities_;
-    std::vector<bool> compMap_; // (note: specialized in the STL)
-                                // TODO Make `compMap_` use atomic bools?
-    std::vector<T> compData_;
+    friend class SceneSnapshot;
+
+public:
+    /// The number of components in each page of the component array.
+    static constexpr const size_t COMP_PAGE_SIZE = 256;
+
+private:
+    using TStorage = typename std::aligned_storage<sizeof(T), alignof(T)>::type;
+    PagedArray<TStorage, COMP_PAGE_SIZE> comps_; ///< Slot -> component
 
     CompStore(const CompStore& toCopy) = delete;
     CompStore& operator=(const CompStore& toCopy) = delete;
 
-public:
-    friend class iterator;
-    class iterator;
+    CompStore(CompStore&& toMove) = delete;
+    CompStore& operator=(CompStore&& toMove) = delete;
 
-    /// Initializes a component store with capacity for a certain number of
-    /// entities. The maximum `Entity` index will hence be `maxEntities - 1`.
-    CompStore(size_t maxEntities)
-        : maxEntities_(maxEntities),
-          compMap_(maxEntities), compData_(maxEntities)
+    /// Returns a pointer to the component in `slot`. The slot must be in use.
+    inline T* compAt(U32 slot) const
     {
+        return reinterpret_cast<T*>(comps_.find(slot));
     }
 
-    CompStore(CompStore&& toMove)
+    /// Fills an empty store with copies of `comps[0..n)` for `entities[0..n)`,
+    /// one memcpy per page of components. Only for trivially copyable `T`s.
+    /// Returns `false` (leaving the store empty) on error; see `restoreSlots()`.
+    /// (Used by `SceneSnapshot`)
+    bool restoreBlock(const EntityId* entities, const T* comps, size_t n)
     {
-        (void)operator=(std::move(toMove));
+        static_assert(std::is_trivially_copyable<T>::value,
+                      "restoreBlock() requires trivially copyable components");
+
+        if(!restoreSlots(entities, n))
+        {
+            return false;
+        }
+
+        for(size_t slot = 0; slot < n; slot += COMP_PAGE_SIZE)
+        {
+            size_t nInPage = n - slot < COMP_PAGE_SIZE ? n - slot : COMP_PAGE_SIZE;
+            memcpy(&comps_[slot], &comps[slot], nInPage * sizeof(T));
+        }
+        return true;
     }
 
-    CompStore& operator=(CompStore&& toMove)
-    {
-        // Move data over and invalidate moved instance
-        maxEntities_ = toMove.maxEntities_;
-        compMap_ = std::move(toMove.compMap_);
-        compData_ = std::move(toMove.compData_);
+public:
+    friend class iterator;
+    class iterator;
 
-        return *this;
+    /// Initializes an empty component store for entities with indices up to
+    /// `maxEntities - 1`. No memory is allocated until components are `set()`.
+    /// If `signatures` is not null, `typeMask` will be set in/cleared from
+    /// `signatures[entity.index]` whenever a component is added/erased for `entity`.
+    /// If `version` is not null, changes are marked with its value at the time
+    /// of the change (otherwise with 1).
+    CompStore(size_t maxEntities,
+              CompMask typeMask=0, Signatures* signatures=nullptr,
+              const std::atomic<U64>* version=nullptr)
+        : CompStoreBase(maxEntities, typeMask, signatures, version),
+          comps_(maxEntities)
+    {
     }
 
-    ~CompStore() override = default;
+    ~CompStore() override
+    {
+        // Destroy all components still in the store
+        auto destroyFunc = [this](size_t slot)
+        {
+            compAt(U32(slot))->~T();
+        };
+        forEachSlot(0, nSlots_, destroyFunc);
+    }
 
 
     /// Returns a pointer to the component stored for `entity` or null if
-    /// there isn't one.
+    /// there isn't one (or if `entity` is a stale handle).
+    /// Does **not** mark the component as changed; see `getMut()`.
     /// **WARNING**: Not fully threadsafe! If the component is removed while the
     ///              `T*` is still in use, the pointer will now point to an unused
     ///              `T` **or may even point to a different entity's `T` component**!!
     inline T* get(EntityId entity)
     {
-        if(entity < maxEntities_ && compMap_[entity])
-        // TODO Make `compMap_[entity]` be an atomic load?
+        U32 slot = slotOf(entity);
+        if(slot != INVALID_SLOT)
         {
-            return &compData_[entity];
+            return compAt(slot);
         }
         else
         {
@@ -88,45 +402,109 @@ public:
         }
     }
 
+    /// Like `get()`, but also marks the component as changed (see `markChanged()`).
+    inline T* getMut(EntityId entity)
+    {
+        U32 slot = slotOf(entity);
+        if(slot != INVALID_SLOT)
+        {
+            touchSlot(slot);
+            return compAt(slot);
+        }
+        else
+        {
+            return nullptr;
+        }
+    }
+
     /// Sets or replaces the `T` component stored for this entity and returns a
     /// pointer to the newly-stored component - or null if the component could not be
-    /// set (possibly because `entity` is out of bounds).
+    /// set (`entity` is out of bounds, or another generation of the entity's
+    /// slot still has a component in the store).
     /// **WARNING**: Not fully threadsafe! If the component is removed while the
     ///              `T*` is still in use, the pointer will now point to an unused
     ///              `T` **or may even point to a different entity's `T` component**!!
+    ///              From tasks that run concurrently with others iterating over
+    ///              the store, record a `SceneCmdQueue::set()` instead.
     inline T* set(EntityId entity, T&& comp)
     {
-        if(entity >= maxEntities_)
+        if(entity.index >= maxEntities_)
         {
             // Entity out of bounds
             return nullptr;
         }
 
-        compMap_[entity] = true; // TODO Make this be an atomic store?
-        T* compPtr = &compData_[entity];
-        *compPtr = std::move(comp);
-        return compPtr;
+        U32 slot = slotAt(entity.index);
+        if(slot != INVALID_SLOT)
+        {
+            if(entityAt(slot) != entity)
+            {
+                // Slot taken by a different generation of the entity
+                return nullptr;
+            }
+
+            // Replace the existing component
+            T* compPtr = compAt(slot);
+            *compPtr = std::move(comp);
+            touchSlot(slot);
+            return compPtr;
+        }
+
+        // Construct a new component in a free slot
+        slot = allocSlot(entity);
+        return new(&comps_[slot]) T(std::move(comp));
     }
 
-    /// Returns `true` if a component is currently associated to `entity` in the
-    /// store.
-    /// **WARNING**: Not reliable in multithreaded environments; see `comp()`,
-    ///              `setComp()`'s warnings!
-    inline bool has(EntityId entity) override
+    /// Like `set()`, but sets a copy of `comp` for each of the `n` `entities` in
+    /// one pass. Returns the number of components actually set.
+    /// **WARNING**: See `set()`'s warnings!
+    size_t setCopies(const EntityId* entities, size_t n, const T& comp)
     {
-        return entity < maxEntities_ && compMap_[entity];
+        size_t nSet = 0;
+        for(size_t i = 0; i < n; i ++)
+        {
+            EntityId entity = entities[i];
+            if(entity.index >= maxEntities_)
+            {
+                continue;
+            }
+
+            U32 slot = slotAt(entity.index);
+            if(slot == INVALID_SLOT)
+            {
+                slot = allocSlot(entity);
+                new(&comps_[slot]) T(comp);
+            }
+            else if(entityAt(slot) == entity)
+            {
+                *compAt(slot) = comp;
+                touchSlot(slot);
+            }
+            else
+            {
+                // Slot taken by a different generation of the entity
+                continue;
+            }
+            nSet ++;
+        }
+        return nSet;
     }
 
     /// Attempts to erase the component associated to `entity`.
-    /// Does nothing if there isn't one (component not set or entity id out of bounds).
-    /// **WARNING**: See `comp()`, `setComp()`'s warnings!
+    /// Does nothing if there isn't one (component not set, stale handle or entity
+    /// id out of bounds).
+    /// **WARNING**: See `comp()`, `setComp()`'s warnings! From concurrent tasks,
+    ///              record a `SceneCmdQueue::erase()` instead.
     inline void erase(EntityId entity) override
     {
-        if(entity < maxEntities_)
+        U32 slot = slotOf(entity);
+        if(slot == INVALID_SLOT)
         {
-            // Erase component now or keep its "erased" value `false`
-            compMap_[entity] = false;
+            return;
         }
+
+        compAt(slot)->~T();
+        freeSlot(entity, slot);
     }
 
 
@@ -145,25 +523,62 @@ public:
     private:
         friend class CompStore;
         CompStore* parent_;
+        U32 slot_; ///< The slot of the current component.
+        U64 bits_; ///< The used slots in `slot_`'s word of the bitset, from `slot_` onwards.
         value_type pair_;
 
 
-        constexpr iterator(CompStore* parent, EntityId entity)
-            : parent_(parent),
-              pair_{entity, nullptr}
+        iterator(CompStore* parent, U32 slot)
+            : parent_(parent), slot_(slot), bits_(0),
+              pair_{INVALID_ENTITY_ID, nullptr}
         {
         }
 
+        /// Moves to the first used slot from `slot` onwards (or to the end).
+        inline void seek(U32 slot)
+        {
+            slot_ = parent_->nextSlot(slot);
+            bits_ = slot_ < parent_->nSlots_ ? parent_->slotBits_.wordFrom(slot_) : 0;
+        }
+
+        /// Moves to the next used slot after the current one; stays inside of
+        /// the cached word of the bitset while it has more bits set.
+        inline void advance()
+        {
+            bits_ &= bits_ - 1; // (Clear the current slot's bit)
+            if(bits_ != 0)
+            {
+                slot_ = (slot_ & ~U32(63)) + ctz64(bits_);
+            }
+            else
+            {
+                seek((slot_ | U32(63)) + 1);
+            }
+        }
+
+        /// Advances to the next slot that is actually in use, in case the
+        /// current one was freed after its bit was cached in `bits_`.
+        inline void skipUnused()
+        {
+            while(slot_ < parent_->nSlots_ && parent_->entityAt(slot_) == INVALID_ENTITY_ID)
+            {
+                advance();
+            }
+        }
+
     public:
-        constexpr iterator(const iterator& toCopy)
+        iterator(const iterator& toCopy)
+            : parent_(toCopy.parent_), slot_(toCopy.slot_), bits_(toCopy.bits_),
+              pair_(toCopy.pair_)
         {
-            (void)operator=(toCopy);
         }
 
         inline iterator& operator=(const iterator& toCopy)
         {
             parent_ = toCopy.parent_;
-            pair_ = {toCopy.pair_.entity, toCopy.pair_.value};
+            slot_ = toCopy.slot_;
+            bits_ = toCopy.bits_;
+            pair_ = toCopy.pair_;
 
             return *this;
         }
@@ -171,25 +586,30 @@ public:
 
         inline reference operator*()
         {
-            // Update the `T*` pointer before returning the pair
-            if(pair_.entity != INVALID_ENTITY_ID && parent_->compMap_[pair_.entity])
+            // Update the pair before returning it
+            if(slot_ < parent_->nSlots_)
             {
-                pair_.component = &parent_->compData_[pair_.first];
+                pair_.entity = parent_->entityAt(slot_);
+                pair_.component = parent_->compAt(slot_);
             }
             else
             {
-                // `INVALID_ENTITY` iterator or component has been erased
-                pair_.component = nullptr;
+                // End iterator
+                pair_ = {INVALID_ENTITY_ID, nullptr};
             }
 
             return pair_;
         }
 
+        inline pointer operator->()
+        {
+            return &operator*();
+        }
+
 
         inline bool operator==(const iterator& other) const
         {
-            return pair_.entity == other.pair_.entity && parent_ == other.parent_;
-            // (Note: if `pair_.entity` matches, then `pair_.component` should also)
+            return slot_ == other.slot_ && parent_ == other.parent_;
         }
 
         inline bool operator!=(const iterator& other) const
@@ -198,23 +618,10 @@ public:
         }
 
 
-        iterator& operator++() // preincrement
+        inline iterator& operator++() // preincrement
         {
-            // Search for the next entity, if any
-            EntityId nextEntity = INVALID_ENTITY_ID;
-            for(EntityId i = pair_.entity; i < parent_->maxEntities_; i ++)
-            {
-                if(parent_->compMap_[i])
-                {
-                    // Next entity found
-                    nextEntity = i;
-                    break;
-                }
-            }
-
-            // (`pair_.component` will be updated each time `operator*()` is called)
-            pair_.entity = nextEntity;
-
+            advance();
+            skipUnused();
             return *this;
         }
 
@@ -228,13 +635,19 @@ public:
 
     inline iterator begin()
     {
-        return iterator(this, 0);
+        iterator it(this, 0);
+        it.seek(0);
+        it.skipUnused();
+        return it;
     }
 
     inline iterator end()
     {
-        return iterator(this, maxEntities_);
+        return iterator(this, nSlots_);
     }
 };
 
+template <typename T>
+constexpr const size_t CompStore<T>::COMP_PAGE_SIZE;
+
 }
@@ -0,0 +1,44 @@
+#pragma once
+
+#include <typeinfo>
+#include <Core/Api.h>
+#include <Core/Base/NumTypes.hh>
+
+namespace Ares
+{
+
+/// An unique, sequential id for a type of component.
+/// Ids are assigned at runtime the first time `compTypeId<T>()` is called for
+/// each `T`, starting from 0, and are the same across the executable and all
+/// loaded DLLs (see `registerCompType()`).
+using CompTypeId = U32;
+
+/// A bitset of `CompTypeId`s, where the `1 << id`th bit is set for each id in the set.
+/// Used as a per-entity signature of which components it has (see `Scene::signature()`).
+using CompMask = U64;
+
+/// Returns the `CompTypeId` registered for the type named `typeName` (its
+/// `typeid().name()`), registering a new one if there is none yet. Threadsafe.
+/// Do not call this directly; use `compTypeId<T>()` instead.
+/// (The registry lives in the core library, not in the inline `compTypeId<T>()`;
+/// a function-local static there would get a separate copy in each module
+/// that instantiates it, making the exe and `App` disagree on ids!)
+ARES_API CompTypeId registerCompType(const char* typeName);
+
+/// Returns the `CompTypeId` of `T`s.
+/// The id is looked up on the first call, subsequent calls just return it.
+template <typename T>
+inline CompTypeId compTypeId()
+{
+    static const CompTypeId id = registerCompType(typeid(T).name());
+    return id;
+}
+
+/// Returns the `CompMask` containing only `compTypeId<T>()`.
+template <typename T>
+inline CompMask compMask()
+{
+    return CompMask(1) << compTypeId<T>();
+}
+
+}
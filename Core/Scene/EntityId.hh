@@ -1,14 +1,64 @@
 #pragma once
 
+#include <stddef.h>
+#include <functional>
+#include <Core/Api.h>
 #include <Core/Base/NumTypes.hh>
 
 namespace Ares
 {
 
 /// An handle that identifies an entity currently in the world.
-using EntityId = U32;
+/// See `Scene::create()`, `Scene::destroy()`, `Scene::alive()`.
+struct ARES_API EntityId
+{
+    /// The index of the entity's slot in its scene; reused by new entities after
+    /// the entity is destroyed.
+    U32 index;
+
+    /// The generation of the slot at `index` when the entity was created.
+    /// Handles to destroyed entities do not match the slot's current generation
+    /// anymore, even if the slot was reused.
+    U32 generation;
+
+
+    /// Initializes an handle to an invalid entity (see `INVALID_ENTITY_ID`).
+    constexpr EntityId()
+        : index(U32(-1)), generation(0)
+    {
+    }
+
+    constexpr EntityId(U32 index, U32 generation)
+        : index(index), generation(generation)
+    {
+    }
+
+    inline bool operator==(const EntityId& other) const
+    {
+        return index == other.index && generation == other.generation;
+    }
+    inline bool operator!=(const EntityId& other) const
+    {
+        return !operator==(other);
+    }
+};
 
 /// The handle to an invalid (not-existing) entity.
-static constexpr const EntityId INVALID_ENTITY_ID = -1;
+static constexpr const EntityId INVALID_ENTITY_ID{U32(-1), 0};
+
+}
+
+namespace std
+{
+
+template <>
+class ARES_API hash<Ares::EntityId>
+{
+public:
+    inline size_t operator()(const Ares::EntityId& value) const
+    {
+        return size_t(Ares::U64(value.generation) << 32 | Ares::U64(value.index));
+    }
+};
 
 }
@@ -30,11 +30,19 @@ public:
     }
 
     /// Returns `false` if the `EntityRef` is null.
+    /// A non-null reference can still refer to a destroyed entity; see `alive()`.
     inline operator bool() const
     {
         return scene_ && id_ != INVALID_ENTITY_ID;
     }
 
+    /// Returns `true` if the `EntityRef` is not null and the entity it refers
+    /// to was not destroyed. See `Scene::alive()`.
+    inline bool alive() const
+    {
+        return scene_ && scene_->alive(id_);
+    }
+
 
 
     EntityRef(const EntityRef& toCopy)
@@ -100,7 +108,9 @@ public:
 
 
     /// Returns a pointer to the `T` component stored for this entity or null if
-    /// there isn't one.
+    /// there isn't one (or if the entity was destroyed).
+    /// Marks the component as changed (see `CompStore::markChanged()`); use
+    /// `constComp()` instead to only read it.
     /// **WARNING**: The `EntityRef` should not be null!
     /// **WARNING**: Not fully threadsafe! If the component is removed while the
     ///              `T*` is still in use, the pointer will now point to an unused
@@ -109,12 +119,30 @@ public:
     inline T* comp()
     {
         auto store = scene_->storeFor<T>(); // (gets added if it does not already exist)
-        return store->get(id_);
+        return store ? store->getMut(id_) : nullptr;
+    }
+
+    /// Like `comp()`, but returns a const pointer and does not mark the component
+    /// as changed.
+    template <typename T>
+    inline const T* constComp() const
+    {
+        auto store = scene_->storeFor<T>(); // (gets added if it does not already exist)
+        return store ? store->get(id_) : nullptr;
+    }
+
+    /// Returns `true` if a `T` component is stored for this entity.
+    /// Only tests the entity's signature, without accessing the `T`s' store.
+    /// **WARNING**: The `EntityRef` should not be null!
+    template <typename T>
+    inline bool has() const
+    {
+        return (scene_->signature(id_) & compMask<T>()) != 0;
     }
 
     /// Sets or replaces the `T` component stored for this entity and returns a
     /// pointer to the newly-stored component - or null if the component could
-    /// not be set (entity id out of bounds?).
+    /// not be set (entity destroyed, id out of bounds or too many component types?).
     /// **WARNING**: The `EntityRef` should not be null!
     /// **WARNING**: Not fully threadsafe! If the component is removed while the
     ///              `T*` is still in use, the pointer will now point to an
@@ -122,8 +150,13 @@ public:
     template <typename T>
     inline T* setComp(T&& comp)
     {
+        if(!scene_->alive(id_))
+        {
+            return nullptr;
+        }
+
         auto store = scene_->storeFor<T>(); // (gets added if it does not already exist)
-        return store->set(id_, std::move(comp));
+        return store ? store->set(id_, std::move(comp)) : nullptr;
     }
 
     /// Erases any `T` component stored for this entity.
@@ -134,7 +167,10 @@ public:
     inline void erase()
     {
         auto store = scene_->storeFor<T>(); // (gets added if it does not already exist)
-        store->erase(id_);
+        if(store)
+        {
+            store->erase(id_);
+        }
     }
 
     /// Erases all components stored for this entity.
@@ -145,6 +181,13 @@ public:
     {
         scene_->erase(id_);
     }
+
+    /// Destroys the entity (erasing all of its components); see `Scene::destroy()`.
+    /// **WARNING**: The `EntityRef` should not be null!
+    inline void destroy()
+    {
+        scene_->destroy(id_);
+    }
 };
 
 }
@@ -0,0 +1,125 @@
+#pragma once
+
+#include <stddef.h>
+#include <memory>
+#include <vector>
+#include <utility>
+#include <Core/Api.h>
+#include <Core/Scene/EntityId.hh>
+#include <Core/Scene/CompTypeId.hh>
+#include <Core/Scene/Scene.hh>
+
+namespace Ares
+{
+
+/// A template set of components, to spawn many entities with copies of them
+/// at once via `Scene::instantiate()`.
+///
+/// Holds at most one component of each type. Components are copy-constructed
+/// into the entities, so each `T` in a prefab must be copyable.
+class ARES_API Prefab
+{
+    /// A type-erased component in the prefab.
+    struct CompBase
+    {
+        virtual ~CompBase() = default;
+
+        /// Sets a copy of the component for each of the `n` `entities` in `scene`.
+        virtual void copyTo(Scene& scene, const EntityId* entities, size_t n) const = 0;
+    };
+
+    template <typename T>
+    struct Comp : public CompBase
+    {
+        T value;
+
+        Comp(T&& value)
+            : value(std::move(value))
+        {
+        }
+
+        void copyTo(Scene& scene, const EntityId* entities, size_t n) const override
+        {
+            // (A single `storeFor()` and pass over the store for all entities)
+            CompStore<T>* store = scene.storeFor<T>();
+            if(store)
+            {
+                (void)store->setCopies(entities, n, value);
+            }
+        }
+    };
+
+    /// The components in the prefab, along with their type ids.
+    std::vector<std::pair<CompTypeId, std::unique_ptr<CompBase>>> comps_;
+
+    /// Returns the index of the `T` in `comps_`, or `comps_.size()` if there is none.
+    template <typename T>
+    inline size_t indexOf() const
+    {
+        size_t i = 0;
+        for(; i < comps_.size() && comps_[i].first != compTypeId<T>(); i ++);
+        return i;
+    }
+
+public:
+    Prefab() = default;
+    ~Prefab() = default;
+
+    Prefab(Prefab&& toMove) = default;
+    Prefab& operator=(Prefab&& toMove) = default;
+
+    /// Sets or replaces the `T` component of the prefab; returns a pointer to it.
+    template <typename T>
+    T* set(T comp)
+    {
+        size_t i = indexOf<T>();
+        if(i < comps_.size())
+        {
+            T& value = static_cast<Comp<T>*>(comps_[i].second.get())->value;
+            value = std::move(comp);
+            return &value;
+        }
+
+        auto newComp = new Comp<T>(std::move(comp));
+        comps_.emplace_back(compTypeId<T>(), std::unique_ptr<CompBase>(newComp));
+        return &newComp->value;
+    }
+
+    /// Returns a pointer to the `T` component of the prefab, or null if it has none.
+    template <typename T>
+    T* get() const
+    {
+        size_t i = indexOf<T>();
+        return i < comps_.size() ? &static_cast<Comp<T>*>(comps_[i].second.get())->value : nullptr;
+    }
+
+    /// Removes the `T` component from the prefab, if it has one.
+    template <typename T>
+    void erase()
+    {
+        size_t i = indexOf<T>();
+        if(i < comps_.size())
+        {
+            comps_.erase(comps_.begin() + i);
+        }
+    }
+
+    /// Returns the number of components in the prefab.
+    inline size_t nComps() const
+    {
+        return comps_.size();
+    }
+
+    /// Sets a copy of each component in the prefab for each of the `n` `entities`
+    /// in `scene`, one component type at a time. See `Scene::instantiate()`.
+    /// **WARNING**: See `CompStore::set()`'s warnings!
+    inline void copyTo(Scene& scene, const EntityId* entities, size_t n) const
+    {
+        for(const auto& comp : comps_)
+        {
+            comp.second->copyTo(scene, entities, n);
+        }
+    }
+};
+
+}
@@ -1,57 +1,215 @@
 #include "Scene.hh"
 
+#include <algorithm>
+#include <string>
+#include <unordered_map>
 #include <Core/Scene/EntityRef.hh>
 #include <Core/Scene/SceneIterator.hh>
+#include <Core/Scene/Prefab.hh>
 
 namespace Ares
 {
 
+CompTypeId registerCompType(const char* typeName)
+{
+    static std::mutex registryLock;
+    static std::unordered_map<std::string, CompTypeId> registry;
+
+    std::lock_guard<std::mutex> registryScopedLock(registryLock);
+    auto it = registry.find(typeName);
+    if(it == registry.end())
+    {
+        it = registry.emplace(typeName, CompTypeId(registry.size())).first;
+    }
+    return it->second;
+}
+
+constexpr const size_t CompStoreBase::INDEX_PAGE_SIZE;
+constexpr const U32 CompStoreBase::INVALID_SLOT;
+constexpr const size_t Scene::MAX_COMP_TYPES;
+
 Scene::Scene(size_t maxEntities)
-    : maxEntities_(maxEntities)
+    : maxEntities_(maxEntities),
+      generations_(maxEntities), aliveBits_(maxEntities),
+      nUsedIndices_(0), nAlive_(0),
+      signatures_(maxEntities),
+      version_(1)
 {
+    for(auto& store : compStores_)
+    {
+        store.store(nullptr);
+    }
 }
 
 Scene::~Scene()
 {
+    for(auto& store : compStores_)
+    {
+        delete store.exchange(nullptr);
+    }
 }
 
 
-EntityRef Scene::ref(EntityId entity)
+EntityId Scene::allocEntity()
+{
+    U32 index;
+    if(!freeIndices_.empty())
+    {
+        // Reuse the slot of a destroyed entity
+        index = freeIndices_.back();
+        freeIndices_.pop_back();
+    }
+    else if(nUsedIndices_.load() < maxEntities_)
+    {
+        // Use a brand new slot
+        index = nUsedIndices_.fetch_add(1);
+    }
+    else
+    {
+        // Scene full
+        return INVALID_ENTITY_ID;
+    }
+
+    (void)signatures_[index]; // (allocate the page if needed, signature is already 0)
+    U32 generation = generations_[index].fetch_add(1, std::memory_order_acq_rel) + 1; // (even -> odd)
+    aliveBits_.set(index);
+    return EntityId(index, generation);
+}
+
+EntityRef Scene::create()
 {
+    std::lock_guard<std::mutex> entitiesScopedLock(entitiesLock_);
+
+    EntityId entity = allocEntity();
+    if(entity == INVALID_ENTITY_ID)
+    {
+        return EntityRef();
+    }
+
+    nAlive_ ++;
     return EntityRef(this, entity);
 }
 
-bool Scene::has(EntityId entity)
+size_t Scene::create(size_t count, EntityId* outIds)
 {
-    std::lock_guard<std::mutex> compStoresScopedLock(compStoresLock_);
+    std::lock_guard<std::mutex> entitiesScopedLock(entitiesLock_);
 
-    bool present = false;
-    for(auto it = compStores_.begin(); it != compStores_.end(); it ++)
+    size_t nCreated = 0;
+    while(nCreated < count)
     {
-        present |= it->second->has(entity);
+        EntityId entity = allocEntity();
+        if(entity == INVALID_ENTITY_ID)
+        {
+            // Scene full
+            break;
+        }
+        outIds[nCreated ++] = entity;
     }
-    return present;
+
+    nAlive_ += U32(nCreated);
+    return nCreated;
 }
 
-void Scene::erase(EntityId entity)
+size_t Scene::instantiate(const Prefab& prefab, size_t count, EntityId* outIds)
 {
-    std::lock_guard<std::mutex> compStoresScopedLock(compStoresLock_);
+    std::vector<EntityId> tempIds;
+    if(!outIds)
+    {
+        tempIds.resize(count);
+        outIds = tempIds.data();
+    }
 
-    for(auto it = compStores_.begin(); it != compStores_.end(); it ++)
+    size_t nCreated = create(count, outIds);
+    prefab.copyTo(*this, outIds, nCreated);
+    return nCreated;
+}
+
+void Scene::destroy(EntityId entity)
+{
+    std::lock_guard<std::mutex> entitiesScopedLock(entitiesLock_);
+
+    if(!alive(entity))
+    {
+        return;
+    }
+
+    erase(entity);
+
+    generations_[entity.index].fetch_add(1, std::memory_order_acq_rel); // (odd -> even)
+    aliveBits_.clear(entity.index);
+    freeIndices_.push_back(entity.index);
+    nAlive_ --;
+}
+
+bool Scene::restoreEntities(const U32* generations, size_t n)
+{
+    std::lock_guard<std::mutex> entitiesScopedLock(entitiesLock_);
+
+    if(nUsedIndices_.load() != 0 || n > maxEntities_)
+    {
+        return false;
+    }
+
+    U32 nAlive = 0;
+    for(U32 index = 0; index < U32(n); index ++)
+    {
+        (void)signatures_[index]; // (allocate the page if needed)
+        generations_[index].store(generations[index], std::memory_order_release);
+        if(generations[index] & 1)
+        {
+            aliveBits_.set(index);
+            nAlive ++;
+        }
+        else
+        {
+            freeIndices_.push_back(index);
+        }
+    }
+
+    // (Reuse the lowest dead slots first, as `create()` pops from the back)
+    std::reverse(freeIndices_.begin(), freeIndices_.end());
+
+    nAlive_.store(nAlive);
+    nUsedIndices_.store(U32(n));
+    return true;
+}
+
+EntityRef Scene::ref(EntityId entity)
+{
+    return EntityRef(this, entity);
+}
+
+bool Scene::has(EntityId entity)
+{
+    return signature(entity) != 0;
+}
+
+void Scene::erase(EntityId entity)
+{
+    // Only visit the stores that actually hold a component for the entity
+    CompMask mask = signature(entity);
+    for(CompTypeId typeId = 0; mask != 0; typeId ++, mask >>= 1)
     {
-        it->second->erase(entity);
+        if(mask & 1)
+        {
+            CompStoreBase* store = compStores_[typeId].load(std::memory_order_acquire);
+            store->erase(entity);
+        }
     }
 }
 
 
 Scene::iterator Scene::begin()
 {
-    return iterator(this, 0);
+    iterator it(this, 0);
+    it.seek(0, nUsedIndices_.load());
+    it.skipDead();
+    return it;
 }
 
 Scene::iterator Scene::end()
 {
-    return iterator(this, maxEntities_); // (one-past-the-end)
+    return iterator(this, nUsedIndices_.load()); // (one-past-the-end)
 }
 
 
@@ -1,29 +1,60 @@
 #pragma once
 
-#include <unordered_map>
-#include <memory>
-#include <typeinfo>
-#include <typeindex>
+#include <assert.h>
+#include <atomic>
 #include <mutex>
+#include <memory>
+#include <vector>
 #include <Core/Api.h>
+#include <Core/Base/ErrString.hh>
+#include <Core/Base/PagedArray.hh>
+#include <Core/Base/PagedBitSet.hh>
 #include <Core/Scene/EntityId.hh>
+#include <Core/Scene/CompTypeId.hh>
 #include <Core/Scene/CompStore.hh>
 
 namespace Ares
 {
 
 class EntityRef; // #include "EntityRef.hh"
+class SceneSnapshot; // #include "SceneSnapshot.hh"
+class Prefab; // #include "Prefab.hh"
+template <typename... Ts> class SceneView; // #include "SceneView.hh"
 
 /// A collection of entities and the components associated to them.
 class ARES_API Scene
 {
     friend class EntityRef;
+    friend class SceneSnapshot;
 
+public:
+    /// The maximum number of different component types (see `CompTypeId`).
+    static constexpr const size_t MAX_COMP_TYPES = 64;
+    static_assert(MAX_COMP_TYPES <= sizeof(CompMask) * 8, "CompMask too small for MAX_COMP_TYPES");
+
+private:
     size_t maxEntities_;
 
-    using CompStoreSlot = std::unique_ptr<CompStoreBase>;
-    std::unordered_map<std::type_index, CompStoreSlot> compStores_;
-    std::mutex compStoresLock_;
+    /// Entity index -> generation of the slot; incremented both when an entity
+    /// is created in the slot and when it is destroyed, so slots of alive
+    /// entities always have an odd generation and dead/unused ones an even one.
+    PagedArray<std::atomic<U32>> generations_;
+    PagedBitSet aliveBits_; ///< A bit set for each alive entity; for fast iteration.
+    std::vector<U32> freeIndices_; ///< Indices of dead slots, reused by `create()`.
+    std::atomic<U32> nUsedIndices_; ///< All slots at indices >= this are unused.
+    std::atomic<U32> nAlive_; ///< The number of alive entities.
+    std::mutex entitiesLock_; ///< Locked by `create()` and `destroy()`.
+
+    /// Entity index -> the `CompMask` of all components the entity has; kept
+    /// up to date by the `CompStore`s.
+    CompStoreBase::Signatures signatures_;
+
+    std::atomic<U64> version_; ///< See `version()`.
+
+    /// `CompTypeId` -> the store for that type of component, or null if not
+    /// allocated yet. Only set once per slot, then readable without locking.
+    std::atomic<CompStoreBase*> compStores_[MAX_COMP_TYPES];
+    std::mutex compStoresLock_; ///< Only locked to allocate new stores.
 
     Scene(Scene&& toMove) = delete;
     Scene& operator=(Scene&& toMove) = delete;
@@ -31,12 +62,26 @@ class ARES_API Scene
     Scene(const Scene& toCopy) = delete;
     Scene& operator=(const Scene& toCopy) = delete;
 
+    /// Takes a free slot (reusing the ones of destroyed entities first) and
+    /// marks a new entity alive in it; returns its id, or `INVALID_ENTITY_ID`
+    /// if the scene is full. Does not update `nAlive_`.
+    /// **WARNING**: `entitiesLock_` must be locked by the caller!
+    EntityId allocEntity();
+
+    /// Recreates the entities in slots `[0, n)` of an empty scene: slot `i` gets
+    /// generation `generations[i]` (alive if odd, dead if even).
+    /// Returns `false` if the scene is not empty or `n > maxEntities()`.
+    /// (Used by `SceneSnapshot`)
+    bool restoreEntities(const U32* generations, size_t n);
+
 public:
     friend class iterator;
     class iterator;  // #include "SceneIterator.hh"
 
     /// Initializes an empty scene given the maximum number of entities that it
-    /// could hold.
+    /// could hold. Memory for entities and components is allocated in pages as
+    /// they are created, not upfront; a high `maxEntities` only costs the size
+    /// of the page tables.
     Scene(size_t maxEntities);
     ~Scene();
 
@@ -50,44 +95,145 @@ public:
     /// Gets a pointer to the scene's component store for `T`s.
     /// If no store for `T`s was already allocated, creates a new one before
     /// returning a pointer to it.
+    /// Lockless unless the store has to be created.
+    /// Returns null (and writes an error to `outErr`, if any) if `T`'s
+    /// `CompTypeId` does not fit, i.e. there are more than `MAX_COMP_TYPES` types
+    /// of components.
     ///
     /// The pointer should remain valid throughout the lifetime of the scene, even
     /// if other stores are registered in the meantime.
     /// Do not call `delete`/`free()` on it by hand!
     template <typename T>
-    CompStore<T>* storeFor()
+    CompStore<T>* storeFor(ErrString* outErr=nullptr)
     {
-        std::lock_guard<std::mutex> compStoresScopedLock(compStoresLock_);
+        CompTypeId typeId = compTypeId<T>();
+        if(typeId >= MAX_COMP_TYPES)
+        {
+            if(outErr)
+            {
+                *outErr = "Too many component types, increase Scene::MAX_COMP_TYPES";
+            }
+            return nullptr;
+        }
 
-        auto slot = compStores_.find(typeid(T));
-        if(slot == compStores_.end())
+        CompStoreBase* store = compStores_[typeId].load(std::memory_order_acquire);
+        if(!store)
         {
-            // CompStore<T> not present, create one now
-            auto storeBasePtr = std::unique_ptr<CompStoreBase>(new CompStore<T>(maxEntities_));
-            slot = compStores_.insert(std::make_pair(std::type_index(typeid(T)),
-                                                     std::move(storeBasePtr))).first;
+            // CompStore<T> possibly not present, create one now
+            // (unless another thread did so first)
+            std::lock_guard<std::mutex> compStoresScopedLock(compStoresLock_);
+
+            store = compStores_[typeId].load(std::memory_order_relaxed);
+            if(!store)
+            {
+                store = new CompStore<T>(maxEntities_, compMask<T>(), &signatures_, &version_);
+                compStores_[typeId].store(store, std::memory_order_release);
+            }
         }
 
-        CompStoreBase* ptr = slot->second.get();
-        return reinterpret_cast<CompStore<T>*>(ptr);
+        return static_cast<CompStore<T>*>(store);
     }
 
 
+    /// Returns a view over all entities in the scene that have all of the `Ts...`
+    /// components; iterating over it is O(size of the smallest store for `Ts...`).
+    /// Prefer this over iterating over all entities and calling `EntityRef::comp()`.
+    template <typename... Ts>
+    SceneView<Ts...> view(); // #include "SceneView.hh"
+
+
+    /// Creates a new entity with no components and returns a reference to it.
+    /// Reuses the slots of destroyed entities, if any (in O(1)).
+    /// Returns a null reference if the scene already has `maxEntities()` entities.
+    EntityRef create();
+
+    /// Creates up to `count` new entities with no components at once, writing
+    /// their ids to `outIds`; returns the number of entities actually created
+    /// (less than `count` if the scene fills up).
+    /// Only locks the scene once, instead of once per entity like `create()`.
+    size_t create(size_t count, EntityId* outIds);
+
+    /// Creates up to `count` new entities, each with a copy of all components
+    /// in `prefab`; writes their ids to `outIds` (if not null) and returns the
+    /// number of entities created.
+    /// Entities are allocated in bulk, then each component is copied to all of
+    /// them in a single pass over its store.
+    /// **WARNING**: See `CompStore::set()`'s warnings!
+    size_t instantiate(const Prefab& prefab, size_t count, EntityId* outIds=nullptr);
+
+    /// Erases all components of `entity` and destroys it, invalidating all handles
+    /// to it. Does nothing if `entity` is not `alive()`.
+    void destroy(EntityId entity);
+
+    /// Returns `true` if `entity` was `create()`d and not `destroy()`ed yet, i.e.
+    /// if it is a valid, non-stale handle. Threadsafe and lockless.
+    inline bool alive(EntityId entity) const
+    {
+        const std::atomic<U32>* generation = generations_.find(entity.index);
+        return (entity.generation & 1) != 0
+               && generation && generation->load(std::memory_order_acquire) == entity.generation;
+    }
+
+    /// Returns the number of alive entities in the scene.
+    inline size_t nEntities() const
+    {
+        return nAlive_.load();
+    }
+
+    /// Returns the current version of the scene; components set or changed now
+    /// are marked with this version (see `CompStore::changedSince()`).
+    /// Starts at 1.
+    inline U64 version() const
+    {
+        return version_.load();
+    }
+
+    /// Increments the version of the scene and returns the previous one.
+    ///
+    /// Systems that want to only process components that changed since they last
+    /// ran should keep the version returned by this the last time they ran (or 0),
+    /// and process the components that changed since it:
+    /// ```
+    /// U64 since = lastVersion_;
+    /// lastVersion_ = scene->advanceVersion();
+    /// scene->view<Ts...>().eachChangedSince(since, func);
+    /// ```
+    /// Changes that happen after the call (made by tasks scheduled after it, or
+    /// in later frames) are marked with a greater version, so none of them are missed.
+    /// **WARNING**: A change made *concurrently* with the call can still be marked
+    /// with the previous version after the caller already iterated the changes
+    /// since it; it is then missed. Only advance the version when no other task can
+    /// be changing the components tracked, or keep `advanceVersion() - 1` instead
+    /// to revisit the previous version's changes as well next time (processing
+    /// some components twice).
+    inline U64 advanceVersion()
+    {
+        return version_.fetch_add(1);
+    }
+
+    /// Returns the signature of `entity`, i.e. the `CompMask` of all components
+    /// it currently has. Returns 0 if the entity is not `alive()`.
+    inline CompMask signature(EntityId entity) const
+    {
+        return alive(entity) ? signatures_.find(entity.index)->load(std::memory_order_acquire) : 0;
+    }
+
     /// Returns a reference to the entity with the given id in this scene.
-    /// **WARNING**: Referencing an out-of-bounds entity has undefined consequences!
+    /// The reference is not checked for liveness; see `alive()`.
     EntityRef ref(EntityId entity);
 
     /// Returns `true` if any component is associated to `entity` in any store.
     bool has(EntityId entity);
 
-    /// Erases all components associated to `entity` across all scene component stores.
+    /// Erases all components associated to `entity` across all scene component
+    /// stores (only visiting the stores in its `signature()`).
     void erase(EntityId entity);
 
 
-    /// Returns the begin iterator over all entities in the scene.
+    /// Returns the begin iterator over all alive entities in the scene.
     iterator begin();
 
-    /// Returns the end iterator over all entities in the scene.
+    /// Returns the end iterator over all alive entities in the scene.
     iterator end();
 };
 
@@ -0,0 +1,98 @@
+#include "SceneCmdQueue.hh"
+
+#include <Core/Scene/Scene.hh>
+#include <Core/Task/TaskScheduler.hh>
+
+namespace Ares
+{
+
+SceneCmdQueue::SceneCmdQueue(TaskScheduler* scheduler)
+    : scheduler_(scheduler), buffers_(scheduler->nWorkers() + 1)
+{
+}
+
+void SceneCmdQueue::record(Cmd&& cmd)
+{
+    size_t workerIndex = scheduler_->localWorkerIndex();
+    if(workerIndex != TaskScheduler::INVALID_INDEX)
+    {
+        // Only this worker ever records into its buffer, no need to lock
+        buffers_[workerIndex].cmds.push_back(std::move(cmd));
+    }
+    else
+    {
+        std::lock_guard<std::mutex> sharedScopedLock(sharedLock_);
+        buffers_.back().cmds.push_back(std::move(cmd));
+    }
+}
+
+size_t SceneCmdQueue::size() const
+{
+    size_t nCmds = 0;
+    for(const Buffer& buffer : buffers_)
+    {
+        nCmds += buffer.cmds.size();
+    }
+    return nCmds;
+}
+
+void SceneCmdQueue::replay(Scene& scene, Cmd& cmd)
+{
+    switch(cmd.op)
+    {
+    case Create:
+    {
+        EntityRef entity = scene.create();
+        if(entity && cmd.func)
+        {
+            cmd.func(entity);
+        }
+    } break;
+
+    case Destroy:
+    {
+        scene.destroy(cmd.entity); // (No-op if not alive)
+    } break;
+
+    case Set:
+    case Erase:
+    {
+        if(scene.alive(cmd.entity))
+        {
+            cmd.func(scene.ref(cmd.entity));
+        }
+    } break;
+    }
+}
+
+void SceneCmdQueue::flush(Scene& scene)
+{
+    // Replaying a command can record more (ex. from a `Create`'s init function),
+    // appending to the buffer being replayed; so each buffer's commands are
+    // swapped out into `replayCmds_` first. Commands recorded while replaying
+    // are then replayed too, after all others, until no buffer has any left.
+    // (Buffers and `replayCmds_` trade storage, keeping the capacity around)
+    bool anyReplayed = true;
+    while(anyReplayed)
+    {
+        anyReplayed = false;
+        for(Buffer& buffer : buffers_)
+        {
+            if(buffer.cmds.empty())
+            {
+                continue;
+            }
+
+            replayCmds_.clear();
+            std::swap(replayCmds_, buffer.cmds);
+            for(Cmd& cmd : replayCmds_)
+            {
+                replay(scene, cmd);
+            }
+            anyReplayed = true;
+        }
+    }
+    replayCmds_.clear();
+}
+
+}
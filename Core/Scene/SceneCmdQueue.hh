@@ -0,0 +1,154 @@
+#pragma once
+
+#include <stddef.h>
+#include <mutex>
+#include <vector>
+#include <utility>
+#include <functional>
+#include <Core/Api.h>
+#include <Core/Scene/EntityId.hh>
+#include <Core/Scene/EntityRef.hh>
+
+namespace Ares
+{
+
+class Scene; // #include "Scene.hh"
+class TaskScheduler; // #include "Task/TaskScheduler.hh"
+
+/// A queue of deferred structural edits to a `Scene` (entity creation/destruction,
+/// component addition/removal).
+///
+/// `CompStore::set()`/`erase()` and `Scene::create()`/`destroy()` are not safe
+/// to call while other tasks are iterating over the same stores; tasks should
+/// record them here instead, and the core will `flush()` them all in one batch
+/// at the end of the frame, once all update tasks are done (see `Core::run()`).
+///
+/// Each worker thread of the scheduler records into its own buffer, so recording
+/// is lockless from tasks; other threads share a single buffer guarded by a mutex.
+/// Commands recorded by the same thread are replayed in order; the order between
+/// commands recorded by different threads is unspecified.
+class ARES_API SceneCmdQueue
+{
+public:
+    /// The type of a recorded command.
+    enum Op
+    {
+        Create, ///< Create an entity, then run `func` on it.
+        Destroy, ///< Destroy `entity`.
+        Set, ///< Set a component of `entity` (in `func`).
+        Erase, ///< Erase a component of `entity` (in `func`).
+    };
+
+    /// A recorded command.
+    struct Cmd
+    {
+        Op op;
+        EntityId entity; ///< The entity to edit (ignored for `Create`).
+        std::function<void(EntityRef)> func; ///< Run on the (new) entity on replay.
+    };
+
+private:
+    /// The commands recorded by one thread.
+    /// (Padded so that the `cmds` of adjacent buffers are always more than a
+    /// cache line apart, and workers recording concurrently don't false-share;
+    /// `alignas(64)` would not do, as C++14's `std::allocator` ignores over-alignment)
+    struct Buffer
+    {
+        std::vector<Cmd> cmds;
+        char pad[64];
+    };
+
+    TaskScheduler* scheduler_;
+    std::vector<Buffer> buffers_; ///< One per worker, plus one for non-worker threads (the last).
+    std::mutex sharedLock_; ///< Locked when recording into the non-worker threads' buffer.
+    std::vector<Cmd> replayCmds_; ///< The commands being replayed by `flush()`.
+
+    SceneCmdQueue(const SceneCmdQueue& toCopy) = delete;
+    SceneCmdQueue& operator=(const SceneCmdQueue& toCopy) = delete;
+
+    SceneCmdQueue(SceneCmdQueue&& toMove) = delete;
+    SceneCmdQueue& operator=(SceneCmdQueue&& toMove) = delete;
+
+    /// Appends `cmd` to the local thread's buffer.
+    void record(Cmd&& cmd);
+
+    /// Replays `cmd` on `scene`.
+    void replay(Scene& scene, Cmd& cmd);
+
+public:
+    /// Initializes an empty command queue with a buffer for each of `scheduler`'s
+    /// workers.
+    SceneCmdQueue(TaskScheduler* scheduler);
+    ~SceneCmdQueue() = default;
+
+
+    /// Records the creation of a new entity; `init(EntityRef entity)` will be
+    /// called on it just after it is created on replay (to set its components...).
+    /// Nothing is done if the scene is full on replay.
+    inline void create(std::function<void(EntityRef)> init={})
+    {
+        record({Create, INVALID_ENTITY_ID, std::move(init)});
+    }
+
+    /// Records the destruction of `entity`. Does nothing on replay if the entity
+    /// is not alive anymore.
+    inline void destroy(EntityId entity)
+    {
+        record({Destroy, entity, {}});
+    }
+
+    /// Records setting (or replacing) the `T` component of `entity` to `comp`.
+    /// Does nothing on replay if the entity is not alive anymore.
+    /// **WARNING**: `T` must be copy-constructible (it is stored in a `std::function`).
+    template <typename T>
+    inline void set(EntityId entity, T comp)
+    {
+        auto setFunc = [comp](EntityRef entityRef) mutable
+        {
+            entityRef.setComp<T>(std::move(comp));
+        };
+        record({Set, entity, std::move(setFunc)});
+    }
+
+    /// Like `set(entity, comp)`, but then also calls `then(EntityRef entity, T& comp)`
+    /// on replay, with `comp` being the newly-set component at its final address.
+    template <typename T, typename Func>
+    inline void set(EntityId entity, T comp, Func then)
+    {
+        auto setFunc = [comp, then](EntityRef entityRef) mutable
+        {
+            T* newComp = entityRef.setComp<T>(std::move(comp));
+            if(newComp)
+            {
+                then(entityRef, *newComp);
+            }
+        };
+        record({Set, entity, std::move(setFunc)});
+    }
+
+    /// Records erasing the `T` component of `entity`, if it has any.
+    template <typename T>
+    inline void erase(EntityId entity)
+    {
+        auto eraseFunc = [](EntityRef entityRef)
+        {
+            entityRef.erase<T>();
+        };
+        record({Erase, entity, eraseFunc});
+    }
+
+
+    /// Returns the number of commands recorded and not yet flushed.
+    /// **WARNING**: Not threadsafe; only call this when no thread is recording!
+    size_t size() const;
+
+    /// Replays all recorded commands on `scene` and clears the queue.
+    /// Commands on entities that are not alive at replay time are skipped.
+    /// Commands recorded while replaying (ex. by a `create()` init function, on
+    /// the thread calling this) are replayed too, after all the others.
+    /// **WARNING**: Not threadsafe; only call this when no thread is recording
+    ///              or iterating over `scene`!
+    void flush(Scene& scene);
+};
+
+}
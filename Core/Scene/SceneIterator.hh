@@ -18,24 +18,73 @@ public:
 private:
     friend class Scene;
     Scene* parent_;
+    U32 index_; ///< The index of the current entity's slot.
+    U64 bits_; ///< The alive slots in `index_`'s word of the bitset, from `index_` onwards.
     value_type ref_;
 
 
-    constexpr iterator(Scene* parent, EntityId entity)
-        : parent_(parent),
-          ref_{parent_, entity}
+    iterator(Scene* parent, U32 index)
+        : parent_(parent), index_(index), bits_(0),
+          ref_{parent_, EntityId(index, 0)}
     {
     }
 
+    /// Moves to the first alive slot from `index` onwards (or to `end`).
+    /// Dead slots are skipped 64 at a time (see `PagedBitSet::findNext()`).
+    inline void seek(U32 index, U32 end)
+    {
+        index_ = U32(parent_->aliveBits_.findNext(index, end));
+        bits_ = index_ < end ? parent_->aliveBits_.wordFrom(index_) : 0;
+    }
+
+    /// Moves to the next alive slot after the current one; stays inside of the
+    /// cached word of the bitset while it has more bits set.
+    inline void advance(U32 end)
+    {
+        bits_ &= bits_ - 1; // (Clear the current slot's bit)
+        if(bits_ != 0)
+        {
+            index_ = (index_ & ~U32(63)) + ctz64(bits_);
+        }
+        else
+        {
+            seek((index_ | U32(63)) + 1, end);
+        }
+    }
+
+    /// Advances `index_` up to the next slot with an alive entity (if not
+    /// already at one), then updates `ref_` to point to it.
+    void skipDead()
+    {
+        U32 end = parent_->nUsedIndices_.load();
+        U32 generation = 0;
+        while(index_ < end)
+        {
+            generation = parent_->generations_.find(index_)->load(std::memory_order_acquire);
+            if(generation & 1)
+            {
+                // Alive entity found
+                break;
+            }
+            // (Destroyed after its bit was read, keep looking)
+            advance(end);
+        }
+
+        ref_.id_ = EntityId(index_, generation);
+    }
+
 public:
     iterator(const iterator& toCopy)
-        : parent_(toCopy.parent_), ref_(toCopy.ref_)
+        : parent_(toCopy.parent_), index_(toCopy.index_), bits_(toCopy.bits_),
+          ref_(toCopy.ref_)
     {
     }
 
     inline iterator& operator=(const iterator& toCopy)
     {
         parent_ = toCopy.parent_;
+        index_ = toCopy.index_;
+        bits_ = toCopy.bits_;
         ref_ = toCopy.ref_;
 
         return *this;
@@ -55,8 +104,7 @@ public:
 
     inline bool operator==(const iterator& other) const
     {
-        return ref_ == other.ref_ && parent_ == other.parent_;
-        // (Note: if `pair_.entity` matches, then `pair_.component` should also)
+        return index_ == other.index_ && parent_ == other.parent_;
     }
 
     inline bool operator!=(const iterator& other) const
@@ -67,8 +115,9 @@ public:
 
     iterator& operator++() // preincrement
     {
-        // Go to the next entity
-        ref_.id_ ++;
+        // Go to the next alive entity
+        advance(parent_->nUsedIndices_.load());
+        skipDead();
 
         return *this;
     }
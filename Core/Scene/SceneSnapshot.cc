@@ -0,0 +1,257 @@
+#include "SceneSnapshot.hh"
+
+#include <fstream>
+#include <Core/Data/MappedFile.hh>
+
+namespace Ares
+{
+
+constexpr const U32 SceneSnapshot::FORMAT_VERSION;
+constexpr const size_t SceneSnapshot::MAX_NAME_LENGTH;
+constexpr const size_t SceneSnapshot::BLOCK_ALIGNMENT;
+
+namespace
+{
+
+/// The magic bytes at the start of each snapshot file.
+constexpr const char SNAPSHOT_MAGIC[8] = {'A', 'r', 'e', 's', 'S', 'n', 'a', 'p'};
+
+/// Written in native byte order; reads back differently on other platforms.
+constexpr const U32 BYTE_ORDER_MARK = 0x01020304;
+
+// Snapshot file layout (each block padded to `BLOCK_ALIGNMENT` bytes):
+//  FileHeader
+//  U32 generations[nUsedIndices]
+//  For each store: StoreHeader, EntityId entities[nComps], U8 data[dataSize]
+
+struct FileHeader
+{
+    char magic[8];
+    U32 formatVersion;
+    U32 byteOrder;
+    U64 maxEntities; ///< (Of the saved scene; informative only)
+    U32 nUsedIndices; ///< The number of entity slots saved.
+    U32 nStores;
+};
+
+struct StoreHeader
+{
+    char name[SceneSnapshot::MAX_NAME_LENGTH];
+    U32 compSize;
+    U32 encoding;
+    U64 nComps;
+    U64 dataSize;
+};
+
+static_assert(sizeof(EntityId) == 8, "EntityId must be 8 bytes to be saved as-is");
+
+inline size_t alignUp(size_t size)
+{
+    return (size + SceneSnapshot::BLOCK_ALIGNMENT - 1) & ~(SceneSnapshot::BLOCK_ALIGNMENT - 1);
+}
+
+}
+
+
+const SceneSnapshot::CompEntry* SceneSnapshot::findEntry(const char* name) const
+{
+    for(const auto& entry : entries_)
+    {
+        if(strcmp(entry.name, name) == 0)
+        {
+            return &entry;
+        }
+    }
+    return nullptr;
+}
+
+
+ErrString SceneSnapshot::save(Scene& scene, const char* path) const
+{
+    std::ofstream stream(path, std::ios::out | std::ios::binary);
+    if(!stream)
+    {
+        return std::string("Could not open snapshot file for writing: ") + path;
+    }
+
+    auto writeBlock = [&stream](const void* data, size_t size)
+    {
+        static const char padding[BLOCK_ALIGNMENT] = {0};
+        stream.write(reinterpret_cast<const char*>(data), size);
+        stream.write(padding, alignUp(size) - size);
+    };
+
+    U32 nUsedIndices = scene.nUsedIndices_.load();
+
+    FileHeader header = {};
+    memcpy(header.magic, SNAPSHOT_MAGIC, sizeof(header.magic));
+    header.formatVersion = FORMAT_VERSION;
+    header.byteOrder = BYTE_ORDER_MARK;
+    header.maxEntities = scene.maxEntities();
+    header.nUsedIndices = nUsedIndices;
+    header.nStores = U32(entries_.size());
+    writeBlock(&header, sizeof(header));
+
+    std::vector<U32> generations(nUsedIndices);
+    for(U32 index = 0; index < nUsedIndices; index ++)
+    {
+        const std::atomic<U32>* generation = scene.generations_.find(index);
+        generations[index] = generation ? generation->load(std::memory_order_acquire) : 0;
+    }
+    writeBlock(generations.data(), generations.size() * sizeof(U32));
+
+    // (Reused for all stores)
+    std::vector<EntityId> entities;
+    std::vector<char> data;
+    for(const auto& entry : entries_)
+    {
+        entities.clear();
+        data.clear();
+        ErrString err = entry.save(scene, entities, data);
+        if(err)
+        {
+            return std::string("Could not save component \"") + (const char*)entry.name + "\": " + err.str();
+        }
+
+        StoreHeader storeHeader = {};
+        strncpy(storeHeader.name, entry.name, MAX_NAME_LENGTH - 1);
+        storeHeader.compSize = entry.compSize;
+        storeHeader.encoding = U32(entry.encoding);
+        storeHeader.nComps = entities.size();
+        storeHeader.dataSize = data.size();
+        writeBlock(&storeHeader, sizeof(storeHeader));
+        writeBlock(entities.data(), entities.size() * sizeof(EntityId));
+        writeBlock(data.data(), data.size());
+    }
+
+    if(!stream.flush())
+    {
+        return std::string("Could not write snapshot file: ") + path;
+    }
+    return {};
+}
+
+
+ErrString SceneSnapshot::load(Scene& scene, const char* path) const
+{
+    MappedFile file;
+    ErrString err = file.open(path);
+    if(err)
+    {
+        return err;
+    }
+    return load(scene, file.data(), file.size());
+}
+
+ErrString SceneSnapshot::load(Scene& scene, const U8* data, size_t size) const
+{
+    size_t offset = 0;
+
+    // Returns a pointer to the next block of `blockSize` bytes and moves past it,
+    // or returns null if it would go past the end of the data
+    auto readBlock = [data, size, &offset](size_t blockSize) -> const U8*
+    {
+        if(blockSize > size - offset)
+        {
+            return nullptr;
+        }
+        const U8* block = data + offset;
+        offset = alignUp(offset + blockSize) < size ? alignUp(offset + blockSize) : size;
+        return block;
+    };
+
+    // Read and check the header
+    const U8* headerBlock = readBlock(sizeof(FileHeader));
+    if(!headerBlock)
+    {
+        return "Not a scene snapshot (too small)";
+    }
+
+    FileHeader header;
+    memcpy(&header, headerBlock, sizeof(header));
+    if(memcmp(header.magic, SNAPSHOT_MAGIC, sizeof(header.magic)) != 0)
+    {
+        return "Not a scene snapshot (wrong magic)";
+    }
+    if(header.formatVersion != FORMAT_VERSION)
+    {
+        return "Unsupported snapshot format version: " + std::to_string(header.formatVersion);
+    }
+    if(header.byteOrder != BYTE_ORDER_MARK)
+    {
+        return "Snapshot was saved on a platform with a different byte order";
+    }
+    if(header.nUsedIndices > scene.maxEntities())
+    {
+        return "Snapshot has more entities (" + std::to_string(header.nUsedIndices)
+               + ") than the scene can hold";
+    }
+
+    // Recreate the entities
+    const U8* generations = readBlock(size_t(header.nUsedIndices) * sizeof(U32));
+    if(!generations)
+    {
+        return "Truncated snapshot (entities)";
+    }
+    if(!scene.restoreEntities(reinterpret_cast<const U32*>(generations), header.nUsedIndices))
+    {
+        return "Scene to load the snapshot into is not empty";
+    }
+
+    // Fill in the stores
+    for(U32 i = 0; i < header.nStores; i ++)
+    {
+        const U8* storeHeaderBlock = readBlock(sizeof(StoreHeader));
+        if(!storeHeaderBlock)
+        {
+            return "Truncated snapshot (store header)";
+        }
+
+        StoreHeader storeHeader;
+        memcpy(&storeHeader, storeHeaderBlock, sizeof(storeHeader));
+        storeHeader.name[MAX_NAME_LENGTH - 1] = '\0';
+
+        if(storeHeader.nComps > size / sizeof(EntityId))
+        {
+            return std::string("Truncated snapshot (component \"") + storeHeader.name + "\")";
+        }
+        const U8* entitiesBlock = readBlock(size_t(storeHeader.nComps) * sizeof(EntityId));
+        const U8* dataBlock = entitiesBlock ? readBlock(size_t(storeHeader.dataSize)) : nullptr;
+        if(!entitiesBlock || !dataBlock)
+        {
+            return std::string("Truncated snapshot (component \"") + storeHeader.name + "\")";
+        }
+
+        const CompEntry* entry = findEntry(storeHeader.name);
+        if(!entry)
+        {
+            // Component type not registered, skip it
+            continue;
+        }
+        if(storeHeader.compSize != entry->compSize || storeHeader.encoding != U32(entry->encoding))
+        {
+            return std::string("Component \"") + storeHeader.name
+                   + "\" has a different size or encoding in the snapshot";
+        }
+
+        auto entities = reinterpret_cast<const EntityId*>(entitiesBlock);
+        size_t nComps = size_t(storeHeader.nComps);
+        for(size_t j = 0; j < nComps; j ++)
+        {
+            if(!scene.alive(entities[j]))
+            {
+                return std::string("Component \"") + storeHeader.name + "\" of a dead entity in the snapshot";
+            }
+        }
+
+        ErrString err = entry->load(scene, entities, nComps, dataBlock, size_t(storeHeader.dataSize));
+        if(err)
+        {
+            return std::string("Could not load component \"") + storeHeader.name + "\": " + err.str();
+        }
+    }
+
+    return {};
+}
+
+}
@@ -0,0 +1,252 @@
+#pragma once
+
+#include <stddef.h>
+#include <string.h>
+#include <string>
+#include <vector>
+#include <sstream>
+#include <functional>
+#include <type_traits>
+#include <Core/Api.h>
+#include <Core/Base/NumTypes.hh>
+#include <Core/Base/ErrString.hh>
+#include <Core/Base/KeyString.hh>
+#include <Core/Base/Serializer.hh>
+#include <Core/Scene/EntityId.hh>
+#include <Core/Scene/EntityRef.hh>
+#include <Core/Scene/Scene.hh>
+
+namespace Ares
+{
+
+/// Saves the entities and components of a `Scene` to a binary file, and loads
+/// them back into an empty scene - for level loading and save states.
+///
+/// Only the component types `registerComp()`ed (with the same names) when saving
+/// and loading are stored. Each store is written as contiguous blocks: the ids
+/// of its entities, then its components. Trivially copyable components are
+/// written as raw memory, so loading them is a `memcpy()` per page of the store
+/// straight from the memory-mapped file (see `MappedFile`), plus an optional
+/// fixup pass; other components go through their `Serializer<T>`.
+///
+/// Entities keep their ids (index and generation) across a save and load, so
+/// `EntityId`s stored in components stay valid without any fixup.
+///
+/// Snapshots are in the native byte order and component layout; loading a
+/// snapshot saved by a build with a different byte order or component size
+/// fails with an error instead of producing garbage.
+class ARES_API SceneSnapshot
+{
+public:
+    /// The version of the snapshot format; snapshots of other versions are rejected.
+    static constexpr const U32 FORMAT_VERSION = 1;
+
+    /// The maximum length of a component type's name, '\0' included.
+    static constexpr const size_t MAX_NAME_LENGTH = 32;
+
+    /// The alignment of each block of data in a snapshot file.
+    static constexpr const size_t BLOCK_ALIGNMENT = 16;
+
+    /// Called on each component after it was loaded as raw memory, to patch up
+    /// whatever cannot survive a round trip to disk (pointers, handles...).
+    template <typename T>
+    using FixupFunc = std::function<void(EntityRef entity, T& comp)>;
+
+private:
+    /// How the components of a store are encoded.
+    enum class Encoding : U32
+    {
+        Raw = 0, ///< As an array of `T`s.
+        Serialized = 1, ///< As the concatenated output of `Serializer<T>::serialize()`.
+    };
+
+    /// A component type known to the snapshot.
+    struct CompEntry
+    {
+        KeyString<MAX_NAME_LENGTH> name;
+        U32 compSize;
+        Encoding encoding;
+
+        /// Appends the ids of all entities with a component in the store to
+        /// `entities` and the components themselves to `data`.
+        std::function<ErrString(Scene& scene, std::vector<EntityId>& entities,
+                           std::vector<char>& data)> save;
+
+        /// Fills the (empty) store from `n` entities and `dataSize` bytes of
+        /// component data.
+        std::function<ErrString(Scene& scene, const EntityId* entities, size_t n,
+                                const U8* data, size_t dataSize)> load;
+    };
+    std::vector<CompEntry> entries_;
+
+    /// Returns the entry registered with `name`, or null if there is none.
+    const CompEntry* findEntry(const char* name) const;
+
+    template <typename T>
+    void addEntry(const char* name, FixupFunc<T> fixup, std::true_type isTriviallyCopyable);
+
+    template <typename T>
+    void addEntry(const char* name, FixupFunc<T> fixup, std::false_type isTriviallyCopyable);
+
+public:
+    SceneSnapshot() = default;
+    ~SceneSnapshot() = default;
+
+    /// Registers `T` components to be saved/loaded under the given `name`, which
+    /// must be unique and shorter than `MAX_NAME_LENGTH`.
+    /// Trivially copyable `T`s are stored as raw memory, and `fixup` (if any) is
+    /// run on each of them after loading; other `T`s need a `Serializer<T>`.
+    template <typename T>
+    void registerComp(const char* name, FixupFunc<T> fixup=nullptr)
+    {
+        addEntry<T>(name, std::move(fixup), std::integral_constant<bool, std::is_trivially_copyable<T>::value>());
+    }
+
+    /// Writes all entities in `scene` and their registered components to a
+    /// snapshot file at `path`. Returns an error on failure.
+    /// **WARNING**: Not threadsafe! Nothing must modify the scene in the meantime.
+    ErrString save(Scene& scene, const char* path) const;
+
+    /// Memory-maps the snapshot file at `path` and loads it into `scene`, which
+    /// must be empty (no entity ever created in it). Returns an error on failure;
+    /// on error the scene may be left partially loaded.
+    /// Stores of component types that are not registered are skipped.
+    /// **WARNING**: Not threadsafe! Nothing must access the scene in the meantime.
+    ErrString load(Scene& scene, const char* path) const;
+
+    /// Like `load(scene, path)`, but reads the snapshot from the `size` bytes at
+    /// `data`, which must be aligned to 16 bytes.
+    ErrString load(Scene& scene, const U8* data, size_t size) const;
+};
+
+
+template <typename T>
+void SceneSnapshot::addEntry(const char* name, FixupFunc<T> fixup, std::true_type isTriviallyCopyable)
+{
+    static_assert(alignof(T) <= BLOCK_ALIGNMENT, "Component too aligned to be loaded in place");
+
+    CompEntry entry;
+    entry.name = KeyString<MAX_NAME_LENGTH>(name);
+    entry.compSize = U32(sizeof(T));
+    entry.encoding = Encoding::Raw;
+
+    entry.save = [](Scene& scene, std::vector<EntityId>& entities, std::vector<char>& data) -> ErrString
+    {
+        ErrString err;
+        CompStore<T>* store = scene.storeFor<T>(&err);
+        if(!store)
+        {
+            return err;
+        }
+        data.resize(store->size() * sizeof(T));
+
+        char* out = data.data();
+        auto saveFunc = [store, &entities, &out](size_t slot)
+        {
+            entities.push_back(store->entityAt(U32(slot)));
+            memcpy(out, store->compAt(U32(slot)), sizeof(T));
+            out += sizeof(T);
+        };
+        store->forEachSlot(0, store->nSlots(), saveFunc);
+        return {};
+    };
+
+    entry.load = [fixup](Scene& scene, const EntityId* entities, size_t n,
+                         const U8* data, size_t dataSize) -> ErrString
+    {
+        if(dataSize != n * sizeof(T))
+        {
+            return "Wrong size of component data";
+        }
+
+        ErrString err;
+        CompStore<T>* store = scene.storeFor<T>(&err);
+        if(!store)
+        {
+            return err;
+        }
+        if(!store->restoreBlock(entities, reinterpret_cast<const T*>(data), n))
+        {
+            return "Invalid or duplicate entities in component data";
+        }
+
+        if(fixup)
+        {
+            // (Components are in slots [0, n) in the same order as `entities`)
+            for(size_t i = 0; i < n; i ++)
+            {
+                fixup(scene.ref(entities[i]), *store->compAt(U32(i)));
+            }
+        }
+        return {};
+    };
+
+    entries_.push_back(std::move(entry));
+}
+
+template <typename T>
+void SceneSnapshot::addEntry(const char* name, FixupFunc<T> fixup, std::false_type isTriviallyCopyable)
+{
+    // (`fixup` is only meaningful for raw components; `Serializer<T>` does its job)
+    CompEntry entry;
+    entry.name = KeyString<MAX_NAME_LENGTH>(name);
+    entry.compSize = U32(sizeof(T));
+    entry.encoding = Encoding::Serialized;
+
+    entry.save = [](Scene& scene, std::vector<EntityId>& entities, std::vector<char>& data) -> ErrString
+    {
+        ErrString err;
+        CompStore<T>* store = scene.storeFor<T>(&err);
+        if(!store)
+        {
+            return err;
+        }
+
+        std::ostringstream stream(std::ios::out | std::ios::binary);
+        auto saveFunc = [store, &entities, &stream](size_t slot)
+        {
+            entities.push_back(store->entityAt(U32(slot)));
+            (void)Serializer<T>::serialize(*store->compAt(U32(slot)), stream);
+        };
+        store->forEachSlot(0, store->nSlots(), saveFunc);
+        if(!stream)
+        {
+            return "Could not serialize component";
+        }
+
+        std::string str = stream.str();
+        data.assign(str.begin(), str.end());
+        return {};
+    };
+
+    entry.load = [](Scene& scene, const EntityId* entities, size_t n,
+                    const U8* data, size_t dataSize) -> ErrString
+    {
+        std::istringstream stream(std::string(reinterpret_cast<const char*>(data), dataSize),
+                                  std::ios::in | std::ios::binary);
+
+        ErrString err;
+        CompStore<T>* store = scene.storeFor<T>(&err);
+        if(!store)
+        {
+            return err;
+        }
+        for(size_t i = 0; i < n; i ++)
+        {
+            T comp;
+            if(!Serializer<T>::deserialize(comp, stream))
+            {
+                return "Could not deserialize component";
+            }
+            if(!store->set(entities[i], std::move(comp)))
+            {
+                return "Invalid entity in component data";
+            }
+        }
+        return {};
+    };
+
+    entries_.push_back(std::move(entry));
+}
+
+}
@@ -0,0 +1,185 @@
+#pragma once
+
+#include <stddef.h>
+#include <tuple>
+#include <atomic>
+#include <utility>
+#include <initializer_list>
+#include <Core/Api.h>
+#include <Core/Scene/Scene.hh>
+#include <Core/Scene/CompStore.hh>
+#include <Core/Task/ParallelFor.hh>
+
+namespace Ares
+{
+
+/// A query over all entities in a scene that have all of the `Ts...` components.
+/// See `Scene::view()`.
+///
+/// Iteration is driven by the smallest of the `CompStore`s for `Ts...`; for each
+/// entity in it, its signature is tested against the view's `CompMask` and the
+/// entity is skipped if any of the components is missing; the stores are only
+/// probed for entities that do match.
+///
+/// Components never move in their stores, so it is safe to add/erase components
+/// while iterating over a view (from the thread that is iterating); entities that
+/// get components added during iteration may or may not be visited though.
+template <typename... Ts>
+class ARES_API SceneView
+{
+    friend class Scene;
+
+    std::tuple<CompStore<Ts>*...> stores_;
+    CompStoreBase* driver_; ///< The smallest of `stores_` (null if any store is missing).
+    const CompStoreBase::Signatures* signatures_; ///< (See `Scene::signature()`)
+    CompMask mask_; ///< The mask of all `Ts...`.
+
+    SceneView(const CompStoreBase::Signatures* signatures, CompStore<Ts>*... stores)
+        : stores_(stores...), driver_(nullptr),
+          signatures_(signatures), mask_(0)
+    {
+        (void)std::initializer_list<int>{(mask_ |= compMask<Ts>(), 0)...};
+
+        for(CompStoreBase* store : std::initializer_list<CompStoreBase*>{stores...})
+        {
+            if(!store)
+            {
+                // (`Scene::storeFor()` failed; the view is always empty)
+                driver_ = nullptr;
+                break;
+            }
+            if(!driver_ || store->nSlots() < driver_->nSlots())
+            {
+                driver_ = store;
+            }
+        }
+    }
+
+    /// Returns `true` if the component of any of the `Ts...` for `entity`
+    /// changed after `version`.
+    template <size_t... Is>
+    inline bool anyChangedSince(EntityId entity, U64 version, std::index_sequence<Is...>) const
+    {
+        bool changed = false;
+        (void)std::initializer_list<int>{
+            (changed = changed || std::get<Is>(stores_)->changedSince(entity, version), 0)...};
+        return changed;
+    }
+
+    /// Returns `true` if any component in any of the `Ts...` stores changed (or
+    /// was erased) after `version`.
+    template <size_t... Is>
+    inline bool anyStoreChangedSince(U64 version, std::index_sequence<Is...>) const
+    {
+        bool changed = false;
+        (void)std::initializer_list<int>{
+            (changed = changed || std::get<Is>(stores_)->lastChangeVersion() > version, 0)...};
+        return changed;
+    }
+
+    template <typename Func, size_t... Is>
+    inline void eachImpl(const Func& func, size_t begin, size_t end,
+                         std::index_sequence<Is...>)
+    {
+        // (Only visits used slots of the driver store)
+        auto slotFunc = [this, &func](size_t slot)
+        {
+            EntityId entity = driver_->entityAt(U32(slot));
+            if(entity == INVALID_ENTITY_ID)
+            {
+                // (Erased during iteration, after its word of the bitset was read)
+                return;
+            }
+
+            CompMask signature = signatures_->find(entity.index)->load(std::memory_order_relaxed);
+            if((signature & mask_) == mask_)
+            {
+                // (The components of the entity in the stores are all there)
+                func(entity, *std::get<Is>(stores_)->get(entity)...);
+            }
+        };
+        if(driver_)
+        {
+            driver_->forEachSlot(begin, end, slotFunc);
+        }
+    }
+
+public:
+    /// Returns an upper bound to the number of entities in the view (i.e. the
+    /// number of slots of the smallest store). Chunks passed to `each(func, begin, end)`
+    /// are in the `[0, size())` range.
+    inline size_t size() const
+    {
+        return driver_ ? driver_->nSlots() : 0;
+    }
+
+    /// Runs `func(EntityId entity, Ts&... comps)` for each entity in the view.
+    /// Components are **not** marked as changed; call `CompStore::markChanged()`
+    /// for the ones that `func` modifies, if any.
+    template <typename Func>
+    inline void each(const Func& func)
+    {
+        eachImpl(func, 0, size(), std::index_sequence_for<Ts...>{});
+    }
+
+    /// Like `each(func)`, but only for the entities in the `[begin, end)` chunk
+    /// of the view.
+    template <typename Func>
+    inline void each(const Func& func, size_t begin, size_t end)
+    {
+        end = end < size() ? end : size();
+        eachImpl(func, begin, end, std::index_sequence_for<Ts...>{});
+    }
+
+    /// Like `each(func)`, but only for the entities any of whose `Ts...` components
+    /// were set or marked as changed after `version` (see `Scene::advanceVersion()`).
+    template <typename Func>
+    inline void eachChangedSince(U64 version, const Func& func)
+    {
+        if(!changedSince(version))
+        {
+            // Nothing changed, no need to visit anything
+            return;
+        }
+
+        auto changedFunc = [this, version, &func](EntityId entity, Ts&... comps)
+        {
+            if(anyChangedSince(entity, version, std::index_sequence_for<Ts...>{}))
+            {
+                func(entity, comps...);
+            }
+        };
+        each(changedFunc);
+    }
+
+    /// Returns `true` if any component of the `Ts...` was set, erased or marked
+    /// as changed after `version` (i.e. if the results of iterating over the view
+    /// might have changed since).
+    inline bool changedSince(U64 version) const
+    {
+        return driver_ && anyStoreChangedSince(version, std::index_sequence_for<Ts...>{});
+    }
+
+    /// Like `each(func)`, but runs over chunks of `chunkSize` entities as parallel
+    /// tasks on `scheduler` and waits for them to complete (see `parallelFor()`).
+    /// `func` will be run on multiple threads concurrently; it must be threadsafe
+    /// and must not add/erase components of any of the `Ts...`!
+    template <typename Func>
+    inline void eachParallel(TaskScheduler& scheduler, size_t chunkSize, const Func& func)
+    {
+        auto chunkFunc = [this, &func](size_t begin, size_t end)
+        {
+            eachImpl(func, begin, end, std::index_sequence_for<Ts...>{});
+        };
+        parallelFor(scheduler, size(), chunkSize, chunkFunc);
+    }
+};
+
+
+template <typename... Ts>
+SceneView<Ts...> Scene::view()
+{
+    return SceneView<Ts...>(&signatures_, storeFor<Ts>()...);
+}
+
+}
@@ -0,0 +1,375 @@
+#include "SpatialIndex.hh"
+
+#include <assert.h>
+#include <algorithm>
+#include <Core/Scene/Scene.hh>
+#include <Core/Scene/EntityRef.hh>
+#include <Core/Scene/SceneView.hh>
+#include <Core/Comp/TransformComp.hh>
+#include <Core/Comp/WorldTransformComp.hh>
+#include <Core/Comp/BoundsComp.hh>
+
+namespace Ares
+{
+
+constexpr const U32 SpatialIndex::NULL_NODE;
+
+SpatialIndex::SpatialIndex(float margin)
+    : margin_(margin), root_(NULL_NODE), freeList_(NULL_NODE), nLeaves_(0), lastVersion_(0)
+{
+}
+
+U32 SpatialIndex::allocNode()
+{
+    U32 node;
+    if(freeList_ != NULL_NODE)
+    {
+        node = freeList_;
+        freeList_ = nodes_[node].parent;
+    }
+    else
+    {
+        node = U32(nodes_.size());
+        nodes_.emplace_back();
+    }
+
+    nodes_[node].parent = NULL_NODE;
+    nodes_[node].child1 = nodes_[node].child2 = NULL_NODE;
+    nodes_[node].height = 0;
+    nodes_[node].entity = INVALID_ENTITY_ID;
+    return node;
+}
+
+void SpatialIndex::freeNode(U32 node)
+{
+    nodes_[node].parent = freeList_;
+    nodes_[node].height = -1;
+    freeList_ = node;
+}
+
+void SpatialIndex::insertLeaf(U32 leaf)
+{
+    if(root_ == NULL_NODE)
+    {
+        root_ = leaf;
+        nodes_[leaf].parent = NULL_NODE;
+        return;
+    }
+
+    // Find the best sibling for the leaf, descending the tree by the cheapest
+    // (surface area heuristic) child
+    const Aabb leafBox = nodes_[leaf].box;
+    U32 index = root_;
+    while(!nodes_[index].isLeaf())
+    {
+        const Node& node = nodes_[index];
+
+        float area = node.box.area();
+        float combinedArea = Aabb::merge(node.box, leafBox).area();
+
+        // Cost of creating a new parent for this node and the leaf, and the
+        // minimum cost of pushing the leaf further down the tree
+        float cost = 2.0f * combinedArea;
+        float inheritanceCost = 2.0f * (combinedArea - area);
+
+        auto childCost = [this, &leafBox, inheritanceCost](U32 child)
+        {
+            const Node& childNode = nodes_[child];
+            float mergedArea = Aabb::merge(childNode.box, leafBox).area();
+            return childNode.isLeaf() ? mergedArea + inheritanceCost
+                                      : mergedArea - childNode.box.area() + inheritanceCost;
+        };
+        float cost1 = childCost(node.child1);
+        float cost2 = childCost(node.child2);
+
+        if(cost < cost1 && cost < cost2)
+        {
+            break;
+        }
+        index = cost1 < cost2 ? node.child1 : node.child2;
+    }
+    U32 sibling = index;
+
+    // Create a new parent for the sibling and the leaf
+    U32 oldParent = nodes_[sibling].parent;
+    U32 newParent = allocNode();
+    nodes_[newParent].parent = oldParent;
+    nodes_[newParent].box = Aabb::merge(leafBox, nodes_[sibling].box);
+    nodes_[newParent].height = nodes_[sibling].height + 1;
+    nodes_[newParent].child1 = sibling;
+    nodes_[newParent].child2 = leaf;
+    nodes_[sibling].parent = newParent;
+    nodes_[leaf].parent = newParent;
+
+    if(oldParent != NULL_NODE)
+    {
+        Node& oldParentNode = nodes_[oldParent];
+        (oldParentNode.child1 == sibling ? oldParentNode.child1 : oldParentNode.child2) = newParent;
+    }
+    else
+    {
+        root_ = newParent;
+    }
+
+    // Walk back up the tree, fixing heights and boxes
+    index = nodes_[leaf].parent;
+    while(index != NULL_NODE)
+    {
+        index = balance(index);
+
+        Node& node = nodes_[index];
+        node.height = 1 + std::max(nodes_[node.child1].height, nodes_[node.child2].height);
+        node.box = Aabb::merge(nodes_[node.child1].box, nodes_[node.child2].box);
+
+        index = node.parent;
+    }
+}
+
+void SpatialIndex::removeLeaf(U32 leaf)
+{
+    if(leaf == root_)
+    {
+        root_ = NULL_NODE;
+        return;
+    }
+
+    U32 parent = nodes_[leaf].parent;
+    U32 grandParent = nodes_[parent].parent;
+    U32 sibling = nodes_[parent].child1 == leaf ? nodes_[parent].child2 : nodes_[parent].child1;
+
+    if(grandParent != NULL_NODE)
+    {
+        // Replace the parent with the sibling
+        Node& grandParentNode = nodes_[grandParent];
+        (grandParentNode.child1 == parent ? grandParentNode.child1 : grandParentNode.child2) = sibling;
+        nodes_[sibling].parent = grandParent;
+        freeNode(parent);
+
+        // Walk back up the tree, fixing heights and boxes
+        U32 index = grandParent;
+        while(index != NULL_NODE)
+        {
+            index = balance(index);
+
+            Node& node = nodes_[index];
+            node.height = 1 + std::max(nodes_[node.child1].height, nodes_[node.child2].height);
+            node.box = Aabb::merge(nodes_[node.child1].box, nodes_[node.child2].box);
+
+            index = node.parent;
+        }
+    }
+    else
+    {
+        root_ = sibling;
+        nodes_[sibling].parent = NULL_NODE;
+        freeNode(parent);
+    }
+}
+
+U32 SpatialIndex::balance(U32 iA)
+{
+    Node& a = nodes_[iA];
+    if(a.isLeaf() || a.height < 2)
+    {
+        return iA;
+    }
+
+    U32 iB = a.child1, iC = a.child2;
+    Node& b = nodes_[iB];
+    Node& c = nodes_[iC];
+    I32 imbalance = c.height - b.height;
+
+    // Rotates `iUp` (a child of `A`) up in place of `A`; `A` takes the place of
+    // the shortest child of `iUp`, and `iOther` (`A`'s other child) stays under `A`
+    auto rotate = [this, iA](U32 iUp, U32 iOther, bool upIsChild2)
+    {
+        Node& a = nodes_[iA];
+        Node& up = nodes_[iUp];
+        U32 iF = up.child1, iG = up.child2;
+        Node& f = nodes_[iF];
+        Node& g = nodes_[iG];
+
+        // Swap A and `up`
+        up.child1 = iA;
+        up.parent = a.parent;
+        a.parent = iUp;
+
+        if(up.parent != NULL_NODE)
+        {
+            Node& parent = nodes_[up.parent];
+            (parent.child1 == iA ? parent.child1 : parent.child2) = iUp;
+        }
+        else
+        {
+            root_ = iUp;
+        }
+
+        // Keep the tallest of `up`'s children under `up`, move the other one under A
+        U32 iKeep = f.height > g.height ? iF : iG;
+        U32 iMove = f.height > g.height ? iG : iF;
+        up.child2 = iKeep;
+        (upIsChild2 ? a.child2 : a.child1) = iMove;
+        nodes_[iMove].parent = iA;
+
+        a.box = Aabb::merge(nodes_[iOther].box, nodes_[iMove].box);
+        up.box = Aabb::merge(a.box, nodes_[iKeep].box);
+        a.height = 1 + std::max(nodes_[iOther].height, nodes_[iMove].height);
+        up.height = 1 + std::max(a.height, nodes_[iKeep].height);
+    };
+
+    if(imbalance > 1)
+    {
+        // C is too tall, rotate it up
+        rotate(iC, iB, true);
+        return iC;
+    }
+    else if(imbalance < -1)
+    {
+        // B is too tall, rotate it up
+        rotate(iB, iC, false);
+        return iB;
+    }
+    return iA;
+}
+
+void SpatialIndex::place(EntityId entity, const Aabb& tight)
+{
+    if(entity.index >= leaves_.size())
+    {
+        leaves_.resize(entity.index + 1, NULL_NODE);
+    }
+
+    U32 leaf = leaves_[entity.index];
+    if(leaf != NULL_NODE)
+    {
+        if(nodes_[leaf].box.contains(tight))
+        {
+            // Still inside of its fat box, no need to touch the tree
+            nodes_[leaf].tight = tight;
+            nodes_[leaf].entity = entity;
+            return;
+        }
+        removeLeaf(leaf);
+    }
+    else
+    {
+        leaf = allocNode();
+        leaves_[entity.index] = leaf;
+        nLeaves_ ++;
+    }
+
+    nodes_[leaf].entity = entity;
+    nodes_[leaf].tight = tight;
+    nodes_[leaf].box = tight.grown(margin_);
+    insertLeaf(leaf);
+}
+
+void SpatialIndex::remove(EntityId entity)
+{
+    if(entity.index >= leaves_.size() || leaves_[entity.index] == NULL_NODE)
+    {
+        return;
+    }
+
+    U32 leaf = leaves_[entity.index];
+    removeLeaf(leaf);
+    freeNode(leaf);
+    leaves_[entity.index] = NULL_NODE;
+    nLeaves_ --;
+}
+
+void SpatialIndex::update(Scene& scene)
+{
+    U64 sinceVersion = lastVersion_;
+    lastVersion_ = scene.advanceVersion();
+
+    CompStore<BoundsComp>* boundsStore = scene.storeFor<BoundsComp>();
+    CompStore<TransformComp>* transformStore = scene.storeFor<TransformComp>();
+    CompStore<WorldTransformComp>* worldStore = scene.storeFor<WorldTransformComp>();
+    if(!boundsStore || !transformStore || !worldStore)
+    {
+        // (Too many component types; nothing to index)
+        return;
+    }
+
+    // Remove entities that were destroyed or lost their bounds/transform (only
+    // the ones whose component was erased since the last update are checked;
+    // nothing can have been placed before recording starts, on the first update)
+    boundsStore->recordErased(true);
+    transformStore->recordErased(true);
+    erased_.clear();
+    boundsStore->takeErased(erased_);
+    transformStore->takeErased(erased_);
+    for(EntityId entity : erased_)
+    {
+        U32 leaf = entity.index < leaves_.size() ? leaves_[entity.index] : NULL_NODE;
+        if(leaf != NULL_NODE && nodes_[leaf].entity == entity
+           && (!scene.alive(entity) || !boundsStore->has(entity) || !transformStore->has(entity)))
+        {
+            remove(entity);
+        }
+    }
+
+    // (Re)place entities whose bounds or local/world transform changed
+    auto placeFunc = [this, worldStore](EntityId entity, BoundsComp& boundsComp, TransformComp& transformComp)
+    {
+        const WorldTransformComp* worldComp = worldStore->get(entity);
+        place(entity, boundsComp.box.transformed(worldComp ? worldComp->matrix : transformComp.matrix()));
+    };
+    scene.view<BoundsComp, TransformComp>().eachChangedSince(sinceVersion, placeFunc);
+
+    auto placeChildFunc = [this](EntityId entity, BoundsComp& boundsComp, WorldTransformComp& worldComp)
+    {
+        place(entity, boundsComp.box.transformed(worldComp.matrix));
+    };
+    scene.view<BoundsComp, WorldTransformComp>().eachChangedSince(sinceVersion, placeChildFunc);
+}
+
+void SpatialIndex::queryBox(const Aabb& box, std::vector<EntityId>& out) const
+{
+    auto test = [&box](const Aabb& nodeBox)
+    {
+        return nodeBox.overlaps(box);
+    };
+    auto func = [&out](EntityId entity, const Aabb& bounds)
+    {
+        out.push_back(entity);
+    };
+    visit(test, func);
+}
+
+void SpatialIndex::querySphere(const glm::vec3& center, float radius, std::vector<EntityId>& out) const
+{
+    auto test = [&center, radius](const Aabb& nodeBox)
+    {
+        return nodeBox.overlapsSphere(center, radius);
+    };
+    auto func = [&out](EntityId entity, const Aabb& bounds)
+    {
+        out.push_back(entity);
+    };
+    visit(test, func);
+}
+
+void SpatialIndex::queryFrustum(const Frustum& frustum, std::vector<EntityId>& out) const
+{
+    auto test = [&frustum](const Aabb& nodeBox)
+    {
+        return frustum.intersects(nodeBox);
+    };
+    auto func = [&out](EntityId entity, const Aabb& bounds)
+    {
+        out.push_back(entity);
+    };
+    visit(test, func);
+}
+
+void SpatialIndex::queryBoxes(const Aabb* boxes, size_t n, std::vector<EntityId>* outs) const
+{
+    for(size_t i = 0; i < n; i ++)
+    {
+        queryBox(boxes[i], outs[i]);
+    }
+}
+
+}
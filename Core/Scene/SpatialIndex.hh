@@ -0,0 +1,168 @@
+#pragma once
+
+#include <stddef.h>
+#include <vector>
+#include <glm/vec3.hpp>
+#include <Core/Api.h>
+#include <Core/Base/NumTypes.hh>
+#include <Core/Base/Aabb.hh>
+#include <Core/Base/Frustum.hh>
+#include <Core/Scene/EntityId.hh>
+
+namespace Ares
+{
+
+class Scene; // #include "Scene.hh"
+
+/// A spatial index over all entities in a scene that have a `BoundsComp` and
+/// a `TransformComp`, to quickly find the ones in a box, sphere or frustum.
+///
+/// Implemented as a dynamic AABB tree (as in Box2D's `b2DynamicTree`): each
+/// entity is a leaf with a "fat" box, its world bounds grown by a margin, so
+/// that small movements do not require touching the tree; inner nodes are
+/// kept balanced by rotations on insertion/removal.
+///
+/// `update()` is incremental: only entities whose bounds/transforms changed
+/// since the last update are reinserted (see `Scene::advanceVersion()`), and
+/// only those whose bounds/transform were erased are checked for removal (see
+/// `CompStoreBase::takeErased()`; the index consumes the scene's records).
+/// Queries are `const` and never modify the tree, so any number of tasks can
+/// run them concurrently - as long as `update()` is not running at the same
+/// time. The core updates its index once per frame, after all update tasks
+/// are done (see `GlobalData::spatialIndex`).
+class ARES_API SpatialIndex
+{
+public:
+    /// The index of an invalid node.
+    static constexpr const U32 NULL_NODE = U32(-1);
+
+private:
+    struct Node
+    {
+        Aabb box; ///< The fat box for leaves, the union of the children's boxes for inner nodes.
+        Aabb tight; ///< The actual world bounds of the entity (leaves only).
+        U32 parent; ///< The parent node; the next free node for free nodes.
+        U32 child1, child2; ///< `NULL_NODE` for leaves.
+        I32 height; ///< 0 for leaves, -1 for free nodes.
+        EntityId entity; ///< (Leaves only)
+
+        inline bool isLeaf() const
+        {
+            return child1 == NULL_NODE;
+        }
+    };
+
+    float margin_;
+    std::vector<Node> nodes_;
+    U32 root_;
+    U32 freeList_;
+    size_t nLeaves_;
+    std::vector<U32> leaves_; ///< Entity index -> leaf node (or `NULL_NODE`).
+    std::vector<EntityId> erased_; ///< (Scratch buffer for `update()`)
+    U64 lastVersion_; ///< The scene version at the last `update()`.
+
+    U32 allocNode();
+    void freeNode(U32 node);
+
+    void insertLeaf(U32 leaf);
+    void removeLeaf(U32 leaf);
+
+    /// Performs a left or right rotation if the subtree rooted at `node` is
+    /// imbalanced; returns the new root of the subtree.
+    U32 balance(U32 node);
+
+    /// Inserts `entity` into the tree with the given world bounds, or moves it
+    /// there if it was already in the tree.
+    void place(EntityId entity, const Aabb& tight);
+
+    /// Removes `entity` from the tree (if it is in it).
+    void remove(EntityId entity);
+
+public:
+    /// Initializes an empty index; leaves are fattened by `margin` in all directions.
+    SpatialIndex(float margin=0.1f);
+    ~SpatialIndex() = default;
+
+    /// Updates the index from the `BoundsComp`s, `TransformComp`s and
+    /// `WorldTransformComp`s of entities in `scene` that changed since the last
+    /// update (or that were destroyed/lost their bounds).
+    /// **WARNING**: Not threadsafe! No query must be running on another thread.
+    void update(Scene& scene);
+
+    /// Returns the number of entities in the index.
+    inline size_t size() const
+    {
+        return nLeaves_;
+    }
+
+    /// Returns the height of the tree (0 if it is empty or has a single entity).
+    inline size_t height() const
+    {
+        return root_ != NULL_NODE ? size_t(nodes_[root_].height) : 0;
+    }
+
+
+    /// Runs `func(EntityId entity, const Aabb& bounds)` for each entity whose
+    /// world bounds pass `test(const Aabb& box)`. `test` is also used to cull
+    /// entire subtrees, so it must return `true` for any box that contains
+    /// one that passes it.
+    template <typename Test, typename Func>
+    void visit(const Test& test, const Func& func) const
+    {
+        if(root_ == NULL_NODE)
+        {
+            return;
+        }
+
+        // (A depth-first traversal never has more than `height + 1` nodes pending)
+        static constexpr const size_t FIXED_STACK_SIZE = 64;
+        U32 fixedStack[FIXED_STACK_SIZE];
+        std::vector<U32> bigStack;
+        U32* stack = fixedStack;
+        if(height() + 2 > FIXED_STACK_SIZE)
+        {
+            bigStack.resize(height() + 2);
+            stack = bigStack.data();
+        }
+
+        size_t top = 0;
+        stack[top ++] = root_;
+        while(top > 0)
+        {
+            const Node& node = nodes_[stack[-- top]];
+            if(!test(node.box))
+            {
+                continue;
+            }
+
+            if(node.isLeaf())
+            {
+                if(test(node.tight))
+                {
+                    func(node.entity, node.tight);
+                }
+            }
+            else
+            {
+                stack[top ++] = node.child1;
+                stack[top ++] = node.child2;
+            }
+        }
+    }
+
+    /// Appends to `out` all entities whose world bounds overlap `box`.
+    void queryBox(const Aabb& box, std::vector<EntityId>& out) const;
+
+    /// Appends to `out` all entities whose world bounds overlap the sphere at
+    /// `center` with the given `radius`.
+    void querySphere(const glm::vec3& center, float radius, std::vector<EntityId>& out) const;
+
+    /// Appends to `out` all entities whose world bounds are (at least partially)
+    /// inside of `frustum`.
+    void queryFrustum(const Frustum& frustum, std::vector<EntityId>& out) const;
+
+    /// Runs `queryBox(boxes[i], outs[i])` for each of the `n` boxes.
+    void queryBoxes(const Aabb* boxes, size_t n, std::vector<EntityId>* outs) const;
+};
+
+}
@@ -1,6 +1,7 @@
 #pragma once
 
 #include <stddef.h>
+#include <assert.h>
 #include <utility>
 #include <Core/Base/NumTypes.hh>
 
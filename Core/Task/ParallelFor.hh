@@ -0,0 +1,52 @@
+#pragma once
+
+#include <stddef.h>
+#include <vector>
+#include <Core/Api.h>
+#include <Core/Task/Task.hh>
+#include <Core/Task/TaskVar.hh>
+#include <Core/Task/TaskScheduler.hh>
+
+namespace Ares
+{
+
+/// Splits the range `[0, n)` into chunks of (at most) `chunkSize` elements and
+/// runs `func(begin, end)` for each chunk as a separate task on `scheduler`,
+/// then waits for all of them to complete (see `TaskScheduler::waitFor()`).
+/// `func` is run concurrently on multiple threads, it must be threadsafe!
+template <typename Func>
+void parallelFor(TaskScheduler& scheduler, size_t n, size_t chunkSize, const Func& func)
+{
+    if(n == 0)
+    {
+        return;
+    }
+    chunkSize = chunkSize > 0 ? chunkSize : 1;
+
+    struct Chunk
+    {
+        const Func* func;
+        size_t begin, end;
+    };
+    static const auto chunkFunc = [](TaskScheduler* scheduler, void* data)
+    {
+        auto chunk = reinterpret_cast<const Chunk*>(data);
+        (*chunk->func)(chunk->begin, chunk->end);
+    };
+
+    size_t nChunks = (n + chunkSize - 1) / chunkSize;
+    std::vector<Chunk> chunks(nChunks);
+    std::vector<Task> tasks(nChunks);
+    for(size_t i = 0; i < nChunks; i ++)
+    {
+        size_t begin = i * chunkSize;
+        chunks[i] = {&func, begin, begin + chunkSize < n ? begin + chunkSize : n};
+        tasks[i] = {chunkFunc, &chunks[i]};
+    }
+
+    TaskVar var{0};
+    scheduler.schedule(tasks.data(), nChunks, &var);
+    scheduler.waitFor(var);
+}
+
+}
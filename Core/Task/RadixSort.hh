@@ -0,0 +1,139 @@
+#pragma once
+
+#include <stddef.h>
+#include <array>
+#include <vector>
+#include <algorithm>
+#include <Core/Base/NumTypes.hh>
+#include <Core/Task/TaskScheduler.hh>
+#include <Core/Task/ParallelFor.hh>
+
+namespace Ares
+{
+
+/// The default `chunkSize` for `radixSort()`.
+static constexpr const size_t RADIX_SORT_CHUNK_SIZE = 16 * 1024;
+
+/// Sorts `n` items (lo to hi) by the 64-bit key returned by `key(item)`, via a
+/// LSD radix sort that handles 8 bits of the keys per pass. The sort is stable.
+///
+/// `temp` must have room for `n` items; the sorted items are put back into
+/// `items`, while `temp` is left with undefined contents. Passes for the bytes
+/// of the keys that have the same value for all items are skipped, so sorting
+/// keys that only use few of their bits is cheaper.
+///
+/// If `scheduler` is not null and `n > chunkSize`, the items are split in
+/// chunks of `chunkSize` items that are counted and scattered in parallel (via
+/// `parallelFor()`) for each pass.
+/// `key` is run concurrently on multiple threads in that case, it must be threadsafe!
+template <typename T, typename KeyFunc>
+void radixSort(T* items, T* temp, size_t n, const KeyFunc& key,
+               TaskScheduler* scheduler=nullptr, size_t chunkSize=RADIX_SORT_CHUNK_SIZE)
+{
+    static constexpr const unsigned int RADIX_BITS = 8;
+    static constexpr const unsigned int RADIX_SIZE = 1 << RADIX_BITS;
+    static constexpr const unsigned int N_PASSES = (sizeof(U64) * 8) / RADIX_BITS;
+    using Histogram = std::array<size_t, RADIX_SIZE>;
+
+    if(n <= 1)
+    {
+        return;
+    }
+
+    bool parallel = scheduler && n > chunkSize;
+    chunkSize = parallel ? chunkSize : n;
+    size_t nChunks = (n + chunkSize - 1) / chunkSize;
+
+    // Runs `func(chunkIndex, begin, end)` for each chunk, in parallel if possible
+    auto forEachChunk = [&](const auto& func)
+    {
+        auto chunkFunc = [&](size_t begin, size_t end)
+        {
+            func(begin / chunkSize, begin, end);
+        };
+        if(parallel)
+        {
+            parallelFor(*scheduler, n, chunkSize, chunkFunc);
+        }
+        else
+        {
+            chunkFunc(0, n);
+        }
+    };
+
+    // Find out which bits differ between keys, to skip the passes that would
+    // leave the items in the same order
+    U64 firstKey = key(items[0]);
+    std::vector<U64> chunkDiffBits(nChunks, 0);
+    forEachChunk([&](size_t chunkI, size_t begin, size_t end)
+    {
+        U64 diffBits = 0;
+        for(size_t i = begin; i < end; i ++)
+        {
+            diffBits |= key(items[i]) ^ firstKey;
+        }
+        chunkDiffBits[chunkI] = diffBits;
+    });
+    U64 diffBits = 0;
+    for(U64 chunkBits : chunkDiffBits)
+    {
+        diffBits |= chunkBits;
+    }
+
+    std::vector<Histogram> chunkOffsets(nChunks);
+    T* src = items;
+    T* dst = temp;
+    for(unsigned int pass = 0; pass < N_PASSES; pass ++)
+    {
+        unsigned int shift = pass * RADIX_BITS;
+        if(((diffBits >> shift) & (RADIX_SIZE - 1)) == 0)
+        {
+            continue;
+        }
+
+        // Count the occurrences of each digit in each chunk...
+        forEachChunk([&](size_t chunkI, size_t begin, size_t end)
+        {
+            Histogram& counts = chunkOffsets[chunkI];
+            counts.fill(0);
+            for(size_t i = begin; i < end; i ++)
+            {
+                counts[(key(src[i]) >> shift) & (RADIX_SIZE - 1)] ++;
+            }
+        });
+
+        // ...turn the counts into the offset in `dst` where each chunk will put
+        // its first item with each digit (all items with a lower digit come
+        // first, then ones with the same digit from previous chunks)...
+        size_t offset = 0;
+        for(unsigned int digit = 0; digit < RADIX_SIZE; digit ++)
+        {
+            for(size_t chunkI = 0; chunkI < nChunks; chunkI ++)
+            {
+                size_t count = chunkOffsets[chunkI][digit];
+                chunkOffsets[chunkI][digit] = offset;
+                offset += count;
+            }
+        }
+
+        // ...then scatter the items, keeping their relative order in each bucket
+        forEachChunk([&](size_t chunkI, size_t begin, size_t end)
+        {
+            Histogram& offsets = chunkOffsets[chunkI];
+            for(size_t i = begin; i < end; i ++)
+            {
+                dst[offsets[(key(src[i]) >> shift) & (RADIX_SIZE - 1)] ++] = src[i];
+            }
+        });
+
+        std::swap(src, dst);
+    }
+
+    if(src != items)
+    {
+        // (Odd number of passes run, the results are in `temp`)
+        std::copy(src, src + n, items);
+    }
+}
+
+}
@@ -1,6 +1,14 @@
 #include "TaskScheduler.hh"
 
 #include <atomic>
+#include <Core/Base/Platform.h>
+#ifdef ARES_PLATFORM_IS_WINDOWS
+#   define WIN32_LEAN_AND_MEAN
+#   include <windows.h>
+#elif defined(__linux__)
+#   include <pthread.h>
+#   include <sched.h>
+#endif
 
 namespace Ares
 {
@@ -12,9 +20,28 @@ unsigned int TaskScheduler::optimalNWorkers()
 }
 
 
-TaskScheduler::TaskScheduler(unsigned int nWorkers, unsigned int nFibers, size_t fiberStackSize)
+/// Attempts to pin `thread` to the `index`th hardware thread; returns `false`
+/// on error or if thread pinning is not supported on this platform.
+static bool pinThread(std::thread& thread, unsigned int index)
+{
+#ifdef ARES_PLATFORM_IS_WINDOWS
+    DWORD_PTR mask = DWORD_PTR(1) << index;
+    return SetThreadAffinityMask(thread.native_handle(), mask) != 0;
+#elif defined(__linux__)
+    cpu_set_t cpuSet;
+    CPU_ZERO(&cpuSet);
+    CPU_SET(index, &cpuSet);
+    return pthread_setaffinity_np(thread.native_handle(), sizeof(cpuSet), &cpuSet) == 0;
+#else
+    (void)thread; (void)index;
+    return false;
+#endif
+}
+
+TaskScheduler::TaskScheduler(unsigned int nWorkers, unsigned int nFibers, size_t fiberStackSize,
+                             bool pinWorkers)
     : nWorkers_(nWorkers), nFibers_(nFibers),
-      fiberStacks_(nFibers, fiberStackSize)
+      fiberStacks_(nFibers, fiberStackSize), nExternalWaiters_(0)
 {
     workers_ = new std::thread[nWorkers_];
     workerData_ = new WorkerData[nWorkers_];
@@ -31,10 +58,17 @@ TaskScheduler::TaskScheduler(unsigned int nWorkers, unsigned int nFibers, size_t
     running_ = true;
     ready_ = false;
 
+    unsigned int nHardwareThreads = std::thread::hardware_concurrency();
     for(unsigned int j = 0; j < nWorkers_; j ++)
     {
         workers_[j] = std::thread(workerLoop, this);
-        // FIXME IMPLEMENT IMPORTANT Pin thread to physical thread for [much] better performance
+
+        if(pinWorkers && nHardwareThreads > 0)
+        {
+            // Hardware thread #0 is left for the main thread; wrap around if there
+            // are more workers than hardware threads
+            (void)pinThread(workers_[j], (j + 1) % nHardwareThreads);
+        }
     }
 
     // Unlock workers and start spinning
@@ -144,13 +178,19 @@ void TaskScheduler::waitFor(TaskVar& var, TaskVarValue target)
     }
     else
     {
-        // `waitFor()` was called from another thread: spinlock
-        // FIXME Replace this with something more sensible!
-        //       (Would the system work better if the list of waiting fibers was
-        //       a shared lockless list instead of being a private per-worker list?)
+        // `waitFor()` was called from another thread: sleep until a worker
+        // decrements `var` to `target`.
+        // (`nExternalWaiters_` is incremented before checking `var`, and workers
+        // decrement `var` before checking `nExternalWaiters_`; so either this
+        // sees the final value of `var` or the worker sees this waiter and
+        // notifies it - which can't happen before it sleeps, as it holds `waitingMutex_`)
+        std::unique_lock<std::mutex> waitLock(waitingMutex_);
+        nExternalWaiters_ ++;
         while(var.load() != target)
         {
+            waitingCond_.wait(waitLock);
         }
+        nExternalWaiters_ --;
     }
 }
 
@@ -172,13 +212,27 @@ Fiber* TaskScheduler::lockingGrabFiber()
     return fiber;
 }
 
+/// The scheduler the local thread was last found to be a worker of, and the
+/// index of the worker (see `TaskScheduler::localWorkerIndex()`).
+/// NOTE Fibers never migrate between workers (a waiting fiber is resumed by the
+///      same worker that suspended it), so caching this per-thread is safe.
+static thread_local const TaskScheduler* localScheduler = nullptr;
+static thread_local size_t localIndex = size_t(-1);
+
 size_t TaskScheduler::localWorkerIndex()
 {
+    if(localScheduler == this)
+    {
+        return localIndex;
+    }
+
     for(unsigned int i = 0; i < nWorkers_; i ++)
     {
         if(std::this_thread::get_id() == workers_[i].get_id())
         {
-            // Found this worker thread
+            // Found this worker thread; cache its index for subsequent calls
+            localScheduler = this;
+            localIndex = i;
             return i;
         }
     }
@@ -248,8 +302,14 @@ void TaskScheduler::fiberFunc(void* data)
 
         if(taskSlot.var)
         {
-            // Then atomically decrement its var when done, if any
+            // Then atomically decrement its var when done, if any, and wake up
+            // any non-worker thread that could be waiting for it (see `waitFor()`)
             std::atomic_fetch_sub(taskSlot.var, TaskVarValue(1));
+            if(scheduler->nExternalWaiters_.load() > 0)
+            {
+                std::lock_guard<std::mutex> waitLock(scheduler->waitingMutex_);
+                scheduler->waitingCond_.notify_all();
+            }
         }
     }
     else
@@ -26,9 +26,11 @@ namespace Ares
 /// and inspired by the implementation of task_scheduler in FiberTaskingLib
 class ARES_API TaskScheduler
 {
-    // A returned index that means "invalid".
+public:
+    /// A returned index that means "invalid".
     static constexpr const size_t INVALID_INDEX = -1;
 
+private:
     // The amount of attempts to grab a free fiber (`lockingGrabFiber()`) after
     // which a deadlock is very likely
     static constexpr const size_t GRAB_DEADLOCK_THRES = 100;
@@ -67,14 +69,16 @@ class ARES_API TaskScheduler
     std::mutex sleepingMutex_;
     std::condition_variable sleepingCond_;
 
+    /// Non-worker threads in `waitFor()` sleep on `waitingCond_`; it is notified
+    /// whenever a task var is decremented while `nExternalWaiters_ > 0`.
+    std::mutex waitingMutex_;
+    std::condition_variable waitingCond_;
+    std::atomic<unsigned int> nExternalWaiters_;
+
     /// Keeps attempting to grab a fiber until it succeeds, then returns it.
     /// **ASSERTS** `false` if the number of attempts grabbing a fiber exceeeds `GRAB_DEADLOCK_THRES`
     Fiber* lockingGrabFiber();
 
-    /// Returns the index of the local worker thread, or `INVALID_INDEX` if the
-    /// local thread is not a worker thread.
-    size_t localWorkerIndex();
-
     /// The function that each fiber in the scheduler will run: grabs a task,
     /// executes it, switches to itself if the scheduler is still `running_`.
     static void fiberFunc(void* data);
@@ -92,8 +96,11 @@ public:
     /// Initializes a task scheduler that will spin `nWorkers` worker threads,
     /// sharing a pool of `nFibers` fibers each with `fiberStackSize` bytes of
     /// stack.
+    /// If `pinWorkers` is `true`, the `i`th worker thread is pinned to the
+    /// `(i + 1)`th hardware thread (the first one is left to the main thread).
     TaskScheduler(unsigned int nWorkers,
-                  unsigned int nFibers=200, size_t fiberStackSize=128*1024);
+                  unsigned int nFibers=200, size_t fiberStackSize=128*1024,
+                  bool pinWorkers=false);
     ~TaskScheduler();
 
 
@@ -108,9 +115,16 @@ public:
     /// Waits for the value inside `var` to reach `target`. If there is to wait,
     /// the task running on the local thread is suspended and other ones are
     /// executed while waiting (so that CPU cycles are not wasted busy-waiting).
+    /// Non-worker threads (ex. the main thread) sleep until `var` reaches `target` instead.
+    /// (Only changes made to `var` by the scheduler, i.e. tasks finishing, wake them up)
     void waitFor(TaskVar& var, TaskVarValue target=0);
 
 
+    /// Returns the index of the local worker thread (in `[0, nWorkers())`), or
+    /// `INVALID_INDEX` if the local thread is not a worker thread of this scheduler.
+    /// Cached per-thread, so cheap to call after the first time.
+    size_t localWorkerIndex();
+
     /// Returns the number of worker threads for this scheduler.
     inline unsigned int nWorkers() const
     {